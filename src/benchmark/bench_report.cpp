@@ -0,0 +1,250 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+
+#include "benchmark/bench_report.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
+namespace benchmark
+{
+
+//-----------------------------------------------------------------------------
+
+double Bench_Result::median() const
+{
+    if (seconds.size() == 0)
+    {
+        return 0.0;
+    }
+    std::vector<double> sorted = seconds;
+    std::sort(sorted.begin(), sorted.end());
+    size_t mid = sorted.size() / 2;
+    if (sorted.size() % 2 == 0)
+    {
+        return (sorted[mid - 1] + sorted[mid]) / 2.0;
+    }
+    return sorted[mid];
+}
+
+//-----------------------------------------------------------------------------
+
+double Bench_Result::mean() const
+{
+    if (seconds.size() == 0)
+    {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (double sec : seconds)
+    {
+        sum += sec;
+    }
+    return sum / seconds.size();
+}
+
+//-----------------------------------------------------------------------------
+
+double Bench_Result::stddev() const
+{
+    if (seconds.size() < 2)
+    {
+        return 0.0;
+    }
+    double avg = mean();
+    double sum = 0.0;
+    for (double sec : seconds)
+    {
+        sum += (sec - avg) * (sec - avg);
+    }
+    return std::sqrt(sum / (seconds.size() - 1));
+}
+
+//-----------------------------------------------------------------------------
+
+double Bench_Result::min() const
+{
+    if (seconds.size() == 0)
+    {
+        return 0.0;
+    }
+    return *std::min_element(seconds.begin(), seconds.end());
+}
+
+//-----------------------------------------------------------------------------
+
+Bench_Report::Bench_Report(size_t repeat, size_t warmup)
+{
+    _repeat = std::max(repeat, (size_t)1);
+    _warmup = warmup;
+}
+
+//-----------------------------------------------------------------------------
+
+Bench_Result& Bench_Report::time(const std::string& name, size_t pixels, size_t bytes, std::function<void()> func)
+{
+    Bench_Result result;
+    result.name = name;
+    result.pixels = pixels;
+    result.bytes = bytes;
+
+    for (size_t i = 0; i < _warmup; i++)
+    {
+        func();
+    }
+    for (size_t i = 0; i < _repeat; i++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        func();
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        result.seconds.push_back(elapsed.count());
+    }
+
+    log(result);
+    _results.emplace_back(result);
+    return _results.back();
+}
+
+//-----------------------------------------------------------------------------
+
+void Bench_Report::log(const Bench_Result& result) const
+{
+    double sec = std::max(result.median(), 1.0e-12);
+    double spread = 100.0 * result.stddev() / sec;
+    logit_s << std::left << std::setw(36) << result.name << std::right << std::setw(12) << (sec * 1.0e9 / std::max(result.pixels, (size_t)1)) << " ns/pixel "
+            << std::setw(12) << (result.pixels / sec) << " pixels/s";
+    if (result.bytes > 0)
+    {
+        logit_s << std::setw(10) << (result.bytes / sec / (1024.0 * 1024.0)) << " MB/s";
+    }
+    logit_s << "  +-" << std::setprecision(3) << spread << "% (" << result.seconds.size() << " runs)" << std::setprecision(6) << "\n";
+}
+
+//-----------------------------------------------------------------------------
+
+static std::string json_escape(const std::string& str)
+{
+    std::string out;
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (c == '\n')
+        {
+            out += "\\n";
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    return out;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Bench_Report::save_json(const std::string& filename) const
+{
+    std::ofstream out(filename);
+    if (false == out.is_open())
+    {
+        logE << "Could not open " << filename << " to save benchmark results\n";
+        return false;
+    }
+
+    out << std::setprecision(10);
+    out << "{\n  \"info\": {";
+    bool first = true;
+    for (const auto& itr : _info)
+    {
+        out << (first ? "\n" : ",\n") << "    \"" << json_escape(itr.first) << "\": \"" << json_escape(itr.second) << "\"";
+        first = false;
+    }
+    out << "\n  },\n  \"repeat\": " << _repeat << ",\n  \"warmup\": " << _warmup << ",\n  \"results\": [";
+
+    first = true;
+    for (const Bench_Result& result : _results)
+    {
+        double sec = std::max(result.median(), 1.0e-12);
+        out << (first ? "\n" : ",\n") << "    {\n";
+        out << "      \"name\": \"" << json_escape(result.name) << "\",\n";
+        out << "      \"pixels\": " << result.pixels << ",\n";
+        out << "      \"bytes\": " << result.bytes << ",\n";
+        out << "      \"median_s\": " << result.median() << ",\n";
+        out << "      \"mean_s\": " << result.mean() << ",\n";
+        out << "      \"stddev_s\": " << result.stddev() << ",\n";
+        out << "      \"min_s\": " << result.min() << ",\n";
+        out << "      \"ns_per_pixel\": " << (sec * 1.0e9 / std::max(result.pixels, (size_t)1)) << ",\n";
+        out << "      \"pixels_per_s\": " << (result.pixels / sec) << ",\n";
+        out << "      \"mb_per_s\": " << (result.bytes / sec / (1024.0 * 1024.0)) << ",\n";
+        for (const auto& itr : result.extra)
+        {
+            out << "      \"" << json_escape(itr.first) << "\": " << itr.second << ",\n";
+        }
+        out << "      \"seconds\": [";
+        for (size_t i = 0; i < result.seconds.size(); i++)
+        {
+            out << (i > 0 ? ", " : "") << result.seconds[i];
+        }
+        out << "]\n    }";
+        first = false;
+    }
+    out << "\n  ]\n}\n";
+
+    logI << "Saved benchmark results to " << filename << "\n";
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+} //namespace benchmark
@@ -0,0 +1,129 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#ifndef BENCH_REPORT_H
+#define BENCH_REPORT_H
+
+#include "core/defines.h"
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace benchmark
+{
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Bench_Result struct : Timings of one benchmark, one entry per repetition.
+///
+struct Bench_Result
+{
+    std::string name;
+
+    // pixels (or items) processed by one repetition
+    size_t pixels;
+
+    // bytes processed by one repetition, 0 if it does not apply
+    size_t bytes;
+
+    std::vector<double> seconds;
+
+    // values specific to a benchmark, ex: file size
+    std::map<std::string, double> extra;
+
+    double median() const;
+
+    double mean() const;
+
+    double stddev() const;
+
+    double min() const;
+};
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Bench_Report class : Runs each benchmark warmup + repeat times, logs the statistics and saves them as json
+///
+class Bench_Report
+{
+public:
+
+    Bench_Report(size_t repeat, size_t warmup);
+
+    ///
+    /// \brief time : Time func, it processes pixels pixels and bytes bytes per call
+    /// \return the result, valid until the next call
+    ///
+    Bench_Result& time(const std::string& name, size_t pixels, size_t bytes, std::function<void()> func);
+
+    // name = value pairs saved with the results, ex: channels, tag
+    void set_info(const std::string& name, const std::string& value) { _info[name] = value; }
+
+    void log(const Bench_Result& result) const;
+
+    bool save_json(const std::string& filename) const;
+
+    size_t repeat() const { return _repeat; }
+
+private:
+
+    size_t _repeat;
+
+    size_t _warmup;
+
+    std::map<std::string, std::string> _info;
+
+    std::vector<Bench_Result> _results;
+};
+
+//-----------------------------------------------------------------------------
+
+} //namespace benchmark
+
+#endif // BENCH_REPORT_H
@@ -0,0 +1,190 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+
+#include "benchmark/fit_benchmark.h"
+#include "io/file/hl_file_io.h"
+#include "fitting/models/gaussian_model.h"
+#include "fitting/optimizers/lmfit_optimizer.h"
+
+#include <random>
+
+namespace benchmark
+{
+
+// number of distinct synthetic spectra, pixels cycle through them
+#define SYNTHETIC_POOL_SIZE 64
+
+//-----------------------------------------------------------------------------
+
+void benchmark_fitting(Bench_Report& report, const std::string& dataset_dir, const std::string& reference_dir, size_t num_pixels, size_t num_channels)
+{
+    if (false == io::load_element_info(reference_dir + "henke.xdr", reference_dir + "xrf_library.csv"))
+    {
+        logE << "fitting benchmark: could not load element info from " << reference_dir << "\n";
+        return;
+    }
+
+    data_struct::Params_Override override_params;
+    if (false == io::load_override_params(dataset_dir, -1, &override_params))
+    {
+        logE << "fitting benchmark: could not load override parameters from " << dataset_dir << "\n";
+        return;
+    }
+    data_struct::Fit_Element_Map_Dict* elements_to_fit = &override_params.elements_to_fit;
+
+    fitting::models::Gaussian_Model model;
+    model.update_fit_params_values(&override_params.fit_params);
+    data_struct::Range energy_range = data_struct::get_energy_range(num_channels, &override_params.fit_params);
+
+    // synthetic pixels: model spectra with random element amplitudes and poisson noise
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<real_t> amplitude(0.0, 3.0);
+    std::uniform_real_distribution<real_t> livetime(0.05, 0.1);
+    std::vector<data_struct::Spectra> pool;
+    for (size_t p = 0; p < SYNTHETIC_POOL_SIZE; p++)
+    {
+        data_struct::Fit_Parameters fit_params = model.fit_parameters();
+        for (const auto& itr : *elements_to_fit)
+        {
+            fit_params.add_parameter(data_struct::Fit_Param(itr.first, amplitude(gen)));
+        }
+        data_struct::Spectra modeled = model.model_spectrum(&fit_params, elements_to_fit, nullptr, energy_range);
+
+        data_struct::Spectra spectra(num_channels);
+        spectra.setZero();
+        for (int i = 0; i < modeled.size(); i++)
+        {
+            std::poisson_distribution<int> noise(std::max(modeled[i], (real_t)0.0) + (real_t)0.001);
+            spectra[energy_range.min + i] = (real_t)noise(gen);
+        }
+        real_t elt = livetime(gen);
+        spectra.elapsed_livetime(elt);
+        spectra.elapsed_realtime(elt * (real_t)1.1);
+        spectra.input_counts(spectra.sum());
+        spectra.output_counts(spectra.sum());
+        pool.push_back(spectra);
+    }
+
+    size_t num_bytes = num_pixels * num_channels * sizeof(real_t);
+    logI << "fitting: " << num_pixels << " pixels, " << num_channels << " channels, " << elements_to_fit->size() << " elements\n";
+
+    real_t energy_offset = override_params.fit_params.value(STR_ENERGY_OFFSET);
+    real_t energy_slope = override_params.fit_params.value(STR_ENERGY_SLOPE);
+    real_t energy_quad = override_params.fit_params.value(STR_ENERGY_QUADRATIC);
+    real_t snip_width = override_params.fit_params.value(STR_SNIP_WIDTH);
+    report.time("snip_background", num_pixels, num_bytes, [&]()
+    {
+        for (size_t i = 0; i < num_pixels; i++)
+        {
+            data_struct::ArrayXr background = data_struct::snip_background(&pool[i % SYNTHETIC_POOL_SIZE], energy_offset, energy_slope, energy_quad, snip_width, energy_range.min, energy_range.max);
+        }
+    });
+
+    data_struct::Fit_Parameters model_params = model.fit_parameters();
+    for (const auto& itr : *elements_to_fit)
+    {
+        model_params.add_parameter(data_struct::Fit_Param(itr.first, (real_t)1.0));
+    }
+    report.time("model_spectrum", num_pixels, num_bytes, [&]()
+    {
+        for (size_t i = 0; i < num_pixels; i++)
+        {
+            data_struct::Spectra modeled = model.model_spectrum(&model_params, elements_to_fit, nullptr, energy_range);
+        }
+    });
+
+    fitting::optimizers::LMFit_Optimizer optimizer;
+    for (data_struct::Fitting_Routines proc_type : { data_struct::Fitting_Routines::ROI,
+                                                     data_struct::Fitting_Routines::SVD,
+                                                     data_struct::Fitting_Routines::NNLS,
+                                                     data_struct::Fitting_Routines::GAUSS_MATRIX,
+                                                     data_struct::Fitting_Routines::GAUSS_TAILS })
+    {
+        fitting::routines::Base_Fit_Routine* fit_routine = io::generate_fit_routine(proc_type, &optimizer);
+        if (fit_routine == nullptr)
+        {
+            continue;
+        }
+        fit_routine->initialize(&model, elements_to_fit, energy_range);
+
+        size_t fit_pixels = num_pixels;
+        if (proc_type == data_struct::Fitting_Routines::GAUSS_TAILS)
+        {
+            fit_pixels = std::max((size_t)1, num_pixels / 100);
+        }
+
+        std::unordered_map<std::string, real_t> out_counts;
+        report.time("fit_spectra " + data_struct::Fitting_Routine_To_Str.at(proc_type), fit_pixels, fit_pixels * num_channels * sizeof(real_t), [&]()
+        {
+            for (size_t i = 0; i < fit_pixels; i++)
+            {
+                fit_routine->fit_spectra(&model, &pool[i % SYNTHETIC_POOL_SIZE], elements_to_fit, out_counts);
+            }
+        });
+
+        if (proc_type == data_struct::Fitting_Routines::ROI
+            || proc_type == data_struct::Fitting_Routines::SVD
+            || proc_type == data_struct::Fitting_Routines::NNLS)
+        {
+            // same pixels through the block api, the pool is fitted as one row
+            data_struct::ArrayXXr block_counts(SYNTHETIC_POOL_SIZE, elements_to_fit->size() + 2);
+            size_t num_blocks = std::max((size_t)1, fit_pixels / SYNTHETIC_POOL_SIZE);
+            report.time("fit_block " + data_struct::Fitting_Routine_To_Str.at(proc_type), num_blocks * SYNTHETIC_POOL_SIZE, num_blocks * SYNTHETIC_POOL_SIZE * num_channels * sizeof(real_t), [&]()
+            {
+                for (size_t i = 0; i < num_blocks; i++)
+                {
+                    fit_routine->fit_block(&model, &pool[0], SYNTHETIC_POOL_SIZE, elements_to_fit, block_counts);
+                }
+            });
+        }
+        delete fit_routine;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+} //namespace benchmark
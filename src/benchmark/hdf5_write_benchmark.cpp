@@ -0,0 +1,153 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+
+#include "benchmark/hdf5_write_benchmark.h"
+#include "io/file/hdf5_io.h"
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+namespace benchmark
+{
+
+//-----------------------------------------------------------------------------
+
+static size_t file_size(const std::string& path)
+{
+    std::ifstream in(path.c_str(), std::ifstream::ate | std::ifstream::binary);
+    if (false == in.is_open())
+    {
+        return 0;
+    }
+    return (size_t)in.tellg();
+}
+
+//-----------------------------------------------------------------------------
+
+void benchmark_hdf5_write(Bench_Report& report, size_t rows, size_t cols, size_t num_channels, size_t num_elements, const std::string& directory)
+{
+    std::mt19937 gen(42);
+    std::poisson_distribution<int> counts(0.7);
+
+    data_struct::Spectra_Volume spectra_volume;
+    spectra_volume.resize_and_zero(rows, cols, num_channels);
+    for (size_t row = 0; row < rows; row++)
+    {
+        for (size_t col = 0; col < cols; col++)
+        {
+            data_struct::Spectra& spectra = spectra_volume[row][col];
+            for (size_t i = 0; i < num_channels; i++)
+            {
+                spectra[i] = (real_t)counts(gen);
+            }
+            spectra.elapsed_livetime(0.1);
+            spectra.elapsed_realtime(0.11);
+            spectra.input_counts((real_t)spectra.sum());
+            spectra.output_counts((real_t)spectra.sum());
+        }
+    }
+
+    std::uniform_real_distribution<real_t> element_counts(0.0, 500.0);
+    data_struct::Fit_Count_Dict fit_counts;
+    for (size_t e = 0; e < num_elements; e++)
+    {
+        data_struct::ArrayXXr map(rows, cols);
+        for (size_t row = 0; row < rows; row++)
+        {
+            for (size_t col = 0; col < cols; col++)
+            {
+                map(row, col) = element_counts(gen);
+            }
+        }
+        fit_counts["Element_" + std::to_string(e)] = map;
+    }
+
+    size_t num_bytes = ((rows * cols * num_channels) + (num_elements * rows * cols)) * sizeof(real_t);
+    logI << "hdf5 write: " << rows << " x " << cols << " pixels, " << num_channels << " channels, " << num_elements << " elements, " << (num_bytes / (1024.0 * 1024.0)) << " MB uncompressed\n";
+
+    io::file::HDF5_IO* hdf5_io = io::file::HDF5_IO::inst();
+    io::file::H5_Write_Profile saved_profile = hdf5_io->write_profile();
+    for (const std::string& profile_name : io::file::get_h5_write_profile_names())
+    {
+        io::file::H5_Write_Profile profile;
+        io::file::get_h5_write_profile(profile_name, profile);
+        hdf5_io->set_write_profile(profile);
+
+        std::string filename = directory + "bench_h5_write_" + profile_name + ".h5";
+        std::remove(filename.c_str());
+
+        bool saved = true;
+        Bench_Result& result = report.time("hdf5_write " + profile_name, rows * cols, num_bytes, [&]()
+        {
+            std::remove(filename.c_str());
+            bool ok = hdf5_io->start_save_seq(filename, true);
+            ok = ok && hdf5_io->save_spectra_volume("mca_arr", &spectra_volume);
+            ok = ok && hdf5_io->save_element_fits(STR_FIT_NNLS, &fit_counts);
+            hdf5_io->end_save_seq(false);
+            saved = saved && ok;
+        });
+
+        if (false == saved)
+        {
+            logE << "hdf5 write " << profile_name << ": failed to save " << filename << "\n";
+            std::remove(filename.c_str());
+            continue;
+        }
+
+        size_t out_size = file_size(filename);
+        result.extra["file_mb"] = out_size / (1024.0 * 1024.0);
+        result.extra["compression_ratio"] = (double)num_bytes / std::max(out_size, (size_t)1);
+        logI << "hdf5 write " << profile_name << ": file " << result.extra["file_mb"] << " MB, ratio " << result.extra["compression_ratio"] << "\n";
+        std::remove(filename.c_str());
+    }
+    hdf5_io->set_write_profile(saved_profile);
+}
+
+//-----------------------------------------------------------------------------
+
+} //namespace benchmark
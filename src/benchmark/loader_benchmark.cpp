@@ -0,0 +1,134 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+
+#include "benchmark/loader_benchmark.h"
+#include "io/file/hl_file_io.h"
+
+#include <cstdio>
+
+namespace benchmark
+{
+
+//-----------------------------------------------------------------------------
+
+void benchmark_loaders(Bench_Report& report, const std::string& dataset_dir, const std::string& tmp_dir)
+{
+    data_struct::Params_Override override_params;
+    if (false == io::load_override_params(dataset_dir, -1, &override_params))
+    {
+        logW << "loader benchmark: no override parameters in " << dataset_dir << ", using defaults\n";
+    }
+
+    io::populate_netcdf_hdf5_files(dataset_dir);
+    std::vector<std::string> dataset_files = io::find_all_dataset_files(dataset_dir + "mda" + DIR_END_CHAR, ".mda");
+    if (dataset_files.size() == 0)
+    {
+        logE << "loader benchmark: no mda files in " << dataset_dir << "mda" << DIR_END_CHAR << "\n";
+        return;
+    }
+
+    // the largest dataset is saved again for the analyzed round trip
+    data_struct::Spectra_Volume largest_volume;
+    for (const std::string& dataset_file : dataset_files)
+    {
+        // first load gives the volume size for the rates
+        data_struct::Spectra_Volume spectra_volume;
+        bool is_loaded_from_analyzed_h5 = false;
+        if (false == io::load_spectra_volume(dataset_dir, dataset_file, 0, &spectra_volume, &override_params, &is_loaded_from_analyzed_h5, false))
+        {
+            logE << "loader benchmark: failed to load " << dataset_file << "\n";
+            continue;
+        }
+        size_t num_pixels = spectra_volume.rows() * spectra_volume.cols();
+        report.time("load " + dataset_file, num_pixels, num_pixels * spectra_volume.samples_size() * sizeof(real_t), [&]()
+        {
+            io::load_spectra_volume(dataset_dir, dataset_file, 0, &spectra_volume, &override_params, &is_loaded_from_analyzed_h5, false);
+        });
+
+        if (num_pixels > largest_volume.rows() * largest_volume.cols())
+        {
+            largest_volume.resize_and_zero(spectra_volume.rows(), spectra_volume.cols(), spectra_volume.samples_size());
+            for (size_t row = 0; row < spectra_volume.rows(); row++)
+            {
+                for (size_t col = 0; col < spectra_volume.cols(); col++)
+                {
+                    largest_volume[row][col] = spectra_volume[row][col];
+                }
+            }
+        }
+    }
+
+    size_t num_pixels = largest_volume.rows() * largest_volume.cols();
+    if (num_pixels == 0)
+    {
+        return;
+    }
+
+    io::file::HDF5_IO* hdf5_io = io::file::HDF5_IO::inst();
+    std::string filename = tmp_dir + "bench_load_analyzed.h5";
+    std::remove(filename.c_str());
+    bool saved = hdf5_io->start_save_seq(filename, true);
+    saved = saved && hdf5_io->save_spectra_volume("mca_arr", &largest_volume);
+    hdf5_io->end_save_seq(false);
+    if (false == saved)
+    {
+        logE << "loader benchmark: failed to save " << filename << "\n";
+        std::remove(filename.c_str());
+        return;
+    }
+
+    data_struct::Spectra_Volume analyzed_volume;
+    report.time("load analyzed h5", num_pixels, num_pixels * largest_volume.samples_size() * sizeof(real_t), [&]()
+    {
+        hdf5_io->load_spectra_vol_analyzed_h5(filename, &analyzed_volume);
+    });
+    std::remove(filename.c_str());
+}
+
+//-----------------------------------------------------------------------------
+
+} //namespace benchmark
@@ -0,0 +1,185 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+
+#include "core/command_line_parser.h"
+#include <set>
+#include <sstream>
+#include "benchmark/serializer_benchmark.h"
+#include "benchmark/hdf5_write_benchmark.h"
+#include "benchmark/fit_benchmark.h"
+#include "benchmark/loader_benchmark.h"
+
+// ----------------------------------------------------------------------------
+
+void help()
+{
+    logit_s<<"Help: \n";
+    logit_s<<"Usage: xrf_maps_bench [Options] \n\n";
+    logit_s<<"Options: \n";
+    logit_s<<"--pixels : <int> number of pixels to time (default 100000) \n";
+    logit_s<<"--channels : <int> spectra size (default 2048) \n";
+    logit_s<<"--elements : <int> number of element counts per fit routine (default 40) \n";
+    logit_s<<"--bench : <serializer, h5_write, fit, load, all> comma separated benchmarks to run (default all) \n";
+    logit_s<<"--repeat : <int> timed repetitions of each benchmark (default 5) \n";
+    logit_s<<"--warmup : <int> untimed runs before the repetitions (default 1) \n";
+    logit_s<<"--json : <file> save the results as json \n";
+    logit_s<<"--tag : <string> label saved with the json results, ex: git hash or machine name \n";
+    logit_s<<"--fit-pixels : <int> pixels fitted per repetition by the fit benchmark (default 2000) \n";
+    logit_s<<"--rows : <int> rows of the synthetic scan for h5_write (default 64) \n";
+    logit_s<<"--cols : <int> columns of the synthetic scan for h5_write (default 64) \n";
+    logit_s<<"--dir : dataset directory for the fit and load benchmarks (default ../test/2_ID_E_dataset/) \n";
+    logit_s<<"--reference : directory with henke.xdr and xrf_library.csv (default ../reference/) \n";
+    logit_s<<"--tmp-dir : directory for temporary files (default /tmp/) \n";
+}
+
+// ----------------------------------------------------------------------------
+
+size_t get_size_option(const Command_Line_Parser& clp, const std::string& option, size_t default_val)
+{
+    std::string val = clp.get_option(option);
+    if (val.length() > 0)
+    {
+        return std::stoul(val);
+    }
+    return default_val;
+}
+
+// ----------------------------------------------------------------------------
+
+std::string get_dir_option(const Command_Line_Parser& clp, const std::string& option, std::string default_val)
+{
+    std::string directory = default_val;
+    if (clp.option_exists(option))
+    {
+        directory = clp.get_option(option);
+    }
+    if (directory.length() > 0 && directory.back() != DIR_END_CHAR)
+    {
+        directory += DIR_END_CHAR;
+    }
+    return directory;
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    Command_Line_Parser clp(argc, argv);
+
+    if (clp.option_exists("-h") || clp.option_exists("--help"))
+    {
+        help();
+        return 0;
+    }
+
+    size_t num_pixels = get_size_option(clp, "--pixels", 100000);
+    size_t num_channels = get_size_option(clp, "--channels", 2048);
+    size_t num_elements = get_size_option(clp, "--elements", 40);
+
+    size_t repeat = get_size_option(clp, "--repeat", 5);
+    size_t warmup = get_size_option(clp, "--warmup", 1);
+    std::string dataset_dir = get_dir_option(clp, "--dir", "../test/2_ID_E_dataset/");
+    std::string reference_dir = get_dir_option(clp, "--reference", "../reference/");
+    std::string tmp_dir = get_dir_option(clp, "--tmp-dir", "/tmp/");
+
+    std::set<std::string> benches = { "all" };
+    if (clp.option_exists("--bench"))
+    {
+        benches.clear();
+        std::stringstream ss(clp.get_option("--bench"));
+        std::string name;
+        while (std::getline(ss, name, ','))
+        {
+            benches.insert(name);
+        }
+    }
+    auto run_bench = [&benches](const std::string& name) { return benches.count("all") > 0 || benches.count(name) > 0; };
+
+    benchmark::Bench_Report report(std::max(repeat, (size_t)1), warmup);
+    report.set_info("pixels", std::to_string(num_pixels));
+    report.set_info("channels", std::to_string(num_channels));
+    report.set_info("elements", std::to_string(num_elements));
+    if (clp.option_exists("--tag"))
+    {
+        report.set_info("tag", clp.get_option("--tag"));
+    }
+
+    if (run_bench("serializer"))
+    {
+        benchmark::benchmark_serializer(report, num_pixels, num_channels, num_elements);
+    }
+
+    if (run_bench("h5_write"))
+    {
+        size_t rows = get_size_option(clp, "--rows", 64);
+        size_t cols = get_size_option(clp, "--cols", 64);
+        benchmark::benchmark_hdf5_write(report, rows, cols, num_channels, num_elements, tmp_dir);
+    }
+
+    if (run_bench("fit"))
+    {
+        size_t fit_pixels = get_size_option(clp, "--fit-pixels", 2000);
+        benchmark::benchmark_fitting(report, dataset_dir, reference_dir, fit_pixels, num_channels);
+    }
+
+    if (run_bench("load"))
+    {
+        benchmark::benchmark_loaders(report, dataset_dir, tmp_dir);
+    }
+
+    if (clp.option_exists("--json"))
+    {
+        if (false == report.save_json(clp.get_option("--json")))
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
@@ -0,0 +1,178 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+
+#include "benchmark/serializer_benchmark.h"
+#include "io/net/basic_serializer.h"
+
+#include <random>
+
+namespace benchmark
+{
+
+//-----------------------------------------------------------------------------
+
+void benchmark_serializer(Bench_Report& report, size_t num_pixels, size_t num_channels, size_t num_elements)
+{
+    std::string dataset_name = "bench_dataset.mda";
+    std::string dataset_dir = "/tmp/";
+    std::mt19937 gen(42);
+    std::poisson_distribution<int> counts(0.7);
+
+    data_struct::Stream_Block stream_block(0, 0, 0, 1, num_pixels);
+    stream_block.dataset_name = &dataset_name;
+    stream_block.dataset_directory = &dataset_dir;
+    stream_block.spectra = new data_struct::Spectra(num_channels);
+    for (size_t i = 0; i < num_channels; i++)
+    {
+        (*stream_block.spectra)[i] = (real_t)counts(gen);
+    }
+    for (data_struct::Fitting_Routines routine : { data_struct::Fitting_Routines::ROI, data_struct::Fitting_Routines::NNLS })
+    {
+        data_struct::Stream_Fitting_Block fit_block;
+        fit_block.routine = routine;
+        for (size_t e = 0; e < num_elements; e++)
+        {
+            fit_block.element_names.push_back("Element_" + std::to_string(e));
+            fit_block.fit_counts.push_back((real_t)e);
+        }
+        stream_block.fitting_blocks.push_back(fit_block);
+    }
+
+    io::net::Basic_Serializer serializer;
+    std::string buffer;
+    std::string spectra_msg = serializer.encode_spectra(&stream_block);
+    size_t num_bytes = num_pixels * spectra_msg.length();
+
+    report.time("encode_spectra", num_pixels, num_bytes, [&]()
+    {
+        for (size_t i = 0; i < num_pixels; i++)
+        {
+            serializer.encode_spectra(&stream_block);
+        }
+    });
+
+    report.time("encode_spectra_into", num_pixels, num_bytes, [&]()
+    {
+        for (size_t i = 0; i < num_pixels; i++)
+        {
+            serializer.encode_spectra_into(&stream_block, buffer);
+        }
+    });
+
+    report.time("decode_spectra", num_pixels, num_bytes, [&]()
+    {
+        for (size_t i = 0; i < num_pixels; i++)
+        {
+            data_struct::Stream_Block* out_block = serializer.decode_spectra(&spectra_msg[0], spectra_msg.length());
+            delete out_block;
+        }
+    });
+
+    // recycled block, reuses its spectra and dataset strings
+    data_struct::Stream_Block pooled_block;
+    report.time("decode_spectra_into", num_pixels, num_bytes, [&]()
+    {
+        for (size_t i = 0; i < num_pixels; i++)
+        {
+            serializer.decode_spectra_into(&spectra_msg[0], spectra_msg.length(), &pooled_block);
+        }
+    });
+
+    serializer.encode_counts_into(&stream_block, buffer);
+    std::string counts_msg = buffer;
+    num_bytes = num_pixels * counts_msg.length();
+
+    report.time("encode_counts_into", num_pixels, num_bytes, [&]()
+    {
+        for (size_t i = 0; i < num_pixels; i++)
+        {
+            serializer.encode_counts_into(&stream_block, buffer);
+        }
+    });
+
+    report.time("decode_counts", num_pixels, num_bytes, [&]()
+    {
+        for (size_t i = 0; i < num_pixels; i++)
+        {
+            data_struct::Stream_Block* out_block = serializer.decode_counts(&counts_msg[0], counts_msg.length());
+            delete out_block;
+        }
+    });
+
+    // version 2 sends the element names once in a dictionary message
+    std::string dictionary;
+    serializer.set_counts_format_version(io::net::SERIALIZER_VERSION);
+    serializer.encode_counts_into(&stream_block, buffer);
+    serializer.encode_counts_dictionary_into(dictionary);
+    serializer.decode_counts(&dictionary[0], dictionary.length());
+    counts_msg = buffer;
+    num_bytes = num_pixels * counts_msg.length();
+
+    report.time("encode_counts_into v2", num_pixels, num_bytes, [&]()
+    {
+        for (size_t i = 0; i < num_pixels; i++)
+        {
+            serializer.encode_counts_into(&stream_block, buffer);
+        }
+    });
+
+    report.time("decode_counts v2", num_pixels, num_bytes, [&]()
+    {
+        for (size_t i = 0; i < num_pixels; i++)
+        {
+            data_struct::Stream_Block* out_block = serializer.decode_counts(&counts_msg[0], counts_msg.length());
+            delete out_block;
+        }
+    });
+
+    stream_block.dataset_name = nullptr;
+    stream_block.dataset_directory = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+
+} //namespace benchmark
@@ -0,0 +1,233 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+
+#include "core/command_line_parser.h"
+#include "io/file/hl_file_io.h"
+#include "benchmark/synthetic_dataset.h"
+#include <fstream>
+#include <sstream>
+
+// ----------------------------------------------------------------------------
+
+void help()
+{
+    logit_s<<"Help: \n";
+    logit_s<<"Usage: xrf_maps_synth --out <dataset dir> [Options] \n\n";
+    logit_s<<"Generates a fly scan dataset of any size from modeled spectra with poisson noise. \n";
+    logit_s<<"Options: \n";
+    logit_s<<"--out : directory the dataset is written to, maps_fit_parameters_override.txt is copied there \n";
+    logit_s<<"--format : <h5, netcdf, zmq> comma separated, each file format gets its own scan number (default h5) \n";
+    logit_s<<"--rows : <int> (default 64) \n";
+    logit_s<<"--cols : <int> (default 64) \n";
+    logit_s<<"--channels : <int> spectra size, the mda based loaders expect 2048 (default 2048) \n";
+    logit_s<<"--detectors : <int> 1 to 4 for h5, up to 8 for netcdf (default 4) \n";
+    logit_s<<"--elements : <Ca,Fe,Zn> elements to generate (default all elements of the override file) \n";
+    logit_s<<"--counts : <float> counts of a pixel at full concentration without dead time (default 5000) \n";
+    logit_s<<"--dwell : <float> real time per pixel in seconds (default 0.05) \n";
+    logit_s<<"--dead-time : <float> dead time fraction of the brightest pixel (default 0.2) \n";
+    logit_s<<"--seed : <int> (default 42) \n";
+    logit_s<<"--scan : <int> first scan number, files are named <prefix>_<scan> (default 1) \n";
+    logit_s<<"--prefix : <string> (default synth) \n";
+    logit_s<<"--params : directory with maps_fit_parameters_override.txt (default ../test/2_ID_E_dataset/) \n";
+    logit_s<<"--reference : directory with henke.xdr and xrf_library.csv (default ../reference/) \n";
+    logit_s<<"--port : <int> port to publish on for zmq (default 43434) \n";
+    logit_s<<"--zmq-wait : <int> milliseconds to wait for subscribers before streaming (default 2000) \n";
+}
+
+// ----------------------------------------------------------------------------
+
+std::string get_dir_option(const Command_Line_Parser& clp, const std::string& option, std::string default_val)
+{
+    std::string directory = default_val;
+    if (clp.option_exists(option))
+    {
+        directory = clp.get_option(option);
+    }
+    if (directory.length() > 0 && directory.back() != DIR_END_CHAR)
+    {
+        directory += DIR_END_CHAR;
+    }
+    return directory;
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<std::string> split_option(const Command_Line_Parser& clp, const std::string& option, std::string default_val)
+{
+    std::vector<std::string> values;
+    std::string val = default_val;
+    if (clp.option_exists(option))
+    {
+        val = clp.get_option(option);
+    }
+    std::stringstream ss(val);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (item.length() > 0)
+        {
+            values.push_back(item);
+        }
+    }
+    return values;
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    Command_Line_Parser clp(argc, argv);
+
+    if (clp.option_exists("-h") || clp.option_exists("--help") || false == clp.option_exists("--out"))
+    {
+        help();
+        return 0;
+    }
+
+    benchmark::Synthetic_Dataset_Params params;
+    if (clp.option_exists("--rows"))
+        params.rows = std::stoul(clp.get_option("--rows"));
+    if (clp.option_exists("--cols"))
+        params.cols = std::stoul(clp.get_option("--cols"));
+    if (clp.option_exists("--channels"))
+        params.channels = std::stoul(clp.get_option("--channels"));
+    if (clp.option_exists("--detectors"))
+        params.detectors = std::max(std::stoul(clp.get_option("--detectors")), 1ul);
+    if (clp.option_exists("--counts"))
+        params.counts_per_pixel = std::stof(clp.get_option("--counts"));
+    if (clp.option_exists("--dwell"))
+        params.dwell = std::stof(clp.get_option("--dwell"));
+    if (clp.option_exists("--dead-time"))
+        params.max_dead_time = std::min(std::stof(clp.get_option("--dead-time")), 0.95f);
+    if (clp.option_exists("--seed"))
+        params.seed = std::stoul(clp.get_option("--seed"));
+    if (clp.option_exists("--scan"))
+        params.scan_number = std::stoi(clp.get_option("--scan"));
+    if (clp.option_exists("--prefix"))
+        params.prefix = clp.get_option("--prefix");
+
+    std::string dataset_dir = get_dir_option(clp, "--out", "");
+    std::string params_dir = get_dir_option(clp, "--params", "../test/2_ID_E_dataset/");
+    std::string reference_dir = get_dir_option(clp, "--reference", "../reference/");
+    std::vector<std::string> formats = split_option(clp, "--format", "h5");
+    std::vector<std::string> element_names = split_option(clp, "--elements", "");
+
+    if (params.channels != 2048)
+    {
+        logW << "The mda based loaders resize spectra to 2048 channels, loading " << params.channels << " channels will be truncated or padded\n";
+    }
+
+    if (false == io::load_element_info(reference_dir + "henke.xdr", reference_dir + "xrf_library.csv"))
+    {
+        logE << "Could not load element info from " << reference_dir << "\n";
+        return -1;
+    }
+
+    data_struct::Params_Override override_params;
+    if (false == io::load_override_params(params_dir, -1, &override_params))
+    {
+        return -1;
+    }
+
+    benchmark::Synthetic_Dataset_Generator generator(params);
+    if (false == generator.init(&override_params, element_names))
+    {
+        return -1;
+    }
+
+    if (false == benchmark::create_dir(dataset_dir))
+    {
+        return -1;
+    }
+    // so the dataset can be fitted as it is
+    std::ifstream params_in(params_dir + "maps_fit_parameters_override.txt", std::ios::binary);
+    std::ofstream params_out(dataset_dir + "maps_fit_parameters_override.txt", std::ios::binary | std::ios::trunc);
+    params_out << params_in.rdbuf();
+
+    int scan_number = params.scan_number;
+    for (const std::string& format : formats)
+    {
+        generator.set_scan_number(scan_number);
+        bool saved = false;
+        if (format == "h5")
+        {
+            saved = generator.save_maps_raw(dataset_dir);
+            scan_number++;
+        }
+        else if (format == "netcdf")
+        {
+            saved = generator.save_netcdf(dataset_dir);
+            scan_number++;
+        }
+        else if (format == "zmq")
+        {
+            std::string port = "43434";
+            if (clp.option_exists("--port"))
+            {
+                port = clp.get_option("--port");
+            }
+            size_t wait_ms = 2000;
+            if (clp.option_exists("--zmq-wait"))
+            {
+                wait_ms = std::stoul(clp.get_option("--zmq-wait"));
+            }
+            saved = generator.stream_zmq(dataset_dir, port, wait_ms);
+        }
+        else
+        {
+            logE << "Unknown format " << format << "\n";
+        }
+        if (false == saved)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
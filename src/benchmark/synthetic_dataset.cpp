@@ -0,0 +1,720 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+
+#include "benchmark/synthetic_dataset.h"
+#include "fitting/models/gaussian_model.h"
+#include "data_struct/element_info.h"
+#include "workflow/xrf/spectra_net_streamer.h"
+
+#include <hdf5.h>
+#include <netcdf.h>
+#if defined _WIN32
+#include "support/direct/dirent.h"
+#else
+#include <dirent.h>
+#endif
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <thread>
+
+namespace benchmark
+{
+
+// XIA mapping mode layout read by NetCDF_IO::load_spectra_line
+#define NETCDF_HEADER_SIZE 256
+#define NETCDF_PIXELS_PER_BUFFER 124
+#define NETCDF_DETECTORS_PER_MODULE 4
+#define NETCDF_CLOCK_TICK 320e-9
+#define NETCDF_REALTIME_OFFSET 32
+#define NETCDF_LIVETIME_OFFSET 34
+#define NETCDF_INPUT_COUNTS_OFFSET 36
+#define NETCDF_OUTPUT_COUNTS_OFFSET 38
+
+#define MAPS_RAW_MAX_DETECTORS 4
+
+// share of the expected counts that goes to the elastic and compton peaks
+#define SCATTER_FRACTION 0.3
+
+//-----------------------------------------------------------------------------
+
+bool create_dir(const std::string& path)
+{
+    DIR *dir = opendir(path.c_str());
+    if (dir != nullptr)
+    {
+        closedir(dir);
+        return true;
+    }
+    std::string cmd = "mkdir " + path;
+    logI << cmd << "\n";
+    if (system(cmd.c_str()) != 0)
+    {
+        logE << "Could not create directory " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// MDA files are XDR, big endian with 16 bit values padded to 4 bytes
+
+static void xdr_put_int(std::string& buf, int32_t val)
+{
+    uint32_t u = (uint32_t)val;
+    char b[4] = { (char)(u >> 24), (char)(u >> 16), (char)(u >> 8), (char)u };
+    buf.append(b, 4);
+}
+
+static void xdr_put_float(std::string& buf, float val)
+{
+    int32_t i;
+    std::memcpy(&i, &val, sizeof(float));
+    xdr_put_int(buf, i);
+}
+
+static void xdr_put_double(std::string& buf, double val)
+{
+    uint64_t u;
+    std::memcpy(&u, &val, sizeof(double));
+    xdr_put_int(buf, (int32_t)(u >> 32));
+    xdr_put_int(buf, (int32_t)(u & 0xFFFFFFFF));
+}
+
+static void xdr_put_string(std::string& buf, const std::string& str)
+{
+    xdr_put_int(buf, (int32_t)str.length());
+    if (str.length() > 0)
+    {
+        xdr_put_int(buf, (int32_t)str.length());
+        buf += str;
+        buf.append((4 - (str.length() % 4)) % 4, '\0');
+    }
+}
+
+static void xdr_put_positioner(std::string& buf, const std::string& name, const std::string& description)
+{
+    xdr_put_int(buf, 0); // number
+    xdr_put_string(buf, name);
+    xdr_put_string(buf, description);
+    xdr_put_string(buf, "LINEAR");
+    xdr_put_string(buf, "mm");
+    xdr_put_string(buf, name);
+    xdr_put_string(buf, description);
+    xdr_put_string(buf, "mm");
+}
+
+//-----------------------------------------------------------------------------
+
+Synthetic_Dataset_Generator::Synthetic_Dataset_Generator(const Synthetic_Dataset_Params& params) : _params(params)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+
+Synthetic_Dataset_Generator::~Synthetic_Dataset_Generator()
+{
+
+}
+
+//-----------------------------------------------------------------------------
+
+bool Synthetic_Dataset_Generator::init(data_struct::Params_Override* override_params, const std::vector<std::string>& element_names)
+{
+    _element_spectra.clear();
+    _element_names.clear();
+
+    fitting::models::Gaussian_Model model;
+    model.update_fit_params_values(&override_params->fit_params);
+    data_struct::Range energy_range = data_struct::get_energy_range(_params.channels, &override_params->fit_params);
+    data_struct::Fit_Parameters fit_params = model.fit_parameters();
+
+    data_struct::Fit_Element_Map_Dict elements;
+    std::vector<data_struct::Fit_Element_Map*> generated_elements;
+    if (element_names.size() == 0)
+    {
+        for (const auto& itr : override_params->elements_to_fit)
+        {
+            if (itr.first != STR_COMPTON_AMPLITUDE && itr.first != STR_COHERENT_SCT_AMPLITUDE)
+            {
+                elements[itr.first] = itr.second;
+            }
+        }
+    }
+    else
+    {
+        data_struct::Element_Info* detector_element = data_struct::Element_Info_Map::inst()->get_element(override_params->detector_element);
+        for (const std::string& name : element_names)
+        {
+            if (override_params->elements_to_fit.count(name) > 0)
+            {
+                elements[name] = override_params->elements_to_fit.at(name);
+                continue;
+            }
+            data_struct::Fit_Element_Map* element = data_struct::gen_element_map(name);
+            if (element == nullptr)
+            {
+                continue;
+            }
+            element->init_energy_ratio_for_detector_element(detector_element);
+            elements[name] = element;
+            generated_elements.push_back(element);
+        }
+    }
+
+    for (const auto& itr : elements)
+    {
+        fit_params.add_parameter(data_struct::Fit_Param(itr.first, (real_t)0.0));
+    }
+
+    // scatter alone, every element spectra is then modeled on top of it
+    data_struct::Fit_Element_Map_Dict no_elements;
+    data_struct::Spectra scatter = model.model_spectrum(&fit_params, &no_elements, nullptr, energy_range);
+    _scatter_spectra = data_struct::ArrayXr::Zero(_params.channels);
+    _scatter_spectra.segment(energy_range.min, scatter.size()) = scatter.cwiseMax((real_t)0.0);
+    if (_scatter_spectra.sum() > 0)
+    {
+        _scatter_spectra /= _scatter_spectra.sum();
+    }
+
+    for (const auto& itr : elements)
+    {
+        data_struct::Fit_Element_Map_Dict one_element;
+        one_element[itr.first] = itr.second;
+        data_struct::Spectra modeled = model.model_spectrum(&fit_params, &one_element, nullptr, energy_range);
+        data_struct::ArrayXr element_spectra = data_struct::ArrayXr::Zero(_params.channels);
+        element_spectra.segment(energy_range.min, modeled.size()) = (modeled - scatter).cwiseMax((real_t)0.0);
+        if (element_spectra.sum() <= 0)
+        {
+            logW << "Element " << itr.first << " has no lines in the energy range, skipping it\n";
+            continue;
+        }
+        _element_spectra.push_back(element_spectra / element_spectra.sum());
+        _element_names.push_back(itr.first);
+    }
+
+    for (data_struct::Fit_Element_Map* element : generated_elements)
+    {
+        delete element;
+    }
+
+    if (_element_spectra.size() == 0)
+    {
+        logE << "No elements to generate\n";
+        return false;
+    }
+
+    logI << "Generating " << _params.rows << " x " << _params.cols << " pixels, " << _params.channels << " channels, " << _params.detectors << " detectors, elements: ";
+    for (const std::string& name : _element_names)
+    {
+        logit_s << name << " ";
+    }
+    logit_s << "\n";
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+std::string Synthetic_Dataset_Generator::dataset_name() const
+{
+    char num[16];
+    std::snprintf(num, sizeof(num), "%04d", _params.scan_number);
+    return _params.prefix + "_" + num;
+}
+
+//-----------------------------------------------------------------------------
+
+real_t Synthetic_Dataset_Generator::_concentration(size_t idx, size_t row, size_t col) const
+{
+    // a different smooth pattern per element
+    const real_t two_pi = (real_t)(2.0 * M_PI);
+    real_t y = (real_t)row / (real_t)std::max(_params.rows, (size_t)1);
+    real_t x = (real_t)col / (real_t)std::max(_params.cols, (size_t)1);
+    real_t fy = (real_t)(1 + (idx % 3));
+    real_t fx = (real_t)(1 + ((idx / 3) % 3));
+    real_t phase = (real_t)idx * (real_t)1.3;
+    return (real_t)0.5 + (real_t)0.5 * std::sin(two_pi * fy * y + phase) * std::cos(two_pi * fx * x + phase * (real_t)0.5);
+}
+
+//-----------------------------------------------------------------------------
+
+real_t Synthetic_Dataset_Generator::_dead_time(size_t row, size_t col) const
+{
+    // dead time follows the count rate
+    real_t mean_concentration = 0;
+    for (size_t e = 0; e < _element_spectra.size(); e++)
+    {
+        mean_concentration += _concentration(e, row, col);
+    }
+    mean_concentration /= (real_t)std::max(_element_spectra.size(), (size_t)1);
+    return _params.max_dead_time * ((real_t)SCATTER_FRACTION + ((real_t)1.0 - (real_t)SCATTER_FRACTION) * mean_concentration);
+}
+
+//-----------------------------------------------------------------------------
+
+void Synthetic_Dataset_Generator::gen_pixel(size_t row, size_t col, size_t detector, data_struct::Spectra* spectra) const
+{
+    real_t live_fraction = (real_t)1.0 - _dead_time(row, col);
+
+    data_struct::ArrayXr expected = _scatter_spectra * (real_t)SCATTER_FRACTION;
+    real_t element_weight = ((real_t)1.0 - (real_t)SCATTER_FRACTION) / (real_t)_element_spectra.size();
+    for (size_t e = 0; e < _element_spectra.size(); e++)
+    {
+        expected += _element_spectra[e] * (element_weight * _concentration(e, row, col));
+    }
+    expected *= _params.counts_per_pixel * live_fraction;
+
+    std::mt19937 gen(_params.seed + (unsigned int)((((row * _params.cols) + col) * _params.detectors) + detector));
+    for (size_t i = 0; i < _params.channels; i++)
+    {
+        if (expected[i] > 0)
+        {
+            std::poisson_distribution<int> counts(expected[i]);
+            (*spectra)[i] = (real_t)counts(gen);
+        }
+        else
+        {
+            (*spectra)[i] = 0;
+        }
+    }
+
+    real_t total = spectra->sum();
+    real_t livetime = _params.dwell * live_fraction;
+    spectra->elapsed_realtime(_params.dwell);
+    spectra->elapsed_livetime(livetime);
+    spectra->input_counts(total / livetime);
+    spectra->output_counts(total / _params.dwell);
+}
+
+//-----------------------------------------------------------------------------
+
+bool Synthetic_Dataset_Generator::_save_mda(const std::string& dataset_dir) const
+{
+    std::string mda_dir = dataset_dir + "mda" + DIR_END_CHAR;
+    if (false == create_dir(mda_dir))
+    {
+        return false;
+    }
+
+    char time_str[64];
+    std::time_t now = std::time(nullptr);
+    std::strftime(time_str, sizeof(time_str), "%b %d, %Y %H:%M:%S", std::localtime(&now));
+    std::string scan_name = _params.prefix + ":scan";
+
+    // 2D scan, y positioner outside, x positioner and scalers per row
+    std::string buf;
+    xdr_put_float(buf, 1.4f);
+    xdr_put_int(buf, _params.scan_number);
+    xdr_put_int(buf, 2); // data rank
+    xdr_put_int(buf, (int32_t)_params.rows);
+    xdr_put_int(buf, (int32_t)_params.cols);
+    xdr_put_int(buf, 1); // regular
+    xdr_put_int(buf, 0); // no extra pvs
+
+    xdr_put_int(buf, 2); // scan rank
+    xdr_put_int(buf, (int32_t)_params.rows);
+    xdr_put_int(buf, (int32_t)_params.rows);
+    size_t offsets_pos = buf.length();
+    for (size_t row = 0; row < _params.rows; row++)
+    {
+        xdr_put_int(buf, 0);
+    }
+    xdr_put_string(buf, scan_name + "2");
+    xdr_put_string(buf, time_str);
+    xdr_put_int(buf, 1); // positioners
+    xdr_put_int(buf, 0); // detectors
+    xdr_put_int(buf, 0); // triggers
+    xdr_put_positioner(buf, _params.prefix + ":y", "y");
+    for (size_t row = 0; row < _params.rows; row++)
+    {
+        xdr_put_double(buf, (double)row * 0.001);
+    }
+
+    // scalers found by the General beamline of Scaler_to_PV_map.yaml
+    const std::vector<std::string> scalers = { "S:SRcurrentAI", "I0", "I1" };
+    for (size_t row = 0; row < _params.rows; row++)
+    {
+        std::string offset;
+        xdr_put_int(offset, (int32_t)buf.length());
+        buf.replace(offsets_pos + (row * 4), 4, offset);
+
+        xdr_put_int(buf, 1); // scan rank
+        xdr_put_int(buf, (int32_t)_params.cols);
+        xdr_put_int(buf, (int32_t)_params.cols);
+        xdr_put_string(buf, scan_name + "1");
+        xdr_put_string(buf, time_str);
+        xdr_put_int(buf, 1);
+        xdr_put_int(buf, (int32_t)scalers.size());
+        xdr_put_int(buf, 0);
+        xdr_put_positioner(buf, _params.prefix + ":x", "x");
+        for (size_t d = 0; d < scalers.size(); d++)
+        {
+            xdr_put_int(buf, (int32_t)d);
+            xdr_put_string(buf, scalers[d]);
+            xdr_put_string(buf, scalers[d]);
+            xdr_put_string(buf, "cts");
+        }
+        for (size_t col = 0; col < _params.cols; col++)
+        {
+            xdr_put_double(buf, (double)col * 0.001);
+        }
+        for (size_t col = 0; col < _params.cols; col++)
+        {
+            xdr_put_float(buf, 102.0f);
+        }
+        for (size_t col = 0; col < _params.cols; col++)
+        {
+            xdr_put_float(buf, (float)(2.0e6 * _params.dwell));
+        }
+        for (size_t col = 0; col < _params.cols; col++)
+        {
+            xdr_put_float(buf, (float)(1.0e6 * _params.dwell));
+        }
+    }
+
+    std::string filename = mda_dir + dataset_name() + ".mda";
+    std::ofstream out(filename.c_str(), std::ios::binary | std::ios::trunc);
+    if (false == out.is_open())
+    {
+        logE << "Could not open " << filename << "\n";
+        return false;
+    }
+    out.write(buf.data(), buf.length());
+    logI << "Saved " << filename << "\n";
+    return out.good();
+}
+
+//-----------------------------------------------------------------------------
+
+bool Synthetic_Dataset_Generator::save_maps_raw(const std::string& dataset_dir)
+{
+    if (_params.detectors > MAPS_RAW_MAX_DETECTORS)
+    {
+        logE << "MAPS_RAW holds at most " << MAPS_RAW_MAX_DETECTORS << " detectors\n";
+        return false;
+    }
+    std::string h5_dir = dataset_dir + "flyXRF.h5" + DIR_END_CHAR;
+    if (false == _save_mda(dataset_dir) || false == create_dir(h5_dir))
+    {
+        return false;
+    }
+
+    std::string filename = h5_dir + dataset_name() + "_" + _params.prefix + "__0.h5";
+    hid_t file_id = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if (file_id < 0)
+    {
+        logE << "Could not create " << filename << "\n";
+        return false;
+    }
+    hid_t grp_id = H5Gcreate(file_id, "MAPS_RAW", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+
+    // one chunk per row, the way the loaders read it
+    hsize_t dims[3] = { _params.channels, _params.rows, _params.cols };
+    hsize_t chunk[3] = { _params.channels, 1, _params.cols };
+    hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(dcpl_id, 3, chunk);
+    hid_t space_id = H5Screate_simple(3, dims, nullptr);
+    const char* data_names[MAPS_RAW_MAX_DETECTORS] = { "data_a", "data_b", "data_c", "data_d" };
+    std::vector<hid_t> data_ids;
+    for (size_t det = 0; det < _params.detectors; det++)
+    {
+        data_ids.push_back(H5Dcreate(grp_id, data_names[det], H5T_STD_U16LE, space_id, H5P_DEFAULT, dcpl_id, H5P_DEFAULT));
+    }
+
+    hsize_t meta_dims[3] = { _params.detectors, _params.rows, _params.cols };
+    hid_t meta_space_id = H5Screate_simple(3, meta_dims, nullptr);
+    const char* meta_names[4] = { "livetime", "realtime", "inputcounts", "ouputcounts" };
+    std::vector<hid_t> meta_ids;
+    for (const char* name : meta_names)
+    {
+        meta_ids.push_back(H5Dcreate(grp_id, name, H5T_NATIVE_FLOAT, meta_space_id, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT));
+    }
+
+    hsize_t row_count[3] = { _params.channels, 1, _params.cols };
+    hid_t row_space_id = H5Screate_simple(3, row_count, nullptr);
+    hsize_t meta_count[3] = { _params.detectors, 1, _params.cols };
+    hid_t meta_row_space_id = H5Screate_simple(3, meta_count, nullptr);
+
+    std::vector<std::vector<uint16_t>> row_buffers(_params.detectors, std::vector<uint16_t>(_params.channels * _params.cols));
+    std::vector<std::vector<float>> meta_buffers(4, std::vector<float>(_params.detectors * _params.cols));
+
+    bool ok = (grp_id >= 0);
+    for (hid_t id : data_ids)
+    {
+        ok = ok && (id >= 0);
+    }
+    for (hid_t id : meta_ids)
+    {
+        ok = ok && (id >= 0);
+    }
+
+    for (size_t row = 0; ok && row < _params.rows; row++)
+    {
+        #pragma omp parallel for
+        for (int col = 0; col < (int)_params.cols; col++)
+        {
+            data_struct::Spectra spectra(_params.channels);
+            for (size_t det = 0; det < _params.detectors; det++)
+            {
+                gen_pixel(row, col, det, &spectra);
+                std::vector<uint16_t>& buffer = row_buffers[det];
+                for (size_t i = 0; i < _params.channels; i++)
+                {
+                    buffer[(i * _params.cols) + col] = (uint16_t)std::min(spectra[i], (real_t)65535);
+                }
+                size_t meta_idx = (det * _params.cols) + col;
+                meta_buffers[0][meta_idx] = spectra.elapsed_livetime();
+                meta_buffers[1][meta_idx] = spectra.elapsed_realtime();
+                meta_buffers[2][meta_idx] = spectra.input_counts();
+                meta_buffers[3][meta_idx] = spectra.output_counts();
+            }
+        }
+
+        hsize_t offset[3] = { 0, row, 0 };
+        H5Sselect_hyperslab(space_id, H5S_SELECT_SET, offset, nullptr, row_count, nullptr);
+        for (size_t det = 0; ok && det < _params.detectors; det++)
+        {
+            ok = H5Dwrite(data_ids[det], H5T_NATIVE_UINT16, row_space_id, space_id, H5P_DEFAULT, row_buffers[det].data()) >= 0;
+        }
+        H5Sselect_hyperslab(meta_space_id, H5S_SELECT_SET, offset, nullptr, meta_count, nullptr);
+        for (size_t m = 0; ok && m < meta_ids.size(); m++)
+        {
+            ok = H5Dwrite(meta_ids[m], H5T_NATIVE_FLOAT, meta_row_space_id, meta_space_id, H5P_DEFAULT, meta_buffers[m].data()) >= 0;
+        }
+        if (row % std::max(_params.rows / 10, (size_t)1) == 0)
+        {
+            logI << "row " << row << " / " << _params.rows << "\n";
+        }
+    }
+
+    for (hid_t id : meta_ids)
+    {
+        H5Dclose(id);
+    }
+    for (hid_t id : data_ids)
+    {
+        H5Dclose(id);
+    }
+    H5Sclose(meta_row_space_id);
+    H5Sclose(row_space_id);
+    H5Sclose(meta_space_id);
+    H5Sclose(space_id);
+    H5Pclose(dcpl_id);
+    H5Gclose(grp_id);
+    H5Fclose(file_id);
+
+    if (false == ok)
+    {
+        logE << "Failed to write " << filename << "\n";
+        return false;
+    }
+    logI << "Saved " << filename << "\n";
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Synthetic_Dataset_Generator::save_netcdf(const std::string& dataset_dir)
+{
+    std::string nc_dir = dataset_dir + "flyXRF" + DIR_END_CHAR;
+    if (false == _save_mda(dataset_dir) || false == create_dir(nc_dir))
+    {
+        return false;
+    }
+
+    size_t num_modules = (_params.detectors + NETCDF_DETECTORS_PER_MODULE - 1) / NETCDF_DETECTORS_PER_MODULE;
+    size_t pixel_size = NETCDF_HEADER_SIZE + (NETCDF_DETECTORS_PER_MODULE * _params.channels);
+    size_t buffer_size = NETCDF_HEADER_SIZE + (NETCDF_PIXELS_PER_BUFFER * pixel_size);
+    size_t num_buffers = (_params.cols + NETCDF_PIXELS_PER_BUFFER - 1) / NETCDF_PIXELS_PER_BUFFER;
+
+    // [buffer][module][words] for one row
+    std::vector<int> row_data(num_buffers * num_modules * buffer_size);
+    std::vector<data_struct::Spectra> pixel_spectra(_params.cols * _params.detectors, data_struct::Spectra(_params.channels));
+
+    auto put_word32 = [](int* words, size_t offset, uint32_t val)
+    {
+        words[offset] = (int)(val & 0xFFFF);
+        words[offset + 1] = (int)(val >> 16);
+    };
+
+    for (size_t row = 0; row < _params.rows; row++)
+    {
+        #pragma omp parallel for
+        for (int col = 0; col < (int)_params.cols; col++)
+        {
+            for (size_t det = 0; det < _params.detectors; det++)
+            {
+                gen_pixel(row, col, det, &pixel_spectra[(col * _params.detectors) + det]);
+            }
+        }
+
+        std::fill(row_data.begin(), row_data.end(), 0);
+        for (size_t b = 0; b < num_buffers; b++)
+        {
+            for (size_t m = 0; m < num_modules; m++)
+            {
+                int* buffer = &row_data[((b * num_modules) + m) * buffer_size];
+                size_t first_col = b * NETCDF_PIXELS_PER_BUFFER;
+                size_t num_pixels = std::min((size_t)NETCDF_PIXELS_PER_BUFFER, _params.cols - first_col);
+                buffer[0] = 21930;
+                buffer[1] = -21931;
+                buffer[2] = NETCDF_HEADER_SIZE;
+                buffer[8] = (int)num_pixels;
+                buffer[20] = (int)_params.channels;
+
+                for (size_t p = 0; p < num_pixels; p++)
+                {
+                    int* pixel = buffer + NETCDF_HEADER_SIZE + (p * pixel_size);
+                    pixel[0] = 13260;
+                    pixel[1] = -13261;
+                    for (size_t d = 0; d < NETCDF_DETECTORS_PER_MODULE; d++)
+                    {
+                        size_t det = (m * NETCDF_DETECTORS_PER_MODULE) + d;
+                        if (det >= _params.detectors)
+                        {
+                            break;
+                        }
+                        const data_struct::Spectra& spectra = pixel_spectra[((first_col + p) * _params.detectors) + det];
+                        // raw counts and clock ticks, the loader divides them by the times
+                        uint32_t total = (uint32_t)spectra.sum();
+                        put_word32(pixel, NETCDF_REALTIME_OFFSET + (d * 8), (uint32_t)(spectra.elapsed_realtime() / NETCDF_CLOCK_TICK));
+                        put_word32(pixel, NETCDF_LIVETIME_OFFSET + (d * 8), (uint32_t)(spectra.elapsed_livetime() / NETCDF_CLOCK_TICK));
+                        put_word32(pixel, NETCDF_INPUT_COUNTS_OFFSET + (d * 8), total);
+                        put_word32(pixel, NETCDF_OUTPUT_COUNTS_OFFSET + (d * 8), total);
+                        int* counts = pixel + NETCDF_HEADER_SIZE + (d * _params.channels);
+                        for (size_t i = 0; i < _params.channels; i++)
+                        {
+                            counts[i] = (int)spectra[i];
+                        }
+                    }
+                }
+            }
+        }
+
+        std::string filename = nc_dir + dataset_name() + "_" + _params.prefix + "__" + std::to_string(row) + ".nc";
+        int ncid, varid, retval;
+        int dimids[3];
+        if ((retval = nc_create(filename.c_str(), NC_CLOBBER | NC_64BIT_OFFSET, &ncid)) != 0)
+        {
+            logE << filename << " :: " << nc_strerror(retval) << "\n";
+            return false;
+        }
+        retval = nc_def_dim(ncid, "dim0", num_buffers, &dimids[0]);
+        retval = retval == 0 ? nc_def_dim(ncid, "dim1", num_modules, &dimids[1]) : retval;
+        retval = retval == 0 ? nc_def_dim(ncid, "dim2", buffer_size, &dimids[2]) : retval;
+        retval = retval == 0 ? nc_def_var(ncid, "array_data", NC_INT, 3, dimids, &varid) : retval;
+        retval = retval == 0 ? nc_enddef(ncid) : retval;
+        retval = retval == 0 ? nc_put_var_int(ncid, varid, row_data.data()) : retval;
+        if (retval != 0)
+        {
+            logE << filename << " :: " << nc_strerror(retval) << "\n";
+            nc_close(ncid);
+            return false;
+        }
+        nc_close(ncid);
+
+        if (row % std::max(_params.rows / 10, (size_t)1) == 0)
+        {
+            logI << "row " << row << " / " << _params.rows << "\n";
+        }
+    }
+    logI << "Saved " << _params.rows << " NetCDF files in " << nc_dir << "\n";
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Synthetic_Dataset_Generator::stream_zmq(const std::string& dataset_dir, const std::string& port, size_t wait_ms)
+{
+#ifdef _BUILD_WITH_ZMQ
+    workflow::xrf::Spectra_Net_Streamer streamer(port);
+    streamer.set_send_counts(false);
+    streamer.set_send_spectra(true);
+
+    // PUB drops everything sent before a subscriber is connected
+    logI << "Waiting " << wait_ms << " ms for subscribers on port " << port << "\n";
+    std::this_thread::sleep_for(std::chrono::milliseconds(wait_ms));
+
+    std::string name = dataset_name() + ".mda";
+    std::string directory = dataset_dir;
+    for (size_t row = 0; row < _params.rows; row++)
+    {
+        for (size_t col = 0; col < _params.cols; col++)
+        {
+            for (size_t det = 0; det < _params.detectors; det++)
+            {
+                data_struct::Stream_Block stream_block((int)det, row, col, _params.rows, _params.cols);
+                stream_block.dataset_name = &name;
+                stream_block.dataset_directory = &directory;
+                stream_block.spectra = new data_struct::Spectra(_params.channels);
+                gen_pixel(row, col, det, stream_block.spectra);
+                streamer.stream(&stream_block);
+                stream_block.dataset_name = nullptr;
+                stream_block.dataset_directory = nullptr;
+            }
+        }
+        if (row % std::max(_params.rows / 10, (size_t)1) == 0)
+        {
+            logI << "row " << row << " / " << _params.rows << "\n";
+        }
+    }
+    streamer.flush();
+    return true;
+#else
+    (void)dataset_dir;
+    (void)port;
+    (void)wait_ms;
+    logE << "Streaming needs ZeroMQ. Recompile with option -DBUILD_WITH_ZMQ\n";
+    return false;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+
+} //namespace benchmark
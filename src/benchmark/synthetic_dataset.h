@@ -0,0 +1,179 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#ifndef SYNTHETIC_DATASET_H
+#define SYNTHETIC_DATASET_H
+
+#include "core/defines.h"
+#include "data_struct/params_override.h"
+#include "data_struct/spectra.h"
+#include <random>
+
+namespace benchmark
+{
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Synthetic_Dataset_Params struct : size and acquisition settings of a generated scan
+///
+struct DLL_EXPORT Synthetic_Dataset_Params
+{
+    Synthetic_Dataset_Params()
+    {
+        rows = 64;
+        cols = 64;
+        channels = 2048;
+        detectors = 4;
+        counts_per_pixel = 5000.0;
+        dwell = 0.05;
+        max_dead_time = 0.2;
+        seed = 42;
+        scan_number = 1;
+        prefix = "synth";
+    }
+
+    size_t rows;
+
+    size_t cols;
+
+    size_t channels;
+
+    size_t detectors;
+
+    // counts of a pixel with every element at full concentration and no dead time
+    real_t counts_per_pixel;
+
+    // real time per pixel in seconds
+    real_t dwell;
+
+    // dead time fraction of the brightest pixel
+    real_t max_dead_time;
+
+    unsigned int seed;
+
+    int scan_number;
+
+    std::string prefix;
+};
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Synthetic_Dataset_Generator class : Generates fly scan datasets of any size from Gaussian_Model spectra.
+///        Every element gets a concentration map, the dead time follows the count rate and the counts are Poisson noised.
+///        A pixel is seeded by its position so every output format holds the same data.
+///
+class DLL_EXPORT Synthetic_Dataset_Generator
+{
+public:
+
+    Synthetic_Dataset_Generator(const Synthetic_Dataset_Params& params);
+
+    ~Synthetic_Dataset_Generator();
+
+    ///
+    /// \brief init : Model one spectra per element and the scatter peaks
+    /// \param override_params : energy calibration, peak shapes and elements_to_fit
+    /// \param element_names : elements to generate, all elements_to_fit if empty
+    ///
+    bool init(data_struct::Params_Override* override_params, const std::vector<std::string>& element_names);
+
+    // dataset name without extension, ex: synth_0001
+    std::string dataset_name() const;
+
+    ///
+    /// \brief save_maps_raw : Write mda/<name>.mda and flyXRF.h5/<name>_<prefix>__0.h5 with the spectra in /MAPS_RAW
+    ///
+    bool save_maps_raw(const std::string& dataset_dir);
+
+    ///
+    /// \brief save_netcdf : Write mda/<name>.mda and one XIA mapping mode flyXRF/<name>_<prefix>__<row>.nc file per row
+    ///
+    bool save_netcdf(const std::string& dataset_dir);
+
+    ///
+    /// \brief stream_zmq : Publish every pixel of every detector on XRF-Spectra like a live scan
+    /// \param wait_ms : time given to subscribers to connect before the first pixel
+    ///
+    bool stream_zmq(const std::string& dataset_dir, const std::string& port, size_t wait_ms);
+
+    // fill spectra with the noised counts of one pixel, spectra has to be channels long
+    void gen_pixel(size_t row, size_t col, size_t detector, data_struct::Spectra* spectra) const;
+
+    void set_scan_number(int scan_number) { _params.scan_number = scan_number; }
+
+    const Synthetic_Dataset_Params& params() const { return _params; }
+
+private:
+
+    // relative concentration 0 to 1 of element idx at row, col
+    real_t _concentration(size_t idx, size_t row, size_t col) const;
+
+    real_t _dead_time(size_t row, size_t col) const;
+
+    bool _save_mda(const std::string& dataset_dir) const;
+
+    Synthetic_Dataset_Params _params;
+
+    // channels long spectra, zero outside the fitted energy range, each summing to 1
+    std::vector<data_struct::ArrayXr> _element_spectra;
+
+    data_struct::ArrayXr _scatter_spectra;
+
+    std::vector<std::string> _element_names;
+};
+
+//-----------------------------------------------------------------------------
+
+// creates path if it does not exist, parent directories have to exist
+DLL_EXPORT bool create_dir(const std::string& path);
+
+//-----------------------------------------------------------------------------
+
+} //namespace benchmark
+
+#endif // SYNTHETIC_DATASET_H
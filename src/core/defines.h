@@ -52,9 +52,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <iostream>
 #include <string>
 
-static std::time_t now_c;
-#define logit now_c=std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());std::cout<<std::put_time(std::localtime(&now_c),"[%F_%T]\t")<<__FILE__<<"::"<<__FUNCTION__<<"():"<<__LINE__<<"\t"
-#define logit_s std::cout
+// messages are formatted by the calling thread and written by a background thread, see core/logger.h
+#define logit logger::Log_Line(__FILE__, __FUNCTION__, __LINE__)
+#define logit_s logger::Log_Line()
 #define logE logit<<"Error: "
 #define logW logit<<"Warning: "
 #define logI logit<<"Info: "
@@ -99,6 +99,8 @@ static std::time_t now_c;
   #endif
 #endif
 
+#include "core/logger.h"
+
 // STRING KEYS
 using namespace std;
 
@@ -242,6 +244,15 @@ const string STR_SPECTRA = "Spectra";
 const string STR_VERSION = "version";
 const string STR_XRF_ANALYZED = "XRF_Analyzed";
 const string STR_COUNTS_PER_SEC = "Counts_Per_Sec";
+const string STR_FIT_INPUT_HASH = "Fit_Input_Hash";
+const string STR_FIT_CHECKPOINT = "Checkpoint";
+const string STR_SKIPPED_PIXELS = "Skipped_Pixels";
+const string STR_PREVIEW_BIN = "Preview_Bin";
+const string STR_ROWS_DONE = "Rows_Done";
+const string STR_INT_FITTED = "Integrated_Fitted";
+const string STR_INT_BACKGROUND = "Integrated_Background";
+const string STR_MAX_CHANNELS = "Max_Channels";
+const string STR_MAX_10_CHANNELS = "Max_10_Channels";
 const string STR_CHANNEL_NAMES = "Channel_Names";
 const string STR_CHANNEL_UNITS = "Channel_Units";
 const string STR_FIT_PARAMETERS_OVERRIDE = "Fit_Parameters_Override";
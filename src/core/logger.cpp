@@ -0,0 +1,393 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#include "core/logger.h"
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+
+namespace logger
+{
+
+// messages per second from one source line before they are dropped
+static const size_t DEFAULT_RATE_LIMIT = 100;
+
+struct Thread_Stream
+{
+    std::ostringstream stream;
+    bool in_use = false;
+};
+
+static thread_local Thread_Stream t_stream;
+
+//-----------------------------------------------------------------------------
+
+static void stop_logger()
+{
+    Logger::inst()->stop();
+}
+
+//-----------------------------------------------------------------------------
+
+Logger* Logger::inst()
+{
+    // never deleted so objects destroyed at exit can still log
+    static Logger* instance = new Logger();
+    return instance;
+}
+
+//-----------------------------------------------------------------------------
+
+Logger::Logger() : _slots(new Slot[CAPACITY]), _tail(0), _head(0), _pushed(0), _written(0), _running(true), _rate_limit(DEFAULT_RATE_LIMIT)
+{
+    for (size_t i = 0; i < CAPACITY; i++)
+    {
+        _slots[i].seq = i;
+    }
+    _last_rate_check = std::chrono::steady_clock::now();
+    _thread = std::thread(&Logger::_run, this);
+    std::atexit(stop_logger);
+}
+
+//-----------------------------------------------------------------------------
+
+bool Logger::_try_push(Log_Message& msg)
+{
+    size_t pos = _tail.load(std::memory_order_relaxed);
+    while (true)
+    {
+        Slot& slot = _slots[pos % CAPACITY];
+        size_t seq = slot.seq.load(std::memory_order_acquire);
+        long long diff = (long long)seq - (long long)pos;
+        if (diff == 0)
+        {
+            if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                slot.msg = std::move(msg);
+                slot.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            // full
+            return false;
+        }
+        else
+        {
+            pos = _tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+bool Logger::_try_pop(Log_Message& msg)
+{
+    Slot& slot = _slots[_head % CAPACITY];
+    if (slot.seq.load(std::memory_order_acquire) != _head + 1)
+    {
+        return false;
+    }
+    msg = std::move(slot.msg);
+    slot.seq.store(_head + CAPACITY, std::memory_order_release);
+    _head++;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void Logger::push(Log_Message&& msg)
+{
+    _pushed++;
+    while (_running)
+    {
+        if (_try_push(msg))
+        {
+            // stop() may have done its last drain between the _running check and the push, then nobody
+            // else will write this message. Drains are serialized on _write_mutex so writing it here is safe.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (false == _running)
+            {
+                _drain();
+            }
+            return;
+        }
+        _wait_condition.notify_one();
+        std::this_thread::yield();
+    }
+
+    std::lock_guard<std::mutex> lock(_write_mutex);
+    _write(msg);
+    std::cout.flush();
+    _written++;
+}
+
+//-----------------------------------------------------------------------------
+
+void Logger::flush()
+{
+    size_t target = _pushed.load();
+    _wait_condition.notify_one();
+    while (_running && _written.load() < target)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::lock_guard<std::mutex> lock(_write_mutex);
+    std::cout.flush();
+}
+
+//-----------------------------------------------------------------------------
+
+void Logger::stop()
+{
+    if (false == _running.exchange(false))
+    {
+        return;
+    }
+    _wait_condition.notify_one();
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+    // pairs with the fence in push(), a message pushed after this drain is written by its pusher
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    _drain();
+
+    std::lock_guard<std::mutex> lock(_write_mutex);
+    for (auto& itr : _rates)
+    {
+        _write_suppressed(itr.first, itr.second);
+    }
+    std::cout.flush();
+}
+
+//-----------------------------------------------------------------------------
+
+void Logger::_run()
+{
+    while (_running)
+    {
+        if (_drain() == 0)
+        {
+            std::unique_lock<std::mutex> lock(_wait_mutex);
+            _wait_condition.wait_for(lock, std::chrono::milliseconds(5));
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+size_t Logger::_drain()
+{
+    size_t cnt = 0;
+    Log_Message msg;
+    std::lock_guard<std::mutex> lock(_write_mutex);
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    while (_try_pop(msg))
+    {
+        if (_allowed(msg, now))
+        {
+            _write(msg);
+        }
+        _written++;
+        cnt++;
+    }
+
+    // report lines that went quiet after being rate limited
+    if (now - _last_rate_check >= std::chrono::seconds(1))
+    {
+        for (auto& itr : _rates)
+        {
+            if (itr.second.suppressed > 0 && now - itr.second.window_start >= std::chrono::seconds(1))
+            {
+                _write_suppressed(itr.first, itr.second);
+            }
+        }
+        _last_rate_check = now;
+    }
+
+    if (cnt > 0)
+    {
+        std::cout.flush();
+    }
+    return cnt;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Logger::_allowed(const Log_Message& msg, std::chrono::steady_clock::time_point now)
+{
+    size_t limit = _rate_limit;
+    if (msg.file == nullptr || limit == 0)
+    {
+        return true;
+    }
+
+    Rate_State& state = _rates[std::make_pair(msg.file, msg.line)];
+    if (state.count == 0 || now - state.window_start >= std::chrono::seconds(1))
+    {
+        _write_suppressed(std::make_pair(msg.file, msg.line), state);
+        state.window_start = now;
+        state.function = msg.function;
+        state.count = 0;
+    }
+    if (state.count >= limit)
+    {
+        state.suppressed++;
+        return false;
+    }
+    state.count++;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void Logger::_write(const Log_Message& msg)
+{
+    if (msg.file != nullptr)
+    {
+        std::time_t now_c = std::chrono::system_clock::to_time_t(msg.time);
+        std::tm now_tm;
+#if defined _WIN32
+        localtime_s(&now_tm, &now_c);
+#else
+        localtime_r(&now_c, &now_tm);
+#endif
+        std::cout << std::put_time(&now_tm, "[%F_%T]\t") << msg.file << "::" << msg.function << "():" << msg.line << "\t";
+    }
+    std::cout << msg.text;
+}
+
+//-----------------------------------------------------------------------------
+
+void Logger::_write_suppressed(const std::pair<const char*, int>& site, Rate_State& state)
+{
+    if (state.suppressed == 0)
+    {
+        return;
+    }
+    Log_Message msg;
+    msg.file = site.first;
+    msg.function = state.function;
+    msg.line = site.second;
+    msg.time = std::chrono::system_clock::now();
+    msg.text = "Warning: " + std::to_string(state.suppressed) + " repeated messages from this line were not logged\n";
+    _write(msg);
+    state.suppressed = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+Log_Line::Log_Line() : Log_Line(nullptr, nullptr, 0)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+
+Log_Line::Log_Line(const char* file, const char* function, int line) : _file(file), _function(function), _line(line)
+{
+    if (t_stream.in_use)
+    {
+        _stream = new std::ostringstream();
+        _owns_stream = true;
+    }
+    else
+    {
+        t_stream.in_use = true;
+        _stream = &t_stream.stream;
+        _owns_stream = false;
+    }
+    if (_file != nullptr)
+    {
+        _time = std::chrono::system_clock::now();
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+Log_Line::~Log_Line()
+{
+    Log_Message msg;
+    msg.text = _stream->str();
+    msg.file = _file;
+    msg.function = _function;
+    msg.line = _line;
+    msg.time = _time;
+
+    if (_owns_stream)
+    {
+        delete _stream;
+    }
+    else
+    {
+        // reuse the buffer, drop any manipulators left from this line
+        _stream->str(std::string());
+        _stream->clear();
+        _stream->flags(std::ios_base::dec | std::ios_base::skipws);
+        _stream->precision(6);
+        _stream->width(0);
+        _stream->fill(' ');
+        t_stream.in_use = false;
+    }
+
+    if (msg.text.length() > 0)
+    {
+        Logger::inst()->push(std::move(msg));
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void flush()
+{
+    Logger::inst()->flush();
+}
+
+//-----------------------------------------------------------------------------
+
+} //namespace logger
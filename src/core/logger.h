@@ -0,0 +1,244 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include "core/defines.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace logger
+{
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Log_Message struct : One formatted message waiting in the ring buffer.
+/// file is nullptr for raw logit_s output which is written without the time / location header.
+///
+struct Log_Message
+{
+    std::string text;
+
+    const char* file;
+
+    const char* function;
+
+    int line;
+
+    std::chrono::system_clock::time_point time;
+};
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Logger class : Lock free multi producer ring buffer of messages written to std::cout by one background thread.
+/// Messages from the same source line beyond the rate limit within one second are dropped and counted.
+///
+class DLL_EXPORT Logger
+{
+public:
+
+    static Logger* inst();
+
+    ///
+    /// \brief push : Queue a message, waits for the writer if the ring buffer is full.
+    /// Writes directly if the writer thread is not running (ex: during exit).
+    ///
+    void push(Log_Message&& msg);
+
+    ///
+    /// \brief flush : Blocks until every message queued before the call has been written
+    ///
+    void flush();
+
+    ///
+    /// \brief stop : Writes what is queued and stops the writer thread, later messages are written directly
+    ///
+    void stop();
+
+    ///
+    /// \brief set_rate_limit : Max messages per second from one source line, 0 for no limit
+    ///
+    void set_rate_limit(size_t per_second) { _rate_limit = per_second; }
+
+private:
+
+    struct Slot
+    {
+        std::atomic<size_t> seq;
+        Log_Message msg;
+    };
+
+    struct Rate_State
+    {
+        std::chrono::steady_clock::time_point window_start;
+        const char* function;
+        size_t count;
+        size_t suppressed;
+    };
+
+    Logger();
+
+    Logger(const Logger&) = delete;
+
+    Logger& operator=(const Logger&) = delete;
+
+    bool _try_push(Log_Message& msg);
+
+    bool _try_pop(Log_Message& msg);
+
+    void _run();
+
+    size_t _drain();
+
+    bool _allowed(const Log_Message& msg, std::chrono::steady_clock::time_point now);
+
+    void _write(const Log_Message& msg);
+
+    void _write_suppressed(const std::pair<const char*, int>& site, Rate_State& state);
+
+    static const size_t CAPACITY = 8192;
+
+    std::unique_ptr<Slot[]> _slots;
+
+    std::atomic<size_t> _tail;
+
+    size_t _head;
+
+    std::atomic<size_t> _pushed;
+
+    std::atomic<size_t> _written;
+
+    std::atomic<bool> _running;
+
+    std::atomic<size_t> _rate_limit;
+
+    // per source line, only touched by the thread doing the writing
+    std::map<std::pair<const char*, int>, Rate_State> _rates;
+
+    std::chrono::steady_clock::time_point _last_rate_check;
+
+    // serializes writes done outside the writer thread
+    std::mutex _write_mutex;
+
+    std::mutex _wait_mutex;
+
+    std::condition_variable _wait_condition;
+
+    std::thread _thread;
+};
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Log_Line class : Temporary created by the log macros. Formats into a thread local stream
+/// and hands the text to the Logger when the statement ends.
+///
+class DLL_EXPORT Log_Line
+{
+public:
+
+    Log_Line();
+
+    Log_Line(const char* file, const char* function, int line);
+
+    ~Log_Line();
+
+    template<typename T>
+    Log_Line& operator<<(const T& val)
+    {
+        (*_stream) << val;
+        return *this;
+    }
+
+    // std::endl, std::flush, ...
+    Log_Line& operator<<(std::ostream& (*manip)(std::ostream&))
+    {
+        (*_stream) << manip;
+        return *this;
+    }
+
+private:
+
+    Log_Line(const Log_Line&) = delete;
+
+    Log_Line& operator=(const Log_Line&) = delete;
+
+    std::ostringstream* _stream;
+
+    // set if the thread local stream was busy (log inside a log statement) and this line made its own
+    bool _owns_stream;
+
+    const char* _file;
+
+    const char* _function;
+
+    int _line;
+
+    std::chrono::system_clock::time_point _time;
+};
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief flush : Wait for all queued log messages to be written
+///
+DLL_EXPORT void flush();
+
+//-----------------------------------------------------------------------------
+
+} //namespace logger
+
+#endif // LOGGER_H
@@ -69,10 +69,29 @@ void help()
 	logit_s << "--update-amps <us_amp>,<ds_amp>: Updates upstream and downstream amps if they changed inbetween scans.\n";
 	logit_s << "--update-quant-amps <us_amp>,<ds_amp>: Updates upstream and downstream amps for quantification if they changed inbetween scans.\n";
     logit_s<<"--quick-and-dirty : Integrate the detector range into 1 spectra.\n";
+    logit_s<<"--incremental : Skip fit routines whose spectra and fit configuration did not change since their counts were saved.\n";
+    logit_s<<"--matrix-nnls-seed : Start each matrix fit from an NNLS solve and fix the elements it finds no signal for.\n";
+    logit_s<<"--checkpoint <minutes> : Save the rows fitted so far every <minutes> so an interrupted run can continue with --resume.\n";
+    logit_s<<"--resume : Continue each fit routine from its last --checkpoint instead of refitting every row.\n";
+    logit_s<<"--min-pixel-counts <counts> : Skip the fits of pixels whose spectra sum to less than <counts>, they get zero counts.\n";
+    logit_s<<"--pixel-mask <file> : Only fit pixels that are not 0 in a text file with one line of 0 / 1 values per row.\n";
+    logit_s<<"--fit-polygon <c0,r0,c1,r1,...> : Only fit pixels inside the polygon, vertices in column,row pixel coordinates.\n";
+    logit_s<<"--preview <8,4,2> : Fit and save maps of summed 8x8, 4x4 then 2x2 pixel blocks before the full fit of each routine.\n";
 //	logit_s<< "--mem-limit <limit> : Limit the memory usage. Append M for megabytes or G for gigabytes\n";
     logit_s<<"--optimize-fit-override-params : <int> Integrate the 8 largest mda datasets and fit with multiple params.\n"<<
                "  1 = matrix batch fit\n  2 = batch fit without tails\n  3 = batch fit with tails\n  4 = batch fit with free E, everything else fixed \n";
     logit_s<<"--optimizer <lmfit, mpfit> : Choose which optimizer to use for --optimize-fit-override-params or matrix fit routine \n";
+    logit_s<<"--h5-profile <legacy, fast, none, small> : Compression and chunking of the saved .h5 files. Default is legacy (deflate 7) \n"<<
+               "  fast = deflate 1 with shuffle\n  none = no compression\n  small = deflate 9 with shuffle and whole number counts in mca_arr\n";
+    logit_s<<"--h5-compression <0-9> : Overrides the deflate level of --h5-profile, 0 disables compression \n";
+    logit_s<<"--h5-shuffle <0, 1> : Overrides the byte shuffle filter of --h5-profile \n";
+    logit_s<<"--h5-scale-offset <0, 1> : Overrides storing mca_arr as whole number counts (scale-offset filter) \n";
+    logit_s<<"--h5-chunk-cache <int> : Max megabytes of chunk cache per dataset when reading large .h5 files \n";
+    logit_s<<"--telemetry <file.json> : Time load, background, fit, save and stream stages, count bytes and fit iterations and save the summary to file.json \n";
+    logit_s<<"--fit-precision <float, double, mixed, routine:type,..> : Solver precision per fit routine, ex: nnls:double,matrix:float. \n"<<
+               "  nnls and roi_plus solve in double. matrix and tails still evaluate the model and residuals in float, double only \n"<<
+               "  accumulates the optimizer state in double and the tolerances are bounded by float resolution \n"<<
+               "  mixed = double for nnls, roi_plus and tails. Default is float \n";
     logit_s<<"Fitting Routines: \n";
 	logit_s<< "--fit <routines,> comma seperated \n";
     logit_s<<"  roi : element energy region of interest \n";
@@ -86,7 +105,12 @@ void help()
 #ifdef _BUILD_WITH_ZMQ
     logit_s<<"Network: \n";
     logit_s<<"--streamin [source ip] : Accept a ZMQ stream of spectra to process. Source ip defaults to localhost (must compile with -DBUILD_WITH_ZMQ option) \n";
-    logit_s<<"--streamout : Streams the analysis counts over a ZMQ stream (must compile with -DBUILD_WITH_ZMQ option) \n\n";
+    logit_s<<"--streamin-decode-threads : <int> Number of threads decoding the incoming stream (default 2) \n";
+    logit_s<<"--stage-threads : <routine:int,..> Threads of each streaming fit stage, ex: ROI:2,NNLS:12. Default is --nthreads per stage \n";
+    logit_s<<"--streamout : Streams the analysis counts over a ZMQ stream (must compile with -DBUILD_WITH_ZMQ option) \n";
+    logit_s<<"--streamout-version : <int> Counts wire format. 1 = element names with every pixel (default), 2 = element names in a dictionary message, repeated every row \n";
+    logit_s<<"--streamout-batch : <int, row> Pixels per stream message, or one message per row. Default is 1 pixel per message \n";
+    logit_s<<"--streamout-batch-latency : <int> Max milliseconds a pixel waits in a batch. Without --streamout-batch this batches by time window \n\n";
 #endif
     logit_s<<"Examples: \n";
     logit_s<<"   Perform roi and matrix analysis on the directory /data/dataset1 \n";
@@ -250,6 +274,12 @@ int main(int argc, char *argv[])
         analysis_job.set_optimizer(clp.get_option("--optimizer"));
     }
 
+    //Scalar type each fit routine solves in, spectra are stored as float either way
+    if( clp.option_exists("--fit-precision"))
+    {
+        analysis_job.set_fit_precision(clp.get_option("--fit-precision"));
+    }
+
     //Should we sum up all the detectors and process it as one?
     if( clp.option_exists("--quick-and-dirty"))
     {
@@ -262,6 +292,57 @@ int main(int argc, char *argv[])
         analysis_job.generate_average_h5 = true;
     }
 
+    //Only refit routines whose inputs changed since the last run
+    if( clp.option_exists("--incremental"))
+    {
+        analysis_job.skip_unchanged_fits = true;
+    }
+
+    //Linear solve first so the matrix fit only has to refine it
+    if( clp.option_exists("--matrix-nnls-seed"))
+    {
+        analysis_job.matrix_nnls_seed = true;
+    }
+
+    //Periodically save fitted rows and continue from them after an interruption
+    if( clp.option_exists("--checkpoint"))
+    {
+        analysis_job.checkpoint_interval_s = (size_t)(std::stod(clp.get_option("--checkpoint")) * 60.0);
+    }
+    if( clp.option_exists("--resume"))
+    {
+        analysis_job.resume_fits = true;
+    }
+
+    //Leave low signal and masked out pixels out of the fits
+    if( clp.option_exists("--min-pixel-counts"))
+    {
+        analysis_job.pixel_mask.set_min_counts(std::stof(clp.get_option("--min-pixel-counts")));
+    }
+    if( clp.option_exists("--pixel-mask"))
+    {
+        analysis_job.pixel_mask.load_mask_file(clp.get_option("--pixel-mask"));
+    }
+    if( clp.option_exists("--fit-polygon"))
+    {
+        analysis_job.pixel_mask.set_polygon(clp.get_option("--fit-polygon"));
+    }
+
+    //Quick binned maps ahead of the full resolution fit
+    if( clp.option_exists("--preview"))
+    {
+        std::stringstream ss(clp.get_option("--preview"));
+        std::string item;
+        while (std::getline(ss, item, ','))
+        {
+            if (item.length() > 0 && std::stoul(item) > 1)
+            {
+                analysis_job.preview_bins.push_back(std::stoul(item));
+            }
+        }
+        std::sort(analysis_job.preview_bins.rbegin(), analysis_job.preview_bins.rend());
+    }
+
     if(clp.option_exists("--add-v9layout"))
     {
         analysis_job.add_v9_layout = true;
@@ -333,6 +414,27 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (clp.option_exists("--streamin-decode-threads"))
+    {
+        analysis_job.network_source_decode_threads = std::stoul(clp.get_option("--streamin-decode-threads"));
+    }
+
+    if (clp.option_exists("--stage-threads"))
+    {
+        std::stringstream ss(clp.get_option("--stage-threads"));
+        std::string item;
+        while (std::getline(ss, item, ','))
+        {
+            size_t idx = item.find(':');
+            if (idx == std::string::npos || idx == 0)
+            {
+                logW << "Ignoring --stage-threads entry " << item << ", expected <routine>:<threads>\n";
+                continue;
+            }
+            analysis_job.stream_stage_threads[item.substr(0, idx)] = std::stoul(item.substr(idx + 1));
+        }
+    }
+
     if( clp.option_exists("--streamout"))
     {
         analysis_job.stream_over_network = true;
@@ -346,11 +448,87 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (clp.option_exists("--streamout-version"))
+    {
+        int version = std::stoi(clp.get_option("--streamout-version"));
+        if (version != 1 && version != 2)
+        {
+            logE << "--streamout-version has to be 1 or 2, got " << version << "\n";
+            help();
+            return -1;
+        }
+        analysis_job.network_stream_version = version;
+    }
+
+    if (clp.option_exists("--streamout-batch"))
+    {
+        std::string batch_str = clp.get_option("--streamout-batch");
+        if (batch_str == "row")
+        {
+            analysis_job.network_stream_batch_size = 0;
+            analysis_job.network_stream_batch_row = true;
+        }
+        else
+        {
+            analysis_job.network_stream_batch_size = std::stoul(batch_str);
+        }
+    }
+
+    if (clp.option_exists("--streamout-batch-latency"))
+    {
+        analysis_job.network_stream_batch_latency_ms = std::stoul(clp.get_option("--streamout-batch-latency"));
+        if (false == clp.option_exists("--streamout-batch"))
+        {
+            analysis_job.network_stream_batch_size = 0;
+        }
+    }
+
     if (clp.option_exists("--add_background"))
     {
         analysis_job.add_background = true;
     }
 
+    //How the output .h5 datasets are compressed and chunked
+    io::file::H5_Write_Profile h5_profile;
+    if (clp.option_exists("--h5-profile"))
+    {
+        std::string profile_name = clp.get_option("--h5-profile");
+        if (false == io::file::get_h5_write_profile(profile_name, h5_profile))
+        {
+            logW << "Unknown --h5-profile " << profile_name << ", using " << h5_profile.name << "\n";
+        }
+    }
+    if (clp.option_exists("--h5-compression"))
+    {
+        h5_profile.compression_level = std::stoi(clp.get_option("--h5-compression"));
+    }
+    if (clp.option_exists("--h5-shuffle"))
+    {
+        h5_profile.shuffle = (clp.get_option("--h5-shuffle") != "0");
+    }
+    if (clp.option_exists("--h5-scale-offset"))
+    {
+        h5_profile.scale_offset_counts = (clp.get_option("--h5-scale-offset") != "0");
+    }
+    io::file::HDF5_IO::inst()->set_write_profile(h5_profile);
+    if (clp.option_exists("--h5-chunk-cache"))
+    {
+        io::file::HDF5_IO::inst()->set_chunk_cache_budget(std::stoul(clp.get_option("--h5-chunk-cache")) * 1024 * 1024);
+    }
+    io::file::HDF5_IO::inst()->set_read_threads(analysis_job.num_threads);
+
+    std::string telemetry_filename;
+    if (clp.option_exists("--telemetry"))
+    {
+        telemetry_filename = clp.get_option("--telemetry");
+        if (telemetry_filename.length() == 0)
+        {
+            telemetry_filename = "telemetry.json";
+        }
+        telemetry::Telemetry::set_enabled(true);
+        telemetry::Telemetry::inst()->reset();
+    }
+
     //TODO: add --quantify-only option if you already did the fits and just want to add quantification
 
     //What detector range should we process. Usually there are 4 detectors.
@@ -609,6 +787,12 @@ int main(int argc, char *argv[])
     std::chrono::duration<double> elapsed_seconds = end-start;
     logI << "=-=-=-=-=-=- Total elapsed time: " << elapsed_seconds.count() << "s =-=-=-=-=-=-=-\n"<<std::endl; //endl will flush the print.
 
+    if (telemetry::enabled())
+    {
+        telemetry::Telemetry::inst()->log_summary();
+        telemetry::Telemetry::inst()->save_json(telemetry_filename);
+    }
+
 
     return 0;
 }
@@ -49,19 +49,57 @@ POSSIBILITY OF SUCH DAMAGE.
 
 // ----------------------------------------------------------------------------
 
-data_struct::Stream_Block* proc_spectra_block( data_struct::Stream_Block* stream_block )
+static void fit_stream_fitting_block(data_struct::Stream_Block* stream_block, data_struct::Stream_Fitting_Block& fit_block)
 {
-
-    for(auto &itr : stream_block->fitting_blocks)
+    telemetry::Scoped_Timer timer;
+    if (telemetry::enabled())
+    {
+        timer.start("fit_pixel/" + fit_block.fit_routine->get_name());
+    }
+    // a block of one pixel into the counts array the fitting block was built with, so nothing is allocated per pixel
+    fit_block.fit_routine->fit_block(stream_block->model, stream_block->spectra, 1, stream_block->elements_to_fit, fit_block.block_counts);
+    const size_t num_itr_col = fit_block.block_counts.cols() - 2;
+    if (telemetry::enabled())
+    {
+        timer.stop();
+        telemetry::add_value("fit_iterations/" + fit_block.fit_routine->get_name(), fit_block.block_counts(0, num_itr_col));
+    }
+    //make count / sec
+    for (size_t i = 0; i < fit_block.block_columns.size(); i++)
     {
-        std::unordered_map<std::string, real_t> counts_dict;
-        stream_block->fitting_blocks[itr.first].fit_routine->fit_spectra(stream_block->model, stream_block->spectra, stream_block->elements_to_fit, counts_dict);
-        //make count / sec
-        for (auto& el_itr : *(stream_block->elements_to_fit))
+        const size_t col = fit_block.block_columns[i];
+        if (col == num_itr_col)
         {
-            stream_block->fitting_blocks[itr.first].fit_counts[el_itr.first] = counts_dict[el_itr.first] / stream_block->spectra->elapsed_livetime();
+            fit_block.fit_counts[i] = fit_block.block_counts(0, col);
+        }
+        else
+        {
+            fit_block.fit_counts[i] = fit_block.block_counts(0, col) / stream_block->spectra->elapsed_livetime();
         }
-        stream_block->fitting_blocks[itr.first].fit_counts[STR_NUM_ITR] = counts_dict[STR_NUM_ITR];
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+data_struct::Stream_Block* proc_spectra_block( data_struct::Stream_Block* stream_block )
+{
+
+    for(auto &fit_block : stream_block->fitting_blocks)
+    {
+        fit_stream_fitting_block(stream_block, fit_block);
+    }
+    return stream_block;
+}
+
+// ----------------------------------------------------------------------------
+
+data_struct::Stream_Block* fit_stream_block(data_struct::Stream_Block* stream_block, data_struct::Fitting_Routines routine)
+{
+    data_struct::Stream_Fitting_Block* fit_block = stream_block->fitting_block(routine);
+    // end of dataset blocks and detectors without this routine pass through
+    if (fit_block != nullptr && fit_block->fit_routine != nullptr && stream_block->spectra != nullptr)
+    {
+        fit_stream_fitting_block(stream_block, *fit_block);
     }
     return stream_block;
 }
@@ -70,49 +108,97 @@ data_struct::Stream_Block* proc_spectra_block( data_struct::Stream_Block* stream
 
 void run_stream_pipeline(data_struct::Analysis_Job* job)
 {
+    size_t sink_capacity = job->num_threads * 4;
+    size_t num_stage_threads = 0;
+    for (data_struct::Fitting_Routines routine : job->fitting_routines)
+    {
+        std::string routine_name = data_struct::Fitting_Routine_To_Str.at(routine);
+        num_stage_threads += (job->stream_stage_threads.count(routine_name) > 0) ? job->stream_stage_threads.at(routine_name) : job->num_threads;
+    }
+    if (job->fitting_routines.empty())
+    {
+        num_stage_threads = job->num_threads;
+    }
+    // a block in every fitting thread and sink slot with as many again queued in front of them. The network source
+    // holds whole decoded messages until they are released in order and a batch can be any size, so it is never capped.
+    size_t num_blocks = 2 * (num_stage_threads + sink_capacity);
+    // outlives source and sink, pixels go back to it once they are saved or sent
+    workflow::xrf::Stream_Block_Pool block_pool(job->is_network_source ? 0 : num_blocks, num_blocks);
     workflow::Source<data_struct::Stream_Block*> *source;
-    workflow::Distributor<data_struct::Stream_Block*, data_struct::Stream_Block*> distributor(job->num_threads);
+    workflow::Stage_Pipeline pipeline;
     workflow::Sink<data_struct::Stream_Block*> *sink;
 
     //setup input
     if(job->quick_and_dirty)
     {
-        source = new workflow::xrf::Detector_Sum_Spectra_Source(job);
+        workflow::xrf::Detector_Sum_Spectra_Source* sum_source = new workflow::xrf::Detector_Sum_Spectra_Source(job);
+        sum_source->set_stream_block_pool(&block_pool);
+        source = sum_source;
     }
     else if(job->is_network_source)
     {
+        workflow::xrf::Spectra_Net_Source* net_source;
         if(job->network_source_ip.length() > 0)
         {
-            source = new workflow::xrf::Spectra_Net_Source(job, job->network_source_ip, job->network_source_port);
+            net_source = new workflow::xrf::Spectra_Net_Source(job, job->network_source_ip, job->network_source_port);
         }
         else
         {
-            source = new workflow::xrf::Spectra_Net_Source(job);
+            net_source = new workflow::xrf::Spectra_Net_Source(job);
         }
+        net_source->set_num_decode_threads(job->network_source_decode_threads);
+        net_source->set_stream_block_pool(&block_pool);
+        source = net_source;
     }
     else
     {
-        source = new workflow::xrf::Spectra_File_Source(job);
+        workflow::xrf::Spectra_File_Source* file_source = new workflow::xrf::Spectra_File_Source(job);
+        file_source->set_stream_block_pool(&block_pool);
+        source = file_source;
     }
 
     //setup output
     if(job->stream_over_network)
     {
-        sink = new workflow::xrf::Spectra_Net_Streamer(job->network_stream_port);
+        workflow::xrf::Spectra_Net_Streamer* net_sink = new workflow::xrf::Spectra_Net_Streamer(job->network_stream_port);
+        net_sink->set_counts_format_version(job->network_stream_version);
+        net_sink->set_batch(job->network_stream_batch_size, job->network_stream_batch_row, job->network_stream_batch_latency_ms);
+        sink = net_sink;
     }
     else
     {
         sink = new workflow::xrf::Spectra_Stream_Saver();
     }
 
-    distributor.set_function(proc_spectra_block);
-    source->connect(&distributor);
-    sink->connect(&distributor);
+    sink->set_release_function(std::bind(&workflow::xrf::Stream_Block_Pool::release, &block_pool, std::placeholders::_1));
+    sink->set_input_capacity(sink_capacity);
+    // the saver puts rows back in order itself so fits can be handed on as soon as they finish,
+    // network clients still get pixels in the order they were read
+    bool ordered = job->stream_over_network;
 
+    //one stage per fitting routine so each can get its own number of threads
+    for (data_struct::Fitting_Routines routine : job->fitting_routines)
+    {
+        std::string routine_name = data_struct::Fitting_Routine_To_Str.at(routine);
+        size_t num_threads = job->num_threads;
+        if (job->stream_stage_threads.count(routine_name) > 0)
+        {
+            num_threads = job->stream_stage_threads.at(routine_name);
+        }
+        pipeline.add_stage<data_struct::Stream_Block*, data_struct::Stream_Block*>("fit " + routine_name, std::bind(fit_stream_block, std::placeholders::_1, routine), num_threads, 0, ordered);
+    }
+    if (job->fitting_routines.empty())
+    {
+        pipeline.add_stage<data_struct::Stream_Block*, data_struct::Stream_Block*>("fit", proc_spectra_block, job->num_threads, 0, ordered);
+    }
+    pipeline.connect_source(source);
+    pipeline.connect_sink(sink);
 
     sink->start();
     source->run();
+    pipeline.wait_idle();
     sink->wait_and_stop();
+    pipeline.log_stats();
 
     delete source;
     delete sink;
@@ -122,10 +208,14 @@ void run_stream_pipeline(data_struct::Analysis_Job* job)
 
 DLL_EXPORT void stream_spectra(data_struct::Analysis_Job* job)
 {
-	workflow::Source<data_struct::Stream_Block*> *source;
+	// the source hands each block straight to the sink, which releases it before the next pixel is read
+	workflow::xrf::Stream_Block_Pool block_pool(job->num_threads * 4, job->num_threads * 4);
+	workflow::xrf::Spectra_File_Source *source;
 	workflow::xrf::Spectra_Net_Streamer sink(job->network_stream_port);
     sink.set_send_counts(false);
     sink.set_send_spectra(true);
+    sink.set_batch(job->network_stream_batch_size, job->network_stream_batch_row, job->network_stream_batch_latency_ms);
+    sink.set_release_function(std::bind(&workflow::xrf::Stream_Block_Pool::release, &block_pool, std::placeholders::_1));
 
 	//setup input
 	if (job->quick_and_dirty)
@@ -136,7 +226,8 @@ DLL_EXPORT void stream_spectra(data_struct::Analysis_Job* job)
 	{
 		source = new workflow::xrf::Spectra_File_Source(job);
 	}
-	
+	source->set_stream_block_pool(&block_pool);
+
 	source->connect(&sink);
 	source->run();
 
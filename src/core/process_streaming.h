@@ -63,6 +63,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <stdlib.h>
 
 #include "core/defines.h"
+#include "core/telemetry.h"
 
 #include "io/file/hl_file_io.h"
 #include "data_struct/element_info.h"
@@ -82,6 +83,9 @@ POSSIBILITY OF SUCH DAMAGE.
 
 DLL_EXPORT data_struct::Stream_Block* proc_spectra_block( data_struct::Stream_Block* stream_block );
 
+// fits only the given routine, used by the per routine stages of the streaming pipeline
+DLL_EXPORT data_struct::Stream_Block* fit_stream_block(data_struct::Stream_Block* stream_block, data_struct::Fitting_Routines routine);
+
 DLL_EXPORT void run_stream_pipeline(data_struct::Analysis_Job* job);
 
 DLL_EXPORT void stream_spectra(data_struct::Analysis_Job* job);
@@ -132,6 +132,137 @@ bool fit_single_spectra(fitting::routines::Base_Fit_Routine * fit_routine,
 
 // ----------------------------------------------------------------------------
 
+bool fit_spectra_row(fitting::routines::Base_Fit_Routine * fit_routine,
+                     const fitting::models::Base_Model * const model,
+                     const data_struct::Spectra_Line * const spectra_line,
+                     const data_struct::Fit_Element_Map_Dict * const elements_to_fit,
+                     data_struct::Fit_Count_Dict * out_fit_counts,
+                     size_t i,
+                     const data_struct::ArrayXXr* fit_pixels)
+{
+    const size_t num_cols = spectra_line->size();
+    if (num_cols == 0)
+    {
+        return true;
+    }
+
+    const std::vector<std::string> labels = fitting::routines::Base_Fit_Routine::block_labels(elements_to_fit);
+    const size_t num_elements = elements_to_fit->size();
+    data_struct::ArrayXXr block_counts(num_cols, labels.size());
+
+    telemetry::Scoped_Timer timer;
+    if (telemetry::enabled())
+    {
+        timer.start("fit_row/" + fit_routine->get_name());
+    }
+    if (fit_pixels == nullptr || (fit_pixels->row(i) != 0.0).all())
+    {
+        fit_routine->fit_block(model, &(*spectra_line)[0], num_cols, elements_to_fit, block_counts);
+    }
+    else
+    {
+        // skipped pixels keep zero counts, the runs of pixels between them are fitted as blocks
+        block_counts.setZero();
+        data_struct::ArrayXXr run_counts;
+        size_t j = 0;
+        while (j < num_cols)
+        {
+            if ((*fit_pixels)(i, j) == 0.0)
+            {
+                j++;
+                continue;
+            }
+            size_t run_start = j;
+            while (j < num_cols && (*fit_pixels)(i, j) != 0.0)
+            {
+                j++;
+            }
+            run_counts.resize(j - run_start, labels.size());
+            fit_routine->fit_block(model, &(*spectra_line)[run_start], j - run_start, elements_to_fit, run_counts);
+            block_counts.middleRows(run_start, j - run_start) = run_counts;
+        }
+    }
+    timer.stop();
+
+    // look the output maps up once per row instead of once per pixel
+    std::vector<data_struct::ArrayXXr*> element_maps(num_elements, nullptr);
+    int coherent_col = -1;
+    int compton_col = -1;
+    for (size_t e = 0; e < num_elements; e++)
+    {
+        element_maps[e] = &(*out_fit_counts)[labels[e]];
+        if (labels[e] == STR_COHERENT_SCT_AMPLITUDE)
+        {
+            coherent_col = (int)e;
+        }
+        else if (labels[e] == STR_COMPTON_AMPLITUDE)
+        {
+            compton_col = (int)e;
+        }
+    }
+    data_struct::ArrayXXr* num_itr_map = (out_fit_counts->count(STR_NUM_ITR) > 0) ? &out_fit_counts->at(STR_NUM_ITR) : nullptr;
+    data_struct::ArrayXXr* residual_map = (out_fit_counts->count(STR_RESIDUAL) > 0) ? &out_fit_counts->at(STR_RESIDUAL) : nullptr;
+    data_struct::ArrayXXr* total_yield_map = (out_fit_counts->count(STR_TOTAL_FLUORESCENCE_YIELD) > 0) ? &out_fit_counts->at(STR_TOTAL_FLUORESCENCE_YIELD) : nullptr;
+    data_struct::ArrayXXr* sum_elastic_map = (out_fit_counts->count(STR_SUM_ELASTIC_INELASTIC_AMP) > 0) ? &out_fit_counts->at(STR_SUM_ELASTIC_INELASTIC_AMP) : nullptr;
+
+    std::string itr_name;
+    if (telemetry::enabled())
+    {
+        itr_name = "fit_iterations/" + fit_routine->get_name();
+    }
+    for (size_t j = 0; j < num_cols; j++)
+    {
+        const data_struct::Spectra& spectra = (*spectra_line)[j];
+        const real_t elapsed_livetime = spectra.elapsed_livetime();
+        // skipped pixels are often empty fly scan columns with 0 livetime, write 0 instead of normalising them to NaN
+        const bool fitted = (fit_pixels == nullptr || (*fit_pixels)(i, j) != 0.0);
+        //save count / sec
+        for (size_t e = 0; e < num_elements; e++)
+        {
+            (*element_maps[e])(i, j) = fitted ? block_counts(j, e) / elapsed_livetime : (real_t)0.0;
+        }
+        if (num_itr_map != nullptr)
+        {
+            (*num_itr_map)(i, j) = block_counts(j, num_elements);
+            if (telemetry::enabled() && fitted)
+            {
+                telemetry::add_value(itr_name, block_counts(j, num_elements));
+            }
+        }
+        if (residual_map != nullptr)
+        {
+            (*residual_map)(i, j) = block_counts(j, num_elements + 1);
+        }
+        if (false == fitted)
+        {
+            if (sum_elastic_map != nullptr)
+            {
+                (*sum_elastic_map)(i, j) = 0.0;
+            }
+            if (total_yield_map != nullptr)
+            {
+                (*total_yield_map)(i, j) = 0.0;
+            }
+        }
+        // add sum coherent and compton
+        else if (sum_elastic_map != nullptr && coherent_col > -1 && compton_col > -1)
+        {
+            (*sum_elastic_map)(i, j) = block_counts(j, coherent_col) + block_counts(j, compton_col);
+            if (total_yield_map != nullptr)
+            {   //                        (sum - (elastic + inelastic)) / live time
+                (*total_yield_map)(i, j) = (spectra.sum() - (*sum_elastic_map)(i, j)) / elapsed_livetime;
+            }
+        }
+        else if (total_yield_map != nullptr)
+        {
+            (*total_yield_map)(i, j) = spectra.sum() / elapsed_livetime;
+        }
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
 bool optimize_integrated_fit_params(std::string dataset_directory,
                                     std::string  dataset_filename,
                                     size_t detector_num,
@@ -203,6 +334,35 @@ bool optimize_integrated_fit_params(std::string dataset_directory,
 
 // ----------------------------------------------------------------------------
 
+// fit the optimize datasets of one detector in order, each good fit updates params_override so it seeds the next one.
+// returns the number of good fits summed into out_fitp_sum
+static size_t optimize_detector_fit_params(data_struct::Analysis_Job* analysis_job,
+                                           size_t detector_num,
+                                           data_struct::Params_Override* params_override,
+                                           data_struct::Fit_Parameters& out_fitp_sum)
+{
+    size_t file_cnt = 0;
+    for (auto &itr : analysis_job->optimize_dataset_files)
+    {
+        data_struct::Fit_Parameters out_fitp;
+        if (optimize_integrated_fit_params(analysis_job->dataset_directory, itr, detector_num, params_override, analysis_job->optimize_fit_params_preset, analysis_job->optimizer(), out_fitp))
+        {
+            if (file_cnt > 0)
+            {
+                out_fitp_sum.sum_values(out_fitp);
+            }
+            else
+            {
+                out_fitp_sum = out_fitp;
+            }
+            file_cnt++;
+        }
+    }
+    return file_cnt;
+}
+
+// ----------------------------------------------------------------------------
+
 void generate_optimal_params(data_struct::Analysis_Job* analysis_job)
 {
     std::unordered_map<int, data_struct::Fit_Parameters> fit_params_avgs;
@@ -215,52 +375,48 @@ void generate_optimal_params(data_struct::Analysis_Job* analysis_job)
     for (size_t detector_num : analysis_job->detector_num_arr)
     {
         detector_file_cnt[detector_num] = 0.0;
+        fit_params_avgs[detector_num] = data_struct::Fit_Parameters();
     }
 
-
-    for(auto &itr : analysis_job->optimize_dataset_files)
+    //load override parameters before starting the fits, the detectors only share read only state after this
+    for (size_t detector_num : analysis_job->detector_num_arr)
     {
-        for(size_t detector_num : analysis_job->detector_num_arr)
+        if (params.count(detector_num) > 0)
         {
-            //reuse previous param override if it exists
-            if (params.count(detector_num) > 0)
-            {
-                params_override = params[detector_num];
-            }
-            else
+            continue;
+        }
+        params_override = new data_struct::Params_Override();
+        if (false == io::load_override_params(analysis_job->dataset_directory, detector_num, params_override))
+        {
+            if (false == io::load_override_params(analysis_job->dataset_directory, -1, params_override))
             {
-                params_override = new data_struct::Params_Override();
-                //load override parameters
-                if (false == io::load_override_params(analysis_job->dataset_directory, detector_num, params_override))
-                {
-                    if (false == io::load_override_params(analysis_job->dataset_directory, -1, params_override))
-                    {
-                        logE << "Loading maps_fit_parameters_override.txt\n";
-                        delete params_override;
-                        params_override = nullptr;
-                        continue;
-                    }
-                }
-                if (params_override != nullptr)
-                {
-                    params[detector_num] = params_override;
-                }
-				
+                logE << "Loading maps_fit_parameters_override.txt\n";
+                delete params_override;
+                continue;
             }
+        }
+        params[detector_num] = params_override;
+    }
 
-            data_struct::Fit_Parameters out_fitp;
-            if (optimize_integrated_fit_params(analysis_job->dataset_directory, itr, detector_num, params_override, analysis_job->optimize_fit_params_preset, analysis_job->optimizer(), out_fitp))
+    // the datasets of a detector stay in order since each fit starts from the previous one, the detectors are fit concurrently
+    {
+        ThreadPool tp(std::max((size_t)1, std::min(analysis_job->num_threads, params.size())));
+        std::vector<std::pair<size_t, std::future<size_t> > > detector_jobs;
+        std::unordered_set<size_t> detector_jobs_started;
+        for (size_t detector_num : analysis_job->detector_num_arr)
+        {
+            if (params.count(detector_num) == 0 || detector_jobs_started.count(detector_num) > 0)
             {
-                detector_file_cnt[detector_num] += 1.0;
-                if (fit_params_avgs.count(detector_num) > 0)
-                {
-                    fit_params_avgs[detector_num].sum_values(out_fitp);
-                }
-                else
-                {
-                    fit_params_avgs[detector_num] = out_fitp;
-                }
+                continue;
             }
+            detector_jobs_started.insert(detector_num);
+            data_struct::Params_Override* detector_params = params[detector_num];
+            data_struct::Fit_Parameters* detector_fitp = &fit_params_avgs[detector_num];
+            detector_jobs.emplace_back(detector_num, tp.enqueue(optimize_detector_fit_params, analysis_job, detector_num, detector_params, std::ref(*detector_fitp)));
+        }
+        for (auto& itr : detector_jobs)
+        {
+            detector_file_cnt[itr.first] = (float)itr.second.get();
         }
     }
 
@@ -287,11 +443,315 @@ void generate_optimal_params(data_struct::Analysis_Job* analysis_job)
 
 // ----------------------------------------------------------------------------
 
+// bump when a change to the fitting code should invalidate the hashes saved by older builds
+#define FIT_INPUT_HASH_VERSION 1
+
+static const uint64_t FIT_HASH_OFFSET = 0xcbf29ce484222325ULL;
+static const uint64_t FIT_HASH_PRIME = 0x100000001b3ULL;
+
+// fnv-1a over 8 byte words, it only has to notice that an input changed
+static uint64_t hash_bytes(uint64_t h, const void* data, size_t len)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(uint64_t));
+        h = (h ^ word) * FIT_HASH_PRIME;
+        h ^= h >> 32;
+    }
+    for (; i < len; i++)
+    {
+        h = (h ^ bytes[i]) * FIT_HASH_PRIME;
+    }
+    return h;
+}
+
+static uint64_t hash_string(uint64_t h, const std::string& str)
+{
+    uint64_t len = str.length();
+    h = hash_bytes(h, &len, sizeof(len));
+    return hash_bytes(h, str.data(), str.length());
+}
+
+static uint64_t hash_value(uint64_t h, double val)
+{
+    return hash_bytes(h, &val, sizeof(val));
+}
+
+// ----------------------------------------------------------------------------
+
+uint64_t spectra_volume_hash(const data_struct::Spectra_Volume* spectra_volume, ThreadPool* tp)
+{
+    std::vector<std::future<uint64_t> > row_hashes;
+    row_hashes.reserve(spectra_volume->rows());
+    for (size_t i = 0; i < spectra_volume->rows(); i++)
+    {
+        const data_struct::Spectra_Line* spectra_line = &(*spectra_volume)[i];
+        row_hashes.emplace_back(tp->enqueue([spectra_line]()
+        {
+            uint64_t h = FIT_HASH_OFFSET;
+            for (size_t j = 0; j < spectra_line->size(); j++)
+            {
+                const data_struct::Spectra& spectra = (*spectra_line)[j];
+                h = hash_bytes(h, spectra.data(), spectra.size() * sizeof(real_t));
+                real_t meta[4] = { spectra.elapsed_livetime(), spectra.elapsed_realtime(), spectra.input_counts(), spectra.output_counts() };
+                h = hash_bytes(h, meta, sizeof(meta));
+            }
+            return h;
+        }));
+    }
+
+    uint64_t dims[3] = { spectra_volume->rows(), spectra_volume->cols(), spectra_volume->samples_size() };
+    uint64_t h = hash_bytes(FIT_HASH_OFFSET, dims, sizeof(dims));
+    for (auto& itr : row_hashes)
+    {
+        uint64_t row_hash = itr.get();
+        h = hash_bytes(h, &row_hash, sizeof(row_hash));
+    }
+    return h;
+}
+
+// ----------------------------------------------------------------------------
+
+uint64_t fit_config_hash(uint64_t input_hash,
+                         const data_struct::Detector* detector,
+                         fitting::routines::Base_Fit_Routine* fit_routine,
+                         const fitting::models::Range& energy_range)
+{
+    uint64_t h = FIT_HASH_OFFSET;
+    uint64_t header[4] = { FIT_INPUT_HASH_VERSION, input_hash, energy_range.min, energy_range.max };
+    h = hash_bytes(h, header, sizeof(header));
+    h = hash_string(h, fit_routine->get_name());
+    h = hash_value(h, (double)fit_routine->precision());
+
+    // parameters and elements are in unordered maps, hash them sorted by name
+    std::map<std::string, const data_struct::Fit_Param*> fit_params;
+    for (const auto& itr : detector->model->fit_parameters())
+    {
+        fit_params[itr.first] = &itr.second;
+    }
+    for (const auto& itr : fit_params)
+    {
+        h = hash_string(h, itr.first);
+        h = hash_value(h, itr.second->value);
+        h = hash_value(h, itr.second->min_val);
+        h = hash_value(h, itr.second->max_val);
+        h = hash_value(h, itr.second->step_size);
+        h = hash_value(h, (double)itr.second->bound_type);
+    }
+
+    const data_struct::Params_Override& override_params = detector->fit_params_override_dict;
+    std::map<std::string, const data_struct::Fit_Element_Map*> elements(override_params.elements_to_fit.begin(), override_params.elements_to_fit.end());
+    for (const auto& itr : elements)
+    {
+        h = hash_string(h, itr.first);
+        if (itr.second != nullptr)
+        {
+            h = hash_value(h, itr.second->center());
+            h = hash_value(h, itr.second->width());
+        }
+    }
+
+    // detector properties that go into the element line ratios
+    h = hash_string(h, override_params.detector_element);
+    h = hash_string(h, override_params.be_window_thickness);
+    h = hash_string(h, override_params.det_chip_thickness);
+    h = hash_string(h, override_params.ge_dead_layer);
+    h = hash_string(h, override_params.airpath);
+    h = hash_value(h, override_params.si_escape_factor);
+    h = hash_value(h, override_params.ge_escape_factor);
+    h = hash_value(h, (double)override_params.si_escape_enabled);
+    h = hash_value(h, (double)override_params.ge_escape_enabled);
+
+    std::string name = fit_routine->get_name();
+    if (name == STR_FIT_GAUSS_TAILS || name == STR_FIT_GAUSS_MATRIX)
+    {
+        fitting::routines::Param_Optimized_Fit_Routine* param_routine = dynamic_cast<fitting::routines::Param_Optimized_Fit_Routine*>(fit_routine);
+        if (param_routine != nullptr && param_routine->optimizer() != nullptr)
+        {
+            std::unordered_map<std::string, real_t> opt_options = param_routine->optimizer()->get_options();
+            std::map<std::string, real_t> options(opt_options.begin(), opt_options.end());
+            for (const auto& itr : options)
+            {
+                h = hash_string(h, itr.first);
+                h = hash_value(h, itr.second);
+            }
+            h = hash_value(h, (double)param_routine->optimizer()->precision());
+        }
+        if (name == STR_FIT_GAUSS_MATRIX)
+        {
+            h = hash_value(h, (double)((fitting::routines::Matrix_Optimized_Fit_Routine*)fit_routine)->nnls_seed());
+        }
+    }
+
+    return h;
+}
+
+// ----------------------------------------------------------------------------
+
+static void save_fit_checkpoint(fitting::routines::Base_Fit_Routine* fit_routine,
+                                bool is_matrix_fit,
+                                const data_struct::Fit_Count_Dict* element_fit_count_dict,
+                                uint64_t checkpoint_hash,
+                                size_t rows_done)
+{
+    telemetry::Scoped_Timer checkpoint_timer("save/checkpoint");
+    io::file::H5_Fit_Checkpoint checkpoint;
+    checkpoint.fit_hash = checkpoint_hash;
+    checkpoint.rows_done = rows_done;
+    if (is_matrix_fit)
+    {
+        fitting::routines::Matrix_Optimized_Fit_Routine* matrix_fit = (fitting::routines::Matrix_Optimized_Fit_Routine*)fit_routine;
+        checkpoint.integrated_fitted = matrix_fit->fitted_integrated_spectra();
+        checkpoint.integrated_background = matrix_fit->fitted_integrated_background();
+        checkpoint.max_channels = matrix_fit->max_integrated_spectra();
+        checkpoint.max_10_channels = matrix_fit->max_10_integrated_spectra();
+    }
+
+    // the counts are only complete once the whole map is fitted
+    io::file::HDF5_IO::inst()->save_fit_input_hash(fit_routine->get_name(), 0);
+    io::file::HDF5_IO::inst()->save_element_fits(fit_routine->get_name(), element_fit_count_dict);
+    if (io::file::HDF5_IO::inst()->save_fit_checkpoint(fit_routine->get_name(), checkpoint))
+    {
+        logI << "Checkpoint " << fit_routine->get_name() << " at row " << rows_done << "\n";
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+// skipped pixels of fit_pixels are left out of the blocks, binned_pixels gets 0 for blocks without any pixel to fit
+static data_struct::Spectra_Volume* bin_spectra_volume(const data_struct::Spectra_Volume* spectra_volume,
+                                                       size_t bin,
+                                                       const data_struct::ArrayXXr* fit_pixels,
+                                                       data_struct::ArrayXXr* binned_pixels,
+                                                       ThreadPool* tp)
+{
+    const size_t rows = (spectra_volume->rows() + bin - 1) / bin;
+    const size_t cols = (spectra_volume->cols() + bin - 1) / bin;
+    data_struct::Spectra_Volume* binned_volume = new data_struct::Spectra_Volume();
+    binned_volume->resize_and_zero(rows, cols, spectra_volume->samples_size());
+    if (fit_pixels != nullptr)
+    {
+        binned_pixels->setZero(rows, cols);
+    }
+
+    std::vector<std::future<bool> > row_jobs;
+    for (size_t r = 0; r < rows; r++)
+    {
+        row_jobs.emplace_back(tp->enqueue([spectra_volume, binned_volume, bin, r, fit_pixels, binned_pixels]()
+        {
+            data_struct::Spectra_Line& binned_line = (*binned_volume)[r];
+            for (size_t c = 0; c < binned_line.size(); c++)
+            {
+                // new spectra start at 1 sec, the block sums its own times
+                binned_line[c].elapsed_livetime(0.0);
+                binned_line[c].elapsed_realtime(0.0);
+                binned_line[c].input_counts(0.0);
+                binned_line[c].output_counts(0.0);
+            }
+            const size_t last_row = std::min((r + 1) * bin, spectra_volume->rows());
+            for (size_t i = r * bin; i < last_row; i++)
+            {
+                const data_struct::Spectra_Line& spectra_line = (*spectra_volume)[i];
+                for (size_t j = 0; j < spectra_line.size(); j++)
+                {
+                    if (fit_pixels != nullptr)
+                    {
+                        if ((*fit_pixels)(i, j) == 0.0)
+                        {
+                            continue;
+                        }
+                        (*binned_pixels)(r, j / bin) = 1.0;
+                    }
+                    binned_line[j / bin].add(spectra_line[j]);
+                }
+            }
+            return true;
+        }));
+    }
+    for (auto& itr : row_jobs)
+    {
+        itr.get();
+    }
+    return binned_volume;
+}
+
+// ----------------------------------------------------------------------------
+
+// fit bin x bin summed spectra and spread the counts over the pixels of each block
+static void fit_preview_level(fitting::routines::Base_Fit_Routine* fit_routine,
+                              data_struct::Detector* detector,
+                              const data_struct::Spectra_Volume* spectra_volume,
+                              size_t bin,
+                              const data_struct::ArrayXXr* fit_pixels,
+                              ThreadPool* tp,
+                              data_struct::Fit_Count_Dict* element_fit_count_dict)
+{
+    telemetry::Scoped_Timer preview_timer;
+    if (telemetry::enabled())
+    {
+        preview_timer.start("fit_preview/" + fit_routine->get_name());
+    }
+    std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
+
+    // same pixels as the full fit so the preview maps match its output
+    data_struct::ArrayXXr binned_pixels;
+    data_struct::Spectra_Volume* binned_volume = bin_spectra_volume(spectra_volume, bin, fit_pixels, &binned_pixels, tp);
+    const data_struct::ArrayXXr* binned_fit_pixels = (fit_pixels != nullptr) ? &binned_pixels : nullptr;
+    data_struct::Fit_Element_Map_Dict* elements_to_fit = &detector->fit_params_override_dict.elements_to_fit;
+    data_struct::Fit_Count_Dict* binned_counts = generate_fit_count_dict(elements_to_fit, binned_volume->rows(), binned_volume->cols(), true);
+
+    std::vector<std::future<bool> > row_jobs;
+    for (size_t i = 0; i < binned_volume->rows(); i++)
+    {
+        row_jobs.emplace_back(tp->enqueue(fit_spectra_row, fit_routine, detector->model, &(*binned_volume)[i], elements_to_fit, binned_counts, i, binned_fit_pixels));
+    }
+    for (auto& itr : row_jobs)
+    {
+        itr.get();
+    }
+
+    for (auto& itr : *binned_counts)
+    {
+        auto full_itr = element_fit_count_dict->find(itr.first);
+        if (full_itr == element_fit_count_dict->end())
+        {
+            continue;
+        }
+        data_struct::ArrayXXr& full_map = full_itr->second;
+        for (Eigen::Index i = 0; i < full_map.rows(); i++)
+        {
+            for (Eigen::Index j = 0; j < full_map.cols(); j++)
+            {
+                full_map(i, j) = (fit_pixels != nullptr && (*fit_pixels)(i, j) == 0.0) ? (real_t)0.0 : itr.second(i / bin, j / bin);
+            }
+        }
+    }
+    delete binned_counts;
+    delete binned_volume;
+
+    std::chrono::duration<double> elapsed_seconds = std::chrono::system_clock::now() - start;
+    logI << "Preview [ " << fit_routine->get_name() << " ] " << bin << "x" << bin << " elapsed time: " << elapsed_seconds.count() << "s\n";
+
+    io::file::HDF5_IO::inst()->save_fit_input_hash(fit_routine->get_name(), 0);
+    io::file::HDF5_IO::inst()->save_element_fits(fit_routine->get_name(), element_fit_count_dict);
+    io::file::HDF5_IO::inst()->save_preview_bin(fit_routine->get_name(), bin);
+}
+
+// ----------------------------------------------------------------------------
+
 void proc_spectra(data_struct::Spectra_Volume* spectra_volume,
                   data_struct::Detector * detector,
                   ThreadPool* tp,
                   bool save_spec_vol,
-                  Callback_Func_Status_Def* status_callback)
+                  Callback_Func_Status_Def* status_callback,
+                  bool skip_unchanged_fits,
+                  size_t checkpoint_interval_s,
+                  bool resume_fits,
+                  const data_struct::Pixel_Mask* pixel_mask,
+                  const std::vector<size_t>* preview_bins)
 {
     if (detector == nullptr)
     {
@@ -312,13 +772,81 @@ void proc_spectra(data_struct::Spectra_Volume* spectra_volume,
 
     std::chrono::time_point<std::chrono::system_clock> start, end;
 
+    if (checkpoint_interval_s > 0 && save_spec_vol)
+    {
+        // a resumed run loads the spectra back from this file, so they have to be in it before the first checkpoint
+        io::file::HDF5_IO::inst()->save_spectra_volume("mca_arr", spectra_volume);
+        telemetry::add_count("save/bytes", spectra_volume->rows() * spectra_volume->cols() * spectra_volume->samples_size() * sizeof(real_t));
+        save_spec_vol = false;
+        if (io::file::HDF5_IO::inst()->write_profile().scale_offset_counts)
+        {
+            // the scale-offset profile rounds mca_arr, fit and hash the counts as a resumed run will load them
+            if (false == io::file::HDF5_IO::inst()->load_spectra_vol_analyzed_h5(io::file::HDF5_IO::inst()->filename(), spectra_volume))
+            {
+                logW << "Could not reload the rounded mca_arr, a resumed run will not match this checkpoint\n";
+            }
+        }
+    }
+
+    // saved with the counts so a later run can skip routines whose spectra and configuration did not change.
+    // checkpoints are matched on it too so --resume never continues the rows of a different scan
+    uint64_t input_hash = spectra_volume_hash(spectra_volume, tp);
+
+    data_struct::Pixel_Mask scan_mask;
+    if (pixel_mask != nullptr && false == pixel_mask->file_mask_fits(spectra_volume->rows(), spectra_volume->cols()))
+    {
+        logE << "Pixel mask file is " << pixel_mask->file_mask().rows() << " x " << pixel_mask->file_mask().cols() << " but the scan is " << spectra_volume->rows() << " x " << spectra_volume->cols() << ", not using it for this scan\n";
+        scan_mask = *pixel_mask;
+        scan_mask.clear_file_mask();
+        pixel_mask = &scan_mask;
+    }
+
+    // pre-pass over the pixels, the ones left out of the mask get zero counts in every routine
+    data_struct::ArrayXXr* fit_pixels = nullptr;
+    if (pixel_mask != nullptr && pixel_mask->enabled())
+    {
+        fit_pixels = new data_struct::ArrayXXr(spectra_volume->rows(), spectra_volume->cols());
+        std::vector<std::future<size_t> > row_skipped;
+        for (size_t i = 0; i < spectra_volume->rows(); i++)
+        {
+            const data_struct::Spectra_Line* spectra_line = &(*spectra_volume)[i];
+            row_skipped.emplace_back(tp->enqueue([pixel_mask, spectra_line, i, fit_pixels]() { return pixel_mask->fill_row(*spectra_line, i, *fit_pixels); }));
+        }
+        size_t skipped = 0;
+        for (auto& itr : row_skipped)
+        {
+            skipped += itr.get();
+        }
+        logI << "Skipping " << skipped << " of " << fit_pixels->size() << " pixels outside the mask or below " << pixel_mask->min_counts() << " counts\n";
+        telemetry::add_count("fit_skipped_pixels", skipped);
+        input_hash = hash_bytes(input_hash, fit_pixels->data(), fit_pixels->size() * sizeof(real_t));
+        io::file::HDF5_IO::inst()->save_skipped_pixels(*fit_pixels);
+    }
+
     for(auto &itr : detector->fit_routines)
     {
         fitting::routines::Base_Fit_Routine *fit_routine = itr.second;
 
+        uint64_t fit_hash = fit_config_hash(input_hash, detector, fit_routine, energy_range);
+        if (skip_unchanged_fits)
+        {
+            uint64_t saved_hash = 0;
+            if (io::file::HDF5_IO::inst()->load_fit_input_hash(fit_routine->get_name(), saved_hash) && saved_hash == fit_hash)
+            {
+                logI << "Skipping " << fit_routine->get_name() << ", spectra and fit configuration did not change since it was saved\n";
+                telemetry::add_count("fit_skipped/" + fit_routine->get_name(), 1);
+                continue;
+            }
+        }
+
         logI << "Processing  "<< fit_routine->get_name()<<"\n";
 
         start = std::chrono::system_clock::now();
+        telemetry::Scoped_Timer fit_timer;
+        if (telemetry::enabled())
+        {
+            fit_timer.start("fit/" + fit_routine->get_name());
+        }
         if (override_params->elements_to_fit.size() < 1)
         {
             logE<<"No elements to fit. Check  maps_fit_parameters_override.txt0 - 3 exist"<<"\n";
@@ -331,39 +859,128 @@ void proc_spectra(data_struct::Spectra_Volume* spectra_volume,
         //Allocate memeory to save fit counts
         data_struct::Fit_Count_Dict  *element_fit_count_dict = generate_fit_count_dict(&override_params->elements_to_fit, spectra_volume->rows(), spectra_volume->cols(), true);
 
-        for(size_t i=0; i<spectra_volume->rows(); i++)
+        bool is_matrix_fit = (itr.first == data_struct::Fitting_Routines::GAUSS_MATRIX
+                              || itr.first == data_struct::Fitting_Routines::NNLS
+                              || itr.first == data_struct::Fitting_Routines::SVD);
+        size_t rows = spectra_volume->rows();
+        size_t next_row = 0;
+        if (checkpoint_interval_s > 0 || resume_fits)
+        {
+            // rows past the checkpoint are saved with it, keep them from holding whatever the allocation had
+            for (auto& c_itr : *element_fit_count_dict)
+            {
+                c_itr.second.setZero();
+            }
+        }
+        if (resume_fits)
         {
-            for(size_t j=0; j<spectra_volume->cols(); j++)
+            io::file::H5_Fit_Checkpoint checkpoint;
+            if (io::file::HDF5_IO::inst()->load_fit_checkpoint(fit_routine->get_name(), checkpoint))
             {
-                //logD<< i<<" "<<j<<"\n";
-                fit_job_queue->emplace( tp->enqueue(fit_single_spectra, fit_routine, detector->model, &(*spectra_volume)[i][j], &override_params->elements_to_fit, element_fit_count_dict, i, j) );
+                if (checkpoint.fit_hash == fit_hash && checkpoint.rows_done <= rows
+                    && io::file::HDF5_IO::inst()->load_element_fits(fit_routine->get_name(), element_fit_count_dict))
+                {
+                    if (is_matrix_fit)
+                    {
+                        fitting::routines::Matrix_Optimized_Fit_Routine* matrix_fit = (fitting::routines::Matrix_Optimized_Fit_Routine*)fit_routine;
+                        matrix_fit->set_integrated_spectra(checkpoint.integrated_fitted, checkpoint.integrated_background, checkpoint.max_channels, checkpoint.max_10_channels);
+                    }
+                    next_row = checkpoint.rows_done;
+                    logI << "Resuming " << fit_routine->get_name() << " at row " << next_row << " of " << rows << "\n";
+                    telemetry::add_count("fit_resumed_rows/" + fit_routine->get_name(), next_row);
+                }
+                else
+                {
+                    logW << "Checkpoint of " << fit_routine->get_name() << " does not match the spectra or fit configuration, fitting all rows\n";
+                    for (auto& c_itr : *element_fit_count_dict)
+                    {
+                        c_itr.second.setZero();
+                    }
+                }
             }
         }
 
-        size_t total_blocks = (spectra_volume->rows() * spectra_volume->cols()) - 1;
-        size_t cur_block = 0;
+        // coarse maps first so there is something to look at long before the full fit is done
+        if (preview_bins != nullptr && preview_bins->size() > 0 && next_row == 0)
+        {
+            // the previews must not end up in the integrated spectra of the full fit
+            data_struct::Spectra int_fitted, int_background, max_channels, max_10_channels;
+            fitting::routines::Matrix_Optimized_Fit_Routine* matrix_fit = nullptr;
+            if (is_matrix_fit)
+            {
+                matrix_fit = (fitting::routines::Matrix_Optimized_Fit_Routine*)fit_routine;
+                int_fitted = matrix_fit->fitted_integrated_spectra();
+                int_background = matrix_fit->fitted_integrated_background();
+                max_channels = matrix_fit->max_integrated_spectra();
+                max_10_channels = matrix_fit->max_10_integrated_spectra();
+            }
+            for (size_t bin : *preview_bins)
+            {
+                if (bin > 1)
+                {
+                    fit_preview_level(fit_routine, detector, spectra_volume, bin, fit_pixels, tp, element_fit_count_dict);
+                }
+            }
+            if (matrix_fit != nullptr)
+            {
+                matrix_fit->set_integrated_spectra(int_fitted, int_background, max_channels, max_10_channels);
+            }
+        }
+
+        // one task per row, idle workers steal rows from busy ones. With checkpoints the rows are handed
+        // out a few per thread at a time so a checkpoint only waits for the rows already running.
+        size_t max_in_flight = rows;
+        if (checkpoint_interval_s > 0)
+        {
+            max_in_flight = std::max((size_t)1, tp->size() * 4);
+        }
+        std::chrono::time_point<std::chrono::steady_clock> last_checkpoint = std::chrono::steady_clock::now();
+
+        size_t total_blocks = (rows * spectra_volume->cols()) - 1;
+        size_t cur_block = next_row * spectra_volume->cols();
         //wait for queue to finish processing
-        while(!fit_job_queue->empty())
+        while (true)
         {
+            bool checkpoint_due = (checkpoint_interval_s > 0 && next_row < rows
+                                   && std::chrono::steady_clock::now() - last_checkpoint >= std::chrono::seconds(checkpoint_interval_s));
+            if (checkpoint_due && fit_job_queue->empty())
+            {
+                // every row before next_row is done and nothing else is running
+                save_fit_checkpoint(fit_routine, is_matrix_fit, element_fit_count_dict, fit_hash, next_row);
+                last_checkpoint = std::chrono::steady_clock::now();
+                checkpoint_due = false;
+            }
+            while (false == checkpoint_due && next_row < rows && fit_job_queue->size() < max_in_flight)
+            {
+                fit_job_queue->emplace( tp->enqueue(fit_spectra_row, fit_routine, detector->model, &(*spectra_volume)[next_row], &override_params->elements_to_fit, element_fit_count_dict, next_row, fit_pixels) );
+                next_row++;
+            }
+            if (fit_job_queue->empty())
+            {
+                break;
+            }
             auto ret = std::move(fit_job_queue->front());
             fit_job_queue->pop();
             ret.get();
+            cur_block += spectra_volume->cols();
             if (status_callback != nullptr)
             {
-                (*status_callback)(cur_block, total_blocks);
+                (*status_callback)(std::min(cur_block, total_blocks), total_blocks);
             }
-            cur_block++;
         }
 
         std::chrono::time_point<std::chrono::system_clock> end = std::chrono::system_clock::now();
         std::chrono::duration<double> elapsed_seconds = end-start;
         logI << "Fitting [ "<< fit_routine->get_name() <<" ] elapsed time: " << elapsed_seconds.count() << "s"<<"\n";
+        fit_timer.stop();
 
+        telemetry::Scoped_Timer save_timer("save");
+        // cleared first so a run that stops while saving does not leave a matching hash next to partial counts
+        io::file::HDF5_IO::inst()->save_fit_input_hash(fit_routine->get_name(), 0);
         io::file::HDF5_IO::inst()->save_element_fits(fit_routine->get_name(), element_fit_count_dict);
+        telemetry::add_count("save/bytes", element_fit_count_dict->size() * spectra_volume->rows() * spectra_volume->cols() * sizeof(real_t));
 
-        if(itr.first == data_struct::Fitting_Routines::GAUSS_MATRIX 
-            || itr.first == data_struct::Fitting_Routines::NNLS 
-            || itr.first == data_struct::Fitting_Routines::SVD)
+        if(is_matrix_fit)
         {
             fitting::routines::Matrix_Optimized_Fit_Routine* matrix_fit = (fitting::routines::Matrix_Optimized_Fit_Routine*)fit_routine;
             io::file::HDF5_IO::inst()->save_fitted_int_spectra( fit_routine->get_name(),
@@ -381,12 +998,28 @@ void proc_spectra(data_struct::Spectra_Volume* spectra_volume,
 																matrix_fit->max_10_integrated_spectra(),
                                                                 matrix_fit->fitted_integrated_background());
 		}
+        io::file::HDF5_IO::inst()->save_fit_input_hash(fit_routine->get_name(), fit_hash);
+        if (preview_bins != nullptr && preview_bins->size() > 0)
+        {
+            io::file::HDF5_IO::inst()->save_preview_bin(fit_routine->get_name(), 1);
+        }
+        if (checkpoint_interval_s > 0 || resume_fits)
+        {
+            io::file::HDF5_IO::inst()->remove_fit_checkpoint(fit_routine->get_name());
+        }
+
+        save_timer.stop();
 
         delete fit_job_queue;
         element_fit_count_dict->clear();
         delete element_fit_count_dict;
     }
 
+    if (fit_pixels != nullptr)
+    {
+        delete fit_pixels;
+    }
+
     real_t energy_offset = 0.0;
     real_t energy_slope = 0.0;
     real_t energy_quad = 0.0;
@@ -404,11 +1037,13 @@ void proc_spectra(data_struct::Spectra_Volume* spectra_volume,
         energy_quad = fit_params[STR_ENERGY_QUADRATIC].value;
     }
 
+    telemetry::Scoped_Timer save_timer("save");
     io::file::HDF5_IO::inst()->save_energy_calib(spectra_volume->samples_size(), energy_offset, energy_slope, energy_quad);
 
     if(save_spec_vol)
     {
         io::file::HDF5_IO::inst()->save_spectra_volume("mca_arr", spectra_volume);
+        telemetry::add_count("save/bytes", spectra_volume->rows() * spectra_volume->cols() * spectra_volume->samples_size() * sizeof(real_t));
     }
     io::file::HDF5_IO::inst()->save_quantification(detector);
     io::file::HDF5_IO::inst()->end_save_seq();
@@ -432,13 +1067,35 @@ void process_dataset_files(data_struct::Analysis_Job* analysis_job, Callback_Fun
         //otherwise process each detector separately
         else
         {
+            // raw fly scans with all detectors in one MAPS_RAW file are read in one pass
+            std::vector<data_struct::Spectra_Volume*> spectra_volumes;
+            std::vector<bool> preloaded_from_analyzed;
+            std::vector<data_struct::Params_Override*> params_overrides;
             for(size_t detector_num : analysis_job->detector_num_arr)
             {
+                spectra_volumes.push_back(new data_struct::Spectra_Volume());
+                params_overrides.push_back(&(analysis_job->get_detector(detector_num)->fit_params_override_dict));
+            }
+            telemetry::Scoped_Timer load_timer("load");
+            bool preloaded = io::load_spectra_volumes(analysis_job->dataset_directory, dataset_file, analysis_job->detector_num_arr, &spectra_volumes, params_overrides, &preloaded_from_analyzed);
+            load_timer.stop();
+            if (preloaded)
+            {
+                for (data_struct::Spectra_Volume* vol : spectra_volumes)
+                {
+                    telemetry::add_count("load/bytes", vol->rows() * vol->cols() * vol->samples_size() * sizeof(real_t));
+                }
+            }
+
+            for(size_t d = 0; d < analysis_job->detector_num_arr.size(); d++)
+            {
+                size_t detector_num = analysis_job->detector_num_arr[d];
 
                 data_struct::Detector* detector = analysis_job->get_detector(detector_num);
 
                 //Spectra volume data
-                data_struct::Spectra_Volume* spectra_volume = new data_struct::Spectra_Volume();
+                data_struct::Spectra_Volume* spectra_volume = spectra_volumes[d];
+                spectra_volumes[d] = nullptr;
 
                 std::string fullpath;
                 size_t dlen = dataset_file.length();
@@ -457,10 +1114,23 @@ void process_dataset_files(data_struct::Analysis_Job* analysis_job, Callback_Fun
                     std::string full_save_path = analysis_job->dataset_directory + DIR_END_CHAR + "img.dat" + DIR_END_CHAR + dataset_file;
                     io::file::HDF5_IO::inst()->set_filename(full_save_path);
                 }
-                
+
+                if (preloaded)
+                {
+                    // scalers were saved while loading, add the fits to that file
+                    io::file::HDF5_IO::inst()->start_save_seq(false);
+                    analysis_job->init_fit_routines(spectra_volume->samples_size(), true);
+                    proc_spectra(spectra_volume, detector, &tp, !preloaded_from_analyzed[d], status_callback, analysis_job->skip_unchanged_fits, analysis_job->checkpoint_interval_s, analysis_job->resume_fits, &analysis_job->pixel_mask, &analysis_job->preview_bins);
+                    delete spectra_volume;
+                    continue;
+                }
+
                 bool loaded_from_analyzed_hdf5 = false;
                 //load spectra volume
-                if (false == io::load_spectra_volume(analysis_job->dataset_directory, dataset_file, detector_num, spectra_volume, &detector->fit_params_override_dict, &loaded_from_analyzed_hdf5, true) )
+                telemetry::Scoped_Timer detector_load_timer("load");
+                bool loaded = io::load_spectra_volume(analysis_job->dataset_directory, dataset_file, detector_num, spectra_volume, &detector->fit_params_override_dict, &loaded_from_analyzed_hdf5, true);
+                detector_load_timer.stop();
+                if (false == loaded)
                 {
                     logW<<"Skipping detector "<<detector_num<<"\n";
                     delete spectra_volume;
@@ -471,8 +1141,10 @@ void process_dataset_files(data_struct::Analysis_Job* analysis_job, Callback_Fun
                     continue;
                 }
 
+                telemetry::add_count("load/bytes", spectra_volume->rows() * spectra_volume->cols() * spectra_volume->samples_size() * sizeof(real_t));
+
                 analysis_job->init_fit_routines(spectra_volume->samples_size(), true);
-                proc_spectra(spectra_volume, detector, &tp, !loaded_from_analyzed_hdf5, status_callback);
+                proc_spectra(spectra_volume, detector, &tp, !loaded_from_analyzed_hdf5, status_callback, analysis_job->skip_unchanged_fits, analysis_job->checkpoint_interval_s, analysis_job->resume_fits, &analysis_job->pixel_mask, &analysis_job->preview_bins);
 				delete spectra_volume;
             }
         }
@@ -488,18 +1160,18 @@ void process_dataset_files_quick_and_dirty(std::string dataset_file, data_struct
     data_struct::Detector* detector = analysis_job->get_detector(0);
     //Spectra volume data
     data_struct::Spectra_Volume* spectra_volume = new data_struct::Spectra_Volume();
-    data_struct::Spectra_Volume* tmp_spectra_volume = new data_struct::Spectra_Volume();
 
     io::file::HDF5_IO::inst()->start_save_seq(full_save_path, true); // force to create new file for quick and dirty
 
-    //load the first one
-    size_t detector_num = analysis_job->detector_num_arr[0];
+    //load the first detector and add the others into the same volume as they are read
     bool is_loaded_from_analyzed_h5 = false;
-    if (false == io::load_spectra_volume(analysis_job->dataset_directory, dataset_file, detector_num, spectra_volume, &detector->fit_params_override_dict, &is_loaded_from_analyzed_h5, true))
+    telemetry::Scoped_Timer load_timer("load");
+    bool loaded = io::load_and_sum_spectra_volume(analysis_job->dataset_directory, dataset_file, analysis_job->detector_num_arr, spectra_volume, &detector->fit_params_override_dict, &is_loaded_from_analyzed_h5);
+    load_timer.stop();
+    if (false == loaded)
     {
         logE << "Loading all detectors for " << analysis_job->dataset_directory << DIR_END_CHAR << dataset_file << "\n";
         delete spectra_volume;
-        delete tmp_spectra_volume;
         if (status_callback != nullptr)
         {
             (*status_callback)(0, 1);
@@ -507,50 +1179,11 @@ void process_dataset_files_quick_and_dirty(std::string dataset_file, data_struct
         return;
     }
 
-    //load spectra volume
-    for (int i = 1; i < analysis_job->detector_num_arr.size(); i++)
-    {
-        if (false == io::load_spectra_volume(analysis_job->dataset_directory, dataset_file, analysis_job->detector_num_arr[i], tmp_spectra_volume, &detector->fit_params_override_dict, &is_loaded_from_analyzed_h5, false))
-        {
-            logE << "Loading all detectors for " << analysis_job->dataset_directory << DIR_END_CHAR << dataset_file << "\n";
-            delete spectra_volume;
-            delete tmp_spectra_volume;
-            if (status_callback != nullptr)
-            {
-                (*status_callback)(0, 1);
-            }
-            return;
-        }
-        //add all detectors up
-        for (size_t j = 0; j < spectra_volume->rows(); j++)
-        {
-            for (size_t k = 0; k < spectra_volume->cols(); k++)
-            {
-                real_t elapsed_livetime = (*spectra_volume)[j][k].elapsed_livetime();
-                real_t elapsed_realtime = (*spectra_volume)[j][k].elapsed_realtime();
-                real_t input_counts = (*spectra_volume)[j][k].input_counts();
-                real_t output_counts = (*spectra_volume)[j][k].output_counts();
-
-
-                (*spectra_volume)[j][k] += (*tmp_spectra_volume)[j][k];
-
-                elapsed_livetime += (*tmp_spectra_volume)[j][k].elapsed_livetime();
-                elapsed_realtime += (*tmp_spectra_volume)[j][k].elapsed_realtime();
-                input_counts += (*tmp_spectra_volume)[j][k].input_counts();
-                output_counts += (*tmp_spectra_volume)[j][k].output_counts();
-
-                (*spectra_volume)[j][k].elapsed_livetime(elapsed_livetime);
-                (*spectra_volume)[j][k].elapsed_realtime(elapsed_realtime);
-                (*spectra_volume)[j][k].input_counts(input_counts);
-                (*spectra_volume)[j][k].output_counts(output_counts);
-            }
-        }
-    }
-    delete tmp_spectra_volume;
+    telemetry::add_count("load/bytes", spectra_volume->rows() * spectra_volume->cols() * spectra_volume->samples_size() * sizeof(real_t));
 
     analysis_job->init_fit_routines(spectra_volume->samples_size(), true);
 	
-    proc_spectra(spectra_volume, detector, &tp, !is_loaded_from_analyzed_h5, status_callback);
+    proc_spectra(spectra_volume, detector, &tp, !is_loaded_from_analyzed_h5, status_callback, false, 0, false, &analysis_job->pixel_mask, &analysis_job->preview_bins);
     delete spectra_volume;
 }
 
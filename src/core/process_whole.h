@@ -55,6 +55,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <array>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <chrono>
 #include <ctime>
 #include <limits>
@@ -72,6 +73,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #endif
 
 #include "core/defines.h"
+#include "core/telemetry.h"
 
 #include "workflow/threadpool.h"
 
@@ -121,6 +123,16 @@ DLL_EXPORT bool fit_single_spectra(fitting::routines::Base_Fit_Routine * fit_rou
 
 // ----------------------------------------------------------------------------
 
+DLL_EXPORT bool fit_spectra_row(fitting::routines::Base_Fit_Routine * fit_routine,
+                     const fitting::models::Base_Model * const model,
+                     const data_struct::Spectra_Line * const spectra_line,
+                     const data_struct::Fit_Element_Map_Dict * const elements_to_fit,
+                     data_struct::Fit_Count_Dict * out_fit_counts,
+                     size_t i,
+                     const data_struct::ArrayXXr* fit_pixels = nullptr);
+
+// ----------------------------------------------------------------------------
+
 DLL_EXPORT bool optimize_integrated_fit_params(std::string dataset_directory,
                                             std::string  dataset_filename,
                                             size_t detector_num,
@@ -135,11 +147,27 @@ DLL_EXPORT void generate_optimal_params(data_struct::Analysis_Job* analysis_job)
 
 // ----------------------------------------------------------------------------
 
+DLL_EXPORT uint64_t spectra_volume_hash(const data_struct::Spectra_Volume* spectra_volume, ThreadPool* tp);
+
+// ----------------------------------------------------------------------------
+
+DLL_EXPORT uint64_t fit_config_hash(uint64_t input_hash,
+                                    const data_struct::Detector* detector,
+                                    fitting::routines::Base_Fit_Routine* fit_routine,
+                                    const fitting::models::Range& energy_range);
+
+// ----------------------------------------------------------------------------
+
 DLL_EXPORT void proc_spectra(data_struct::Spectra_Volume* spectra_volume,
                              data_struct::Detector* detector_struct,
                              ThreadPool* tp,
                              bool save_spec_vol,
-                             Callback_Func_Status_Def* status_callback = nullptr);
+                             Callback_Func_Status_Def* status_callback = nullptr,
+                             bool skip_unchanged_fits = false,
+                             size_t checkpoint_interval_s = 0,
+                             bool resume_fits = false,
+                             const data_struct::Pixel_Mask* pixel_mask = nullptr,
+                             const std::vector<size_t>* preview_bins = nullptr);
 
 // ----------------------------------------------------------------------------
 
@@ -0,0 +1,323 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#include "core/telemetry.h"
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+
+namespace telemetry
+{
+
+std::atomic<bool> Telemetry::_enabled(false);
+
+//-----------------------------------------------------------------------------
+
+static std::string json_escape(const std::string& str)
+{
+    std::string out;
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+//-----------------------------------------------------------------------------
+
+// nan and inf are not valid JSON numbers, written as null instead
+struct Json_Number
+{
+    double value;
+};
+
+static std::ostream& operator<<(std::ostream& out, const Json_Number& num)
+{
+    if (std::isfinite(num.value))
+    {
+        out << num.value;
+    }
+    else
+    {
+        out << "null";
+    }
+    return out;
+}
+
+//-----------------------------------------------------------------------------
+
+Telemetry_Stat::Telemetry_Stat()
+{
+    count = 0;
+    sum = 0.0;
+    min = std::numeric_limits<double>::max();
+    max = std::numeric_limits<double>::lowest();
+    buckets.fill(0);
+}
+
+//-----------------------------------------------------------------------------
+
+void Telemetry_Stat::add(double value)
+{
+    count++;
+    sum += value;
+    min = std::min(min, value);
+    max = std::max(max, value);
+
+    int idx = 0;
+    if (std::isinf(value) && value > 0.0)
+    {
+        idx = NUM_BUCKETS - 1;
+    }
+    else if (value > 0.0)
+    {
+        idx = (int)std::floor(std::log2(value) * BUCKETS_PER_OCTAVE) + BUCKET_ZERO + 1;
+        idx = std::max(1, std::min(idx, NUM_BUCKETS - 1));
+    }
+    buckets[idx]++;
+}
+
+//-----------------------------------------------------------------------------
+
+double Telemetry_Stat::mean() const
+{
+    if (count == 0)
+    {
+        return 0.0;
+    }
+    return sum / (double)count;
+}
+
+//-----------------------------------------------------------------------------
+
+double Telemetry_Stat::bucket_lower(int idx)
+{
+    if (idx < 1)
+    {
+        return 0.0;
+    }
+    return std::pow(2.0, (double)(idx - 1 - BUCKET_ZERO) / BUCKETS_PER_OCTAVE);
+}
+
+//-----------------------------------------------------------------------------
+
+double Telemetry_Stat::bucket_upper(int idx)
+{
+    if (idx < 1)
+    {
+        return 0.0;
+    }
+    return std::pow(2.0, (double)(idx - BUCKET_ZERO) / BUCKETS_PER_OCTAVE);
+}
+
+//-----------------------------------------------------------------------------
+
+double Telemetry_Stat::percentile(double p) const
+{
+    if (count == 0)
+    {
+        return 0.0;
+    }
+    size_t rank = (size_t)std::ceil(p / 100.0 * (double)count);
+    rank = std::max(rank, (size_t)1);
+    size_t seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+        {
+            // geometric middle of the bucket, kept inside the recorded range
+            double val = (i == 0) ? 0.0 : std::sqrt(bucket_lower(i) * bucket_upper(i));
+            return std::max(min, std::min(max, val));
+        }
+    }
+    return max;
+}
+
+//-----------------------------------------------------------------------------
+
+Telemetry::Telemetry()
+{
+    _start = std::chrono::steady_clock::now();
+}
+
+//-----------------------------------------------------------------------------
+
+Telemetry* Telemetry::inst()
+{
+    static Telemetry instance;
+    return &instance;
+}
+
+//-----------------------------------------------------------------------------
+
+void Telemetry::add_time(const std::string& stage, double seconds)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _timers[stage].add(seconds);
+}
+
+//-----------------------------------------------------------------------------
+
+void Telemetry::add_value(const std::string& name, double value)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _values[name].add(value);
+}
+
+//-----------------------------------------------------------------------------
+
+void Telemetry::add_count(const std::string& name, size_t value)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _counts[name] += value;
+}
+
+//-----------------------------------------------------------------------------
+
+void Telemetry::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _timers.clear();
+    _values.clear();
+    _counts.clear();
+    _start = std::chrono::steady_clock::now();
+}
+
+//-----------------------------------------------------------------------------
+
+void Telemetry::log_summary()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto& itr : _timers)
+    {
+        const Telemetry_Stat& stat = itr.second;
+        logI << "Telemetry " << itr.first << " : count " << stat.count << " total " << stat.sum << "s p50 " << stat.percentile(50.0) << "s p99 " << stat.percentile(99.0) << "s\n";
+    }
+    for (const auto& itr : _values)
+    {
+        const Telemetry_Stat& stat = itr.second;
+        logI << "Telemetry " << itr.first << " : count " << stat.count << " mean " << stat.mean() << " p50 " << stat.percentile(50.0) << " max " << stat.max << "\n";
+    }
+    for (const auto& itr : _counts)
+    {
+        logI << "Telemetry " << itr.first << " : " << itr.second << "\n";
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+static void write_stats(std::ofstream& out, const std::map<std::string, Telemetry_Stat>& stats)
+{
+    bool first = true;
+    for (const auto& itr : stats)
+    {
+        const Telemetry_Stat& stat = itr.second;
+        out << (first ? "\n" : ",\n") << "    \"" << json_escape(itr.first) << "\": {\n";
+        out << "      \"count\": " << stat.count << ",\n";
+        out << "      \"sum\": " << Json_Number{stat.sum} << ",\n";
+        out << "      \"mean\": " << Json_Number{stat.mean()} << ",\n";
+        out << "      \"min\": " << Json_Number{stat.count > 0 ? stat.min : 0.0} << ",\n";
+        out << "      \"max\": " << Json_Number{stat.count > 0 ? stat.max : 0.0} << ",\n";
+        out << "      \"p50\": " << Json_Number{stat.percentile(50.0)} << ",\n";
+        out << "      \"p90\": " << Json_Number{stat.percentile(90.0)} << ",\n";
+        out << "      \"p99\": " << Json_Number{stat.percentile(99.0)} << ",\n";
+        // only the buckets that were hit, as [lower, upper, count]
+        out << "      \"histogram\": [";
+        bool first_bucket = true;
+        for (int i = 0; i < Telemetry_Stat::NUM_BUCKETS; i++)
+        {
+            if (stat.buckets[i] > 0)
+            {
+                out << (first_bucket ? "" : ", ") << "[" << Telemetry_Stat::bucket_lower(i) << ", " << Telemetry_Stat::bucket_upper(i) << ", " << stat.buckets[i] << "]";
+                first_bucket = false;
+            }
+        }
+        out << "]\n    }";
+        first = false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+bool Telemetry::save_json(const std::string& filename)
+{
+    std::ofstream out(filename);
+    if (false == out.is_open())
+    {
+        logE << "Could not open " << filename << " to save telemetry\n";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - _start;
+
+    out << std::setprecision(10);
+    out << "{\n  \"wall_time_s\": " << wall.count() << ",\n  \"timers_s\": {";
+    write_stats(out, _timers);
+    out << "\n  },\n  \"values\": {";
+    write_stats(out, _values);
+    out << "\n  },\n  \"counters\": {";
+    bool first = true;
+    for (const auto& itr : _counts)
+    {
+        out << (first ? "\n" : ",\n") << "    \"" << json_escape(itr.first) << "\": " << itr.second;
+        first = false;
+    }
+    out << "\n  }\n}\n";
+
+    logI << "Saved telemetry to " << filename << "\n";
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+} //namespace telemetry
@@ -0,0 +1,255 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "core/defines.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace telemetry
+{
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Telemetry_Stat struct : Count, sum, min, max and a log scale histogram of the values recorded under one name.
+/// Each power of 2 is split in 8 buckets so percentiles are within ~9% of the recorded values.
+///
+struct DLL_EXPORT Telemetry_Stat
+{
+    // bucket 0 holds values <= 0, bucket i > 0 holds [2^((i-1-BUCKET_ZERO)/8), 2^((i-BUCKET_ZERO)/8))
+    static const int BUCKETS_PER_OCTAVE = 8;
+    static const int BUCKET_ZERO = 256;
+    static const int NUM_BUCKETS = 2 * BUCKET_ZERO + 1;
+
+    Telemetry_Stat();
+
+    void add(double value);
+
+    double mean() const;
+
+    ///
+    /// \brief percentile : Approximate percentile from the histogram, p is 0 - 100
+    ///
+    double percentile(double p) const;
+
+    static double bucket_lower(int idx);
+
+    static double bucket_upper(int idx);
+
+    size_t count;
+
+    double sum;
+
+    double min;
+
+    double max;
+
+    std::array<size_t, NUM_BUCKETS> buckets;
+};
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Telemetry class : Collects per stage timings, counters and value distributions of a processing run.
+/// Disabled by default, every entry point returns right away after checking one atomic flag when it is off.
+///
+class DLL_EXPORT Telemetry
+{
+public:
+
+    static Telemetry* inst();
+
+    static inline bool enabled() { return _enabled.load(std::memory_order_relaxed); }
+
+    static void set_enabled(bool val) { _enabled = val; }
+
+    ///
+    /// \brief add_time : Record seconds spent in stage, ex: load, background, fit/NNLS, save
+    ///
+    void add_time(const std::string& stage, double seconds);
+
+    ///
+    /// \brief add_value : Record one value of a distribution, ex: optimizer iterations per pixel, queue depth
+    ///
+    void add_value(const std::string& name, double value);
+
+    ///
+    /// \brief add_count : Add to a running total, ex: bytes read or written
+    ///
+    void add_count(const std::string& name, size_t value);
+
+    void reset();
+
+    void log_summary();
+
+    bool save_json(const std::string& filename);
+
+private:
+
+    Telemetry();
+
+    static std::atomic<bool> _enabled;
+
+    std::mutex _mutex;
+
+    std::map<std::string, Telemetry_Stat> _timers;
+
+    std::map<std::string, Telemetry_Stat> _values;
+
+    std::map<std::string, size_t> _counts;
+
+    std::chrono::time_point<std::chrono::steady_clock> _start;
+};
+
+//-----------------------------------------------------------------------------
+
+inline bool enabled() { return Telemetry::enabled(); }
+
+inline void add_value(const std::string& name, double value)
+{
+    if (Telemetry::enabled())
+    {
+        Telemetry::inst()->add_value(name, value);
+    }
+}
+
+inline void add_count(const std::string& name, size_t value)
+{
+    if (Telemetry::enabled())
+    {
+        Telemetry::inst()->add_count(name, value);
+    }
+}
+
+// literal names only become a std::string once telemetry is on, some are too long for the small string buffer
+inline void add_value(const char* name, double value)
+{
+    if (Telemetry::enabled())
+    {
+        Telemetry::inst()->add_value(name, value);
+    }
+}
+
+inline void add_count(const char* name, size_t value)
+{
+    if (Telemetry::enabled())
+    {
+        Telemetry::inst()->add_count(name, value);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Scoped_Timer class : Adds the time from construction (or start()) to destruction (or stop()) to a stage.
+/// Does not read the clock when telemetry is disabled.
+///
+class Scoped_Timer
+{
+public:
+
+    Scoped_Timer() : _active(false) {}
+
+    Scoped_Timer(const char* stage) : _active(false)
+    {
+        if (Telemetry::enabled())
+        {
+            start(stage);
+        }
+    }
+
+    Scoped_Timer(const std::string& stage) : _active(false)
+    {
+        if (Telemetry::enabled())
+        {
+            start(stage);
+        }
+    }
+
+    ~Scoped_Timer() { stop(); }
+
+    void start(const std::string& stage)
+    {
+        _stage = stage;
+        _active = true;
+        _start = std::chrono::steady_clock::now();
+    }
+
+    void stop()
+    {
+        if (_active)
+        {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - _start;
+            Telemetry::inst()->add_time(_stage, elapsed.count());
+            _active = false;
+        }
+    }
+
+private:
+
+    Scoped_Timer(const Scoped_Timer&) = delete;
+
+    Scoped_Timer& operator=(const Scoped_Timer&) = delete;
+
+    bool _active;
+
+    std::string _stage;
+
+    std::chrono::time_point<std::chrono::steady_clock> _start;
+};
+
+//-----------------------------------------------------------------------------
+
+} //namespace telemetry
+
+#endif // TELEMETRY_H
@@ -48,6 +48,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 
 #include "analysis_job.h"
+#include <sstream>
 
 namespace data_struct
 {
@@ -57,12 +58,17 @@ namespace data_struct
 Analysis_Job::Analysis_Job()
 {
     _optimizer = &_lmfit_optimizer;
+    _lmfit_optimizer_double.set_precision(Fit_Precision::DOUBLE);
     _last_init_sample_size = 0;
 	_first_init = true;
     num_threads = std::thread::hardware_concurrency();
     //default mode for which parameters to fit when optimizing fit parameters
     optimize_fit_params_preset = fitting::models::Fit_Params_Preset::BATCH_FIT_NO_TAILS;
     quick_and_dirty = false;
+    skip_unchanged_fits = false;
+    matrix_nnls_seed = false;
+    checkpoint_interval_s = 0;
+    resume_fits = false;
     generate_average_h5 = false;
     add_v9_layout = false;
     add_exchange_layout = false;
@@ -76,7 +82,12 @@ Analysis_Job::Analysis_Job()
     network_source_ip = "";
     theta = 0.f;
     network_source_port = "43434";
+    network_source_decode_threads = 2;
     network_stream_port = "43434";
+    network_stream_version = 1;
+    network_stream_batch_size = 1;
+    network_stream_batch_row = false;
+    network_stream_batch_latency_ms = 0;
 	mem_limit = -1;
 	update_theta_str = "";
 	update_us_amps_str = "";
@@ -167,4 +178,125 @@ void Analysis_Job::set_optimizer(std::string optimizer)
 
 //-----------------------------------------------------------------------------
 
+fitting::optimizers::Optimizer* Analysis_Job::optimizer(Fit_Precision precision)
+{
+    if (precision == Fit_Precision::FLOAT)
+    {
+        return _optimizer;
+    }
+    if (_optimizer == &_lmfit_optimizer)
+    {
+        return &_lmfit_optimizer_double;
+    }
+    if (false == _optimizer->supports_precision(precision))
+    {
+        logW << "Selected optimizer only runs in float, ignoring double precision\n";
+    }
+    return _optimizer;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Analysis_Job::set_fit_precision(std::string precision_str)
+{
+    for (std::string::size_type x = 0; x < precision_str.length(); ++x)
+    {
+        precision_str[x] = std::toupper(precision_str[x]);
+    }
+
+    fit_precisions.clear();
+    if (precision_str == "FLOAT")
+    {
+        return true;
+    }
+    if (precision_str == "DOUBLE")
+    {
+        for (const auto& itr : Fitting_Routine_To_Str)
+        {
+            fit_precisions[itr.first] = Fit_Precision::DOUBLE;
+        }
+        return true;
+    }
+    if (precision_str == "MIXED")
+    {
+        // float storage with double solves, GAUSS_MATRIX stays in float
+        fit_precisions[Fitting_Routines::NNLS] = Fit_Precision::DOUBLE;
+        fit_precisions[Fitting_Routines::SVD] = Fit_Precision::DOUBLE;
+        fit_precisions[Fitting_Routines::GAUSS_TAILS] = Fit_Precision::DOUBLE;
+        return true;
+    }
+
+    bool ret = true;
+    std::stringstream ss(precision_str);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        size_t idx = item.find(':');
+        if (idx == std::string::npos)
+        {
+            logW << "Ignoring fit precision entry " << item << ", expected <routine>:<float|double>\n";
+            ret = false;
+            continue;
+        }
+        std::string routine_str = item.substr(0, idx);
+        std::string type_str = item.substr(idx + 1);
+        Fit_Precision precision;
+        if (type_str == "FLOAT")
+        {
+            precision = Fit_Precision::FLOAT;
+        }
+        else if (type_str == "DOUBLE")
+        {
+            precision = Fit_Precision::DOUBLE;
+        }
+        else
+        {
+            logW << "Unknown fit precision " << type_str << ", expected float or double\n";
+            ret = false;
+            continue;
+        }
+
+        if (routine_str == STR_FIT_ROI)
+        {
+            fit_precisions[Fitting_Routines::ROI] = precision;
+        }
+        else if (routine_str == STR_FIT_SVD || routine_str == "ROI_PLUS")
+        {
+            fit_precisions[Fitting_Routines::SVD] = precision;
+        }
+        else if (routine_str == STR_FIT_NNLS)
+        {
+            fit_precisions[Fitting_Routines::NNLS] = precision;
+        }
+        else if (routine_str == "MATRIX" || routine_str == "FITTED")
+        {
+            fit_precisions[Fitting_Routines::GAUSS_MATRIX] = precision;
+        }
+        else if (routine_str == "TAILS" || routine_str == "GAUSSIAN_PARAMETER")
+        {
+            fit_precisions[Fitting_Routines::GAUSS_TAILS] = precision;
+        }
+        else
+        {
+            logW << "Unknown fit routine " << routine_str << " in fit precision\n";
+            ret = false;
+        }
+    }
+    return ret;
+}
+
+//-----------------------------------------------------------------------------
+
+Fit_Precision Analysis_Job::fit_precision(Fitting_Routines routine) const
+{
+    const auto& itr = fit_precisions.find(routine);
+    if (itr != fit_precisions.end())
+    {
+        return itr->second;
+    }
+    return Fit_Precision::FLOAT;
+}
+
+//-----------------------------------------------------------------------------
+
 } //namespace data_struct
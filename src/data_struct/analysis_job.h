@@ -59,6 +59,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <thread>
 #include "data_struct/quantification_standard.h"
 #include "data_struct/params_override.h"
+#include "data_struct/pixel_mask.h"
 #include "fitting/optimizers/lmfit_optimizer.h"
 #include "fitting/optimizers/mpfit_optimizer.h"
 #include <iostream>
@@ -87,6 +88,19 @@ public:
 
     fitting::optimizers::Optimizer *optimizer(){return _optimizer;}
 
+    ///
+    /// \brief optimizer : Optimizer for a routine fitting in precision, falls back to optimizer() if it only runs in float
+    ///
+    fitting::optimizers::Optimizer *optimizer(Fit_Precision precision);
+
+    ///
+    /// \brief set_fit_precision : Parse float, double, mixed (double for nnls, svd and tails) or a list of routine:precision, ex: nnls:double,roi:float
+    /// Optimizer routines (matrix, tails) only accumulate in double, their model and residuals stay in real_t.
+    ///
+    bool set_fit_precision(std::string precision_str);
+
+    Fit_Precision fit_precision(Fitting_Routines routine) const;
+
     void init_fit_routines(size_t spectra_samples, bool force=false);
 
     std::string command_line;
@@ -101,8 +115,19 @@ public:
 
     std::string network_source_port;
 
+    size_t network_source_decode_threads;
+
     std::string network_stream_port;
 
+    unsigned short network_stream_version;
+
+    // pixels per stream message, 1 sends every pixel on its own and 0 means no pixel limit
+    size_t network_stream_batch_size;
+
+    bool network_stream_batch_row;
+
+    size_t network_stream_batch_latency_ms;
+
     float theta;
 
     std::vector<std::string> dataset_files;
@@ -111,6 +136,9 @@ public:
 
     std::vector<Fitting_Routines> fitting_routines;
 
+    // routines not listed fit in float
+    std::unordered_map<Fitting_Routines, Fit_Precision> fit_precisions;
+
     std::map<int, Detector> detectors_meta_data;
 
     fitting::models::Fit_Params_Preset optimize_fit_params_preset;
@@ -121,10 +149,31 @@ public:
 
     size_t num_threads;
 
+    // threads of each streaming fit stage by routine name, stages not listed use num_threads
+    std::unordered_map<std::string, size_t> stream_stage_threads;
+
     //bool update_scalers;
 
     bool quick_and_dirty;
 
+    // skip fit routines whose saved input hash matches the spectra and configuration of this run
+    bool skip_unchanged_fits;
+
+    // seed GAUSS_MATRIX fits with an NNLS solve of the element models
+    bool matrix_nnls_seed;
+
+    // seconds between checkpoints of the rows fitted so far, 0 disables them
+    size_t checkpoint_interval_s;
+
+    // continue each fit routine from its last checkpoint instead of the first row
+    bool resume_fits;
+
+    // pixels left out of the fits, by total counts, mask file or polygon
+    Pixel_Mask pixel_mask;
+
+    // pixels per side of the binned preview fits saved before the full fit, coarsest first. Empty disables them
+    std::vector<size_t> preview_bins;
+
     bool generate_average_h5;
 
     bool add_v9_layout;
@@ -156,6 +205,7 @@ protected:
 
     //Optimizers for fitting models
     fitting::optimizers::LMFit_Optimizer _lmfit_optimizer;
+    fitting::optimizers::LMFit_Optimizer _lmfit_optimizer_double;
     fitting::optimizers::MPFit_Optimizer _mpfit_optimizer;
     fitting::optimizers::Optimizer *_optimizer;
 
@@ -63,6 +63,9 @@ namespace data_struct
 
 enum class Fitting_Routines { ROI=1 , GAUSS_TAILS=2, GAUSS_MATRIX=4, SVD=8, NNLS=16 };
 
+// scalar type a fit routine solves in, spectra are always stored as real_t
+enum class Fit_Precision { FLOAT=0, DOUBLE=1 };
+
 enum class E_Bound_Type {NOT_INIT=0, FIXED=1, LIMITED_LO_HI=2, LIMITED_LO=3, LIMITED_HI=4, FIT=5};
 
  const static std::unordered_map<Fitting_Routines, std::string> Fitting_Routine_To_Str = { {Fitting_Routines::ROI, STR_FIT_ROI},
@@ -0,0 +1,233 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#include "pixel_mask.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+namespace data_struct
+{
+
+//-----------------------------------------------------------------------------
+
+Pixel_Mask::Pixel_Mask()
+{
+    _min_counts = 0.0;
+}
+
+//-----------------------------------------------------------------------------
+
+Pixel_Mask::~Pixel_Mask()
+{
+
+}
+
+//-----------------------------------------------------------------------------
+
+void Pixel_Mask::clear()
+{
+    _min_counts = 0.0;
+    _polygon.clear();
+    _file_mask.resize(0, 0);
+}
+
+//-----------------------------------------------------------------------------
+
+bool Pixel_Mask::set_polygon(const std::vector<std::pair<real_t, real_t> >& vertices)
+{
+    if (vertices.size() < 3)
+    {
+        logE << "A fit polygon needs at least 3 vertices, got " << vertices.size() << "\n";
+        return false;
+    }
+    _polygon = vertices;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Pixel_Mask::set_polygon(const std::string& vertices)
+{
+    std::vector<real_t> values;
+    std::stringstream strstream(vertices);
+    std::string value;
+    while (std::getline(strstream, value, ','))
+    {
+        try
+        {
+            values.push_back(std::stof(value));
+        }
+        catch (std::exception&)
+        {
+            logE << "Could not parse fit polygon vertex '" << value << "'\n";
+            return false;
+        }
+    }
+    if (values.size() % 2 != 0)
+    {
+        logE << "Fit polygon needs col,row pairs, got " << values.size() << " values\n";
+        return false;
+    }
+    std::vector<std::pair<real_t, real_t> > points;
+    for (size_t i = 0; i < values.size(); i += 2)
+    {
+        points.push_back({ values[i], values[i + 1] });
+    }
+    return set_polygon(points);
+}
+
+//-----------------------------------------------------------------------------
+
+bool Pixel_Mask::load_mask_file(const std::string& path)
+{
+    std::ifstream mask_file(path);
+    if (false == mask_file.is_open())
+    {
+        logE << "Could not open pixel mask " << path << "\n";
+        return false;
+    }
+
+    std::vector<std::vector<real_t> > rows;
+    std::string line;
+    while (std::getline(mask_file, line))
+    {
+        if (line.length() == 0 || line[0] == '#')
+        {
+            continue;
+        }
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::replace(line.begin(), line.end(), '\t', ' ');
+        std::stringstream strstream(line);
+        std::vector<real_t> row;
+        real_t value;
+        while (strstream >> value)
+        {
+            row.push_back(value);
+        }
+        if (row.size() > 0)
+        {
+            rows.push_back(row);
+        }
+    }
+
+    if (rows.size() == 0)
+    {
+        logE << "Pixel mask " << path << " is empty\n";
+        return false;
+    }
+    for (const auto& row : rows)
+    {
+        if (row.size() != rows[0].size())
+        {
+            logE << "Pixel mask " << path << " rows have different lengths\n";
+            return false;
+        }
+    }
+
+    _file_mask.resize(rows.size(), rows[0].size());
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        for (size_t j = 0; j < rows[i].size(); j++)
+        {
+            _file_mask(i, j) = (rows[i][j] != 0.0) ? 1.0 : 0.0;
+        }
+    }
+    logI << "Loaded " << _file_mask.rows() << " x " << _file_mask.cols() << " pixel mask " << path << "\n";
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Pixel_Mask::_inside_polygon(real_t x, real_t y) const
+{
+    // even-odd rule
+    bool inside = false;
+    for (size_t i = 0, j = _polygon.size() - 1; i < _polygon.size(); j = i++)
+    {
+        const real_t xi = _polygon[i].first, yi = _polygon[i].second;
+        const real_t xj = _polygon[j].first, yj = _polygon[j].second;
+        if (((yi > y) != (yj > y)) && (x < (xj - xi) * (y - yi) / (yj - yi) + xi))
+        {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+//-----------------------------------------------------------------------------
+
+size_t Pixel_Mask::fill_row(const Spectra_Line& spectra_line, size_t row, ArrayXXr& fit_pixels) const
+{
+    const bool use_file_mask = (_file_mask.rows() == fit_pixels.rows() && _file_mask.cols() == fit_pixels.cols());
+    size_t skipped = 0;
+    for (size_t j = 0; j < spectra_line.size(); j++)
+    {
+        bool fit = true;
+        if (use_file_mask)
+        {
+            fit = (_file_mask(row, j) != 0.0);
+        }
+        if (fit && _polygon.size() > 2)
+        {
+            fit = _inside_polygon((real_t)j, (real_t)row);
+        }
+        if (fit && _min_counts > 0.0)
+        {
+            fit = (spectra_line[j].sum() >= _min_counts);
+        }
+        fit_pixels(row, j) = fit ? 1.0 : 0.0;
+        if (false == fit)
+        {
+            skipped++;
+        }
+    }
+    return skipped;
+}
+
+//-----------------------------------------------------------------------------
+
+} //namespace data_struct
@@ -0,0 +1,113 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#ifndef Pixel_Mask_H
+#define Pixel_Mask_H
+
+#include <string>
+#include <vector>
+#include "core/defines.h"
+#include "data_struct/fit_parameters.h"
+#include "data_struct/spectra_line.h"
+
+namespace data_struct
+{
+
+///\brief Picks the pixels of a map that get fitted. Skipped pixels get zero counts instead of a fit.
+class DLL_EXPORT Pixel_Mask
+{
+public:
+
+    Pixel_Mask();
+
+    ~Pixel_Mask();
+
+    // fit every pixel again
+    void clear();
+
+    // skip pixels whose spectra sum to less than min_counts, 0 disables the threshold
+    void set_min_counts(real_t min_counts) { _min_counts = min_counts; }
+
+    real_t min_counts() const { return _min_counts; }
+
+    // only fit pixels whose center is inside the polygon, vertices are (col, row) pairs
+    bool set_polygon(const std::vector<std::pair<real_t, real_t> >& vertices);
+
+    // parse "c0,r0,c1,r1,..." into set_polygon()
+    bool set_polygon(const std::string& vertices);
+
+    // text file with one line of 0 / 1 values per row (space, tab or comma separated), 0 skips the pixel
+    bool load_mask_file(const std::string& path);
+
+    bool enabled() const { return _min_counts > 0.0 || _polygon.size() > 2 || _file_mask.size() > 0; }
+
+    // false if a mask file is loaded and it is not rows x cols
+    bool file_mask_fits(size_t rows, size_t cols) const { return _file_mask.size() == 0 || ((size_t)_file_mask.rows() == rows && (size_t)_file_mask.cols() == cols); }
+
+    const ArrayXXr& file_mask() const { return _file_mask; }
+
+    // keep the threshold and polygon, drop the mask file
+    void clear_file_mask() { _file_mask.resize(0, 0); }
+
+    // mark the pixels of one row with 1 (fit) or 0 (skip) in fit_pixels, returns the number skipped.
+    // fit_pixels is rows x cols of the volume, check file_mask_fits() first, a mask file of another size is ignored.
+    size_t fill_row(const Spectra_Line& spectra_line, size_t row, ArrayXXr& fit_pixels) const;
+
+private:
+
+    bool _inside_polygon(real_t x, real_t y) const;
+
+    real_t _min_counts;
+
+    std::vector<std::pair<real_t, real_t> > _polygon;
+
+    ArrayXXr _file_mask;
+
+};
+
+} //namespace data_struct
+
+#endif // Pixel_Mask_H
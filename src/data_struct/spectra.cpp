@@ -48,6 +48,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 
 #include "spectra.h"
+#include "core/telemetry.h"
 #include <algorithm>
 #include <math.h>
 #include <iostream>
@@ -125,6 +126,7 @@ ArrayXr snip_background(const Spectra* const spectra,
 									  real_t xmin,
 									  real_t xmax)
 {
+    telemetry::Scoped_Timer timer("background");
 	ArrayXr energy = ArrayXr::LinSpaced(spectra->size(), 0, spectra->size() - 1);
     
 	ArrayXr background;
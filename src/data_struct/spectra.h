@@ -86,6 +86,9 @@ public:
 		_output_counts = spectra._output_counts;
 	}
 
+    // spelled out because the copy constructor is user declared, pooled buffers are refilled with it
+    Spectra_T& operator=(const Spectra_T &spectra) = default;
+
     Spectra_T(size_t sample_size) : TArrayXr(sample_size)
 	{
 		this->setZero();
@@ -163,7 +166,8 @@ public:
 
     void add(const Spectra_T& spectra)
     {
-        *this += (TArrayXr)spectra;
+        // add through a reference so Eigen vectorizes it without copying the other spectra first
+        *this += static_cast<const TArrayXr&>(spectra);
         real_t val = spectra.elapsed_livetime();
         if(std::isfinite(val))
         {
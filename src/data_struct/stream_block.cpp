@@ -48,22 +48,56 @@ POSSIBILITY OF SUCH DAMAGE.
 
 
 #include "stream_block.h"
+#include <algorithm>
 
 namespace data_struct
 {
 
+int Stream_Fitting_Block::index_of(const std::string& name) const
+{
+    for (size_t i = 0; i < element_names.size(); i++)
+    {
+        if (element_names[i] == name)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+//-----------------------------------------------------------------------------
+
+real_t Stream_Fitting_Block::count(const std::string& name) const
+{
+    int idx = index_of(name);
+    if (idx < 0 || (size_t)idx >= fit_counts.size())
+    {
+        return (real_t)0.0;
+    }
+    return fit_counts[idx];
+}
+
+//-----------------------------------------------------------------------------
+
 Stream_Block::Stream_Block()
 {
 	_row = 0;
 	_col = 0;
     _height = 0;
     _width = 0;
+    _detector = 0;
     theta = 0;
 	elements_to_fit = nullptr;
+    dataset_directory = nullptr;
+    dataset_name = nullptr;
+    model = nullptr;
     // by default we don't want to delete the string pointers becaues they are shared by stream blocks
     del_str_ptr = false;
 	spectra = nullptr;
     optimize_fit_params_preset = fitting::models::Fit_Params_Preset::BATCH_FIT_NO_TAILS;
+    _pooled = false;
+    _spare_spectra = nullptr;
+    _fit_routines_src = nullptr;
 }
 
 //-----------------------------------------------------------------------------
@@ -81,9 +115,15 @@ Stream_Block::Stream_Block(int detector,
     _detector = detector;
     theta = 0;
 	elements_to_fit = nullptr;
+    dataset_directory = nullptr;
+    dataset_name = nullptr;
+    model = nullptr;
     // by default we don't want to delete the string pointers becaues they are shared by stream blocks
     del_str_ptr = false;
     spectra = nullptr;
+    _pooled = false;
+    _spare_spectra = nullptr;
+    _fit_routines_src = nullptr;
 }
 
 //-----------------------------------------------------------------------------
@@ -110,6 +150,12 @@ Stream_Block::~Stream_Block()
         spectra = nullptr;
     }
 
+    if(_spare_spectra != nullptr)
+    {
+        delete _spare_spectra;
+        _spare_spectra = nullptr;
+    }
+
     elements_to_fit = nullptr;
 
     model = nullptr;
@@ -128,6 +174,9 @@ Stream_Block::Stream_Block(const Stream_Block& stream_block)
 	this->spectra = stream_block.spectra;
 	this->elements_to_fit = stream_block.elements_to_fit;
 	this->model = stream_block.model;
+	this->_fit_routines_src = stream_block._fit_routines_src;
+	this->_pooled = false;
+	this->_spare_spectra = nullptr;
 }
 
 
@@ -144,6 +193,7 @@ Stream_Block& Stream_Block::operator=(const Stream_Block& stream_block)
 	this->spectra = stream_block.spectra;
 	this->elements_to_fit = stream_block.elements_to_fit;
 	this->model = stream_block.model;
+	this->_fit_routines_src = stream_block._fit_routines_src;
 	return *this;
 }
 
@@ -152,23 +202,141 @@ Stream_Block& Stream_Block::operator=(const Stream_Block& stream_block)
 void Stream_Block::init_fitting_blocks(std::unordered_map<Fitting_Routines, fitting::routines::Base_Fit_Routine *> *fit_routines,
                                        Fit_Element_Map_Dict * elements_to_fit_)
 {
+    size_t num_names = 1; // STR_NUM_ITR
+    if(elements_to_fit_ != nullptr)
+    {
+        num_names += elements_to_fit_->size();
+    }
+
+    // recycled block with the same layout, only zero the counts
+    bool same_layout = (fit_routines == _fit_routines_src && elements_to_fit_ == elements_to_fit && fitting_blocks.size() == fit_routines->size());
+    for(size_t i = 0; same_layout && i < fitting_blocks.size(); i++)
+    {
+        same_layout = (fitting_blocks[i].element_names.size() == num_names);
+    }
+
     elements_to_fit = elements_to_fit_;
+    _fit_routines_src = fit_routines;
 
-    if(elements_to_fit == nullptr)
+    if(same_layout)
     {
-        //throw Exception;
+        for(auto &fit_block : fitting_blocks)
+        {
+            fit_block.fit_routine = fit_routines->at(fit_block.routine);
+            std::fill(fit_block.fit_counts.begin(), fit_block.fit_counts.end(), (real_t)0.0);
+        }
+        return;
     }
 
+    fitting_blocks.clear();
+    fitting_blocks.reserve(fit_routines->size());
     for(const auto &itr : *fit_routines)
     {
-        fitting_blocks[itr.first] = Stream_Fitting_Block();
-        fitting_blocks[itr.first].fit_routine = itr.second;
-        for(auto& e_itr : *elements_to_fit)
+        Stream_Fitting_Block fit_block;
+        fit_block.routine = itr.first;
+        fit_block.fit_routine = itr.second;
+        fit_block.element_names.reserve(num_names);
+        if(elements_to_fit != nullptr)
+        {
+            for(auto& e_itr : *elements_to_fit)
+            {
+                fit_block.element_names.push_back(e_itr.first);
+            }
+        }
+        fit_block.element_names.push_back(STR_NUM_ITR);
+        std::sort(fit_block.element_names.begin(), fit_block.element_names.end());
+        fit_block.fit_counts.assign(fit_block.element_names.size(), (real_t)0.0);
+
+        // elements in elements_to_fit order, then STR_NUM_ITR and STR_RESIDUAL, see Base_Fit_Routine::block_labels()
+        std::vector<std::string> labels;
+        if(elements_to_fit != nullptr)
+        {
+            labels = fitting::routines::Base_Fit_Routine::block_labels(elements_to_fit);
+        }
+        else
+        {
+            labels = { STR_NUM_ITR, STR_RESIDUAL };
+        }
+        fit_block.block_counts.setZero(1, labels.size());
+        fit_block.block_columns.reserve(fit_block.element_names.size());
+        for(const auto& name : fit_block.element_names)
+        {
+            fit_block.block_columns.push_back(std::find(labels.begin(), labels.end(), name) - labels.begin());
+        }
+        fitting_blocks.push_back(std::move(fit_block));
+    }
+    std::sort(fitting_blocks.begin(), fitting_blocks.end(), [](const Stream_Fitting_Block& a, const Stream_Fitting_Block& b) { return a.routine < b.routine; });
+}
+
+//-----------------------------------------------------------------------------
+
+Stream_Fitting_Block* Stream_Block::fitting_block(Fitting_Routines routine)
+{
+    for(auto &fit_block : fitting_blocks)
+    {
+        if(fit_block.routine == routine)
+        {
+            return &fit_block;
+        }
+    }
+    return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+
+void Stream_Block::reset(int detector, size_t row, size_t col, size_t height, size_t width)
+{
+    _row = row;
+    _col = col;
+    _height = height;
+    _width = width;
+    _detector = detector;
+    theta = 0;
+    model = nullptr;
+    optimize_fit_params_preset = fitting::models::Fit_Params_Preset::BATCH_FIT_NO_TAILS;
+
+    // shared strings belong to the source, owned ones are reused by the next decode
+    if(false == del_str_ptr)
+    {
+        dataset_directory = nullptr;
+        dataset_name = nullptr;
+    }
+
+    if(spectra != nullptr)
+    {
+        if(_spare_spectra != nullptr)
         {
-            fitting_blocks[itr.first].fit_counts.emplace(std::pair<std::string, real_t> (e_itr.first, (real_t)0.0));
+            delete _spare_spectra;
         }
-        fitting_blocks[itr.first].fit_counts.emplace(std::pair<std::string, real_t> (STR_NUM_ITR, (real_t)0.0));
+        _spare_spectra = spectra;
+        spectra = nullptr;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+Spectra* Stream_Block::alloc_spectra(size_t size, real_t elt, real_t ert, real_t incnt, real_t outcnt)
+{
+    if(spectra == nullptr)
+    {
+        spectra = _spare_spectra;
+        _spare_spectra = nullptr;
+    }
+    if(spectra == nullptr)
+    {
+        spectra = new Spectra(size, elt, ert, incnt, outcnt);
+        return spectra;
+    }
+    if((size_t)spectra->size() != size)
+    {
+        spectra->resize(size);
     }
+    spectra->setZero();
+    spectra->elapsed_livetime(elt);
+    spectra->elapsed_realtime(ert);
+    spectra->input_counts(incnt);
+    spectra->output_counts(outcnt);
+    return spectra;
 }
 
 //-----------------------------------------------------------------------------
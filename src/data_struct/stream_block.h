@@ -60,12 +60,36 @@ namespace data_struct
 //-----------------------------------------------------------------------------
 
 ///
-/// \brief The Stream_Fitting_Block struct
+/// \brief The Stream_Fitting_Block struct : counts of one fitting routine.
+/// fit_counts[i] is the count for element_names[i], STR_NUM_ITR is one of the names.
 ///
 struct Stream_Fitting_Block
 {
+    Stream_Fitting_Block()
+    {
+        routine = Fitting_Routines::ROI;
+        fit_routine = nullptr;
+    }
+
+    // index of name in element_names, -1 if it is not in this block
+    int index_of(const std::string& name) const;
+
+    // count for name, 0 if it is not in this block
+    real_t count(const std::string& name) const;
+
+    Fitting_Routines routine;
+
     fitting::routines::Base_Fit_Routine * fit_routine;
-    std::unordered_map<std::string, real_t> fit_counts;
+
+    std::vector<std::string> element_names;
+
+    std::vector<real_t> fit_counts;
+
+    // fit_block() output of the last pixel, 1 x block_labels() raw counts, allocated once with the block
+    ArrayXXr block_counts;
+
+    // column of block_counts that holds fit_counts[i]
+    std::vector<size_t> block_columns;
 };
 
 //-----------------------------------------------------------------------------
@@ -88,8 +112,23 @@ public:
 
     ~Stream_Block();
 
+    // Builds one fitting block per routine with element names sorted. A recycled block that was initialized
+    // with the same routines and elements only zeros its counts.
     void init_fitting_blocks(std::unordered_map<Fitting_Routines, fitting::routines::Base_Fit_Routine *> *fit_routines, Fit_Element_Map_Dict * elements_to_fit_);
 
+    // nullptr if the routine has no fitting block
+    Stream_Fitting_Block* fitting_block(Fitting_Routines routine);
+
+    // Set the pixel position of a recycled block. Spectra and dataset strings owned by the block are kept for reuse.
+    void reset(int detector, size_t row, size_t col, size_t height, size_t width);
+
+    // Sets spectra to a zeroed spectra, reusing the allocation the block had before it was recycled.
+    Spectra* alloc_spectra(size_t size, real_t elt, real_t ert, real_t incnt, real_t outcnt);
+
+    bool is_pooled() { return _pooled; }
+
+    void set_pooled(bool val) { _pooled = val; }
+
     const size_t& row() { return _row; }
 
     const size_t& col() { return _col; }
@@ -105,8 +144,8 @@ public:
 	inline bool is_end_block() { return (_detector == -1 && _row == -1 && _height == -1 && _col == -1 && _width == -1); }
 
 
-    //by Fitting_Routines
-    std::unordered_map<Fitting_Routines, Stream_Fitting_Block> fitting_blocks;
+    //sorted by Fitting_Routines
+    std::vector<Stream_Fitting_Block> fitting_blocks;
 
     size_t dataset_hash();
 
@@ -139,6 +178,14 @@ protected:
 
     int _detector;
 
+    bool _pooled;
+
+    // spectra kept from the last use of a recycled block
+    Spectra * _spare_spectra;
+
+    // routines the fitting blocks were built from
+    std::unordered_map<Fitting_Routines, fitting::routines::Base_Fit_Routine *> *_fit_routines_src;
+
 };
 
 } //namespace data_struct
@@ -141,6 +141,31 @@ void quantification_residuals_lmfit( const real_t *par, int m_dat, const void *d
 }
 
 
+//-----------------------------------------------------------------------------
+
+// lets lmmin<double> call a residual function written for real_t, the residuals keep real_t resolution
+struct Double_Residual_Data
+{
+    const void* data;
+    void (*evaluate)(const real_t* par, const int m_dat, const void* data, real_t* fvec, int* userbreak);
+    std::vector<real_t> par;
+    std::vector<real_t> fvec;
+};
+
+void double_residuals_lmfit( const double *par, int m_dat, const void *data, double *fvec, int *userbreak )
+{
+    Double_Residual_Data* dd = (Double_Residual_Data*)(data);
+    for (size_t i = 0; i < dd->par.size(); i++)
+    {
+        dd->par[i] = static_cast<real_t>(par[i]);
+    }
+    dd->evaluate(&dd->par[0], m_dat, dd->data, &dd->fvec[0], userbreak);
+    for (int i = 0; i < m_dat; i++)
+    {
+        fvec[i] = dd->fvec[i];
+    }
+}
+
 // =====================================================================================================================
 
 
@@ -226,6 +251,56 @@ void LMFit_Optimizer::set_options(unordered_map<string, real_t> opt)
 
 // ----------------------------------------------------------------------------
 
+void LMFit_Optimizer::_lmmin(std::vector<real_t>& fitp_arr,
+                             int m_dat,
+                             const void* data,
+                             void (*evaluate)(const real_t* par, const int m_dat, const void* data, real_t* fvec, int* userbreak),
+                             lm_status_struct<real_t>& status)
+{
+    if (_precision == Fit_Precision::FLOAT)
+    {
+        lmmin( fitp_arr.size(), &fitp_arr[0], m_dat, data, evaluate, &_options, &status );
+        return;
+    }
+
+    // the residuals are still summed in real_t, relative changes in the chi square close to its epsilon are
+    // rounding noise that keeps producing tiny accepted steps, so the tolerances can not be tighter than that
+    const double res_eps = 10.0 * std::numeric_limits<real_t>::epsilon();
+    lm_control_struct<double> options;
+    options.ftol = std::max((double)_options.ftol, res_eps);
+    options.xtol = std::max((double)_options.xtol, res_eps);
+    options.gtol = std::max((double)_options.gtol, res_eps);
+    options.epsilon = _options.epsilon;
+    options.stepbound = _options.stepbound;
+    options.patience = _options.patience;
+    options.scale_diag = _options.scale_diag;
+    options.msgfile = _options.msgfile;
+    options.verbosity = _options.verbosity;
+    options.n_maxpri = _options.n_maxpri;
+    options.m_maxpri = _options.m_maxpri;
+
+    Double_Residual_Data dd;
+    dd.data = data;
+    dd.evaluate = evaluate;
+    dd.par.resize(fitp_arr.size());
+    dd.fvec.resize(m_dat);
+
+    std::vector<double> fitp_arr_d(fitp_arr.begin(), fitp_arr.end());
+    lm_status_struct<double> status_d;
+    lmmin( fitp_arr_d.size(), &fitp_arr_d[0], m_dat, (const void*) &dd, double_residuals_lmfit, &options, &status_d );
+
+    for (size_t i = 0; i < fitp_arr.size(); i++)
+    {
+        fitp_arr[i] = static_cast<real_t>(fitp_arr_d[i]);
+    }
+    status.fnorm = static_cast<real_t>(status_d.fnorm);
+    status.nfev = status_d.nfev;
+    status.outcome = status_d.outcome;
+    status.userbreak = status_d.userbreak;
+}
+
+// ----------------------------------------------------------------------------
+
 OPTIMIZER_OUTCOME LMFit_Optimizer::minimize(Fit_Parameters *fit_params,
                                            const Spectra * const spectra,
                                            const Fit_Element_Map_Dict * const elements_to_fit,
@@ -284,7 +359,7 @@ OPTIMIZER_OUTCOME LMFit_Optimizer::minimize(Fit_Parameters *fit_params,
     //control.verbosity = 3;
 
     /* perform the fit */
-    lmmin( fitp_arr.size(), &fitp_arr[0], energy_range.count(), (const void*) &ud, residuals_lmfit, &_options, &status );
+    _lmmin( fitp_arr, energy_range.count(), (const void*) &ud, residuals_lmfit, status );
     logI<< "Status after "<<status.nfev<<" function evaluations:\n  "<<lm_infmsg[status.outcome]<<"\r\n";
 
     fit_params->from_array(fitp_arr);
@@ -328,7 +403,7 @@ OPTIMIZER_OUTCOME LMFit_Optimizer::minimize_func(Fit_Parameters *fit_params,
 
     lm_status_struct<real_t> status;
 
-    lmmin( fitp_arr.size(), &fitp_arr[0], energy_range.count(), (const void*) &ud, general_residuals_lmfit, &_options, &status );
+    _lmmin( fitp_arr, energy_range.count(), (const void*) &ud, general_residuals_lmfit, status );
 
     fit_params->from_array(fitp_arr);
 
@@ -373,7 +448,7 @@ OPTIMIZER_OUTCOME LMFit_Optimizer::minimize_quantification(Fit_Parameters *fit_p
     std::vector<real_t> perror(fitp_arr.size());
 
     lm_status_struct<real_t> status;
-    lmmin( fitp_arr.size(), &fitp_arr[0], quant_map->size(), (const void*) &ud, quantification_residuals_lmfit, &_options, &status );
+    _lmmin( fitp_arr, quant_map->size(), (const void*) &ud, quantification_residuals_lmfit, status );
     logI<<lm_infmsg[status.outcome]<<"\n";
 
     fit_params->from_array(fitp_arr);
@@ -93,8 +93,18 @@ public:
 
     virtual void set_options(unordered_map<string, real_t> opt);
 
+    virtual bool supports_precision(Fit_Precision /*precision*/) const { return true; }
+
 private:
 
+    // runs lmmin in real_t, or with its state (parameters, jacobian, QR, norms) accumulated in double for Fit_Precision::DOUBLE.
+    // The model and residuals are still real_t and the tolerances are floored at real_t resolution, so it is not a full double fit.
+    void _lmmin(std::vector<real_t>& fitp_arr,
+                int m_dat,
+                const void* data,
+                void (*evaluate)(const real_t* par, const int m_dat, const void* data, real_t* fvec, int* userbreak),
+                lm_status_struct<real_t>& status);
+
     struct lm_control_struct<real_t> _options;
 };
 
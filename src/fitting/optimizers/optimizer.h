@@ -151,7 +151,7 @@ void update_background_user_data(User_Data *ud);
 class DLL_EXPORT Optimizer
 {
 public:
-    Optimizer(){}
+    Optimizer(){ _precision = Fit_Precision::FLOAT; }
 
     ~Optimizer(){}
 
@@ -177,9 +177,18 @@ public:
 
     virtual void set_options(unordered_map<string, real_t> opt) = 0;
 
+    // scalar type of the optimizer state (parameters, jacobian, step), the model is always evaluated in real_t
+    virtual bool supports_precision(Fit_Precision precision) const { return precision == Fit_Precision::FLOAT; }
+
+    void set_precision(Fit_Precision precision) { _precision = precision; }
+
+    Fit_Precision precision() const { return _precision; }
+
 protected:
     map<int, OPTIMIZER_OUTCOME> _outcome_map;
 
+    Fit_Precision _precision;
+
 };
 
 } //namespace optimizers
@@ -50,6 +50,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #define Base_Fit_Routine_H
 
 #include <unordered_map>
+#include <vector>
 
 #include "fitting/optimizers/optimizer.h"
 #include "data_struct/spectra.h"
@@ -74,7 +75,7 @@ public:
     /**
      * @brief Base_Fit_Routine : Constructor
      */
-    Base_Fit_Routine() {}
+    Base_Fit_Routine() { _precision = Fit_Precision::FLOAT; }
 
     /**
      * @brief ~Base_Fit_Routine : Destructor
@@ -95,6 +96,59 @@ public:
                                                       const Fit_Element_Map_Dict * const elements_to_fit,
                                                       std::unordered_map<std::string, real_t>& out_counts) = 0;
 
+    /**
+     * @brief fit_block : Fit count spectra that are stored back to back ( a Spectra_Line for example ).
+     *  Results are written into out_counts, one row per spectra and one column per entry of block_labels(),
+     *  out_counts has to be allocated by the caller. The default fits one pixel at a time with fit_spectra,
+     *  linear routines override it to share the work across the block.
+     * @param model : Model used for the fit
+     * @param spectra : Pointer to the first spectra
+     * @param count : Number of spectra to fit
+     * @param elements_to_fit : List of elements to fit, has to be the same dict for the whole block
+     * @param out_counts : count x block_labels(elements_to_fit).size() array of raw counts
+     */
+    virtual void fit_block(const models::Base_Model * const model,
+                           const Spectra * const spectra,
+                           size_t count,
+                           const Fit_Element_Map_Dict * const elements_to_fit,
+                           ArrayXXr& out_counts)
+    {
+        std::unordered_map<std::string, real_t> counts;
+        const size_t num_elements = elements_to_fit->size();
+        for (size_t p = 0; p < count; p++)
+        {
+            for (auto& itr : counts)
+            {
+                itr.second = 0.0;
+            }
+            fit_spectra(model, &spectra[p], elements_to_fit, counts);
+            size_t col = 0;
+            for (const auto& itr : *elements_to_fit)
+            {
+                out_counts(p, col) = counts[itr.first];
+                col++;
+            }
+            out_counts(p, num_elements) = counts[STR_NUM_ITR];
+            out_counts(p, num_elements + 1) = counts[STR_RESIDUAL];
+        }
+    }
+
+    /**
+     * @brief block_labels : Column names of the fit_block() output, the elements in elements_to_fit iteration order followed by STR_NUM_ITR and STR_RESIDUAL
+     */
+    static std::vector<std::string> block_labels(const Fit_Element_Map_Dict * const elements_to_fit)
+    {
+        std::vector<std::string> labels;
+        labels.reserve(elements_to_fit->size() + 2);
+        for (const auto& itr : *elements_to_fit)
+        {
+            labels.push_back(itr.first);
+        }
+        labels.push_back(STR_NUM_ITR);
+        labels.push_back(STR_RESIDUAL);
+        return labels;
+    }
+
     /**
      * @brief get_name : Returns fit routine name
      * @return
@@ -112,9 +166,27 @@ public:
                             const Fit_Element_Map_Dict * const elements_to_fit,
                             const struct Range energy_range) = 0;
 
+    /**
+     * @brief set_precision : Scalar type used by the solver, call before initialize(). Routines without a double path ignore it.
+     */
+    void set_precision(Fit_Precision precision) { _precision = precision; }
+
+    Fit_Precision precision() const { return _precision; }
 
 protected:
 
+    // per pixel adapter for routines that implement fit_block() natively, copies the element columns of a single row block
+    void _block_to_counts(const ArrayXXr& block, const Fit_Element_Map_Dict * const elements_to_fit, std::unordered_map<std::string, real_t>& out_counts) const
+    {
+        size_t col = 0;
+        for (const auto& itr : *elements_to_fit)
+        {
+            out_counts[itr.first] = block(0, col);
+            col++;
+        }
+    }
+
+    Fit_Precision _precision;
 
 private:
 
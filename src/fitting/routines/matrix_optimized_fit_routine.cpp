@@ -47,6 +47,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 
 #include "matrix_optimized_fit_routine.h"
+#include "support/nnls/nnls.hpp"
 
 namespace fitting
 {
@@ -59,7 +60,7 @@ std::mutex Matrix_Optimized_Fit_Routine::_int_spec_mutex;
 
 Matrix_Optimized_Fit_Routine::Matrix_Optimized_Fit_Routine() : Param_Optimized_Fit_Routine()
 {
-
+    _nnls_seed = false;
 }
 
 // ----------------------------------------------------------------------------
@@ -78,16 +79,12 @@ void Matrix_Optimized_Fit_Routine::model_spectrum(const Fit_Parameters * const f
                                                   const struct Range * const energy_range,
 												  Spectra* spectra_model)
 {
-	spectra_model->setZero();
-
-    for(const auto& itr : _element_models)
+    Eigen::Matrix<real_t, Eigen::Dynamic, 1> amplitudes(_model_labels.size());
+    for (size_t i = 0; i < _model_labels.size(); i++)
     {
-        if(fit_params->contains(itr.first))
-        {
-            Fit_Param param = fit_params->at(itr.first);
-            (*spectra_model) += (pow((real_t)10.0, param.value) * itr.second);
-        }
+        amplitudes[i] = fit_params->contains(_model_labels[i]) ? std::pow((real_t)10.0, fit_params->at(_model_labels[i]).value) : (real_t)0.0;
     }
+    spectra_model->matrix().noalias() = _model_matrix * amplitudes;
 
 /*
     if (np.sum(this->add_matrixfit_pars[3:6]) >= 0.)
@@ -217,6 +214,85 @@ void Matrix_Optimized_Fit_Routine::initialize(models::Base_Model * const model,
         _integrated_background.setZero(energy_range.count());
     }
 
+    _model_labels.clear();
+    _model_matrix.resize(energy_range.count(), _element_models.size());
+    for (const auto& itr : _element_models)
+    {
+        _model_matrix.col(_model_labels.size()) = itr.second.matrix();
+        _model_labels.push_back(itr.first);
+    }
+
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<const Fit_Param*> Matrix_Optimized_Fit_Routine::_model_param_slots(const Fit_Parameters * const fit_params) const
+{
+    std::vector<const Fit_Param*> slots(_model_labels.size(), nullptr);
+    for (size_t i = 0; i < _model_labels.size(); i++)
+    {
+        if (fit_params->contains(_model_labels[i]))
+        {
+            slots[i] = &fit_params->at(_model_labels[i]);
+        }
+    }
+    return slots;
+}
+
+// ----------------------------------------------------------------------------
+
+void Matrix_Optimized_Fit_Routine::_seed_from_nnls(Fit_Parameters *fit_params, const Spectra * const spectra, const ArrayXr& background)
+{
+    if (_model_labels.size() == 0)
+    {
+        return;
+    }
+
+    nsNNLS::nnls<real_t>::TArrayXr rhs = spectra->segment(_energy_range.min, _energy_range.count()) - background;
+    nsNNLS::nnls<real_t> solver(&_model_matrix, &rhs, 200);
+    int num_iter;
+    real_t npg;
+    solver.optimize(num_iter, npg);
+    const nsNNLS::nnls<real_t>::TArrayXr& weights = *solver.getSolution();
+    if (false == (weights > (real_t)0.0).any())
+    {
+        // nothing to seed from, leave the guesses so LM still has parameters to fit
+        return;
+    }
+
+    for (size_t i = 0; i < _model_labels.size(); i++)
+    {
+        if (false == fit_params->contains(_model_labels[i]))
+        {
+            continue;
+        }
+        Fit_Param& param = (*fit_params)[_model_labels[i]];
+        if (param.bound_type == E_Bound_Type::FIXED)
+        {
+            continue;
+        }
+        if (std::isfinite(weights[i]) && weights[i] > 0.0)
+        {
+            param.value = std::log10(weights[i]);
+        }
+        else
+        {
+            // no weight in the linear solve, fix it at ~0 counts (the element lower bound) instead of letting LM search for it
+            param.value = (real_t)-11.0;
+            param.bound_type = E_Bound_Type::FIXED;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void Matrix_Optimized_Fit_Routine::set_integrated_spectra(const Spectra& fitted, const Spectra& background, const Spectra& max_channels, const Spectra& max_10_channels)
+{
+    std::lock_guard<std::mutex> lock(_int_spec_mutex);
+    _integrated_fitted_spectra = fitted;
+    _integrated_background = background;
+    _max_channels_spectra = max_channels;
+    _max_10_channels_spectra = max_10_channels;
 }
 
 // ----------------------------------------------------------------------------
@@ -258,7 +334,27 @@ OPTIMIZER_OUTCOME Matrix_Optimized_Fit_Routine:: fit_spectra(const models::Base_
             background.setZero(_energy_range.count());
         }
 
-        std::function<void(const Fit_Parameters* const, const  Range* const, Spectra*)> gen_func = std::bind(&Matrix_Optimized_Fit_Routine::model_spectrum, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+        if (_nnls_seed)
+        {
+            _seed_from_nnls(&fit_params, spectra, background);
+        }
+
+        // the optimizer updates fit_params in place, resolve the amplitude of each model column once instead of every evaluation
+        const std::vector<const Fit_Param*> model_slots = _model_param_slots(&fit_params);
+        Eigen::Matrix<real_t, Eigen::Dynamic, 1> amplitudes(_model_labels.size());
+        std::function<void(const Fit_Parameters* const, const  Range* const, Spectra*)> gen_func = [this, &fit_params, &model_slots, &amplitudes](const Fit_Parameters* const params, const Range* const energy_range, Spectra* spectra_model)
+        {
+            if (params != &fit_params)
+            {
+                model_spectrum(params, energy_range, spectra_model);
+                return;
+            }
+            for (size_t i = 0; i < model_slots.size(); i++)
+            {
+                amplitudes[i] = (model_slots[i] != nullptr) ? std::pow((real_t)10.0, model_slots[i]->value) : (real_t)0.0;
+            }
+            spectra_model->matrix().noalias() = _model_matrix * amplitudes;
+        };
 
         //set num iter to 300;
         unordered_map<string, real_t> opt_options{ {STR_OPT_MAXITER, 300.}, {STR_OPT_FTOL, 1.0e-11 }, {STR_OPT_GTOL, 1.0e-11 } };
@@ -96,6 +96,14 @@ public:
 
 	const Spectra& max_10_integrated_spectra() { return _max_10_channels_spectra; }
 
+    // restore the sums of a resumed fit, call after initialize()
+    void set_integrated_spectra(const Spectra& fitted, const Spectra& background, const Spectra& max_channels, const Spectra& max_10_channels);
+
+    // start each LM fit from an NNLS solve against the element models, elements it gives no weight are fixed
+    void set_nnls_seed(bool val) { _nnls_seed = val; }
+
+    bool nnls_seed() const { return _nnls_seed; }
+
 protected:
 
     unordered_map<string, Spectra> _generate_element_models(models::Base_Model * const model,
@@ -109,6 +117,18 @@ protected:
 
     unordered_map<string, Spectra> _element_models;
 
+    void _seed_from_nnls(Fit_Parameters *fit_params, const Spectra * const spectra, const ArrayXr& background);
+
+    // fit_params entry of each _model_matrix column, nullptr if it has none
+    std::vector<const Fit_Param*> _model_param_slots(const Fit_Parameters * const fit_params) const;
+
+    bool _nnls_seed;
+
+    // _element_models packed one per column at initialize(), model_spectrum() is a single product with 10^amplitudes
+    Eigen::Matrix<real_t, Eigen::Dynamic, Eigen::Dynamic> _model_matrix;
+
+    std::vector<std::string> _model_labels;
+
     static std::mutex _int_spec_mutex;
 
 };
@@ -101,6 +101,29 @@ void NNLS_Fit_Routine::_generate_fitmatrix()
         i++;
     }
 
+    if (_precision == Fit_Precision::DOUBLE)
+    {
+        _fitmatrix_d = _fitmatrix.cast<double>();
+    }
+    else
+    {
+        _fitmatrix_d.resize(0, 0);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T>
+int NNLS_Fit_Routine::_solve(Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>* fitmatrix, const ArrayXr& rhs, ArrayXr& result, real_t& npg)
+{
+    typename nsNNLS::nnls<T>::TArrayXr t_rhs = rhs.template cast<T>();
+    nsNNLS::nnls<T> solver(fitmatrix, &t_rhs, _max_iter);
+    int num_iter;
+    T t_npg;
+    solver.optimize(num_iter, t_npg);
+    result = solver.getSolution()->template cast<real_t>();
+    npg = static_cast<real_t>(t_npg);
+    return num_iter;
 }
 
 // ----------------------------------------------------------------------------
@@ -110,78 +133,107 @@ OPTIMIZER_OUTCOME NNLS_Fit_Routine::fit_spectra(const models::Base_Model * const
                                                 const Fit_Element_Map_Dict * const elements_to_fit,
                                                 std::unordered_map<std::string, real_t>& out_counts)
 {
-	data_struct::ArrayXr* result;
-    int num_iter;
-    real_t npg;
-    Fit_Parameters fit_params = model->fit_parameters();
-    fit_params.add_parameter(Fit_Param(STR_RESIDUAL, 0.0));
-    ArrayXr background;
-    if (fit_params.contains(STR_SNIP_WIDTH))
-    {        
-        ArrayXr bkg = snip_background(spectra,
-            fit_params.value(STR_ENERGY_OFFSET),
-            fit_params.value(STR_ENERGY_SLOPE),
-            fit_params.value(STR_ENERGY_QUADRATIC),
-            fit_params.value(STR_SNIP_WIDTH),
-            _energy_range.min,
-            _energy_range.max);
-
-        background = bkg.segment(_energy_range.min, _energy_range.count());
-    }
-    else
+    const size_t num_elements = elements_to_fit->size();
+    ArrayXXr block(1, num_elements + 2);
+    fit_block(model, spectra, 1, elements_to_fit, block);
+    _block_to_counts(block, elements_to_fit, out_counts);
+    out_counts[STR_NUM_ITR] = block(0, num_elements);
+    out_counts[STR_RESIDUAL] = block(0, num_elements + 1);
+
+    if (block(0, num_elements) == (real_t)_max_iter)
     {
-        background.setZero(_energy_range.count());
+        return OPTIMIZER_OUTCOME::EXHAUSTED;
     }
+    return OPTIMIZER_OUTCOME::CONVERGED;
+}
 
-    ArrayXr spectra_sub_background = spectra->segment(_energy_range.min, _energy_range.count());
-    spectra_sub_background -= background;
-    spectra_sub_background = spectra_sub_background.unaryExpr([](real_t v) { return v>0.0 ? v : (real_t)0.0; });
-    nsNNLS::nnls<real_t> solver(&_fitmatrix, &spectra_sub_background, _max_iter);
+// ----------------------------------------------------------------------------
 
-    Spectra spectra_model = background;
+void NNLS_Fit_Routine::fit_block(const models::Base_Model * const model,
+                                 const Spectra * const spectra,
+                                 size_t count,
+                                 const Fit_Element_Map_Dict * const elements_to_fit,
+                                 ArrayXXr& out_counts)
+{
+    const Eigen::Index n = _energy_range.count();
+    const size_t num_elements = elements_to_fit->size();
 
-	//Spectra spectra_model(_energy_range.count());
-	//ArrayXr rhs = spectra->sub_spectra(_energy_range.min, _energy_range.count());
-	//nsNNLS::nnls<real_t> solver(&_fitmatrix, &rhs, _max_iter);
+    const Fit_Parameters& fit_params = model->fit_parameters();
+    const bool has_background = fit_params.contains(STR_SNIP_WIDTH);
+    // double keeps the projected gradient steps from stalling on pixels with a wide dynamic range
+    const bool use_double = (_precision == Fit_Precision::DOUBLE && _fitmatrix_d.size() > 0);
 
-    solver.optimize(num_iter, npg);
-    if (num_iter < 0)
+    std::vector<int> element_rows;
+    element_rows.reserve(num_elements);
+    for (const auto& itr : *elements_to_fit)
     {
-        logE<<"NNLS_Fit_Routine::_fit_spectra: in optimization routine"<<"\n";
+        element_rows.push_back(_element_row_index.at(itr.first));
     }
 
-    result = solver.getSolution();
+    ArrayXr result;
+    ArrayXr background = ArrayXr::Zero(n);
+    ArrayXr spectra_sub_background(n);
+    // summed over the block so the shared integrated spectra are only locked once, the model is linear
+    // so the integrated fit is the fit matrix times the summed coefficients
+    Eigen::Matrix<real_t, Eigen::Dynamic, 1> coef_sum = Eigen::Matrix<real_t, Eigen::Dynamic, 1>::Zero(_fitmatrix.cols());
+    ArrayXr background_sum = ArrayXr::Zero(n);
 
-    for(const auto& itr : *elements_to_fit)
+    for (size_t p = 0; p < count; p++)
     {
-        out_counts[itr.first] = (*result)[_element_row_index[itr.first]];
-
-		for (int j = 0; j < _energy_range.count(); j++)
-		{
-			real_t val = _fitmatrix(j, _element_row_index[itr.first]) * (*result)[_element_row_index[itr.first]];
-			if (std::isfinite(val))
-			{
-				spectra_model[j] += val;
-			}
-		}
-    }
+        const Spectra* spectra_p = &spectra[p];
+        int num_iter;
+        real_t npg;
+        if (has_background)
+        {
+            ArrayXr bkg = snip_background(spectra_p,
+                fit_params.value(STR_ENERGY_OFFSET),
+                fit_params.value(STR_ENERGY_SLOPE),
+                fit_params.value(STR_ENERGY_QUADRATIC),
+                fit_params.value(STR_SNIP_WIDTH),
+                _energy_range.min,
+                _energy_range.max);
+
+            background = bkg.segment(_energy_range.min, n);
+        }
+
+        spectra_sub_background = spectra_p->segment(_energy_range.min, n) - background;
+        spectra_sub_background = spectra_sub_background.unaryExpr([](real_t v) { return v>0.0 ? v : (real_t)0.0; });
+
+        if (use_double)
+        {
+            num_iter = _solve(&_fitmatrix_d, spectra_sub_background, result, npg);
+        }
+        else
+        {
+            num_iter = _solve(&_fitmatrix, spectra_sub_background, result, npg);
+        }
+        if (num_iter < 0)
+        {
+            logE<<"NNLS_Fit_Routine::_fit_spectra: in optimization routine"<<"\n";
+        }
 
-    out_counts[STR_NUM_ITR] = static_cast<real_t>(num_iter);
-    out_counts[STR_RESIDUAL] = npg;
+        for (size_t e = 0; e < num_elements; e++)
+        {
+            real_t val = result[element_rows[e]];
+            out_counts(p, e) = val;
+            if (std::isfinite(val))
+            {
+                coef_sum[element_rows[e]] += val;
+            }
+        }
+        out_counts(p, num_elements) = static_cast<real_t>(num_iter);
+        out_counts(p, num_elements + 1) = npg;
 
-	//lock and integrate results
-	{
-		std::lock_guard<std::mutex> lock(_int_spec_mutex);
-		_integrated_fitted_spectra.add(spectra_model);
-        _integrated_background.add(background);
-	}
+        background_sum += background;
+    }
 
-    if (num_iter == solver.getMaxit())
+    ArrayXr model_sum = (_fitmatrix * coef_sum).array() + background_sum;
+    //lock and integrate results
     {
-        return OPTIMIZER_OUTCOME::EXHAUSTED;
+        std::lock_guard<std::mutex> lock(_int_spec_mutex);
+        _integrated_fitted_spectra.add(model_sum);
+        _integrated_background.add(background_sum);
     }
-    return OPTIMIZER_OUTCOME::CONVERGED;
-
 }
 
 // ----------------------------------------------------------------------------
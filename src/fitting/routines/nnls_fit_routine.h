@@ -76,6 +76,12 @@ public:
                                         const Fit_Element_Map_Dict* const elements_to_fit,
                                         std::unordered_map<std::string, real_t>& out_counts);
 
+    virtual void fit_block(const models::Base_Model * const model,
+                           const Spectra * const spectra,
+                           size_t count,
+                           const Fit_Element_Map_Dict * const elements_to_fit,
+                           ArrayXXr& out_counts);
+
     virtual std::string get_name() { return STR_FIT_NNLS; }
 
     virtual void initialize(models::Base_Model * const model,
@@ -88,10 +94,16 @@ protected:
 
 private:
 
+    template<typename T>
+    int _solve(Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>* fitmatrix, const ArrayXr& rhs, ArrayXr& result, real_t& npg);
+
     size_t _max_iter;
 
     Eigen::Matrix<real_t, Eigen::Dynamic, Eigen::Dynamic> _fitmatrix;
 
+    // copy of _fitmatrix for Fit_Precision::DOUBLE, empty otherwise
+    Eigen::MatrixXd _fitmatrix_d;
+
     std::unordered_map<std::string, int> _element_row_index;
 
 };
@@ -89,6 +89,8 @@ public:
 
      void set_optimizer(Optimizer *optimizer);
 
+     Optimizer* optimizer() const { return _optimizer; }
+
      void set_update_coherent_amplitude_on_fit(bool val) {_update_coherent_amplitude_on_fit = val;}
 
      const Range& energy_range() { return _energy_range; }
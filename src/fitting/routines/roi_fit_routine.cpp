@@ -74,12 +74,34 @@ optimizers::OPTIMIZER_OUTCOME ROI_Fit_Routine::fit_spectra(const models::Base_Mo
                                                             const Spectra * const spectra,
                                                             const Fit_Element_Map_Dict * const elements_to_fit,
                                                             std::unordered_map<std::string, real_t>& out_counts)
- {    
-    Fit_Parameters fitp = model->fit_parameters();
-    unsigned int n_mca_channels = spectra->size();
+{
+    ArrayXXr block(1, elements_to_fit->size() + 2);
+    fit_block(model, spectra, 1, elements_to_fit, block);
+    _block_to_counts(block, elements_to_fit, out_counts);
+    return optimizers::OPTIMIZER_OUTCOME::CONVERGED;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+void ROI_Fit_Routine::fit_block(const models::Base_Model * const model,
+                                const Spectra * const spectra,
+                                size_t count,
+                                const Fit_Element_Map_Dict * const elements_to_fit,
+                                ArrayXXr& out_counts)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    const Fit_Parameters& fitp = model->fit_parameters();
+    unsigned int n_mca_channels = spectra[0].size();
 
     real_t energy_offset = fitp.value(STR_ENERGY_OFFSET);
     real_t energy_slope = fitp.value(STR_ENERGY_SLOPE);
+
+    // the windows only depend on the calibration, find them once for the block
+    std::vector<std::pair<unsigned int, size_t> > windows;
+    windows.reserve(elements_to_fit->size());
     for(const auto& e_itr : *elements_to_fit)
     {
         unsigned int left_roi = 0;
@@ -97,10 +119,19 @@ optimizers::OPTIMIZER_OUTCOME ROI_Fit_Routine::fit_spectra(const models::Base_Mo
             left_roi = right_roi - 1;
         }
 
-        size_t spec_size = (right_roi - left_roi) + 1;
-        out_counts[e_itr.first] = spectra->segment(left_roi, spec_size).sum();
+        windows.emplace_back(left_roi, (right_roi - left_roi) + 1);
+    }
+
+    const size_t num_elements = windows.size();
+    for (size_t p = 0; p < count; p++)
+    {
+        for (size_t e = 0; e < num_elements; e++)
+        {
+            out_counts(p, e) = spectra[p].segment(windows[e].first, windows[e].second).sum();
+        }
+        out_counts(p, num_elements) = 0.0;
+        out_counts(p, num_elements + 1) = 0.0;
     }
-    return optimizers::OPTIMIZER_OUTCOME::CONVERGED;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
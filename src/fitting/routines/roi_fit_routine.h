@@ -71,6 +71,11 @@ public:
                                                       const Fit_Element_Map_Dict * const elements_to_fit,
                                                       std::unordered_map<std::string, real_t>& out_counts);
 
+    virtual void fit_block(const models::Base_Model * const model,
+                           const Spectra * const spectra,
+                           size_t count,
+                           const Fit_Element_Map_Dict * const elements_to_fit,
+                           ArrayXXr& out_counts);
 
     virtual std::string get_name() { return STR_FIT_ROI; }
 
@@ -96,6 +96,17 @@ void SVD_Fit_Routine::_generate_fitmatrix()
         i++;
     }
 
+    // the matrix is the same for every pixel so decompose it once here instead of per fit
+    if (_precision == Fit_Precision::DOUBLE)
+    {
+        _svd_d.compute(_fitmatrix.cast<double>(), Eigen::ComputeThinU | Eigen::ComputeThinV);
+        _svd = Eigen::JacobiSVD<Eigen::Matrix<real_t, Eigen::Dynamic, Eigen::Dynamic> >();
+    }
+    else
+    {
+        _svd.compute(_fitmatrix, Eigen::ComputeThinU | Eigen::ComputeThinV);
+        _svd_d = Eigen::JacobiSVD<Eigen::MatrixXd>();
+    }
 }
 
 // ----------------------------------------------------------------------------
@@ -105,48 +116,93 @@ optimizers::OPTIMIZER_OUTCOME SVD_Fit_Routine::fit_spectra(const models::Base_Mo
                                                            const Fit_Element_Map_Dict * const elements_to_fit,
                                                            std::unordered_map<std::string, real_t>& out_counts)
 {
-    Eigen::JacobiSVD<Eigen::Matrix<real_t, Eigen::Dynamic, Eigen::Dynamic> > svd(_fitmatrix, Eigen::ComputeThinU | Eigen::ComputeThinV );
-    Eigen::VectorXf rhs = spectra->segment(_energy_range.min, _energy_range.count());
+    ArrayXXr block(1, elements_to_fit->size() + 2);
+    fit_block(model, spectra, 1, elements_to_fit, block);
+    _block_to_counts(block, elements_to_fit, out_counts);
+    out_counts[STR_RESIDUAL] = block(0, elements_to_fit->size() + 1);
+    return optimizers::OPTIMIZER_OUTCOME::CONVERGED;
+}
 
-    Fit_Parameters fit_params = model->fit_parameters();
-    Eigen::VectorXf background;
-    if (fit_params.contains(STR_SNIP_WIDTH))
-    {
-        ArrayXr bkg = snip_background(spectra,
-            fit_params.value(STR_ENERGY_OFFSET),
-            fit_params.value(STR_ENERGY_SLOPE),
-            fit_params.value(STR_ENERGY_QUADRATIC),
-            fit_params.value(STR_SNIP_WIDTH),
-            _energy_range.min,
-            _energy_range.max);
-
-        background = bkg.segment(_energy_range.min, _energy_range.count());
-    }
-    else
+// ----------------------------------------------------------------------------
+
+void SVD_Fit_Routine::fit_block(const models::Base_Model * const model,
+                                const Spectra * const spectra,
+                                size_t count,
+                                const Fit_Element_Map_Dict * const elements_to_fit,
+                                ArrayXXr& out_counts)
+{
+    // spectra are solved as columns of one right hand side, in chunks so a long row does not need a huge matrix
+    const size_t chunk_size = 64;
+    const Eigen::Index n = _energy_range.count();
+    const size_t num_elements = elements_to_fit->size();
+
+    const Fit_Parameters& fit_params = model->fit_parameters();
+    const bool has_background = fit_params.contains(STR_SNIP_WIDTH);
+
+    std::vector<int> element_rows;
+    element_rows.reserve(num_elements);
+    for (const auto& itr : *elements_to_fit)
     {
-        background.setZero(_energy_range.count());
+        element_rows.push_back(_element_row_index.at(itr.first));
     }
-    
-    rhs -= background;
-    rhs = rhs.unaryExpr([](real_t v) { return v > 0.0 ? v : (real_t)0.0; });
 
-    ArrayXr spectra_model = background;
+    Eigen::Matrix<real_t, Eigen::Dynamic, Eigen::Dynamic> rhs;
+    Eigen::Matrix<real_t, Eigen::Dynamic, Eigen::Dynamic> result;
+    Eigen::Matrix<real_t, Eigen::Dynamic, Eigen::Dynamic> fitted;
+    ArrayXr spectra_model = ArrayXr::Zero(n);
+    // the model is linear so the integrated fit is the fit matrix times the summed coefficients
+    Eigen::Matrix<real_t, Eigen::Dynamic, 1> coef_sum = Eigen::Matrix<real_t, Eigen::Dynamic, 1>::Zero(_fitmatrix.cols());
 
-    Eigen::VectorXf result = svd.solve(rhs);
-
-    for(const auto& itr : *elements_to_fit)
+    for (size_t start = 0; start < count; start += chunk_size)
     {
-        
-        out_counts[itr.first] = result[_element_row_index[itr.first]];
-        for (int j = 0; j < _energy_range.count(); j++)
+        const size_t chunk = std::min(chunk_size, count - start);
+        rhs.resize(n, chunk);
+        for (size_t p = 0; p < chunk; p++)
+        {
+            const Spectra* spectra_p = &spectra[start + p];
+            rhs.col(p) = spectra_p->segment(_energy_range.min, n).matrix();
+            if (has_background)
+            {
+                ArrayXr bkg = snip_background(spectra_p,
+                    fit_params.value(STR_ENERGY_OFFSET),
+                    fit_params.value(STR_ENERGY_SLOPE),
+                    fit_params.value(STR_ENERGY_QUADRATIC),
+                    fit_params.value(STR_SNIP_WIDTH),
+                    _energy_range.min,
+                    _energy_range.max);
+
+                rhs.col(p) -= bkg.segment(_energy_range.min, n).matrix();
+                spectra_model += bkg.segment(_energy_range.min, n);
+            }
+        }
+        rhs = rhs.unaryExpr([](real_t v) { return v > 0.0 ? v : (real_t)0.0; });
+
+        if (_precision == Fit_Precision::DOUBLE)
+        {
+            result = _svd_d.solve(rhs.cast<double>()).cast<real_t>();
+        }
+        else
+        {
+            result = _svd.solve(rhs);
+        }
+
+        fitted.noalias() = _fitmatrix * result;
+        for (size_t p = 0; p < chunk; p++)
         {
-            real_t val = _fitmatrix(j, _element_row_index[itr.first]) * result[_element_row_index[itr.first]];
-            if (std::isfinite(val))
+            for (size_t e = 0; e < num_elements; e++)
             {
-                spectra_model[j] += val;
+                real_t val = result(element_rows[e], p);
+                out_counts(start + p, e) = val;
+                if (std::isfinite(val))
+                {
+                    coef_sum[element_rows[e]] += val;
+                }
             }
+            out_counts(start + p, num_elements) = 0.0;
+            out_counts(start + p, num_elements + 1) = (fitted.col(p) - rhs.col(p)).norm();
         }
     }
+    spectra_model += (_fitmatrix * coef_sum).array();
 
     //lock and integrate results
     {
@@ -154,10 +210,6 @@ optimizers::OPTIMIZER_OUTCOME SVD_Fit_Routine::fit_spectra(const models::Base_Mo
         _integrated_fitted_spectra.add(spectra_model);
         //_integrated_background.add(background);
     }
-
-    out_counts[STR_RESIDUAL] = (_fitmatrix * result - rhs).norm();
-
-    return optimizers::OPTIMIZER_OUTCOME::CONVERGED;
 }
 
 // ----------------------------------------------------------------------------
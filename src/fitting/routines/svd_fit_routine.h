@@ -53,6 +53,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "fitting/routines/matrix_optimized_fit_routine.h"
 
 #include <Eigen/Core>
+#include <Eigen/SVD>
 
 namespace fitting
 {
@@ -74,6 +75,12 @@ public:
                                                       const Fit_Element_Map_Dict * const elements_to_fit,
                                                       std::unordered_map<std::string, real_t>& out_counts);
 
+    virtual void fit_block(const models::Base_Model * const model,
+                           const Spectra * const spectra,
+                           size_t count,
+                           const Fit_Element_Map_Dict * const elements_to_fit,
+                           ArrayXXr& out_counts);
+
 
     virtual std::string get_name() { return STR_FIT_SVD; }
 
@@ -89,6 +96,12 @@ private:
 
     Eigen::Matrix<real_t, Eigen::Dynamic, Eigen::Dynamic> _fitmatrix;
 
+    // decomposition of _fitmatrix, shared by all pixels
+    Eigen::JacobiSVD<Eigen::Matrix<real_t, Eigen::Dynamic, Eigen::Dynamic> > _svd;
+
+    // used instead of _svd for Fit_Precision::DOUBLE
+    Eigen::JacobiSVD<Eigen::MatrixXd> _svd_d;
+
     std::unordered_map<std::string, int> _element_row_index;
 
 };
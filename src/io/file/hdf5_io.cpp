@@ -63,6 +63,12 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "csv_io.h"
 
+#include "workflow/threadpool.h"
+
+#ifdef _BUILD_WITH_ZLIB
+#include <zlib.h>
+#endif
+
 #define HDF5_SAVE_VERSION 10.0
 
 #define HDF5_EXCHANGE_VERSION 1.0
@@ -100,6 +106,73 @@ hsize_t max_dims_1d[1] = { H5S_UNLIMITED };
 hsize_t max_dims_2d[2] = { H5S_UNLIMITED, H5S_UNLIMITED };
 hsize_t max_dims_3d[3] = { H5S_UNLIMITED, H5S_UNLIMITED, H5S_UNLIMITED };
 
+// target size of an mca_arr chunk when the profile picks the spectra per chunk
+const size_t H5_SPECTRA_CHUNK_BYTES = 1024 * 1024;
+
+// HDF5 default chunk cache per dataset, datasets whose reads fit in it keep the default access list
+const size_t H5_DEFAULT_CHUNK_CACHE_BYTES = 1024 * 1024;
+
+// raw chunk bytes held in memory at once by the direct chunk read
+const size_t H5_DIRECT_READ_BATCH_BYTES = 64 * 1024 * 1024;
+
+//-----------------------------------------------------------------------------
+
+H5_Write_Profile::H5_Write_Profile()
+{
+    // same filters and chunks as files written before profiles existed
+    name = "legacy";
+    compression_level = 7;
+    shuffle = false;
+    scale_offset_counts = false;
+    spectra_chunk_pixels = 1;
+    map_per_chunk = false;
+}
+
+//-----------------------------------------------------------------------------
+
+bool get_h5_write_profile(const std::string& name, H5_Write_Profile& out_profile)
+{
+    H5_Write_Profile profile;
+    if (name == "legacy")
+    {
+    }
+    else if (name == "fast")
+    {
+        profile.compression_level = 1;
+        profile.shuffle = true;
+        profile.spectra_chunk_pixels = 0;
+        profile.map_per_chunk = true;
+    }
+    else if (name == "none")
+    {
+        profile.compression_level = 0;
+        profile.spectra_chunk_pixels = 0;
+        profile.map_per_chunk = true;
+    }
+    else if (name == "small")
+    {
+        profile.compression_level = 9;
+        profile.shuffle = true;
+        profile.scale_offset_counts = true;
+        profile.spectra_chunk_pixels = 0;
+        profile.map_per_chunk = true;
+    }
+    else
+    {
+        return false;
+    }
+    profile.name = name;
+    out_profile = profile;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+std::vector<std::string> get_h5_write_profile_names()
+{
+    return { "legacy", "fast", "none", "small" };
+}
+
 std::mutex HDF5_IO::_mutex;
 
 HDF5_IO* HDF5_IO::_this_inst(nullptr);
@@ -120,6 +193,14 @@ HDF5_IO::HDF5_IO()
 	hid_t status;
     status = H5Eset_auto(H5E_DEFAULT, nullptr, nullptr);
     _cur_file_id = -1;
+
+    long long total_mem = get_total_mem();
+    _chunk_cache_budget = 256 * 1024 * 1024;
+    if (total_mem > 0)
+    {
+        _chunk_cache_budget = std::min((size_t)512 * 1024 * 1024, (size_t)(total_mem / 16));
+    }
+    _read_threads = std::max(std::thread::hardware_concurrency(), 1u);
 }
 
 //-----------------------------------------------------------------------------
@@ -214,6 +295,297 @@ bool HDF5_IO::_open_h5_object(hid_t &id, H5_OBJECTS obj, std::stack<std::pair<hi
 
 //-----------------------------------------------------------------------------
 
+static size_t next_prime(size_t val)
+{
+    val = std::max(val, (size_t)3) | 1;
+    for (;; val += 2)
+    {
+        bool prime = true;
+        for (size_t d = 3; d * d <= val; d += 2)
+        {
+            if (val % d == 0)
+            {
+                prime = false;
+                break;
+            }
+        }
+        if (prime)
+        {
+            return val;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+hid_t HDF5_IO::_create_chunk_cache_plist(hid_t dset_id, const std::vector<hsize_t>& read_count)
+{
+    hid_t dcpl_id = H5Dget_create_plist(dset_id);
+    if (dcpl_id < 0)
+    {
+        return -1;
+    }
+    if (H5Pget_layout(dcpl_id) != H5D_CHUNKED)
+    {
+        H5Pclose(dcpl_id);
+        return -1;
+    }
+
+    hid_t space_id = H5Dget_space(dset_id);
+    int rank = H5Sget_simple_extent_ndims(space_id);
+    if (rank < 1)
+    {
+        H5Sclose(space_id);
+        H5Pclose(dcpl_id);
+        return -1;
+    }
+    std::vector<hsize_t> dims(rank, 0);
+    std::vector<hsize_t> chunk_dims(rank, 1);
+    H5Sget_simple_extent_dims(space_id, dims.data(), nullptr);
+    H5Sclose(space_id);
+    int chunk_rank = H5Pget_chunk(dcpl_id, rank, chunk_dims.data());
+    H5Pclose(dcpl_id);
+    if (chunk_rank != rank)
+    {
+        return -1;
+    }
+
+    hid_t type_id = H5Dget_type(dset_id);
+    size_t chunk_bytes = H5Tget_size(type_id);
+    H5Tclose(type_id);
+
+    // chunks touched by one read of read_count (0 is the whole dimension) at any offset
+    size_t num_chunks = 1;
+    for (int i = 0; i < rank; i++)
+    {
+        chunk_bytes *= chunk_dims[i];
+        hsize_t chunks_in_dim = (dims[i] + chunk_dims[i] - 1) / chunk_dims[i];
+        hsize_t count = dims[i];
+        if (i < (int)read_count.size() && read_count[i] > 0)
+        {
+            count = std::min(read_count[i], dims[i]);
+        }
+        hsize_t chunks_per_read = (count + chunk_dims[i] - 1) / chunk_dims[i];
+        if (count < dims[i] && chunk_dims[i] > 1)
+        {
+            chunks_per_read++;
+        }
+        num_chunks *= std::max(std::min(chunks_per_read, chunks_in_dim), (hsize_t)1);
+    }
+
+    size_t cache_bytes = num_chunks * chunk_bytes;
+    if (cache_bytes <= H5_DEFAULT_CHUNK_CACHE_BYTES)
+    {
+        return -1;
+    }
+    if (cache_bytes > _chunk_cache_budget)
+    {
+        logW << "Chunk cache needs " << cache_bytes / (1024 * 1024) << " MB to read without decompressing chunks twice, limited to " << _chunk_cache_budget / (1024 * 1024) << " MB\n";
+        cache_bytes = _chunk_cache_budget;
+        num_chunks = std::max(cache_bytes / std::max(chunk_bytes, (size_t)1), (size_t)1);
+    }
+
+    hid_t dapl_id = H5Pcreate(H5P_DATASET_ACCESS);
+    // HDF5 recommends a prime number of hash slots about 100 times the chunks in the cache
+    H5Pset_chunk_cache(dapl_id, next_prime(std::min(num_chunks * 100, (size_t)16777216)), cache_bytes, H5D_CHUNK_CACHE_W0_DEFAULT);
+    return dapl_id;
+}
+
+//-----------------------------------------------------------------------------
+
+bool HDF5_IO::_open_h5_dataset_cached(hid_t &id, std::stack<std::pair<hid_t, H5_OBJECTS> > &close_map, std::string name, hid_t parent_id, const std::vector<hsize_t>& read_count)
+{
+    if (false == _open_h5_object(id, H5O_DATASET, close_map, name, parent_id))
+    {
+        return false;
+    }
+
+    hid_t dapl_id = _create_chunk_cache_plist(id, read_count);
+    if (dapl_id < 0)
+    {
+        return true;
+    }
+    // the cache size is fixed when the dataset is opened, reopen it with the sized cache
+    hid_t cached_id = H5Dopen2(parent_id, name.c_str(), dapl_id);
+    H5Pclose(dapl_id);
+    if (cached_id > -1)
+    {
+        close_map.push({ cached_id, H5O_DATASET });
+        id = cached_id;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool HDF5_IO::_read_spectra_chunks_direct(hid_t dset_id, const hsize_t* dims_in, data_struct::Spectra_Volume* spectra_volume, size_t row_idx_start, size_t row_idx_end, size_t col_idx_start, size_t col_idx_end)
+{
+#if defined(_BUILD_WITH_ZLIB) && H5_VERSION_GE(1, 10, 2)
+    // only the layouts save_spectra_volume writes: [samples][1][cols] chunks of native floats, deflate and shuffle filters
+    hid_t dcpl_id = H5Dget_create_plist(dset_id);
+    if (dcpl_id < 0)
+    {
+        return false;
+    }
+    hsize_t chunk_dims[3] = { 0,0,0 };
+    bool matches = (H5Pget_layout(dcpl_id) == H5D_CHUNKED && H5Pget_chunk(dcpl_id, 3, chunk_dims) == 3);
+    matches = matches && chunk_dims[0] == dims_in[0] && chunk_dims[1] == 1 && chunk_dims[2] > 0;
+    int shuffle_idx = -1;
+    int deflate_idx = -1;
+    int num_filters = matches ? H5Pget_nfilters(dcpl_id) : 0;
+    for (int i = 0; i < num_filters && matches; i++)
+    {
+        unsigned int flags = 0;
+        size_t cd_nelmts = 0;
+        unsigned int filter_config = 0;
+        H5Z_filter_t filter = H5Pget_filter2(dcpl_id, (unsigned)i, &flags, &cd_nelmts, nullptr, 0, nullptr, &filter_config);
+        if (filter == H5Z_FILTER_SHUFFLE && deflate_idx < 0)
+        {
+            shuffle_idx = i;
+        }
+        else if (filter == H5Z_FILTER_DEFLATE)
+        {
+            deflate_idx = i;
+        }
+        else
+        {
+            matches = false;
+        }
+    }
+    H5Pclose(dcpl_id);
+
+    hid_t type_id = H5Dget_type(dset_id);
+    matches = matches && H5Tget_class(type_id) == H5T_FLOAT && H5Tget_size(type_id) == sizeof(real_t) && H5Tget_order(type_id) == H5Tget_order(H5T_NATIVE_REAL);
+    H5Tclose(type_id);
+    if (false == matches || _read_threads < 2)
+    {
+        return false;
+    }
+
+    struct Raw_Chunk
+    {
+        size_t row;
+        size_t col;
+        uint32_t filter_mask;
+        std::vector<unsigned char> data;
+    };
+
+    const size_t samples = dims_in[0];
+    const size_t chunk_cols = chunk_dims[2];
+    const size_t chunk_bytes = samples * chunk_cols * sizeof(real_t);
+    const size_t first_chunk_col = (col_idx_start / chunk_cols) * chunk_cols;
+
+    ThreadPool tp(_read_threads);
+    std::vector<Raw_Chunk> batch;
+    size_t batch_bytes = 0;
+    std::atomic<bool> decoded(true);
+
+    auto decode_batch = [&]()
+    {
+        tp.parallel_for(0, batch.size(), [&](size_t idx)
+        {
+            Raw_Chunk& raw = batch[idx];
+            std::vector<unsigned char> inflated;
+            const unsigned char* bytes = raw.data.data();
+            if (deflate_idx > -1 && (raw.filter_mask & (1u << deflate_idx)) == 0)
+            {
+                inflated.resize(chunk_bytes);
+                uLongf dest_len = (uLongf)chunk_bytes;
+                if (uncompress(inflated.data(), &dest_len, raw.data.data(), (uLong)raw.data.size()) != Z_OK || dest_len != chunk_bytes)
+                {
+                    decoded = false;
+                    return;
+                }
+                bytes = inflated.data();
+            }
+            else if (raw.data.size() != chunk_bytes)
+            {
+                decoded = false;
+                return;
+            }
+
+            std::vector<real_t> values(samples * chunk_cols);
+            if (shuffle_idx > -1 && (raw.filter_mask & (1u << shuffle_idx)) == 0)
+            {
+                // shuffle stores byte b of every value together
+                size_t num_values = values.size();
+                unsigned char* out = (unsigned char*)values.data();
+                for (size_t b = 0; b < sizeof(real_t); b++)
+                {
+                    const unsigned char* in = bytes + (b * num_values);
+                    for (size_t v = 0; v < num_values; v++)
+                    {
+                        out[(v * sizeof(real_t)) + b] = in[v];
+                    }
+                }
+            }
+            else
+            {
+                memcpy(values.data(), bytes, chunk_bytes);
+            }
+
+            data_struct::Spectra_Line& spectra_line = (*spectra_volume)[raw.row];
+            size_t col_end = std::min(raw.col + chunk_cols, col_idx_end);
+            for (size_t col = std::max(raw.col, col_idx_start); col < col_end; col++)
+            {
+                data_struct::Spectra& spectra = spectra_line[col];
+                size_t c = col - raw.col;
+                for (size_t s = 0; s < samples; s++)
+                {
+                    spectra[s] = values[(s * chunk_cols) + c];
+                }
+            }
+        });
+        batch.clear();
+        batch_bytes = 0;
+    };
+
+    // reading raw chunks has to stay on this thread, the decompression runs on the pool
+    hsize_t offset[3] = { 0,0,0 };
+    for (size_t row = row_idx_start; row < row_idx_end && decoded; row++)
+    {
+        offset[1] = row;
+        for (size_t col = first_chunk_col; col < col_idx_end; col += chunk_cols)
+        {
+            offset[2] = col;
+            hsize_t storage_size = 0;
+            if (H5Dget_chunk_storage_size(dset_id, offset, &storage_size) < 0 || storage_size == 0)
+            {
+                // never written, the volume is already zeroed like the fill value
+                continue;
+            }
+            Raw_Chunk raw;
+            raw.row = row;
+            raw.col = col;
+            raw.filter_mask = 0;
+            raw.data.resize(storage_size);
+            if (H5Dread_chunk(dset_id, H5P_DEFAULT, offset, &raw.filter_mask, raw.data.data()) < 0)
+            {
+                logW << "Direct chunk read failed at row " << row << " col " << col << ", reading through the filter pipeline\n";
+                return false;
+            }
+            batch_bytes += storage_size;
+            batch.emplace_back(std::move(raw));
+        }
+        if (batch_bytes >= H5_DIRECT_READ_BATCH_BYTES)
+        {
+            decode_batch();
+        }
+    }
+    decode_batch();
+
+    if (false == decoded)
+    {
+        logW << "Could not decompress chunks directly, reading through the filter pipeline\n";
+    }
+    return decoded;
+#else
+    return false;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+
 bool HDF5_IO::_open_or_create_group(const std::string name, hid_t parent_id, hid_t& out_id, bool log_error, bool close_on_fail)
 {
     out_id = H5Gopen(parent_id, name.c_str(), H5P_DEFAULT);
@@ -250,7 +622,64 @@ bool HDF5_IO::_create_memory_space(int rank, const hsize_t* count, hid_t& out_id
 
 //-----------------------------------------------------------------------------
 
-bool HDF5_IO::_open_h5_dataset(const std::string& name, hid_t data_type, hid_t parent_id, int dims_size, const hsize_t* dims, const hsize_t* chunk_dims, hid_t& out_id, hid_t& out_dataspece)
+hid_t HDF5_IO::_create_dataset_plist(H5_DATASET_KINDS kind, int dims_size, const hsize_t* dims, const hsize_t* chunk_dims)
+{
+    hsize_t profile_chunk[3] = { 1, 1, 1 };
+    for (int i = 0; i < dims_size; i++)
+    {
+        profile_chunk[i] = chunk_dims[i];
+    }
+
+    if (kind == H5D_SPECTRA_VOLUME && dims_size == 3 && _write_profile.spectra_chunk_pixels != 1)
+    {
+        // [samples][rows][cols], group neighbouring spectra of a row so a row write fills whole chunks
+        hsize_t pixels = _write_profile.spectra_chunk_pixels;
+        if (pixels == 0)
+        {
+            pixels = H5_SPECTRA_CHUNK_BYTES / (std::max(dims[0], (hsize_t)1) * sizeof(real_t));
+        }
+        profile_chunk[0] = std::max(dims[0], (hsize_t)1);
+        profile_chunk[1] = 1;
+        profile_chunk[2] = std::max(std::min(pixels, dims[2]), (hsize_t)1);
+    }
+    else if (kind == H5D_MAPS && dims_size > 1 && _write_profile.map_per_chunk)
+    {
+        for (int i = 0; i < dims_size - 2; i++)
+        {
+            profile_chunk[i] = 1;
+        }
+        profile_chunk[dims_size - 2] = std::max(dims[dims_size - 2], (hsize_t)1);
+        profile_chunk[dims_size - 1] = std::max(dims[dims_size - 1], (hsize_t)1);
+    }
+
+    hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(dcpl_id, dims_size, profile_chunk);
+    // filters run in the order they are added: scale-offset, shuffle, deflate
+    if (kind == H5D_SPECTRA_VOLUME && _write_profile.scale_offset_counts)
+    {
+        if (H5Zfilter_avail(H5Z_FILTER_SCALEOFFSET) > 0)
+        {
+            H5Pset_scaleoffset(dcpl_id, H5Z_SO_FLOAT_DSCALE, 0);
+        }
+        else
+        {
+            logW << "HDF5 library has no scale-offset filter, saving counts without it\n";
+        }
+    }
+    if (_write_profile.shuffle)
+    {
+        H5Pset_shuffle(dcpl_id);
+    }
+    if (_write_profile.compression_level > 0)
+    {
+        H5Pset_deflate(dcpl_id, std::min(_write_profile.compression_level, 9));
+    }
+    return dcpl_id;
+}
+
+//-----------------------------------------------------------------------------
+
+bool HDF5_IO::_open_h5_dataset(const std::string& name, hid_t data_type, hid_t parent_id, int dims_size, const hsize_t* dims, const hsize_t* chunk_dims, hid_t& out_id, hid_t& out_dataspece, H5_DATASET_KINDS kind)
 {
     out_id = H5Dopen(parent_id, name.c_str(), H5P_DEFAULT);
     if (out_id < 0)
@@ -274,9 +703,7 @@ bool HDF5_IO::_open_h5_dataset(const std::string& name, hid_t data_type, hid_t p
         out_dataspece = H5Screate_simple(dims_size, dims, max_dims);
         _global_close_map.push({ out_dataspece, H5O_DATASPACE });
 
-        hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
-        H5Pset_chunk(dcpl_id, dims_size, chunk_dims);
-        H5Pset_deflate(dcpl_id, 7);
+        hid_t dcpl_id = _create_dataset_plist(kind, dims_size, dims, chunk_dims);
         _global_close_map.push({ dcpl_id, H5O_PROPERTY });
 
         out_id = H5Dcreate(parent_id, name.c_str(), data_type, out_dataspece, H5P_DEFAULT, dcpl_id, H5P_DEFAULT);
@@ -438,27 +865,27 @@ bool HDF5_IO::load_spectra_volume(std::string path, size_t detector_num, data_st
     if ( false == _open_h5_object(maps_grp_id, H5O_GROUP, close_map, "MAPS_RAW", file_id) )
        return false;
 
-    if ( false == _open_h5_object(dset_id, H5O_DATASET, close_map, detector_path, maps_grp_id) )
+    if ( false == _open_h5_dataset_cached(dset_id, close_map, detector_path, maps_grp_id, {0, 1, 0}) )
        return false;
     dataspace_id = H5Dget_space(dset_id);
     close_map.push({dataspace_id, H5O_DATASPACE});
 
-    if ( false == _open_h5_object(dset_lt_id, H5O_DATASET, close_map, "livetime", maps_grp_id) )
+    if ( false == _open_h5_dataset_cached(dset_lt_id, close_map, "livetime", maps_grp_id, {1, 1, 0}) )
        return false;
     dataspace_lt_id = H5Dget_space(dset_lt_id);
     close_map.push({dataspace_lt_id, H5O_DATASPACE});
 
-    if ( false == _open_h5_object(dset_rt_id, H5O_DATASET, close_map, "realtime", maps_grp_id) )
+    if ( false == _open_h5_dataset_cached(dset_rt_id, close_map, "realtime", maps_grp_id, {1, 1, 0}) )
        return false;
     dataspace_rt_id = H5Dget_space(dset_rt_id);
     close_map.push({dataspace_rt_id, H5O_DATASPACE});
 
-    if ( false == _open_h5_object(dset_incnt_id, H5O_DATASET, close_map, "inputcounts", maps_grp_id) )
+    if ( false == _open_h5_dataset_cached(dset_incnt_id, close_map, "inputcounts", maps_grp_id, {1, 1, 0}) )
        return false;
     dataspace_inct_id = H5Dget_space(dset_incnt_id);
     close_map.push({dataspace_inct_id, H5O_DATASPACE});
 
-    if ( false == _open_h5_object(dset_outcnt_id, H5O_DATASET, close_map, "ouputcounts", maps_grp_id) )
+    if ( false == _open_h5_dataset_cached(dset_outcnt_id, close_map, "ouputcounts", maps_grp_id, {1, 1, 0}) )
        return false;
     dataspace_outct_id = H5Dget_space(dset_outcnt_id);
     close_map.push({dataspace_outct_id, H5O_DATASPACE});
@@ -585,58 +1012,277 @@ bool HDF5_IO::load_spectra_volume(std::string path, size_t detector_num, data_st
 
 //-----------------------------------------------------------------------------
 
-bool HDF5_IO::load_spectra_line_xspress3(std::string path, size_t detector_num, data_struct::Spectra_Line* spec_row)
+bool HDF5_IO::load_spectra_volumes(std::string path, const std::vector<size_t>& detector_num_arr, std::vector<data_struct::Spectra_Volume*>* spec_vols, bool add_to_volumes)
 {
     std::lock_guard<std::mutex> lock(_mutex);
 
-   //_is_loaded = ERROR_LOADING;
-   std::chrono::time_point<std::chrono::system_clock> start, end;
-   start = std::chrono::system_clock::now();
-
-   logI<< path <<" detector : "<<detector_num<<"\n";
-
-   std::stack<std::pair<hid_t, H5_OBJECTS> > close_map;
-   hid_t    file_id, dset_id, dataspace_id, maps_grp_id, scaler_grp_id, memoryspace_id, memoryspace_meta_id, dset_lt_id;
-   //hid_t    dset_incnt_id, dset_outcnt_id, dset_rt_id;
-   hid_t    dataspace_lt_id;
-  //hid_t dataspace_inct_id, dataspace_outct_id;
-   herr_t   error;
-   std::string detector_path;
-   real_t * buffer;
-   hsize_t offset_row[3] = {0,0,0};
-   hsize_t count_row[3] = {0,0,0};
-   hsize_t offset_meta[1] = {0};
-   hsize_t count_meta[1] = {1};
-
-   std::string live_time_dataset_name = "CHAN" + std::to_string(detector_num+1) + "SCA0";
-   //std::string real_time_dataset_name = "CHAN" + std::to_string(detector_num+1) + "EventWidth";
+    std::chrono::time_point<std::chrono::system_clock> start, end;
+    start = std::chrono::system_clock::now();
 
+    std::stack<std::pair<hid_t, H5_OBJECTS> > close_map;
 
-    if ( false == _open_h5_object(file_id, H5O_FILE, close_map, path, -1) )
-       return false;
+    if (spec_vols == nullptr || detector_num_arr.size() == 0 || spec_vols->size() != detector_num_arr.size())
+    {
+        logE << "Need one spectra volume per detector\n";
+        return false;
+    }
 
-    if ( false == _open_h5_object(maps_grp_id, H5O_GROUP, close_map, "/entry/data", file_id) )
-      return false;
+    logI << path << " detectors : " << detector_num_arr.size() << "\n";
 
-    if ( false == _open_h5_object(scaler_grp_id, H5O_GROUP, close_map, "/entry/instrument/NDAttributes", file_id) )
-      return false;
+    hid_t    file_id, maps_grp_id, memoryspace_id, memoryspace_meta_id;
+    herr_t   error;
+    const char* meta_names[4] = { "livetime", "realtime", "inputcounts", "ouputcounts" };
+    hid_t meta_ids[4];
+    hid_t meta_space_ids[4];
+    std::vector<hid_t> dset_ids(detector_num_arr.size());
+    std::vector<hid_t> dataspace_ids(detector_num_arr.size());
+    hsize_t dims_in[3] = { 0,0,0 };
+    hsize_t offset[3] = { 0,0,0 };
+    hsize_t count[3] = { 0,0,0 };
+    hsize_t offset_row[2] = { 0,0 };
+    hsize_t count_row[2] = { 0,0 };
+    hsize_t meta_dims[3] = { 0,0,0 };
+    hsize_t offset_meta[3] = { 0,0,0 };
+    hsize_t count_meta[3] = { 1,1,1 };
 
-    if ( false == _open_h5_object(dset_id, H5O_DATASET, close_map, "data", maps_grp_id) )
-      return false;
-    dataspace_id = H5Dget_space(dset_id);
-    close_map.push({dataspace_id, H5O_DATASPACE});
+    if (false == _open_h5_object(file_id, H5O_FILE, close_map, path, -1))
+        return false;
 
-    if ( false == _open_h5_object(dset_lt_id, H5O_DATASET, close_map, live_time_dataset_name, scaler_grp_id) )
-      return false;
-    dataspace_lt_id = H5Dget_space(dset_lt_id);
-    close_map.push({dataspace_lt_id, H5O_DATASPACE});
+    if (false == _open_h5_object(maps_grp_id, H5O_GROUP, close_map, "MAPS_RAW", file_id))
+        return false;
 
-    int rank = H5Sget_simple_extent_ndims(dataspace_id);
-    if (rank != 3)
+    size_t min_detector = detector_num_arr[0];
+    size_t max_detector = detector_num_arr[0];
+    for (size_t d = 0; d < detector_num_arr.size(); d++)
     {
-        _close_h5_objects(close_map);
-        logW<<"Dataset /MAPS_RAW/"<<detector_path<<" rank != 3. rank = "<<rank<<". Can't load dataset. returning"<<"\n";
-        return false;
+        std::string detector_path;
+        switch (detector_num_arr[d])
+        {
+        case 0:
+            detector_path = "data_a";
+            break;
+        case 1:
+            detector_path = "data_b";
+            break;
+        case 2:
+            detector_path = "data_c";
+            break;
+        case 3:
+            detector_path = "data_d";
+            break;
+        default:
+            detector_path = "";
+            break;
+        }
+        if (false == _open_h5_dataset_cached(dset_ids[d], close_map, detector_path, maps_grp_id, {0, 1, 0}))
+            return false;
+        dataspace_ids[d] = H5Dget_space(dset_ids[d]);
+        close_map.push({ dataspace_ids[d], H5O_DATASPACE });
+
+        hsize_t det_dims[3] = { 0,0,0 };
+        int rank = H5Sget_simple_extent_ndims(dataspace_ids[d]);
+        if (rank != 3 || H5Sget_simple_extent_dims(dataspace_ids[d], &det_dims[0], nullptr) < 0)
+        {
+            _close_h5_objects(close_map);
+            logW << "Dataset /MAPS_RAW/" << detector_path << " rank != 3. rank = " << rank << ". Can't load dataset. returning" << "\n";
+            return false;
+        }
+        if (d == 0)
+        {
+            dims_in[0] = det_dims[0];
+            dims_in[1] = det_dims[1];
+            dims_in[2] = det_dims[2];
+        }
+        else if (det_dims[0] != dims_in[0] || det_dims[2] != dims_in[2])
+        {
+            _close_h5_objects(close_map);
+            logW << "Dataset /MAPS_RAW/" << detector_path << " does not have the same size as the other detectors. returning" << "\n";
+            return false;
+        }
+        min_detector = std::min(min_detector, detector_num_arr[d]);
+        max_detector = std::max(max_detector, detector_num_arr[d]);
+    }
+
+    for (int m = 0; m < 4; m++)
+    {
+        if (false == _open_h5_dataset_cached(meta_ids[m], close_map, meta_names[m], maps_grp_id, {0, 1, 0}))
+            return false;
+        meta_space_ids[m] = H5Dget_space(meta_ids[m]);
+        close_map.push({ meta_space_ids[m], H5O_DATASPACE });
+    }
+    if (H5Sget_simple_extent_ndims(meta_space_ids[0]) != 3 || H5Sget_simple_extent_dims(meta_space_ids[0], &meta_dims[0], nullptr) < 0)
+    {
+        _close_h5_objects(close_map);
+        logW << "Dataset /MAPS_RAW/livetime rank != 3. Can't load dataset. returning" << "\n";
+        return false;
+    }
+
+    size_t rows = (*spec_vols)[0]->rows();
+    size_t cols = (*spec_vols)[0]->cols();
+    for (const auto& spec_vol : *spec_vols)
+    {
+        rows = std::min(rows, spec_vol->rows());
+        cols = std::min(cols, spec_vol->cols());
+    }
+    rows = std::min(rows, (size_t)dims_in[1]);
+    cols = std::min(cols, (size_t)dims_in[2]);
+    size_t meta_cols = std::min(cols, (size_t)meta_dims[2]);
+
+    // one row of every detector, and the meta data of all requested detectors for that row
+    real_t* buffer = new real_t[dims_in[0] * dims_in[2]]; // spectra_size x cols
+    size_t num_meta_detectors = max_detector - min_detector + 1;
+    std::vector<real_t> meta_buffer[4];
+    for (int m = 0; m < 4; m++)
+    {
+        meta_buffer[m].resize(num_meta_detectors * meta_cols, 1.0);
+    }
+
+    count[0] = dims_in[0];
+    count[1] = 1; //1 row
+    count[2] = dims_in[2];
+    count_row[0] = dims_in[0];
+    count_row[1] = dims_in[2];
+    offset_meta[0] = min_detector;
+    count_meta[0] = num_meta_detectors;
+    count_meta[2] = meta_cols;
+
+    memoryspace_id = H5Screate_simple(2, count_row, nullptr);
+    close_map.push({ memoryspace_id, H5O_DATASPACE });
+    memoryspace_meta_id = H5Screate_simple(3, count_meta, nullptr);
+    close_map.push({ memoryspace_meta_id, H5O_DATASPACE });
+    H5Sselect_hyperslab(memoryspace_id, H5S_SELECT_SET, offset_row, nullptr, count_row, nullptr);
+
+    for (size_t row = 0; row < rows; row++)
+    {
+        offset[1] = row;
+        offset_meta[1] = row;
+
+        if (meta_cols > 0)
+        {
+            for (int m = 0; m < 4; m++)
+            {
+                H5Sselect_hyperslab(meta_space_ids[m], H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
+                error = H5Dread(meta_ids[m], H5T_NATIVE_REAL, memoryspace_meta_id, meta_space_ids[m], H5P_DEFAULT, meta_buffer[m].data());
+                if (error < 0)
+                {
+                    logE << "reading " << meta_names[m] << " row " << row << "\n";
+                }
+            }
+        }
+
+        for (size_t d = 0; d < detector_num_arr.size(); d++)
+        {
+            H5Sselect_hyperslab(dataspace_ids[d], H5S_SELECT_SET, offset, nullptr, count, nullptr);
+            error = H5Dread(dset_ids[d], H5T_NATIVE_REAL, memoryspace_id, dataspace_ids[d], H5P_DEFAULT, buffer);
+            if (error < 0)
+            {
+                logE << "reading row " << row << " detector " << detector_num_arr[d] << "\n";
+                continue;
+            }
+
+            size_t meta_idx = (detector_num_arr[d] - min_detector) * meta_cols;
+            data_struct::Spectra_Volume* spec_vol = (*spec_vols)[d];
+            for (size_t col = 0; col < cols; col++)
+            {
+                data_struct::Spectra* spectra = &((*spec_vol)[row][col]);
+                size_t samples = std::min((size_t)count_row[0], (size_t)spectra->size());
+                if (add_to_volumes)
+                {
+                    if (col < meta_cols)
+                    {
+                        // same as Spectra::add(), times that are not finite are left out of the sum
+                        real_t meta[4] = { meta_buffer[0][meta_idx + col], meta_buffer[1][meta_idx + col], meta_buffer[2][meta_idx + col], meta_buffer[3][meta_idx + col] };
+                        spectra->elapsed_livetime(spectra->elapsed_livetime() + (std::isfinite(meta[0]) ? meta[0] : (real_t)0.0));
+                        spectra->elapsed_realtime(spectra->elapsed_realtime() + (std::isfinite(meta[1]) ? meta[1] : (real_t)0.0));
+                        spectra->input_counts(spectra->input_counts() + (std::isfinite(meta[2]) ? meta[2] : (real_t)0.0));
+                        spectra->output_counts(spectra->output_counts() + (std::isfinite(meta[3]) ? meta[3] : (real_t)0.0));
+                    }
+                    // the row buffer is spectra_size x cols, add the column of this pixel straight from it
+                    spectra->head(samples) += Eigen::Map<const data_struct::ArrayXr, 0, Eigen::InnerStride<> >(buffer + col, samples, Eigen::InnerStride<>(count_row[1]));
+                    continue;
+                }
+                if (col < meta_cols)
+                {
+                    spectra->elapsed_livetime(meta_buffer[0][meta_idx + col]);
+                    spectra->elapsed_realtime(meta_buffer[1][meta_idx + col]);
+                    spectra->input_counts(meta_buffer[2][meta_idx + col]);
+                    spectra->output_counts(meta_buffer[3][meta_idx + col]);
+                    spectra->recalc_elapsed_livetime();
+                }
+
+                for (size_t s = 0; s < samples; s++)
+                {
+                    (*spectra)[s] = buffer[(count_row[1] * s) + col];
+                }
+            }
+        }
+    }
+
+    delete[] buffer;
+
+    _close_h5_objects(close_map);
+
+    end = std::chrono::system_clock::now();
+    std::chrono::duration<double> elapsed_seconds = end - start;
+
+    logI << "elapsed time: " << elapsed_seconds.count() << "s" << "\n";
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool HDF5_IO::load_spectra_line_xspress3(std::string path, size_t detector_num, data_struct::Spectra_Line* spec_row)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+   //_is_loaded = ERROR_LOADING;
+   std::chrono::time_point<std::chrono::system_clock> start, end;
+   start = std::chrono::system_clock::now();
+
+   logI<< path <<" detector : "<<detector_num<<"\n";
+
+   std::stack<std::pair<hid_t, H5_OBJECTS> > close_map;
+   hid_t    file_id, dset_id, dataspace_id, maps_grp_id, scaler_grp_id, memoryspace_id, memoryspace_meta_id, dset_lt_id;
+   //hid_t    dset_incnt_id, dset_outcnt_id, dset_rt_id;
+   hid_t    dataspace_lt_id;
+  //hid_t dataspace_inct_id, dataspace_outct_id;
+   herr_t   error;
+   std::string detector_path;
+   real_t * buffer;
+   hsize_t offset_row[3] = {0,0,0};
+   hsize_t count_row[3] = {0,0,0};
+   hsize_t offset_meta[1] = {0};
+   hsize_t count_meta[1] = {1};
+
+   std::string live_time_dataset_name = "CHAN" + std::to_string(detector_num+1) + "SCA0";
+   //std::string real_time_dataset_name = "CHAN" + std::to_string(detector_num+1) + "EventWidth";
+
+
+    if ( false == _open_h5_object(file_id, H5O_FILE, close_map, path, -1) )
+       return false;
+
+    if ( false == _open_h5_object(maps_grp_id, H5O_GROUP, close_map, "/entry/data", file_id) )
+      return false;
+
+    if ( false == _open_h5_object(scaler_grp_id, H5O_GROUP, close_map, "/entry/instrument/NDAttributes", file_id) )
+      return false;
+
+    if ( false == _open_h5_object(dset_id, H5O_DATASET, close_map, "data", maps_grp_id) )
+      return false;
+    dataspace_id = H5Dget_space(dset_id);
+    close_map.push({dataspace_id, H5O_DATASPACE});
+
+    if ( false == _open_h5_object(dset_lt_id, H5O_DATASET, close_map, live_time_dataset_name, scaler_grp_id) )
+      return false;
+    dataspace_lt_id = H5Dget_space(dset_lt_id);
+    close_map.push({dataspace_lt_id, H5O_DATASPACE});
+
+    int rank = H5Sget_simple_extent_ndims(dataspace_id);
+    if (rank != 3)
+    {
+        _close_h5_objects(close_map);
+        logW<<"Dataset /MAPS_RAW/"<<detector_path<<" rank != 3. rank = "<<rank<<". Can't load dataset. returning"<<"\n";
+        return false;
        //throw exception ("Dataset is not a volume");
     }
     hsize_t* dims_in = new hsize_t[rank];
@@ -2886,27 +3532,28 @@ bool HDF5_IO::load_spectra_vol_analyzed_h5(std::string path,
    if ( false == _open_h5_object(spec_grp_id, H5O_GROUP, close_map, "/MAPS/Spectra", file_id) )
       return false;
 
-   if ( false == _open_h5_object(dset_id, H5O_DATASET, close_map, "mca_arr", spec_grp_id) )
+   // rows are read one at a time, size the chunk caches so each chunk is decompressed once
+   if ( false == _open_h5_dataset_cached(dset_id, close_map, "mca_arr", spec_grp_id, {0, 1, 0}) )
       return false;
    dataspace_id = H5Dget_space(dset_id);
    close_map.push({dataspace_id, H5O_DATASPACE});
 
-   if ( false == _open_h5_object(dset_lt_id, H5O_DATASET, close_map, "Elapsed_Livetime", spec_grp_id) )
+   if ( false == _open_h5_dataset_cached(dset_lt_id, close_map, "Elapsed_Livetime", spec_grp_id, {1, 0}) )
       return false;
    dataspace_lt_id = H5Dget_space(dset_lt_id);
    close_map.push({dataspace_lt_id, H5O_DATASPACE});
 
-   if ( false == _open_h5_object(dset_rt_id, H5O_DATASET, close_map, "Elapsed_Realtime", spec_grp_id) )
+   if ( false == _open_h5_dataset_cached(dset_rt_id, close_map, "Elapsed_Realtime", spec_grp_id, {1, 0}) )
       return false;
    dataspace_rt_id = H5Dget_space(dset_rt_id);
    close_map.push({dataspace_rt_id, H5O_DATASPACE});
 
-   if ( false == _open_h5_object(dset_incnt_id, H5O_DATASET, close_map, "Input_Counts", spec_grp_id) )
+   if ( false == _open_h5_dataset_cached(dset_incnt_id, close_map, "Input_Counts", spec_grp_id, {1, 0}) )
       return false;
    dataspace_inct_id = H5Dget_space(dset_incnt_id);
    close_map.push({dataspace_inct_id, H5O_DATASPACE});
 
-   if ( false == _open_h5_object(dset_outcnt_id, H5O_DATASET, close_map, "Output_Counts", spec_grp_id) )
+   if ( false == _open_h5_dataset_cached(dset_outcnt_id, close_map, "Output_Counts", spec_grp_id, {1, 0}) )
       return false;
    dataspace_outct_id = H5Dget_space(dset_outcnt_id);
    close_map.push({dataspace_outct_id, H5O_DATASPACE});
@@ -2948,58 +3595,79 @@ bool HDF5_IO::load_spectra_vol_analyzed_h5(std::string path,
 
     spectra_volume->resize_and_zero(dims_in[1], dims_in[2], dims_in[0]);
 
-    //buffer = new real_t [dims_in[0] * dims_in[2]]; // cols x spectra_size
+    row_idx_end = std::min(row_idx_end, (int)dims_in[1]);
+    col_idx_end = std::min(col_idx_end, (int)dims_in[2]);
+    if (row_idx_start >= row_idx_end || col_idx_start >= col_idx_end)
+    {
+        _close_h5_objects(close_map);
+        return true;
+    }
+    size_t num_cols = (size_t)(col_idx_end - col_idx_start);
+
+    // read a whole row per call instead of one pixel at a time
+    real_t* buffer = new real_t[dims_in[0] * num_cols]; // spectra_size x cols
+    std::vector<real_t> real_time(num_cols, 1.0);
+    std::vector<real_t> live_time(num_cols, 1.0);
+    std::vector<real_t> in_cnt(num_cols, 1.0);
+    std::vector<real_t> out_cnt(num_cols, 1.0);
+
     count[0] = dims_in[0];
     count[1] = 1;
-    count[2] = 1;
+    count[2] = num_cols;
+    offset[2] = col_idx_start;
+    count_time[1] = num_cols;
+    offset_time[1] = col_idx_start;
 
-    memoryspace_id = H5Screate_simple(3, count, nullptr);
-    memoryspace_meta_id = H5Screate_simple(2, count_time, nullptr);
-    H5Sselect_hyperslab (memoryspace_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
-    H5Sselect_hyperslab (memoryspace_meta_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-
-    real_t live_time = 1.0;
-    real_t real_time = 1.0;
-    real_t in_cnt = 1.0;
-    real_t out_cnt = 1.0;
+    hsize_t count_mem[2] = { dims_in[0], num_cols };
+    memoryspace_id = H5Screate_simple(2, count_mem, nullptr);
+    close_map.push({ memoryspace_id, H5O_DATASPACE });
+    memoryspace_meta_id = H5Screate_simple(1, &count_time[1], nullptr);
+    close_map.push({ memoryspace_meta_id, H5O_DATASPACE });
 
-    //offset[1] = row;
+    // decompress the spectra chunks in parallel when the layout allows it
+    bool read_direct = _read_spectra_chunks_direct(dset_id, dims_in, spectra_volume, row_idx_start, row_idx_end, col_idx_start, col_idx_end);
 
     for(size_t row=(size_t)row_idx_start; row < (size_t)row_idx_end; row++)
     {
         offset[1] = row;
         offset_time[0] = row;
-        for(size_t col=(size_t)col_idx_start; col < (size_t)col_idx_end; col++)
+        if (false == read_direct)
         {
-            data_struct::Spectra *spectra = &((*spectra_volume)[row][col]);
-            offset[2] = col;
-            offset_time[1] = col;
             H5Sselect_hyperslab (dataspace_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
+            error = H5Dread(dset_id, H5T_NATIVE_REAL, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)buffer);
+            if (error < 0)
+            {
+                logW << "Counld not read row " << row << "\n";
+                continue;
+            }
+        }
 
-            //error = H5Dread (dset_id, H5T_NATIVE_REAL, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)&(*spectra)[0]);
-			error = H5Dread(dset_id, H5T_NATIVE_REAL, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)spectra->data());
-			if (error > 0)
-			{
-				logW << "Counld not read row " << row << " col " << col << "\n";
-			}
-
-            H5Sselect_hyperslab (dataspace_lt_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-            H5Sselect_hyperslab (dataspace_rt_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-            H5Sselect_hyperslab (dataspace_inct_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-            H5Sselect_hyperslab (dataspace_outct_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
+        H5Sselect_hyperslab (dataspace_lt_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
+        H5Sselect_hyperslab (dataspace_rt_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
+        H5Sselect_hyperslab (dataspace_inct_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
+        H5Sselect_hyperslab (dataspace_outct_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
 
-            error = H5Dread (dset_rt_id, H5T_NATIVE_REAL, memoryspace_meta_id, dataspace_rt_id, H5P_DEFAULT, (void*)&real_time);
-            error = H5Dread (dset_lt_id, H5T_NATIVE_REAL, memoryspace_meta_id, dataspace_lt_id, H5P_DEFAULT, (void*)&live_time);
-            error = H5Dread (dset_incnt_id, H5T_NATIVE_REAL, memoryspace_meta_id, dataspace_inct_id, H5P_DEFAULT, (void*)&in_cnt);
-            error = H5Dread (dset_outcnt_id, H5T_NATIVE_REAL, memoryspace_meta_id, dataspace_outct_id, H5P_DEFAULT, (void*)&out_cnt);
+        error = H5Dread (dset_rt_id, H5T_NATIVE_REAL, memoryspace_meta_id, dataspace_rt_id, H5P_DEFAULT, (void*)real_time.data());
+        error = H5Dread (dset_lt_id, H5T_NATIVE_REAL, memoryspace_meta_id, dataspace_lt_id, H5P_DEFAULT, (void*)live_time.data());
+        error = H5Dread (dset_incnt_id, H5T_NATIVE_REAL, memoryspace_meta_id, dataspace_inct_id, H5P_DEFAULT, (void*)in_cnt.data());
+        error = H5Dread (dset_outcnt_id, H5T_NATIVE_REAL, memoryspace_meta_id, dataspace_outct_id, H5P_DEFAULT, (void*)out_cnt.data());
 
-            spectra->elapsed_livetime(live_time);
-            spectra->elapsed_realtime(real_time);
-            spectra->input_counts(in_cnt);
-            spectra->output_counts(out_cnt);
+        for(size_t c = 0; c < num_cols; c++)
+        {
+            data_struct::Spectra *spectra = &((*spectra_volume)[row][col_idx_start + c]);
+            for (size_t s = 0; s < dims_in[0] && false == read_direct; s++)
+            {
+                (*spectra)[s] = buffer[(num_cols * s) + c];
+            }
+            spectra->elapsed_livetime(live_time[c]);
+            spectra->elapsed_realtime(real_time[c]);
+            spectra->input_counts(in_cnt[c]);
+            spectra->output_counts(out_cnt[c]);
         }
     }
 
+    delete[] buffer;
+
     _close_h5_objects(close_map);
 
     end = std::chrono::system_clock::now();
@@ -4272,10 +4940,12 @@ bool HDF5_IO::save_spectra_volume(const std::string path,
     dims_out[2] = spectra_volume->cols();
     offset[0] = 0;
     offset[1] = 0;
-    offset[2] = 0;
+    offset[2] = col_idx_start;
+    // write a row at a time, a per spectra write would read and recompress a multi pixel chunk every time
+    size_t row_cols = (size_t)col_idx_end - col_idx_start;
     count[0] = dims_out[0];
     count[1] = 1;
-    count[2] = 1;
+    count[2] = row_cols;
     chunk_dims[0] = dims_out[0];
     chunk_dims[1] = 1;
     chunk_dims[2] = 1;
@@ -4287,14 +4957,19 @@ bool HDF5_IO::save_spectra_volume(const std::string path,
     chunk_dims_times[1] = 1;
 
     offset_time[0] = 0;
-    offset_time[1] = 0;
+    offset_time[1] = col_idx_start;
     count_time[0] = 1;
-    count_time[1] = 1;
-
-    _create_memory_space(3, count, memoryspace_id);
-    _create_memory_space(2, count_time, memoryspace_time_id);
+    count_time[1] = row_cols;
 
-    H5Sselect_hyperslab (memoryspace_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
+    if (row_cols == 0)
+    {
+        logW << "No columns to save for " << path << "\n";
+    }
+    else
+    {
+        _create_memory_space(3, count, memoryspace_id);
+        _create_memory_space(2, count_time, memoryspace_time_id);
+    }
 
     // open /MAPS
     if(false == _open_or_create_group(STR_MAPS, _cur_file_id, maps_grp_id))
@@ -4309,85 +4984,89 @@ bool HDF5_IO::save_spectra_volume(const std::string path,
     }
 
 	// try to open mca dataset and expand before creating 
-    if (false == _open_h5_dataset(path, H5T_INTEL_R, spec_grp_id, 3, dims_out, chunk_dims, dset_id, dataspace_id))
+    if (false == _open_h5_dataset(path, H5T_INTEL_R, spec_grp_id, 3, dims_out, chunk_dims, dset_id, dataspace_id, H5D_SPECTRA_VOLUME))
     {
         logE << "Error creating " << path << "\n";
         return false;
     }
 
-    if (false == _open_h5_dataset(STR_ELAPSED_REAL_TIME, H5T_INTEL_R, spec_grp_id, 2, dims_time_out, chunk_dims_times, dset_rt_id, dataspace_rt_id))
+    if (false == _open_h5_dataset(STR_ELAPSED_REAL_TIME, H5T_INTEL_R, spec_grp_id, 2, dims_time_out, chunk_dims_times, dset_rt_id, dataspace_rt_id, H5D_MAPS))
     {
         logE << "Error creating " << path << "\n";
         return false;
     }
-    if (false == _open_h5_dataset(STR_ELAPSED_LIVE_TIME, H5T_INTEL_R, spec_grp_id, 2, dims_time_out, chunk_dims_times, dset_lt_id, dataspace_lt_id))
+    if (false == _open_h5_dataset(STR_ELAPSED_LIVE_TIME, H5T_INTEL_R, spec_grp_id, 2, dims_time_out, chunk_dims_times, dset_lt_id, dataspace_lt_id, H5D_MAPS))
     {
         logE << "Error creating " << path << "\n";
         return false;
     }
-    if (false == _open_h5_dataset(STR_INPUT_COUNTS, H5T_INTEL_R, spec_grp_id, 2, dims_time_out, chunk_dims_times, incnt_dset_id, dataspace_incr_id))
+    if (false == _open_h5_dataset(STR_INPUT_COUNTS, H5T_INTEL_R, spec_grp_id, 2, dims_time_out, chunk_dims_times, incnt_dset_id, dataspace_incr_id, H5D_MAPS))
     {
         logE << "Error creating " << path << "\n";
         return false;
     }
-    if (false == _open_h5_dataset(STR_OUTPUT_COUNTS, H5T_INTEL_R, spec_grp_id, 2, dims_time_out, chunk_dims_times, outcnt_dset_id, dataspace_ocr_id))
+    if (false == _open_h5_dataset(STR_OUTPUT_COUNTS, H5T_INTEL_R, spec_grp_id, 2, dims_time_out, chunk_dims_times, outcnt_dset_id, dataspace_ocr_id, H5D_MAPS))
     {
         logE << "Error creating " << path << "\n";
         return false;
     }
 
-    H5Sselect_hyperslab (memoryspace_time_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-
-    real_t real_time;
-    real_t life_time;
-    real_t in_cnt;
-    real_t out_cnt;
-    for(size_t row=row_idx_start; row < (size_t)row_idx_end; row++)
+    // mca_arr is [samples][rows][cols] so a row is written sample major
+    size_t samples = dims_out[0];
+    std::vector<real_t> row_buffer(row_cols > 0 ? samples * row_cols : 0);
+    std::vector<real_t> real_time(row_cols);
+    std::vector<real_t> life_time(row_cols);
+    std::vector<real_t> in_cnt(row_cols);
+    std::vector<real_t> out_cnt(row_cols);
+    for(size_t row=row_idx_start; row < (size_t)row_idx_end && row_cols > 0; row++)
     {
         offset[1] = row;
         offset_time[0] = row;
-        for(size_t col=col_idx_start; col < (size_t)col_idx_end; col++)
+        const data_struct::Spectra_Line& spectra_line = (*spectra_volume)[row];
+        for(size_t c = 0; c < row_cols; c++)
         {
-            const data_struct::Spectra *spectra = &((*spectra_volume)[row][col]);
-            offset[2] = col;
-            offset_time[1] = col;
-            H5Sselect_hyperslab (dataspace_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
-
-            status = H5Dwrite (dset_id, H5T_NATIVE_REAL, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)&(*spectra)[0]);
-            if (status < 0)
+            const data_struct::Spectra *spectra = &spectra_line[col_idx_start + c];
+            for (size_t s = 0; s < samples; s++)
             {
-                logE << " H5Dwrite failed to write spectra\n";
+                row_buffer[(s * row_cols) + c] = (*spectra)[s];
             }
+            real_time[c] = spectra->elapsed_realtime();
+            life_time[c] = spectra->elapsed_livetime();
+            in_cnt[c] = spectra->input_counts();
+            out_cnt[c] = spectra->output_counts();
+        }
 
-            H5Sselect_hyperslab (dataspace_rt_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-            H5Sselect_hyperslab(dataspace_lt_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-            H5Sselect_hyperslab(dataspace_incr_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-            H5Sselect_hyperslab(dataspace_ocr_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
+        H5Sselect_hyperslab (dataspace_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
+        status = H5Dwrite (dset_id, H5T_NATIVE_REAL, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)&row_buffer[0]);
+        if (status < 0)
+        {
+            logE << " H5Dwrite failed to write spectra\n";
+        }
 
-            real_time = spectra->elapsed_realtime();
-            life_time = spectra->elapsed_livetime();
-            in_cnt = spectra->input_counts();
-            out_cnt = spectra->output_counts();
-            status = H5Dwrite (dset_rt_id, H5T_NATIVE_REAL, memoryspace_time_id, dataspace_rt_id, H5P_DEFAULT, (void*)&real_time);
-            if (status < 0)
-            {
-                logE << " H5Dwrite failed to write "<< STR_ELAPSED_REAL_TIME<< "\n";
-            }
-            status = H5Dwrite (dset_lt_id, H5T_NATIVE_REAL, memoryspace_time_id, dataspace_lt_id, H5P_DEFAULT, (void*)&life_time);
-            if (status < 0)
-            {
-                logE << " H5Dwrite failed to write " << STR_ELAPSED_LIVE_TIME << "\n";
-            }
-            status = H5Dwrite (incnt_dset_id, H5T_NATIVE_REAL, memoryspace_time_id, dataspace_incr_id, H5P_DEFAULT, (void*)&in_cnt);
-            if (status < 0)
-            {
-                logE << " H5Dwrite failed to write " << STR_INPUT_COUNTS << "\n";
-            }
-            status = H5Dwrite (outcnt_dset_id, H5T_NATIVE_REAL, memoryspace_time_id, dataspace_ocr_id, H5P_DEFAULT, (void*)&out_cnt);
-            if (status < 0)
-            {
-                logE << " H5Dwrite failed to write " << STR_OUTPUT_COUNTS << "\n";
-            }
+        H5Sselect_hyperslab (dataspace_rt_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
+        H5Sselect_hyperslab(dataspace_lt_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
+        H5Sselect_hyperslab(dataspace_incr_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
+        H5Sselect_hyperslab(dataspace_ocr_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
+
+        status = H5Dwrite (dset_rt_id, H5T_NATIVE_REAL, memoryspace_time_id, dataspace_rt_id, H5P_DEFAULT, (void*)&real_time[0]);
+        if (status < 0)
+        {
+            logE << " H5Dwrite failed to write "<< STR_ELAPSED_REAL_TIME<< "\n";
+        }
+        status = H5Dwrite (dset_lt_id, H5T_NATIVE_REAL, memoryspace_time_id, dataspace_lt_id, H5P_DEFAULT, (void*)&life_time[0]);
+        if (status < 0)
+        {
+            logE << " H5Dwrite failed to write " << STR_ELAPSED_LIVE_TIME << "\n";
+        }
+        status = H5Dwrite (incnt_dset_id, H5T_NATIVE_REAL, memoryspace_time_id, dataspace_incr_id, H5P_DEFAULT, (void*)&in_cnt[0]);
+        if (status < 0)
+        {
+            logE << " H5Dwrite failed to write " << STR_INPUT_COUNTS << "\n";
+        }
+        status = H5Dwrite (outcnt_dset_id, H5T_NATIVE_REAL, memoryspace_time_id, dataspace_ocr_id, H5P_DEFAULT, (void*)&out_cnt[0]);
+        if (status < 0)
+        {
+            logE << " H5Dwrite failed to write " << STR_OUTPUT_COUNTS << "\n";
         }
     }
 
@@ -4631,145 +5310,505 @@ bool HDF5_IO::save_element_fits(std::string path,
     {
         return false;
     }
-
+
+    if (false == _open_or_create_group(STR_XRF_ANALYZED, maps_grp_id, xrf_grp_id))
+    {
+        return false;
+    }
+
+    if (false == _open_or_create_group(path, xrf_grp_id, fit_grp_id))
+    {
+        return false;
+    }
+    
+    if (false == _open_h5_dataset(STR_COUNTS_PER_SEC, H5T_INTEL_R, fit_grp_id, 3, dims_out, dims_out, dset_id, dataspace_id, H5D_MAPS))
+    {
+        return false;
+    }
+
+    //filetype = H5Tcopy (H5T_FORTRAN_S1);
+    filetype = H5Tcopy (H5T_C_S1);
+    H5Tset_size (filetype, 256);
+    memtype = H5Tcopy (H5T_C_S1);
+    status = H5Tset_size (memtype, 255);
+
+    if (false == _open_h5_dataset(STR_CHANNEL_NAMES, filetype, fit_grp_id, 1, dims_out, dims_out, dset_ch_id, dataspace_ch_id))
+    {
+        return false;
+    }
+
+    if (false == _open_h5_dataset(STR_CHANNEL_UNITS, filetype, fit_grp_id, 1, dims_out, dims_out, dset_un_id, dataspace_un_id))
+    {
+        return false;
+    }
+
+
+/*
+   if (row_idx_end < row_idx_start || row_idx_end > spectra_volume->rows() -1)
+    {
+        row_idx_end = spectra_volume->rows();
+    }
+    if (col_idx_end < col_idx_start || col_idx_end > spectra_volume->cols() -1)
+    {
+        col_idx_end = spectra_volume->cols();
+    }
+*/
+
+    //create save ordered vector by element Z number with K , L, M lines
+    std::vector<std::string> element_lines;
+    for (std::string el_name : data_struct::Element_Symbols)
+    {
+        element_lines.push_back(el_name);
+    }
+    for (std::string el_name : data_struct::Element_Symbols)
+    {
+        element_lines.push_back(el_name+"_L");
+    }
+    for (std::string el_name : data_struct::Element_Symbols)
+    {
+        element_lines.push_back(el_name+"_M");
+    }
+
+    //add the rest 
+    for (const auto& itr : *element_counts)
+    {
+        if( std::find(element_lines.begin(), element_lines.end(), itr.first) == element_lines.end() )
+        {
+            element_lines.push_back(itr.first);
+        }
+    }
+
+    //H5Sselect_hyperslab (memoryspace, H5S_SELECT_SET, offset_3d, nullptr, count_3d, nullptr);
+
+    int i=0;
+    //save by element Z order
+    //for(const auto& iter : *element_counts)
+	std::string units = "cts/s";
+    for (std::string el_name : element_lines)
+    {
+        char tmp_char[256] = {0};
+        if(element_counts->count(el_name) < 1 )
+        {
+            continue;
+        }
+        offset[0] = i;
+        offset_3d[0] = i;
+
+        H5Sselect_hyperslab (dataspace_ch_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
+		H5Sselect_hyperslab(dataspace_un_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
+        H5Sselect_hyperslab (dataspace_ch_off_id, H5S_SELECT_SET, offset2, nullptr, count, nullptr);
+
+        el_name.copy(tmp_char, 254);
+
+        status = H5Dwrite (dset_ch_id, memtype, dataspace_ch_off_id, dataspace_ch_id, H5P_DEFAULT, (void*)tmp_char);
+        if (status < 0)
+        {
+            logE << " H5Dwrite failed to write " << STR_CHANNEL_NAMES << " at row " << i << "\n";
+        }
+
+		for (int z = 0; z < 256; z++)
+		{
+			tmp_char[z] = '\0';
+		}
+		if (el_name != STR_NUM_ITR && el_name != STR_RESIDUAL)
+		{
+			units.copy(tmp_char, 256);
+		}
+		status = H5Dwrite(dset_un_id, memtype, dataspace_ch_off_id, dataspace_un_id, H5P_DEFAULT, (void*)tmp_char);
+        if (status < 0)
+        {
+            logE << " H5Dwrite failed to write " << STR_CHANNEL_UNITS << " at row " << i << "\n";
+        }
+        H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset_3d, nullptr, chunk_dims, nullptr);
+
+        status = H5Dwrite(dset_id, H5T_NATIVE_REAL, memoryspace, dataspace_id, H5P_DEFAULT, (void*)element_counts->at(el_name).data());
+        if (status < 0)
+        {
+            logE << " H5Dwrite failed to write "<< STR_COUNTS_PER_SEC<< " at row "<< i <<"\n";
+        }
+        
+        i++;
+    }
+
+    _close_h5_objects(_global_close_map);
+
+    end = std::chrono::system_clock::now();
+    std::chrono::duration<double> elapsed_seconds = end-start;
+
+    logI << "elapsed time: " << elapsed_seconds.count() << "s"<<"\n";
+
+
+    return true;
+
+}
+
+//-----------------------------------------------------------------------------
+
+bool HDF5_IO::save_fitted_int_spectra(const std::string path,
+                                     const data_struct::Spectra& spectra,
+                                     const data_struct::Range& spectra_range,
+                                     const data_struct::Spectra& background,
+									 const size_t save_spectra_size)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if(_cur_file_id < 0)
+    {
+        logE << "hdf5 file was never initialized. Call start_save_seq() before this function." << "\n";
+        return false;
+    }
+
+    bool ret_val = true;
+    hid_t   dset_id, dataspace_id, memoryspace_id;
+    herr_t  status;
+    std::chrono::time_point<std::chrono::system_clock> start, end;
+    start = std::chrono::system_clock::now();
+    std::string dset_name = "/" + STR_MAPS+ "/" + STR_XRF_ANALYZED + "/" + path + "/" + STR_FIT_INT_SPEC;
+    std::string background_name = "/" + STR_MAPS + "/" + STR_XRF_ANALYZED + "/" + path + "/"+ STR_FIT_INT_BACKGROUND;
+
+    hsize_t offset[1] = {0};
+    hsize_t count[1] = {1};
+    count[0] = save_spectra_size;
+
+    // resize to the size of collected spectra
+    data_struct::ArrayXr save_spectra;
+    save_spectra.setZero(save_spectra_size);
+    data_struct::ArrayXr save_background;
+    save_background.setZero(save_spectra_size);
+
+    int j = 0;
+    for(int i= spectra_range.min; i <= spectra_range.max; i++)
+    {
+        if(std::isfinite(spectra[j]))
+        {
+            save_spectra[i] = spectra[j];
+        }
+        if (std::isfinite(background[j]))
+        {
+            save_background[i] = background[j];
+        }
+        j++;
+    }
+
+    _create_memory_space(1, count, memoryspace_id);
+
+    // save spectra
+    if (false == _open_h5_dataset(dset_name, H5T_INTEL_R, _cur_file_id, 1, count, count, dset_id, dataspace_id))
+    {
+        return false;
+    }
+    status = H5Dwrite(dset_id, H5T_NATIVE_REAL, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)save_spectra.data());
+    if (status < 0)
+    {
+        logW<<"Failed to save "<< dset_name <<"\n";
+        ret_val = false;
+    }
+
+    // save background
+    if (false == _open_h5_dataset(background_name, H5T_INTEL_R, _cur_file_id, 1, count, count, dset_id, dataspace_id))
+    {
+        return false;
+    }
+    status = H5Dwrite(dset_id, H5T_NATIVE_REAL, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)save_background.data());
+    if (status < 0)
+    {
+        logW << "Failed to save " << background_name << "\n";
+        ret_val = false;
+    }
+
+    _close_h5_objects(_global_close_map);
+
+    end = std::chrono::system_clock::now();
+    std::chrono::duration<double> elapsed_seconds = end-start;
+
+    logI << "elapsed time: " << elapsed_seconds.count() << "s"<<"\n";
+    return ret_val;
+}
+
+//-----------------------------------------------------------------------------
+
+bool HDF5_IO::save_fit_input_hash(const std::string path, uint64_t hash)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _save_fit_u64(path, STR_FIT_INPUT_HASH, hash);
+}
+
+//-----------------------------------------------------------------------------
+
+bool HDF5_IO::save_preview_bin(const std::string path, uint64_t bin)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    bool ret_val = _save_fit_u64(path, STR_PREVIEW_BIN, bin);
+    if (_cur_file_id > -1)
+    {
+        H5Fflush(_cur_file_id, H5F_SCOPE_LOCAL);
+    }
+    return ret_val;
+}
+
+//-----------------------------------------------------------------------------
+
+bool HDF5_IO::_save_fit_u64(const std::string& path, const std::string& name, uint64_t value)
+{
+    if(_cur_file_id < 0)
+    {
+        logE << "hdf5 file was never initialized. Call start_save_seq() before this function." << "\n";
+        return false;
+    }
+
+    hid_t dset_id, dataspace_id, memoryspace_id;
+    hid_t maps_grp_id, xrf_grp_id, fit_grp_id;
+    hsize_t count[1] = {1};
+
+    if (false == _open_or_create_group(STR_MAPS, _cur_file_id, maps_grp_id))
+    {
+        return false;
+    }
+
+    if (false == _open_or_create_group(STR_XRF_ANALYZED, maps_grp_id, xrf_grp_id))
+    {
+        return false;
+    }
+
+    if (false == _open_or_create_group(path, xrf_grp_id, fit_grp_id))
+    {
+        return false;
+    }
+
+    _create_memory_space(1, count, memoryspace_id);
+
+    if (false == _open_h5_dataset(name, H5T_STD_U64LE, fit_grp_id, 1, count, count, dset_id, dataspace_id))
+    {
+        return false;
+    }
+    herr_t status = H5Dwrite(dset_id, H5T_NATIVE_UINT64, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)&value);
+    if (status < 0)
+    {
+        logE << " H5Dwrite failed to write " << path << "/" << name << "\n";
+    }
+
+    _close_h5_objects(_global_close_map);
+
+    return (status > -1);
+}
+
+//-----------------------------------------------------------------------------
+
+bool HDF5_IO::load_fit_input_hash(const std::string path, uint64_t& hash)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if(_cur_file_id < 0)
+    {
+        return false;
+    }
+
+    std::stack<std::pair<hid_t, H5_OBJECTS> > close_map;
+    hid_t dset_id;
+
+    if (false == _open_h5_object(dset_id, H5O_DATASET, close_map, STR_MAPS + "/" + STR_XRF_ANALYZED + "/" + path + "/" + STR_FIT_INPUT_HASH, _cur_file_id, false))
+    {
+        return false;
+    }
+
+    herr_t error = H5Dread(dset_id, H5T_NATIVE_UINT64, H5S_ALL, H5S_ALL, H5P_DEFAULT, (void*)&hash);
+    _close_h5_objects(close_map);
+
+    return (error > -1);
+}
+
+//-----------------------------------------------------------------------------
+
+bool HDF5_IO::save_skipped_pixels(const data_struct::ArrayXXr& fit_pixels)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if(_cur_file_id < 0)
+    {
+        logE << "hdf5 file was never initialized. Call start_save_seq() before this function." << "\n";
+        return false;
+    }
+
+    hid_t dset_id, dataspace_id, memoryspace_id;
+    hid_t maps_grp_id, xrf_grp_id;
+    hsize_t offset[2] = {0, 0};
+    hsize_t count[2] = {(hsize_t)fit_pixels.rows(), (hsize_t)fit_pixels.cols()};
+
+    std::vector<unsigned char> skipped(fit_pixels.size());
+    for (Eigen::Index i = 0; i < fit_pixels.size(); i++)
+    {
+        skipped[i] = (fit_pixels.data()[i] == 0.0) ? 1 : 0;
+    }
+
+    if (false == _open_or_create_group(STR_MAPS, _cur_file_id, maps_grp_id))
+    {
+        return false;
+    }
     if (false == _open_or_create_group(STR_XRF_ANALYZED, maps_grp_id, xrf_grp_id))
     {
         return false;
     }
 
-    if (false == _open_or_create_group(path, xrf_grp_id, fit_grp_id))
+    _create_memory_space(2, count, memoryspace_id);
+    if (false == _open_h5_dataset(STR_SKIPPED_PIXELS, H5T_STD_U8LE, xrf_grp_id, 2, count, count, dset_id, dataspace_id, H5D_MAPS))
     {
         return false;
     }
-    
-    if (false == _open_h5_dataset(STR_COUNTS_PER_SEC, H5T_INTEL_R, fit_grp_id, 3, dims_out, dims_out, dset_id, dataspace_id))
+    H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
+    herr_t status = H5Dwrite(dset_id, H5T_NATIVE_UCHAR, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)skipped.data());
+    if (status < 0)
     {
-        return false;
+        logE << " H5Dwrite failed to write " << STR_SKIPPED_PIXELS << "\n";
     }
 
-    //filetype = H5Tcopy (H5T_FORTRAN_S1);
-    filetype = H5Tcopy (H5T_C_S1);
-    H5Tset_size (filetype, 256);
-    memtype = H5Tcopy (H5T_C_S1);
-    status = H5Tset_size (memtype, 255);
+    _close_h5_objects(_global_close_map);
 
-    if (false == _open_h5_dataset(STR_CHANNEL_NAMES, filetype, fit_grp_id, 1, dims_out, dims_out, dset_ch_id, dataspace_ch_id))
-    {
-        return false;
-    }
+    return (status > -1);
+}
 
-    if (false == _open_h5_dataset(STR_CHANNEL_UNITS, filetype, fit_grp_id, 1, dims_out, dims_out, dset_un_id, dataspace_un_id))
+//-----------------------------------------------------------------------------
+
+bool HDF5_IO::load_element_fits(const std::string path, data_struct::Fit_Count_Dict * element_counts)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if(_cur_file_id < 0 || element_counts == nullptr)
     {
         return false;
     }
 
+    std::stack<std::pair<hid_t, H5_OBJECTS> > close_map;
+    hid_t fit_grp_id, dset_id, dset_ch_id, dataspace_id, dataspace_ch_id, memoryspace_id;
+    hsize_t dims_in[3] = {0, 0, 0};
+    hsize_t ch_dims[1] = {0};
+    hsize_t offset_3d[3] = {0, 0, 0};
+    hsize_t count_3d[3] = {1, 1, 1};
 
-/*
-   if (row_idx_end < row_idx_start || row_idx_end > spectra_volume->rows() -1)
-    {
-        row_idx_end = spectra_volume->rows();
-    }
-    if (col_idx_end < col_idx_start || col_idx_end > spectra_volume->cols() -1)
+    if (false == _open_h5_object(fit_grp_id, H5O_GROUP, close_map, STR_MAPS + "/" + STR_XRF_ANALYZED + "/" + path, _cur_file_id, false))
     {
-        col_idx_end = spectra_volume->cols();
+        return false;
     }
-*/
-
-    //create save ordered vector by element Z number with K , L, M lines
-    std::vector<std::string> element_lines;
-    for (std::string el_name : data_struct::Element_Symbols)
+    if (false == _open_h5_object(dset_id, H5O_DATASET, close_map, STR_COUNTS_PER_SEC, fit_grp_id, false))
     {
-        element_lines.push_back(el_name);
+        return false;
     }
-    for (std::string el_name : data_struct::Element_Symbols)
+    if (false == _open_h5_object(dset_ch_id, H5O_DATASET, close_map, STR_CHANNEL_NAMES, fit_grp_id, false))
     {
-        element_lines.push_back(el_name+"_L");
+        return false;
     }
-    for (std::string el_name : data_struct::Element_Symbols)
+
+    dataspace_id = H5Dget_space(dset_id);
+    close_map.push({dataspace_id, H5O_DATASPACE});
+    dataspace_ch_id = H5Dget_space(dset_ch_id);
+    close_map.push({dataspace_ch_id, H5O_DATASPACE});
+    if (H5Sget_simple_extent_dims(dataspace_id, dims_in, nullptr) != 3 || H5Sget_simple_extent_dims(dataspace_ch_id, ch_dims, nullptr) != 1)
     {
-        element_lines.push_back(el_name+"_M");
+        logW << "Unexpected " << STR_COUNTS_PER_SEC << " layout in " << path << "\n";
+        _close_h5_objects(close_map);
+        return false;
     }
 
-    //add the rest 
-    for (const auto& itr : *element_counts)
+    std::vector<char> names(ch_dims[0] * 256, '\0');
+    hid_t memtype = H5Tcopy(H5T_C_S1);
+    H5Tset_size(memtype, 256);
+    herr_t error = H5Dread(dset_ch_id, memtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, (void*)names.data());
+    H5Tclose(memtype);
+    if (error < 0)
     {
-        if( std::find(element_lines.begin(), element_lines.end(), itr.first) == element_lines.end() )
-        {
-            element_lines.push_back(itr.first);
-        }
+        _close_h5_objects(close_map);
+        return false;
     }
 
-    //H5Sselect_hyperslab (memoryspace, H5S_SELECT_SET, offset_3d, nullptr, count_3d, nullptr);
+    count_3d[1] = dims_in[1];
+    count_3d[2] = dims_in[2];
+    _create_memory_space(3, count_3d, memoryspace_id);
+    close_map.push({memoryspace_id, H5O_DATASPACE});
 
-    int i=0;
-    //save by element Z order
-    //for(const auto& iter : *element_counts)
-	std::string units = "cts/s";
-    for (std::string el_name : element_lines)
+    size_t loaded = 0;
+    for (hsize_t i = 0; i < ch_dims[0] && i < dims_in[0]; i++)
     {
-        char tmp_char[256] = {0};
-        if(element_counts->count(el_name) < 1 )
+        std::string el_name(&names[i * 256], 256);
+        el_name = el_name.substr(0, el_name.find('\0'));
+        auto itr = element_counts->find(el_name);
+        if (itr == element_counts->end() || (hsize_t)itr->second.rows() != dims_in[1] || (hsize_t)itr->second.cols() != dims_in[2])
         {
             continue;
         }
-        offset[0] = i;
         offset_3d[0] = i;
-
-        H5Sselect_hyperslab (dataspace_ch_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
-		H5Sselect_hyperslab(dataspace_un_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
-        H5Sselect_hyperslab (dataspace_ch_off_id, H5S_SELECT_SET, offset2, nullptr, count, nullptr);
-
-        el_name.copy(tmp_char, 254);
-
-        status = H5Dwrite (dset_ch_id, memtype, dataspace_ch_off_id, dataspace_ch_id, H5P_DEFAULT, (void*)tmp_char);
-        if (status < 0)
+        H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset_3d, nullptr, count_3d, nullptr);
+        error = H5Dread(dset_id, H5T_NATIVE_REAL, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)itr->second.data());
+        if (error < 0)
         {
-            logE << " H5Dwrite failed to write " << STR_CHANNEL_NAMES << " at row " << i << "\n";
+            logW << "Failed to read " << STR_COUNTS_PER_SEC << " of " << el_name << " in " << path << "\n";
+            _close_h5_objects(close_map);
+            return false;
         }
+        loaded++;
+    }
+    _close_h5_objects(close_map);
 
-		for (int z = 0; z < 256; z++)
-		{
-			tmp_char[z] = '\0';
-		}
-		if (el_name != STR_NUM_ITR && el_name != STR_RESIDUAL)
-		{
-			units.copy(tmp_char, 256);
-		}
-		status = H5Dwrite(dset_un_id, memtype, dataspace_ch_off_id, dataspace_un_id, H5P_DEFAULT, (void*)tmp_char);
-        if (status < 0)
-        {
-            logE << " H5Dwrite failed to write " << STR_CHANNEL_UNITS << " at row " << i << "\n";
-        }
-        H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset_3d, nullptr, chunk_dims, nullptr);
+    return (loaded == element_counts->size());
+}
 
-        status = H5Dwrite(dset_id, H5T_NATIVE_REAL, memoryspace, dataspace_id, H5P_DEFAULT, (void*)element_counts->at(el_name).data());
-        if (status < 0)
-        {
-            logE << " H5Dwrite failed to write "<< STR_COUNTS_PER_SEC<< " at row "<< i <<"\n";
-        }
-        
-        i++;
-    }
+//-----------------------------------------------------------------------------
 
-    _close_h5_objects(_global_close_map);
+bool HDF5_IO::_save_checkpoint_spectra(const std::string& name, hid_t parent_id, const data_struct::Spectra& spectra)
+{
+    if (spectra.size() == 0)
+    {
+        return true;
+    }
 
-    end = std::chrono::system_clock::now();
-    std::chrono::duration<double> elapsed_seconds = end-start;
+    hid_t dset_id, dataspace_id, memoryspace_id;
+    hsize_t offset[1] = {0};
+    hsize_t count[1] = {(hsize_t)spectra.size()};
 
-    logI << "elapsed time: " << elapsed_seconds.count() << "s"<<"\n";
+    _create_memory_space(1, count, memoryspace_id);
+    if (false == _open_h5_dataset(name, H5T_INTEL_R, parent_id, 1, count, count, dset_id, dataspace_id))
+    {
+        return false;
+    }
+    H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
+    herr_t status = H5Dwrite(dset_id, H5T_NATIVE_REAL, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)spectra.data());
+    if (status < 0)
+    {
+        logE << " H5Dwrite failed to write " << STR_FIT_CHECKPOINT << "/" << name << "\n";
+    }
+    return (status > -1);
+}
 
+//-----------------------------------------------------------------------------
 
-    return true;
+bool HDF5_IO::_load_checkpoint_spectra(const std::string& name, hid_t parent_id, std::stack<std::pair<hid_t, H5_OBJECTS> > &close_map, data_struct::Spectra& spectra)
+{
+    hid_t dset_id, dataspace_id;
+    hsize_t dims_in[1] = {0};
 
+    // only the matrix routines save their sums
+    if (H5Lexists(parent_id, name.c_str(), H5P_DEFAULT) <= 0)
+    {
+        spectra.resize(0);
+        return true;
+    }
+    if (false == _open_h5_object(dset_id, H5O_DATASET, close_map, name, parent_id, false, false))
+    {
+        return false;
+    }
+    dataspace_id = H5Dget_space(dset_id);
+    close_map.push({dataspace_id, H5O_DATASPACE});
+    if (H5Sget_simple_extent_dims(dataspace_id, dims_in, nullptr) != 1)
+    {
+        return false;
+    }
+    spectra.resize(dims_in[0]);
+    return (H5Dread(dset_id, H5T_NATIVE_REAL, H5S_ALL, H5S_ALL, H5P_DEFAULT, (void*)spectra.data()) > -1);
 }
 
 //-----------------------------------------------------------------------------
 
-bool HDF5_IO::save_fitted_int_spectra(const std::string path,
-                                     const data_struct::Spectra& spectra,
-                                     const data_struct::Range& spectra_range,
-                                     const data_struct::Spectra& background,
-									 const size_t save_spectra_size)
+bool HDF5_IO::save_fit_checkpoint(const std::string path, const H5_Fit_Checkpoint& checkpoint)
 {
     std::lock_guard<std::mutex> lock(_mutex);
 
@@ -4779,75 +5818,129 @@ bool HDF5_IO::save_fitted_int_spectra(const std::string path,
         return false;
     }
 
-    bool ret_val = true;
-    hid_t   dset_id, dataspace_id, memoryspace_id;
-    herr_t  status;
-    std::chrono::time_point<std::chrono::system_clock> start, end;
-    start = std::chrono::system_clock::now();
-    std::string dset_name = "/" + STR_MAPS+ "/" + STR_XRF_ANALYZED + "/" + path + "/" + STR_FIT_INT_SPEC;
-    std::string background_name = "/" + STR_MAPS + "/" + STR_XRF_ANALYZED + "/" + path + "/"+ STR_FIT_INT_BACKGROUND;
-
-    hsize_t offset[1] = {0};
+    hid_t dset_id, dataspace_id, memoryspace_id;
+    hid_t maps_grp_id, xrf_grp_id, fit_grp_id, ckpt_grp_id;
     hsize_t count[1] = {1};
-    count[0] = save_spectra_size;
-
-    // resize to the size of collected spectra
-    data_struct::ArrayXr save_spectra;
-    save_spectra.setZero(save_spectra_size);
-    data_struct::ArrayXr save_background;
-    save_background.setZero(save_spectra_size);
+    herr_t status;
 
-    int j = 0;
-    for(int i= spectra_range.min; i <= spectra_range.max; i++)
+    if (false == _open_or_create_group(STR_MAPS, _cur_file_id, maps_grp_id))
     {
-        if(std::isfinite(spectra[j]))
-        {
-            save_spectra[i] = spectra[j];
-        }
-        if (std::isfinite(background[j]))
-        {
-            save_background[i] = background[j];
-        }
-        j++;
+        return false;
+    }
+    if (false == _open_or_create_group(STR_XRF_ANALYZED, maps_grp_id, xrf_grp_id))
+    {
+        return false;
+    }
+    if (false == _open_or_create_group(path, xrf_grp_id, fit_grp_id))
+    {
+        return false;
+    }
+    if (false == _open_or_create_group(STR_FIT_CHECKPOINT, fit_grp_id, ckpt_grp_id))
+    {
+        return false;
     }
 
     _create_memory_space(1, count, memoryspace_id);
 
-    // save spectra
-    if (false == _open_h5_dataset(dset_name, H5T_INTEL_R, _cur_file_id, 1, count, count, dset_id, dataspace_id))
+    bool ret_val = _save_checkpoint_spectra(STR_INT_FITTED, ckpt_grp_id, checkpoint.integrated_fitted);
+    ret_val = _save_checkpoint_spectra(STR_INT_BACKGROUND, ckpt_grp_id, checkpoint.integrated_background) && ret_val;
+    ret_val = _save_checkpoint_spectra(STR_MAX_CHANNELS, ckpt_grp_id, checkpoint.max_channels) && ret_val;
+    ret_val = _save_checkpoint_spectra(STR_MAX_10_CHANNELS, ckpt_grp_id, checkpoint.max_10_channels) && ret_val;
+
+    if (false == _open_h5_dataset(STR_FIT_INPUT_HASH, H5T_STD_U64LE, ckpt_grp_id, 1, count, count, dset_id, dataspace_id))
     {
         return false;
     }
-    status = H5Dwrite(dset_id, H5T_NATIVE_REAL, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)save_spectra.data());
-    if (status < 0)
+    status = H5Dwrite(dset_id, H5T_NATIVE_UINT64, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)&checkpoint.fit_hash);
+    ret_val = (status > -1) && ret_val;
+
+    // written last so an interrupted save leaves the previous row count
+    if (false == _open_h5_dataset(STR_ROWS_DONE, H5T_STD_U64LE, ckpt_grp_id, 1, count, count, dset_id, dataspace_id))
     {
-        logW<<"Failed to save "<< dset_name <<"\n";
-        ret_val = false;
+        return false;
+    }
+    status = H5Dwrite(dset_id, H5T_NATIVE_UINT64, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)&checkpoint.rows_done);
+    ret_val = (status > -1) && ret_val;
+    if (false == ret_val)
+    {
+        logE << " Failed to write " << path << "/" << STR_FIT_CHECKPOINT << "\n";
     }
 
-    // save background
-    if (false == _open_h5_dataset(background_name, H5T_INTEL_R, _cur_file_id, 1, count, count, dset_id, dataspace_id))
+    _close_h5_objects(_global_close_map);
+
+    H5Fflush(_cur_file_id, H5F_SCOPE_LOCAL);
+
+    return ret_val;
+}
+
+//-----------------------------------------------------------------------------
+
+bool HDF5_IO::load_fit_checkpoint(const std::string path, H5_Fit_Checkpoint& checkpoint)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if(_cur_file_id < 0)
     {
         return false;
     }
-    status = H5Dwrite(dset_id, H5T_NATIVE_REAL, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)save_background.data());
-    if (status < 0)
+
+    std::stack<std::pair<hid_t, H5_OBJECTS> > close_map;
+    hid_t ckpt_grp_id, dset_id;
+
+    if (false == _open_h5_object(ckpt_grp_id, H5O_GROUP, close_map, STR_MAPS + "/" + STR_XRF_ANALYZED + "/" + path + "/" + STR_FIT_CHECKPOINT, _cur_file_id, false))
     {
-        logW << "Failed to save " << background_name << "\n";
-        ret_val = false;
+        return false;
     }
 
-    _close_h5_objects(_global_close_map);
+    bool ret_val = _open_h5_object(dset_id, H5O_DATASET, close_map, STR_FIT_INPUT_HASH, ckpt_grp_id, false, false)
+                && H5Dread(dset_id, H5T_NATIVE_UINT64, H5S_ALL, H5S_ALL, H5P_DEFAULT, (void*)&checkpoint.fit_hash) > -1
+                && _open_h5_object(dset_id, H5O_DATASET, close_map, STR_ROWS_DONE, ckpt_grp_id, false, false)
+                && H5Dread(dset_id, H5T_NATIVE_UINT64, H5S_ALL, H5S_ALL, H5P_DEFAULT, (void*)&checkpoint.rows_done) > -1
+                && _load_checkpoint_spectra(STR_INT_FITTED, ckpt_grp_id, close_map, checkpoint.integrated_fitted)
+                && _load_checkpoint_spectra(STR_INT_BACKGROUND, ckpt_grp_id, close_map, checkpoint.integrated_background)
+                && _load_checkpoint_spectra(STR_MAX_CHANNELS, ckpt_grp_id, close_map, checkpoint.max_channels)
+                && _load_checkpoint_spectra(STR_MAX_10_CHANNELS, ckpt_grp_id, close_map, checkpoint.max_10_channels);
 
-    end = std::chrono::system_clock::now();
-    std::chrono::duration<double> elapsed_seconds = end-start;
+    _close_h5_objects(close_map);
 
-    logI << "elapsed time: " << elapsed_seconds.count() << "s"<<"\n";
     return ret_val;
 }
 
 //-----------------------------------------------------------------------------
 
+bool HDF5_IO::remove_fit_checkpoint(const std::string path)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if(_cur_file_id < 0)
+    {
+        return false;
+    }
+
+    std::stack<std::pair<hid_t, H5_OBJECTS> > close_map;
+    hid_t fit_grp_id;
+
+    if (false == _open_h5_object(fit_grp_id, H5O_GROUP, close_map, STR_MAPS + "/" + STR_XRF_ANALYZED + "/" + path, _cur_file_id, false))
+    {
+        return true;
+    }
+
+    herr_t error = 0;
+    if (H5Lexists(fit_grp_id, STR_FIT_CHECKPOINT.c_str(), H5P_DEFAULT) > 0)
+    {
+        error = H5Ldelete(fit_grp_id, STR_FIT_CHECKPOINT.c_str(), H5P_DEFAULT);
+        if (error < 0)
+        {
+            logW << "Failed to remove " << path << "/" << STR_FIT_CHECKPOINT << "\n";
+        }
+    }
+    _close_h5_objects(close_map);
+
+    return (error > -1);
+}
+
+//-----------------------------------------------------------------------------
+
 bool HDF5_IO::save_max_10_spectra(const std::string path,
 	const data_struct::Range& spectra_range,
 	const data_struct::Spectra& max_spectra,
@@ -5629,7 +6722,6 @@ bool HDF5_IO::_save_scalers(hid_t maps_grp_id, std::vector<data_struct::Scaler_M
     hid_t dset_units_id = -1;
     hid_t dset_values_id = -1;
     hid_t scalers_grp_id = -1;
-    hid_t dcpl_id = -1;
     herr_t status;
     
     hsize_t offset[1] = { 0 };
@@ -5787,18 +6879,11 @@ bool HDF5_IO::_save_scalers(hid_t maps_grp_id, std::vector<data_struct::Scaler_M
                 break;
             }
 
-            if (false == _open_h5_dataset(STR_VALUES, H5T_INTEL_R, scalers_grp_id, 3, count_3d, count_3d, dset_values_id, dataspace_values_id))
+            if (false == _open_h5_dataset(STR_VALUES, H5T_INTEL_R, scalers_grp_id, 3, count_3d, count_3d, dset_values_id, dataspace_values_id, H5D_MAPS))
             {
                 return false;
             }
 
-            count_3d[0] = 1;
-
-            dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
-            H5Pset_chunk(dcpl_id, 3, count_3d);
-            H5Pset_deflate(dcpl_id, 7);
-               
-            count_3d[0] = scalers_map->size();
             count[0] = count_3d[0];
 
             if (false == _open_h5_dataset(STR_NAMES, filetype, scalers_grp_id, 1, count, count, dset_names_id, dataspace_names_id))
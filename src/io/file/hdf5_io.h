@@ -75,6 +75,53 @@ enum H5_SPECTRA_LAYOUTS {MAPS_RAW, MAPS_V9, MAPS_V10, XSPRESS, APS_SEC20};
 
 enum GSE_CARS_SAVE_VER {UNKNOWN, XRFMAP, XRMMAP};
 
+// what a created dataset holds, picks the chunk shape used by the write profile
+enum H5_DATASET_KINDS {H5D_GENERIC, H5D_SPECTRA_VOLUME, H5D_MAPS};
+
+///\brief Filters and chunk shapes used when creating output datasets
+struct DLL_EXPORT H5_Write_Profile
+{
+    H5_Write_Profile();
+
+    std::string name;
+
+    // deflate level 1 - 9, 0 disables compression
+    int compression_level;
+
+    // byte shuffle before deflate, compresses float maps and spectra noticeably better
+    bool shuffle;
+
+    // store mca_arr with the scale-offset filter rounded to whole counts. Lossy for fractional values.
+    bool scale_offset_counts;
+
+    // spectra per mca_arr chunk along a row. 1 is one spectra per chunk, 0 fills about 1 MB
+    size_t spectra_chunk_pixels;
+
+    // chunk counts_per_sec, scalers and the per pixel times one map at a time
+    bool map_per_chunk;
+};
+
+// legacy (default), fast, none, small. Returns false for an unknown name
+DLL_EXPORT bool get_h5_write_profile(const std::string& name, H5_Write_Profile& out_profile);
+
+DLL_EXPORT std::vector<std::string> get_h5_write_profile_names();
+
+///\brief Partial fit of a routine saved while a map is being fitted, see HDF5_IO::save_fit_checkpoint()
+struct DLL_EXPORT H5_Fit_Checkpoint
+{
+    // hash of the spectra and fit configuration the rows were fitted with
+    uint64_t fit_hash;
+
+    // rows [0, rows_done) are fitted and saved in Counts_Per_Sec
+    uint64_t rows_done;
+
+    // partial sums of the matrix routines, empty for the others
+    data_struct::Spectra integrated_fitted;
+    data_struct::Spectra integrated_background;
+    data_struct::Spectra max_channels;
+    data_struct::Spectra max_10_channels;
+};
+
 class DLL_EXPORT HDF5_IO
 {
 public:
@@ -85,6 +132,10 @@ public:
 
     bool load_spectra_volume(std::string path, size_t detector_num, data_struct::Spectra_Volume* spec_vol);
 
+    // opens MAPS_RAW once and fills one (already sized) volume per detector, spec_vols is indexed like detector_num_arr.
+    // add_to_volumes adds the counts and times to what the volumes hold, so several detectors can be summed into one volume
+    bool load_spectra_volumes(std::string path, const std::vector<size_t>& detector_num_arr, std::vector<data_struct::Spectra_Volume*>* spec_vols, bool add_to_volumes = false);
+
     bool load_spectra_volume_with_callback(std::string path,
 											const std::vector<size_t>& detector_num_arr,
 										   data_struct::IO_Callback_Func_Def callback_func,
@@ -159,6 +210,8 @@ public:
 
     void set_filename(std::string fname) {_cur_filename = fname;}
 
+    const std::string& filename() const { return _cur_filename; }
+
     bool save_spectra_volume(const std::string path,
                             data_struct::Spectra_Volume* spectra_volume,
                              size_t row_idx_start=0,
@@ -181,6 +234,46 @@ public:
                                  const data_struct::Spectra& background,
 								 const size_t save_spectra_size);
 	
+    ///
+    /// \brief save_fit_input_hash : Hash of the spectra and fit configuration the counts in /MAPS/XRF_Analyzed/path were fitted with
+    ///
+    bool save_fit_input_hash(const std::string path, uint64_t hash);
+
+    ///
+    /// \brief load_fit_input_hash : Read the hash saved by save_fit_input_hash() from the open file, false if there is none
+    ///
+    bool load_fit_input_hash(const std::string path, uint64_t& hash);
+
+    ///
+    /// \brief save_preview_bin : Pixels per side of the binned preview in Counts_Per_Sec of /MAPS/XRF_Analyzed/path, 1 once the full fit is saved. Flushes the file.
+    ///
+    bool save_preview_bin(const std::string path, uint64_t bin);
+
+    ///
+    /// \brief save_skipped_pixels : Save /MAPS/XRF_Analyzed/Skipped_Pixels, 1 where fit_pixels is 0 and the counts were not fitted
+    ///
+    bool save_skipped_pixels(const data_struct::ArrayXXr& fit_pixels);
+
+    ///
+    /// \brief load_element_fits : Read Counts_Per_Sec of /MAPS/XRF_Analyzed/path back into the maps of element_counts with matching names and size
+    ///
+    bool load_element_fits(const std::string path, data_struct::Fit_Count_Dict * element_counts);
+
+    ///
+    /// \brief save_fit_checkpoint : Save /MAPS/XRF_Analyzed/path/Checkpoint and flush the file. Save the counts with save_element_fits() first.
+    ///
+    bool save_fit_checkpoint(const std::string path, const H5_Fit_Checkpoint& checkpoint);
+
+    ///
+    /// \brief load_fit_checkpoint : Read the checkpoint saved by save_fit_checkpoint(), false if there is none
+    ///
+    bool load_fit_checkpoint(const std::string path, H5_Fit_Checkpoint& checkpoint);
+
+    ///
+    /// \brief remove_fit_checkpoint : Unlink the checkpoint once all rows are saved
+    ///
+    bool remove_fit_checkpoint(const std::string path);
+
 	bool save_max_10_spectra(const std::string path,
 							const data_struct::Range& range,
 							const data_struct::Spectra& max_spectra,
@@ -241,6 +334,17 @@ public:
 
     bool add_background(std::string directory, std::string filename, data_struct::Params_Override& params);
 
+    // applies to datasets created after this call, existing datasets keep their filters
+    void set_write_profile(const H5_Write_Profile& profile) { _write_profile = profile; }
+
+    const H5_Write_Profile& write_profile() const { return _write_profile; }
+
+    // upper limit of the chunk cache given to each large dataset opened for reading
+    void set_chunk_cache_budget(size_t bytes) { _chunk_cache_budget = bytes; }
+
+    // threads decompressing chunks on the direct chunk read path
+    void set_read_threads(size_t num_threads) { _read_threads = num_threads; }
+
 private:
 
     HDF5_IO();
@@ -268,15 +372,31 @@ private:
     bool _add_exchange_meta(hid_t file_id, std::string exchange_idx, std::string fits_link, std::string normalize_scaler);
 	
     bool _open_h5_object(hid_t &id, H5_OBJECTS obj, std::stack<std::pair<hid_t, H5_OBJECTS> > &close_map, std::string s1, hid_t id2, bool log_error=true, bool close_on_fail=true);
+    bool _open_h5_dataset_cached(hid_t &id, std::stack<std::pair<hid_t, H5_OBJECTS> > &close_map, std::string name, hid_t parent_id, const std::vector<hsize_t>& read_count);
+    hid_t _create_chunk_cache_plist(hid_t dset_id, const std::vector<hsize_t>& read_count);
+    bool _read_spectra_chunks_direct(hid_t dset_id, const hsize_t* dims_in, data_struct::Spectra_Volume* spectra_volume, size_t row_idx_start, size_t row_idx_end, size_t col_idx_start, size_t col_idx_end);
     bool _open_or_create_group(const std::string name, hid_t parent_id, hid_t& out_id, bool log_error = true, bool close_on_fail = true);
     bool _create_memory_space(int rank, const hsize_t* count, hid_t& out_id);
-    bool _open_h5_dataset(const std::string& name, hid_t data_type, hid_t parent_id, int dims_size, const hsize_t* dims, const hsize_t* chunk_dims, hid_t& out_id, hid_t& out_dataspece);
+    bool _save_fit_u64(const std::string& path, const std::string& name, uint64_t value);
+
+    bool _save_checkpoint_spectra(const std::string& name, hid_t parent_id, const data_struct::Spectra& spectra);
+
+    bool _load_checkpoint_spectra(const std::string& name, hid_t parent_id, std::stack<std::pair<hid_t, H5_OBJECTS> > &close_map, data_struct::Spectra& spectra);
+
+    bool _open_h5_dataset(const std::string& name, hid_t data_type, hid_t parent_id, int dims_size, const hsize_t* dims, const hsize_t* chunk_dims, hid_t& out_id, hid_t& out_dataspece, H5_DATASET_KINDS kind = H5D_GENERIC);
+    hid_t _create_dataset_plist(H5_DATASET_KINDS kind, int dims_size, const hsize_t* dims, const hsize_t* chunk_dims);
     void _close_h5_objects(std::stack<std::pair<hid_t, H5_OBJECTS> > &close_map);
 
     hid_t _cur_file_id;
     std::string _cur_filename;
     std::stack<std::pair<hid_t, H5_OBJECTS> > _global_close_map;
 
+    H5_Write_Profile _write_profile;
+
+    size_t _chunk_cache_budget;
+
+    size_t _read_threads;
+
 };
 
 }// end namespace file
@@ -187,7 +187,16 @@ bool init_analysis_job_detectors(data_struct::Analysis_Job* analysis_job)
         for(auto proc_type : analysis_job->fitting_routines)
         {
             //Fitting models
-            detector->fit_routines[proc_type] = generate_fit_routine(proc_type, analysis_job->optimizer());
+            data_struct::Fit_Precision precision = analysis_job->fit_precision(proc_type);
+            detector->fit_routines[proc_type] = generate_fit_routine(proc_type, analysis_job->optimizer(precision));
+            if (detector->fit_routines[proc_type] != nullptr)
+            {
+                detector->fit_routines[proc_type]->set_precision(precision);
+                if (proc_type == data_struct::Fitting_Routines::GAUSS_MATRIX)
+                {
+                    ((fitting::routines::Matrix_Optimized_Fit_Routine*)detector->fit_routines[proc_type])->set_nnls_seed(analysis_job->matrix_nnls_seed);
+                }
+            }
 
             //reset model fit parameters to defaults
             detector->model->reset_to_default_fit_params();
@@ -682,6 +691,78 @@ bool load_override_params(std::string dataset_directory,
 
 // ----------------------------------------------------------------------------
 
+// raw detector files that belong to a mda dataset, the first layout found wins
+struct Raw_File_Layout
+{
+    Raw_File_Layout() : hasNetcdf(false), hasBnpNetcdf(false), hasHdf(false), hasXspress(false), bnp_netcdf_base_name("bnp_fly_") {}
+
+    bool hasNetcdf;
+    bool hasBnpNetcdf;
+    bool hasHdf;
+    bool hasXspress;
+    std::string file_middle; //_2xfm3_, dxpM, or file index in case of bnp...
+    std::string bnp_netcdf_base_name;
+
+    bool has_any() const { return hasNetcdf || hasBnpNetcdf || hasHdf || hasXspress; }
+};
+
+// ----------------------------------------------------------------------------
+
+// tmp_dataset_file is the dataset file name without the .mda extension
+Raw_File_Layout find_raw_file_layout(const std::string& tmp_dataset_file)
+{
+    Raw_File_Layout layout;
+    for(auto &itr : netcdf_files)
+    {
+        if (itr.find(tmp_dataset_file) == 0)
+        {
+            size_t slen = (itr.length()-4) - tmp_dataset_file.length();
+            layout.file_middle = itr.substr(tmp_dataset_file.length(), slen);
+            layout.hasNetcdf = true;
+            return layout;
+        }
+    }
+    int idx = static_cast<int>(tmp_dataset_file.find("bnp_fly"));
+    if (idx == 0)
+    {
+        std::string footer = tmp_dataset_file.substr(7, tmp_dataset_file.length() - 7);
+        int file_index = std::atoi(footer.c_str());
+        layout.file_middle = std::to_string(file_index);
+        layout.bnp_netcdf_base_name = "bnp_fly_"+ layout.file_middle + "_";
+        for(auto &itr : bnp_netcdf_files)
+        {
+            if (itr.find(layout.bnp_netcdf_base_name) == 0)
+            {
+                layout.hasBnpNetcdf = true;
+                return layout;
+            }
+        }
+    }
+    for(auto &itr : hdf_files)
+    {
+        if (itr.find(tmp_dataset_file) == 0)
+        {
+            size_t slen = (itr.length()-4) - tmp_dataset_file.length();
+            layout.file_middle = itr.substr(tmp_dataset_file.length(), slen);
+            layout.hasHdf = true;
+            return layout;
+        }
+    }
+    for(auto &itr : hdf_xspress_files)
+    {
+        if (itr.find(tmp_dataset_file) == 0)
+        {
+            size_t slen = (itr.length()-4) - tmp_dataset_file.length();
+            layout.file_middle = itr.substr(tmp_dataset_file.length(), slen);
+            layout.hasXspress = true;
+            return layout;
+        }
+    }
+    return layout;
+}
+
+// ----------------------------------------------------------------------------
+
 bool load_spectra_volume(std::string dataset_directory,
                          std::string dataset_file,
                          size_t detector_num,
@@ -705,68 +786,8 @@ bool load_spectra_volume(std::string dataset_directory,
     }
     //check if we have a netcdf file associated with this dataset.
     tmp_dataset_file = tmp_dataset_file.substr(0, tmp_dataset_file.size()-4);
-    bool hasNetcdf = false;
-    bool hasBnpNetcdf = false;
-    bool hasHdf = false;
-    bool hasXspress = false;
-    std::string file_middle = ""; //_2xfm3_, dxpM, or file index in case of bnp...
-    std::string bnp_netcdf_base_name = "bnp_fly_";
     std::vector<int> bad_rows;
-    for(auto &itr : netcdf_files)
-    {
-        if (itr.find(tmp_dataset_file) == 0)
-        {
-            size_t slen = (itr.length()-4) - tmp_dataset_file.length();
-            file_middle = itr.substr(tmp_dataset_file.length(), slen);
-            hasNetcdf = true;
-            break;
-        }
-    }
-    if (hasNetcdf == false)
-    {
-        int idx = static_cast<int>(tmp_dataset_file.find("bnp_fly"));
-        if (idx == 0)
-        {
-            std::string footer = tmp_dataset_file.substr(7, tmp_dataset_file.length() - 7);
-            int file_index = std::atoi(footer.c_str());
-            file_middle = std::to_string(file_index);
-            bnp_netcdf_base_name = "bnp_fly_"+ file_middle + "_";
-            for(auto &itr : bnp_netcdf_files)
-            {
-                if (itr.find(bnp_netcdf_base_name) == 0)
-                {
-                    hasBnpNetcdf = true;
-                    break;
-                }
-            }
-        }
-    }
-    if (hasNetcdf == false && hasBnpNetcdf == false)
-    {
-        for(auto &itr : hdf_files)
-        {
-            if (itr.find(tmp_dataset_file) == 0)
-            {
-                size_t slen = (itr.length()-4) - tmp_dataset_file.length();
-                file_middle = itr.substr(tmp_dataset_file.length(), slen);
-                hasHdf = true;
-                break;
-            }
-        }
-    }
-    if (hasNetcdf == false && hasBnpNetcdf == false && hasHdf == false)
-    {
-        for(auto &itr : hdf_xspress_files)
-        {
-            if (itr.find(tmp_dataset_file) == 0)
-            {
-                size_t slen = (itr.length()-4) - tmp_dataset_file.length();
-                file_middle = itr.substr(tmp_dataset_file.length(), slen);
-                hasXspress = true;
-                break;
-            }
-        }
-    }
+    const Raw_File_Layout layout = find_raw_file_layout(tmp_dataset_file);
 
     bool ends_in_h5 = false;
     size_t dlen = dataset_file.length();
@@ -873,23 +894,23 @@ bool load_spectra_volume(std::string dataset_directory,
     }
 
     // try to load spectra from mda file
-    if (false == mda_io.load_spectra_volume(dataset_directory+"mda"+DIR_END_CHAR+dataset_file, detector_num, spectra_volume, hasNetcdf | hasBnpNetcdf | hasHdf | hasXspress) )
+    if (false == mda_io.load_spectra_volume(dataset_directory+"mda"+DIR_END_CHAR+dataset_file, detector_num, spectra_volume, layout.has_any()) )
     {
         logE<<"Load spectra "<<dataset_directory+"mda"+DIR_END_CHAR +dataset_file<<"\n";
         return false;
     }
     else
     {
-        if(hasNetcdf)
+        if(layout.hasNetcdf)
         {
-            std::ifstream file_io(dataset_directory + "flyXRF"+ DIR_END_CHAR + tmp_dataset_file + file_middle + "0.nc");
+            std::ifstream file_io(dataset_directory + "flyXRF"+ DIR_END_CHAR + tmp_dataset_file + layout.file_middle + "0.nc");
             if(file_io.is_open())
             {
                 file_io.close();
                 std::string full_filename;
                 for(size_t i=0; i<spectra_volume->rows(); i++)
                 {
-                    full_filename = dataset_directory + "flyXRF"+ DIR_END_CHAR + tmp_dataset_file + file_middle + std::to_string(i) + ".nc";
+                    full_filename = dataset_directory + "flyXRF"+ DIR_END_CHAR + tmp_dataset_file + layout.file_middle + std::to_string(i) + ".nc";
                     //todo: add verbose option
                     //logI<<"Loading file "<<full_filename<<"\n";
                     size_t spec_size = io::file::NetCDF_IO::inst()->load_spectra_line(full_filename, detector_num, &(*spectra_volume)[i]);
@@ -901,13 +922,13 @@ bool load_spectra_volume(std::string dataset_directory,
             }
             else
             {
-                logW<<"Did not find netcdf files "<<dataset_directory + "flyXRF"+ DIR_END_CHAR + tmp_dataset_file + file_middle + "0.nc"<<"\n";
+                logW<<"Did not find netcdf files "<<dataset_directory + "flyXRF"+ DIR_END_CHAR + tmp_dataset_file + layout.file_middle + "0.nc"<<"\n";
                 //return false;
             }
         }
-        else if(hasBnpNetcdf)
+        else if(layout.hasBnpNetcdf)
         {
-            std::ifstream file_io(dataset_directory + "flyXRF"+ DIR_END_CHAR + bnp_netcdf_base_name + "001.nc");
+            std::ifstream file_io(dataset_directory + "flyXRF"+ DIR_END_CHAR + layout.bnp_netcdf_base_name + "001.nc");
             if(file_io.is_open())
             {
                 file_io.close();
@@ -922,7 +943,7 @@ bool load_spectra_volume(std::string dataset_directory,
                         row_idx_str_full += "0";
                     }
                     row_idx_str_full += row_idx_str;
-                    full_filename = dataset_directory + "flyXRF"+ DIR_END_CHAR + bnp_netcdf_base_name + row_idx_str_full + ".nc";
+                    full_filename = dataset_directory + "flyXRF"+ DIR_END_CHAR + layout.bnp_netcdf_base_name + row_idx_str_full + ".nc";
                     size_t prev_size = 0;
                     size_t spec_size = io::file::NetCDF_IO::inst()->load_spectra_line(full_filename, detector_num, &(*spectra_volume)[i]);
                     //
@@ -948,20 +969,20 @@ bool load_spectra_volume(std::string dataset_directory,
             }
             else
             {
-                logW<<"Did not find netcdf files "<<dataset_directory + "flyXRF"+ DIR_END_CHAR + tmp_dataset_file + file_middle + "0.nc"<<"\n";
+                logW<<"Did not find netcdf files "<<dataset_directory + "flyXRF"+ DIR_END_CHAR + tmp_dataset_file + layout.file_middle + "0.nc"<<"\n";
                 //return false;
             }
         }
-        else if (hasHdf)
+        else if (layout.hasHdf)
         {
-            io::file::HDF5_IO::inst()->load_spectra_volume(dataset_directory + "flyXRF.h5"+ DIR_END_CHAR + tmp_dataset_file + file_middle + "0.h5", detector_num, spectra_volume);
+            io::file::HDF5_IO::inst()->load_spectra_volume(dataset_directory + "flyXRF.h5"+ DIR_END_CHAR + tmp_dataset_file + layout.file_middle + "0.h5", detector_num, spectra_volume);
         }
-        else if (hasXspress)
+        else if (layout.hasXspress)
         {
             std::string full_filename;
             for(size_t i=0; i<spectra_volume->rows(); i++)
             {
-                full_filename = dataset_directory + "flyXspress"+ DIR_END_CHAR + tmp_dataset_file + file_middle + std::to_string(i) + ".h5";
+                full_filename = dataset_directory + "flyXspress"+ DIR_END_CHAR + tmp_dataset_file + layout.file_middle + std::to_string(i) + ".h5";
                 io::file::HDF5_IO::inst()->load_spectra_line_xspress3(full_filename, detector_num, &(*spectra_volume)[i]);
             }
         }
@@ -999,6 +1020,250 @@ bool load_spectra_volume(std::string dataset_directory,
 
 // ----------------------------------------------------------------------------
 
+bool load_spectra_volumes(std::string dataset_directory,
+                          std::string dataset_file,
+                          const std::vector<size_t>& detector_num_arr,
+                          std::vector<data_struct::Spectra_Volume*> *spectra_volumes,
+                          const std::vector<data_struct::Params_Override*>& params_overrides,
+                          std::vector<bool> *is_loaded_from_analyazed_h5)
+{
+    if (spectra_volumes == nullptr || is_loaded_from_analyazed_h5 == nullptr || detector_num_arr.size() < 2 || spectra_volumes->size() != detector_num_arr.size() || params_overrides.size() != detector_num_arr.size())
+    {
+        return false;
+    }
+    size_t dlen = dataset_file.length();
+    if (dlen < 4 || dataset_file.substr(dlen - 4) != ".mda")
+    {
+        return false;
+    }
+    is_loaded_from_analyazed_h5->assign(detector_num_arr.size(), false);
+
+    // same lookup order as load_spectra_volume(): analyzed files and netcdf are used before the raw hdf5
+    bool has_analyzed = false;
+    for (size_t detector_num : detector_num_arr)
+    {
+        std::ifstream analyzed_io(dataset_directory + "img.dat" + DIR_END_CHAR + dataset_file + ".h5" + std::to_string(detector_num));
+        if (analyzed_io.is_open())
+        {
+            has_analyzed = true;
+            break;
+        }
+    }
+    std::string tmp_dataset_file = dataset_file.substr(0, dlen - 4);
+    const Raw_File_Layout layout = find_raw_file_layout(tmp_dataset_file);
+
+    if (has_analyzed || false == layout.hasHdf)
+    {
+        // reruns and the other layouts load one detector at a time, closing each detector file before the next one
+        for (size_t i = 0; i < detector_num_arr.size(); i++)
+        {
+            bool loaded_from_analyzed = false;
+            io::file::HDF5_IO::inst()->set_filename(dataset_directory + DIR_END_CHAR + "img.dat" + DIR_END_CHAR + dataset_file + ".h5" + std::to_string(detector_num_arr[i]));
+            bool loaded = load_spectra_volume(dataset_directory, dataset_file, detector_num_arr[i], (*spectra_volumes)[i], params_overrides[i], &loaded_from_analyzed, true);
+            io::file::HDF5_IO::inst()->end_save_seq();
+            if (false == loaded)
+            {
+                return false;
+            }
+            (*is_loaded_from_analyazed_h5)[i] = loaded_from_analyzed;
+        }
+        return true;
+    }
+
+    logI << "Loading dataset " << dataset_directory << "mda" << DIR_END_CHAR << dataset_file << " detectors " << detector_num_arr.size() << "\n";
+
+    // the mda file sizes the volumes and has the scalers, it is the same for every detector
+    io::file::MDA_IO mda_io;
+    if (false == mda_io.load_spectra_volume(dataset_directory + "mda" + DIR_END_CHAR + dataset_file, detector_num_arr[0], (*spectra_volumes)[0], true))
+    {
+        logE << "Load spectra " << dataset_directory + "mda" + DIR_END_CHAR + dataset_file << "\n";
+        return false;
+    }
+    data_struct::Spectra_Volume* first_volume = (*spectra_volumes)[0];
+    for (size_t i = 1; i < spectra_volumes->size(); i++)
+    {
+        (*spectra_volumes)[i]->resize_and_zero(first_volume->rows(), first_volume->cols(), first_volume->samples_size());
+    }
+
+    if (false == io::file::HDF5_IO::inst()->load_spectra_volumes(dataset_directory + "flyXRF.h5" + DIR_END_CHAR + tmp_dataset_file + layout.file_middle + "0.h5", detector_num_arr, spectra_volumes))
+    {
+        mda_io.unload();
+        return false;
+    }
+
+    data_struct::Scan_Info* scan_info = mda_io.get_scan_info();
+    for (size_t i = 0; i < detector_num_arr.size(); i++)
+    {
+        io::file::HDF5_IO::inst()->start_save_seq(dataset_directory + "img.dat" + DIR_END_CHAR + dataset_file + ".h5" + std::to_string(detector_num_arr[i]), true);
+        if (scan_info != nullptr)
+        {
+            // add ELT, ERT, INCNT, OUTCNT of this detector to scaler map
+            std::vector<data_struct::Scaler_Map> scaler_maps = scan_info->scaler_maps;
+            (*spectra_volumes)[i]->generate_scaler_maps(&(scan_info->scaler_maps));
+            io::file::HDF5_IO::inst()->save_scan_scalers(detector_num_arr[i], scan_info, params_overrides[i]);
+            scan_info->scaler_maps = scaler_maps;
+        }
+        io::file::HDF5_IO::inst()->end_save_seq();
+    }
+
+    mda_io.unload();
+    logI << "Finished Loading dataset " << dataset_directory + "mda" + DIR_END_CHAR + dataset_file << "\n";
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void add_spectra_line(data_struct::Spectra_Line *dst, const data_struct::Spectra_Line &src)
+{
+    size_t cols = std::min(dst->size(), src.size());
+    for (size_t col = 0; col < cols; col++)
+    {
+        data_struct::Spectra &dst_spectra = (*dst)[col];
+        const data_struct::Spectra &src_spectra = src[col];
+        if (dst_spectra.size() == src_spectra.size())
+        {
+            dst_spectra.add(src_spectra);
+        }
+        else if (dst_spectra.size() == 0)
+        {
+            dst_spectra = src_spectra;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void cb_sum_spectra_volume_helper(size_t row, size_t col, size_t, size_t, size_t, data_struct::Spectra* spectra, void* user_data)
+{
+    data_struct::Spectra_Volume* spectra_volume = static_cast<data_struct::Spectra_Volume*>(user_data);
+
+    if (spectra_volume != nullptr && spectra != nullptr && row < spectra_volume->rows() && col < spectra_volume->cols())
+    {
+        data_struct::Spectra &dst_spectra = (*spectra_volume)[row][col];
+        if (dst_spectra.size() == spectra->size())
+        {
+            dst_spectra.add(*spectra);
+        }
+        else if (dst_spectra.size() == 0)
+        {
+            dst_spectra = *spectra;
+        }
+    }
+
+    if (spectra != nullptr)
+    {
+        delete spectra;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+// Detector reads are not overlapped with each other. Every HDF5_IO call takes its global mutex because the serial
+// HDF5 library is not thread safe, so a second reader thread would only wait on the first. The netcdf layouts read
+// all detectors of a row file in one pass instead and the raw hdf5 layout sums through one reused row buffer.
+bool load_and_sum_spectra_volume(std::string dataset_directory,
+                                 std::string dataset_file,
+                                 const std::vector<size_t>& detector_num_arr,
+                                 data_struct::Spectra_Volume *spectra_volume,
+                                 data_struct::Params_Override * params_override,
+                                 bool *is_loaded_from_analyazed_h5)
+{
+    if (detector_num_arr.size() == 0 || spectra_volume == nullptr)
+    {
+        return false;
+    }
+
+    // the first detector sets the volume size and saves the scalers
+    if (false == load_spectra_volume(dataset_directory, dataset_file, detector_num_arr[0], spectra_volume, params_override, is_loaded_from_analyazed_h5, true))
+    {
+        return false;
+    }
+    if (detector_num_arr.size() == 1)
+    {
+        return true;
+    }
+
+    std::vector<size_t> sum_detector_num_arr(detector_num_arr.begin() + 1, detector_num_arr.end());
+    std::string tmp_dataset_file = dataset_file.substr(0, dataset_file.size() - 4);
+    Raw_File_Layout layout;
+    if (false == *is_loaded_from_analyazed_h5)
+    {
+        layout = find_raw_file_layout(tmp_dataset_file);
+    }
+
+    logI << "Summing detectors into dataset " << dataset_directory << dataset_file << "\n";
+
+    if (layout.hasNetcdf || layout.hasBnpNetcdf)
+    {
+        // every row file holds all detectors, read them with one open and add each pixel as it comes in
+        std::string full_filename;
+        for (size_t i = 0; i < spectra_volume->rows(); i++)
+        {
+            if (layout.hasNetcdf)
+            {
+                full_filename = dataset_directory + "flyXRF" + DIR_END_CHAR + tmp_dataset_file + layout.file_middle + std::to_string(i) + ".nc";
+            }
+            else
+            {
+                std::string row_idx_str = std::to_string(i + 1);
+                while (row_idx_str.size() < 3)
+                {
+                    row_idx_str = "0" + row_idx_str;
+                }
+                full_filename = dataset_directory + "flyXRF" + DIR_END_CHAR + layout.bnp_netcdf_base_name + row_idx_str + ".nc";
+            }
+            if (false == io::file::NetCDF_IO::inst()->load_spectra_line_with_callback(full_filename, sum_detector_num_arr, (int)i, spectra_volume->rows(), spectra_volume->cols(), cb_sum_spectra_volume_helper, spectra_volume))
+            {
+                logW << "Could not sum detectors for row " << i << " from " << full_filename << "\n";
+            }
+        }
+        return true;
+    }
+    else if (layout.hasHdf)
+    {
+        // every detector row is read into one reused row buffer and added into the volume from there
+        std::vector<data_struct::Spectra_Volume*> sum_volumes(sum_detector_num_arr.size(), spectra_volume);
+        return io::file::HDF5_IO::inst()->load_spectra_volumes(dataset_directory + "flyXRF.h5" + DIR_END_CHAR + tmp_dataset_file + layout.file_middle + "0.h5", sum_detector_num_arr, &sum_volumes, true);
+    }
+    else if (layout.hasXspress)
+    {
+        // one row per file, only a row of the other detectors is held at a time
+        data_struct::Spectra_Line spectra_line;
+        std::string full_filename;
+        for (size_t i = 0; i < spectra_volume->rows(); i++)
+        {
+            full_filename = dataset_directory + "flyXspress" + DIR_END_CHAR + tmp_dataset_file + layout.file_middle + std::to_string(i) + ".h5";
+            for (size_t detector_num : sum_detector_num_arr)
+            {
+                spectra_line.resize_and_zero(spectra_volume->cols(), spectra_volume->samples_size());
+                if (io::file::HDF5_IO::inst()->load_spectra_line_xspress3(full_filename, detector_num, &spectra_line))
+                {
+                    add_spectra_line(&(*spectra_volume)[i], spectra_line);
+                }
+            }
+        }
+        return true;
+    }
+
+    // analyzed and single file layouts only load a whole detector at a time
+    data_struct::Spectra_Volume tmp_spectra_volume;
+    for (size_t detector_num : sum_detector_num_arr)
+    {
+        if (false == load_spectra_volume(dataset_directory, dataset_file, detector_num, &tmp_spectra_volume, params_override, is_loaded_from_analyazed_h5, false))
+        {
+            return false;
+        }
+        size_t rows = std::min(spectra_volume->rows(), tmp_spectra_volume.rows());
+        for (size_t i = 0; i < rows; i++)
+        {
+            add_spectra_line(&(*spectra_volume)[i], tmp_spectra_volume[i]);
+        }
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
 void cb_load_spectra_data_helper(size_t row, size_t col, size_t height, size_t width, size_t detector_num, data_struct::Spectra* spectra, void* user_data)
 {
     data_struct::Spectra* integrated_spectra = nullptr;
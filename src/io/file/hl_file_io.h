@@ -157,6 +157,24 @@ DLL_EXPORT bool load_spectra_volume(std::string dataset_directory,
                          bool *is_loaded_from_analyazed_h5,
                          bool save_scalers);
 
+// Loads all detectors of a mda dataset, saving the scalers of each detector. A raw fly scan whose spectra are in one MAPS_RAW file
+// is read with a single open, analyzed files and the other layouts go through load_spectra_volume() one detector at a time.
+// Returns false for non mda datasets or if a detector fails to load, load_spectra_volume() should be used per detector then.
+DLL_EXPORT bool load_spectra_volumes(std::string dataset_directory,
+                                     std::string dataset_file,
+                                     const std::vector<size_t>& detector_num_arr,
+                                     std::vector<data_struct::Spectra_Volume*> *spectra_volumes,
+                                     const std::vector<data_struct::Params_Override*>& params_overrides,
+                                     std::vector<bool> *is_loaded_from_analyazed_h5);
+
+// Loads the first detector with load_spectra_volume() and adds the other detectors into the same volume while they are read.
+DLL_EXPORT bool load_and_sum_spectra_volume(std::string dataset_directory,
+                                            std::string dataset_file,
+                                            const std::vector<size_t>& detector_num_arr,
+                                            data_struct::Spectra_Volume *spectra_volume,
+                                            data_struct::Params_Override * params_override,
+                                            bool *is_loaded_from_analyazed_h5);
+
 // This is for HDF5 files only
 DLL_EXPORT bool get_scalers_and_metadata_h5(std::string dataset_directory, std::string dataset_file, data_struct::Scan_Info* scan_info);
 
@@ -50,6 +50,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <iostream>
 #include <string>
+#include <algorithm>
 
 
 namespace io
@@ -61,278 +62,321 @@ namespace net
 
 Basic_Serializer::Basic_Serializer()
 {
-    _tmp_real = new char[sizeof(real_t)];
-    _tmp_uint = new char[sizeof(unsigned int)];
-    _tmp_size_t = new char[sizeof(size_t)];
-    _tmp_ushort = new char[sizeof(unsigned short)];
+    _counts_version = SERIALIZER_LEGACY_VERSION;
+    _dictionary_pending = false;
+    _missing_dictionary_id = 0;
 }
 
 Basic_Serializer::~Basic_Serializer()
 {
-    delete[] _tmp_real;
-    delete[] _tmp_uint;
-    delete[] _tmp_size_t;
-    delete[] _tmp_ushort;
+
+}
+
+//-----------------------------------------------------------------------------
+
+size_t Basic_Serializer::_meta_size(data_struct::Stream_Block* stream_block)
+{
+    size_t size = sizeof(unsigned int) + (sizeof(size_t) * 4) + sizeof(real_t);
+    size += stream_block->dataset_name->length() + 1;
+    size += stream_block->dataset_directory->length() + 1;
+    return size;
+}
+
+//-----------------------------------------------------------------------------
+
+size_t Basic_Serializer::_counts_size(data_struct::Stream_Block* stream_block)
+{
+    size_t size = 4;
+    for (const auto& fit_block : stream_block->fitting_blocks)
+    {
+        size += 8;
+        for (const auto& name : fit_block.element_names)
+        {
+            size += name.length() + 1 + sizeof(real_t);
+        }
+    }
+    return size;
+}
+
+//-----------------------------------------------------------------------------
+
+size_t Basic_Serializer::_spectra_max_size(data_struct::Stream_Block* stream_block)
+{
+    if (stream_block->spectra == nullptr)
+    {
+        return 0;
+    }
+    // 4 scalers, spectra size, non zero count, then worst case every channel is an index/value pair
+    return (sizeof(real_t) * 4) + 4 + sizeof(unsigned short) + (stream_block->spectra->size() * (sizeof(unsigned short) + sizeof(real_t)));
 }
 
 //-----------------------------------------------------------------------------
 
-void Basic_Serializer::_encode_meta(data_struct::Stream_Block* stream_block, std::string& raw_msg)
+char* Basic_Serializer::_encode_meta(data_struct::Stream_Block* stream_block, char* cursor)
 {
     //TODO:
     // add something to tell if 4 or 8 byte real
-    _convert_var_to_bytes(&raw_msg, _tmp_uint, stream_block->detector_number(), sizeof(unsigned int));
-    _convert_var_to_bytes(&raw_msg, _tmp_size_t, stream_block->row(), sizeof(size_t));
-    _convert_var_to_bytes(&raw_msg, _tmp_size_t, stream_block->col(), sizeof(size_t));
-    _convert_var_to_bytes(&raw_msg, _tmp_size_t, stream_block->height(), sizeof(size_t));
-    _convert_var_to_bytes(&raw_msg, _tmp_size_t, stream_block->width(), sizeof(size_t));
-    _convert_var_to_bytes(&raw_msg, _tmp_real, stream_block->theta, sizeof(real_t));
-    // dataset name
-    raw_msg += *stream_block->dataset_name;
-    raw_msg += '\0';
-    // dataset directory
-    raw_msg += *stream_block->dataset_directory;
-    raw_msg += '\0';
-
+    _write_var(cursor, stream_block->detector_number(), sizeof(unsigned int));
+    _write_var(cursor, stream_block->row(), sizeof(size_t));
+    _write_var(cursor, stream_block->col(), sizeof(size_t));
+    _write_var(cursor, stream_block->height(), sizeof(size_t));
+    _write_var(cursor, stream_block->width(), sizeof(size_t));
+    _write_var(cursor, (real_t)stream_block->theta, sizeof(real_t));
+    // dataset name and directory, null terminated
+    size_t len = stream_block->dataset_name->length() + 1;
+    memcpy(cursor, stream_block->dataset_name->c_str(), len);
+    cursor += len;
+    len = stream_block->dataset_directory->length() + 1;
+    memcpy(cursor, stream_block->dataset_directory->c_str(), len);
+    cursor += len;
+    return cursor;
 }
 
 //-----------------------------------------------------------------------------
 
-data_struct::Stream_Block* Basic_Serializer::_decode_meta(char* message, size_t message_len, size_t& idx)
+bool Basic_Serializer::_decode_meta(char* message, size_t message_len, size_t& idx, data_struct::Stream_Block* out_stream_block)
 {
-    size_t idx2 = 0;
     int detector_number = 0;
     size_t row = 0;
     size_t col = 0;
     size_t height = 0;
     size_t width = 0;
-    float theta = 0;
-    char tmp_char_arr[4096] = {0};
-
-	size_t first_header_size = (sizeof(size_t) * 4) + sizeof(real_t) + sizeof(unsigned int);
-	if (message_len < first_header_size)
-	{
-		return nullptr;
-	}
-
-    memcpy(&detector_number, message + idx, sizeof(unsigned int));
-    idx += sizeof(unsigned int);
-    memcpy(&row, message + idx, sizeof(size_t));
-    idx += sizeof(size_t);
-    memcpy(&col, message + idx, sizeof(size_t));
-    idx += sizeof(size_t);
-    memcpy(&height, message + idx, sizeof(size_t));
-    idx += sizeof(size_t);
-    memcpy(&width, message + idx, sizeof(size_t));
-    idx += sizeof(size_t);
-    memcpy(&theta, message + idx, sizeof(real_t));
-    idx += sizeof(real_t);
-
-    data_struct::Stream_Block* out_stream_block = new data_struct::Stream_Block(detector_number, row, col, height, width);
+    real_t theta = 0;
 
-    //find dataset name
-    for(size_t i=idx; i < message_len; i++)
+    size_t first_header_size = (sizeof(size_t) * 4) + sizeof(real_t) + sizeof(unsigned int);
+    if (message_len < idx + first_header_size)
     {
-        if(message[i] == '\0')
-        {
-            idx2 = i;
-            break;
-        }
+        return false;
     }
 
-    if( idx2 > 0 && idx2 <message_len)
+    _read_var(message, message_len, idx, detector_number, sizeof(unsigned int));
+    _read_var(message, message_len, idx, row, sizeof(size_t));
+    _read_var(message, message_len, idx, col, sizeof(size_t));
+    _read_var(message, message_len, idx, height, sizeof(size_t));
+    _read_var(message, message_len, idx, width, sizeof(size_t));
+    _read_var(message, message_len, idx, theta, sizeof(real_t));
+
+    out_stream_block->reset(detector_number, row, col, height, width);
+    out_stream_block->theta = theta;
+
+    // a recycled block keeps the strings it owns, assigning reuses their capacity
+    if (false == out_stream_block->del_str_ptr)
     {
-        memset(&tmp_char_arr[0], 0, 4095);
-        if (idx2 > 4095)
-        {
-            memcpy(&tmp_char_arr[0], message+idx, 4095);
-        }
-        else
-        {
-            memcpy(&tmp_char_arr[0], message+idx, idx2 - idx);
-        }
+        out_stream_block->dataset_name = nullptr;
+        out_stream_block->dataset_directory = nullptr;
+        out_stream_block->del_str_ptr = true;
     }
-    idx = idx2+1;
-    out_stream_block->dataset_name = new string(tmp_char_arr);
-    out_stream_block->del_str_ptr = true;
-    //find dataset dir
-    for(size_t i=idx; i < message_len; i++)
+    if (out_stream_block->dataset_name == nullptr)
     {
-        if(message[i] == '\0')
-        {
-            idx2 = i;
-            break;
-        }
+        out_stream_block->dataset_name = new std::string();
     }
-
-    if( idx2 > 0 && idx <message_len)
+    if (out_stream_block->dataset_directory == nullptr)
     {
-        memset(&tmp_char_arr[0], 0, 4095);
-        if (idx2 > 4095)
-        {
-            memcpy(&tmp_char_arr[0], message + idx, 4095);
-        }
-        else
-        {
-            memcpy(&tmp_char_arr[0], message + idx, idx2 - idx);
-        }
+        out_stream_block->dataset_directory = new std::string();
     }
-    idx = idx2+1;
-    out_stream_block->dataset_directory = new string(tmp_char_arr);
 
-    return out_stream_block;
+    //find dataset name
+    const char* term = (const char*)memchr(message + idx, '\0', message_len - idx);
+    size_t str_len = (term != nullptr) ? (size_t)(term - (message + idx)) : (message_len - idx);
+    out_stream_block->dataset_name->assign(message + idx, str_len);
+    idx = std::min(idx + str_len + 1, message_len);
+
+    //find dataset dir
+    term = (const char*)memchr(message + idx, '\0', message_len - idx);
+    str_len = (term != nullptr) ? (size_t)(term - (message + idx)) : (message_len - idx);
+    out_stream_block->dataset_directory->assign(message + idx, str_len);
+    idx = std::min(idx + str_len + 1, message_len);
+
+    return true;
 }
 
 //-----------------------------------------------------------------------------
 
-void Basic_Serializer::_encode_counts(data_struct::Stream_Block* stream_block, std::string& raw_msg)
+char* Basic_Serializer::_encode_counts(data_struct::Stream_Block* stream_block, char* cursor)
 {
-    _convert_var_to_bytes(&raw_msg, _tmp_uint, stream_block->fitting_blocks.size(), 4);
+    _write_var(cursor, stream_block->fitting_blocks.size(), 4);
 
     // iterate through fitting routine
-    for( auto& itr : stream_block->fitting_blocks)
+    for( auto& fit_block : stream_block->fitting_blocks)
     {
-        _convert_var_to_bytes(&raw_msg, _tmp_uint, itr.first, 4);
-        _convert_var_to_bytes(&raw_msg, _tmp_uint, itr.second.fit_counts.size(), 4);
+        _write_var(cursor, fit_block.routine, 4);
+        _write_var(cursor, fit_block.element_names.size(), 4);
         // iterate through elements counts
-        for(auto &itr2 : itr.second.fit_counts)
+        for(size_t i = 0; i < fit_block.element_names.size(); i++)
+        {
+            size_t len = fit_block.element_names[i].length() + 1;
+            memcpy(cursor, fit_block.element_names[i].c_str(), len);
+            cursor += len;
+            _write_var(cursor, fit_block.fit_counts[i], sizeof(real_t));
+        }
+    }
+    return cursor;
+}
+
+//-----------------------------------------------------------------------------
+
+void Basic_Serializer::encode_counts_into(data_struct::Stream_Block* stream_block, std::string& out_msg)
+{
+    if (_counts_version >= SERIALIZER_VERSION)
+    {
+        if (false == _dictionary_matches(stream_block))
         {
-            raw_msg += itr2.first;
-            raw_msg += '\0';
-            _convert_var_to_bytes(&raw_msg, _tmp_real, itr2.second, sizeof(real_t));
+            _build_counts_dictionary(stream_block);
         }
+        out_msg.resize(_header_size() + _meta_size(stream_block) + _dense_counts_size());
+        char* start = &out_msg[0];
+        char* cursor = _encode_header(Message_Type::COUNTS, start);
+        cursor = _encode_meta(stream_block, cursor);
+        cursor = _encode_dense_counts(stream_block, cursor);
+        out_msg.resize(cursor - start);
+        return;
     }
+    out_msg.resize(_meta_size(stream_block) + _counts_size(stream_block));
+    char* start = &out_msg[0];
+    char* cursor = _encode_meta(stream_block, start);
+    cursor = _encode_counts(stream_block, cursor);
+    out_msg.resize(cursor - start);
 }
 
 //-----------------------------------------------------------------------------
 
 std::string Basic_Serializer::encode_counts(data_struct::Stream_Block* stream_block)
 {
-    std::string raw_msg = "";
-    _encode_meta(stream_block, raw_msg);
-    _encode_counts(stream_block, raw_msg);
-	return raw_msg;
+    std::string raw_msg;
+    encode_counts_into(stream_block, raw_msg);
+    return raw_msg;
 }
 
 //-----------------------------------------------------------------------------
 
 void Basic_Serializer::_decode_counts(char* message, size_t message_len, size_t& idx, data_struct::Stream_Block* out_stream_block)
 {
-    size_t idx2 = 0;
     real_t val = 0.0;
     size_t proc_type_count = 0;
     data_struct::Fitting_Routines proc_type;
     size_t fit_block_size = 0;
-    char name[256] = { 0 };
 
-	memcpy(&proc_type_count, message + idx, 4);
-	idx += 4;
+    if (false == _read_var(message, message_len, idx, proc_type_count, 4))
+    {
+        return;
+    }
     for (size_t proc_type_itr = 0; proc_type_itr < proc_type_count; proc_type_itr++)
-	{
-		memcpy(&proc_type, message + idx, 4);
-		idx += 4;
-		out_stream_block->fitting_blocks[proc_type] = data_struct::Stream_Fitting_Block();
-
-		//get fit_block[proc_type] size
-		memcpy(&fit_block_size, message + idx, 4);
-		idx += 4;
+    {
+        if (false == _read_var(message, message_len, idx, proc_type, 4))
+        {
+            return;
+        }
+        data_struct::Stream_Fitting_Block& fit_block = _fitting_block_for(out_stream_block, proc_type);
+
+        //get fit_block[proc_type] size
+        fit_block_size = 0;
+        if (false == _read_var(message, message_len, idx, fit_block_size, 4))
+        {
+            return;
+        }
+        fit_block.element_names.clear();
+        fit_block.fit_counts.clear();
+        fit_block.element_names.reserve(fit_block_size);
+        fit_block.fit_counts.reserve(fit_block_size);
         for (size_t i = 0; i < fit_block_size; i++)
-		{
-			idx2 = idx;
-			// find null term
-			while (idx2 < message_len && message[idx2] != '\0')
-			{
-				idx2++;
-			}
-
-            if (idx2 >= message_len)
-                break;
-
-			memset(&name[0], 0, 255);
-			if (idx2 - idx > 255)
-			{
-				memcpy(&name[0], message + idx, 255);
-			}
-			else
-			{
-				memcpy(&name[0], message + idx, idx2 - idx);
-			}
-			idx = idx2 + 1;
-			memcpy(&val, message + idx, sizeof(real_t));
-			idx += sizeof(real_t);
-			out_stream_block->fitting_blocks[proc_type].fit_counts[std::string(name)] = val;
-		}
-	}
+        {
+            // find null term
+            const char* term = (const char*)memchr(message + idx, '\0', message_len - idx);
+            if (term == nullptr)
+            {
+                return;
+            }
+            size_t name_len = term - (message + idx);
+            size_t name_idx = idx;
+            idx += name_len + 1;
+            if (false == _read_var(message, message_len, idx, val, sizeof(real_t)))
+            {
+                return;
+            }
+            fit_block.element_names.emplace_back(message + name_idx, name_len);
+            fit_block.fit_counts.push_back(val);
+        }
+    }
 }
 
 //-----------------------------------------------------------------------------
 
 data_struct::Stream_Block* Basic_Serializer::decode_counts(char* message, size_t message_len)
 {
+    if (is_versioned(message, message_len))
+    {
+        return _decode_versioned(message, message_len, false);
+    }
     size_t idx = 0;
-    data_struct::Stream_Block* out_stream_block = _decode_meta(message, message_len, idx);
-	if (out_stream_block != nullptr && idx < message_len)
-	{
-		_decode_counts(message, message_len, idx, out_stream_block);
-	}
-	return out_stream_block;
+    data_struct::Stream_Block* out_stream_block = new data_struct::Stream_Block();
+    if (false == _decode_meta(message, message_len, idx, out_stream_block))
+    {
+        delete out_stream_block;
+        return nullptr;
+    }
+    if (idx < message_len)
+    {
+        _decode_counts(message, message_len, idx, out_stream_block);
+    }
+    return out_stream_block;
 }
 
 //-----------------------------------------------------------------------------
 
-void Basic_Serializer::_encode_spectra(data_struct::Stream_Block* stream_block, std::string& raw_msg)
+char* Basic_Serializer::_encode_spectra(data_struct::Stream_Block* stream_block, char* cursor)
 {
-	if (stream_block->spectra == nullptr)
-	{
-		return;
-	}
+    if (stream_block->spectra == nullptr)
+    {
+        return cursor;
+    }
 
-    short send_cnt = 0;
+    const data_struct::Spectra& spectra = *(stream_block->spectra);
+    unsigned int spectra_size = (unsigned int)spectra.size();
 
-    std::map<unsigned short, real_t> spec_indx_values;
+    _write_var(cursor, (real_t)spectra.elapsed_livetime(), sizeof(real_t));
+    _write_var(cursor, (real_t)spectra.elapsed_realtime(), sizeof(real_t));
+    _write_var(cursor, (real_t)spectra.input_counts(), sizeof(real_t));
+    _write_var(cursor, (real_t)spectra.output_counts(), sizeof(real_t));
+    _write_var(cursor, spectra_size, 4);
 
-    _convert_var_to_bytes(&raw_msg, _tmp_real, stream_block->spectra->elapsed_livetime(), sizeof(real_t));
-    _convert_var_to_bytes(&raw_msg, _tmp_real, stream_block->spectra->elapsed_realtime(), sizeof(real_t));
-    _convert_var_to_bytes(&raw_msg, _tmp_real, stream_block->spectra->input_counts(), sizeof(real_t));
-    _convert_var_to_bytes(&raw_msg, _tmp_real, stream_block->spectra->output_counts(), sizeof(real_t));
-    _convert_var_to_bytes(&raw_msg, _tmp_uint, stream_block->spectra->size(), 4);
+    // reserve room for the non zero count and fill it in once the index/value pairs are written
+    char* send_cnt_pos = cursor;
+    cursor += sizeof(unsigned short);
 
-    //first get count of how many
-    for(unsigned short i=0; i<stream_block->spectra->size(); i++)
+    unsigned short send_cnt = 0;
+    const auto* values = spectra.data();
+    for (unsigned int i = 0; i < spectra_size; i++)
     {
-
-        real_t spec_val = (*(stream_block->spectra))[i];
-        if(spec_val > (real_t)0.0)
+        if (values[i] > 0.0f)
         {
+            _write_var(cursor, (unsigned short)i, sizeof(unsigned short));
+            _write_var(cursor, (real_t)values[i], sizeof(real_t));
             send_cnt++;
-            spec_indx_values.emplace(i, spec_val);
         }
     }
 
-    //if we have more than half the spec it doesn't help to to send index/values pairs
-//    if(send_cnt < (stream_block->spectra->size() / 2))
-//    {
-
-    _convert_var_to_bytes(&raw_msg, _tmp_ushort, send_cnt, sizeof(unsigned short));
+    memcpy(send_cnt_pos, &send_cnt, sizeof(unsigned short));
 
-    //encode values
-    for(auto const & itr : spec_indx_values)
-    {
-        _convert_var_to_bytes(&raw_msg, _tmp_ushort, itr.first, sizeof(unsigned short));
-        _convert_var_to_bytes(&raw_msg, _tmp_real, itr.second, sizeof(real_t));
-    }
+    return cursor;
+}
 
-//    }
+//-----------------------------------------------------------------------------
 
+void Basic_Serializer::encode_spectra_into(data_struct::Stream_Block* stream_block, std::string& out_msg)
+{
+    out_msg.resize(_meta_size(stream_block) + _spectra_max_size(stream_block));
+    char* start = &out_msg[0];
+    char* cursor = _encode_meta(stream_block, start);
+    cursor = _encode_spectra(stream_block, cursor);
+    out_msg.resize(cursor - start);
 }
 
 //-----------------------------------------------------------------------------
 
 std::string Basic_Serializer::encode_spectra(data_struct::Stream_Block* stream_block)
 {
-    std::string raw_msg = "";
-    _encode_meta(stream_block, raw_msg);
-    _encode_spectra(stream_block, raw_msg);
+    std::string raw_msg;
+    encode_spectra_into(stream_block, raw_msg);
     return raw_msg;
 }
 
@@ -349,62 +393,115 @@ void Basic_Serializer::_decode_spectra(char* message, size_t message_len, size_t
     unsigned short spec_index = 0;
     real_t spec_value = 0.0f;
 
-    memcpy(&elt, message + idx, sizeof(real_t));
-    idx += sizeof(real_t);
-    memcpy(&ert, message + idx, sizeof(real_t));
-    idx += sizeof(real_t);
-    memcpy(&incnt, message + idx, sizeof(real_t));
-    idx += sizeof(real_t);
-    memcpy(&outcnt, message + idx, sizeof(real_t));
-    idx += sizeof(real_t);
-
-    memcpy(&spectra_size, message + idx, 4);
-    idx += 4;
+    size_t header_size = (sizeof(real_t) * 4) + 4 + sizeof(unsigned short);
+    if (idx + header_size > message_len)
+    {
+        logE << "spectra message truncated!\n";
+        return;
+    }
+
+    _read_var(message, message_len, idx, elt, sizeof(real_t));
+    _read_var(message, message_len, idx, ert, sizeof(real_t));
+    _read_var(message, message_len, idx, incnt, sizeof(real_t));
+    _read_var(message, message_len, idx, outcnt, sizeof(real_t));
+    _read_var(message, message_len, idx, spectra_size, 4);
     if(spectra_size < 1)
     {
         logE<<"spectra_size < 1!\n";
         return;
     }
-    out_stream_block->spectra = new data_struct::Spectra(spectra_size);
-    out_stream_block->spectra->elapsed_livetime(elt);
-    out_stream_block->spectra->elapsed_realtime(ert);
-    out_stream_block->spectra->input_counts(incnt);
-    out_stream_block->spectra->output_counts(outcnt);
+    out_stream_block->alloc_spectra(spectra_size, elt, ert, incnt, outcnt);
 
-    memcpy(&recv_cnt, message + idx, sizeof(unsigned short));
-    idx += sizeof(unsigned short);
+    _read_var(message, message_len, idx, recv_cnt, sizeof(unsigned short));
+
+    const size_t pair_size = sizeof(unsigned short) + sizeof(real_t);
+    if (idx + (recv_cnt * pair_size) > message_len)
+    {
+        logE << "spectra message truncated, expected " << recv_cnt << " channels\n";
+        recv_cnt = (unsigned short)((message_len - idx) / pair_size);
+    }
 
+    auto* values = out_stream_block->spectra->data();
     for (unsigned short i = 0; i < recv_cnt; i++)
     {
         memcpy(&spec_index, message + idx, sizeof(unsigned short));
         idx += sizeof(unsigned short);
         memcpy(&spec_value, message + idx, sizeof(real_t));
         idx += sizeof(real_t);
-        (*(out_stream_block->spectra))[spec_index] = spec_value;
+        if (spec_index < spectra_size)
+        {
+            values[spec_index] = spec_value;
+        }
     }
 }
 
 //-----------------------------------------------------------------------------
 
-data_struct::Stream_Block* Basic_Serializer::decode_spectra(char* message, size_t message_len)
+bool Basic_Serializer::decode_spectra_into(char* message, size_t message_len, data_struct::Stream_Block* out_stream_block)
 {
+    if (is_versioned(message, message_len))
+    {
+        logW << "Spectra messages are not versioned, batches have to be split with for_each_in_batch() before decoding\n";
+        return false;
+    }
     size_t idx = 0;
-    data_struct::Stream_Block* out_stream_block = _decode_meta(message, message_len, idx);
-	if (out_stream_block != nullptr && idx < message_len)
-	{
-		_decode_spectra(message, message_len, idx, out_stream_block);
-	}
-	return out_stream_block;
+    if (false == _decode_meta(message, message_len, idx, out_stream_block))
+    {
+        return false;
+    }
+    if (idx < message_len)
+    {
+        _decode_spectra(message, message_len, idx, out_stream_block);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+data_struct::Stream_Block* Basic_Serializer::decode_spectra(char* message, size_t message_len)
+{
+    data_struct::Stream_Block* out_stream_block = new data_struct::Stream_Block();
+    if (false == decode_spectra_into(message, message_len, out_stream_block))
+    {
+        delete out_stream_block;
+        return nullptr;
+    }
+    return out_stream_block;
+}
+
+//-----------------------------------------------------------------------------
+
+void Basic_Serializer::encode_counts_and_spectra_into(data_struct::Stream_Block* stream_block, std::string& out_msg)
+{
+    if (_counts_version >= SERIALIZER_VERSION)
+    {
+        if (false == _dictionary_matches(stream_block))
+        {
+            _build_counts_dictionary(stream_block);
+        }
+        out_msg.resize(_header_size() + _meta_size(stream_block) + _dense_counts_size() + _spectra_max_size(stream_block));
+        char* start = &out_msg[0];
+        char* cursor = _encode_header(Message_Type::COUNTS_AND_SPECTRA, start);
+        cursor = _encode_meta(stream_block, cursor);
+        cursor = _encode_dense_counts(stream_block, cursor);
+        cursor = _encode_spectra(stream_block, cursor);
+        out_msg.resize(cursor - start);
+        return;
+    }
+    out_msg.resize(_meta_size(stream_block) + _counts_size(stream_block) + _spectra_max_size(stream_block));
+    char* start = &out_msg[0];
+    char* cursor = _encode_meta(stream_block, start);
+    cursor = _encode_counts(stream_block, cursor);
+    cursor = _encode_spectra(stream_block, cursor);
+    out_msg.resize(cursor - start);
 }
 
 //-----------------------------------------------------------------------------
 
 std::string Basic_Serializer::encode_counts_and_spectra(data_struct::Stream_Block* in_stream_block)
 {
-    std::string raw_msg = "";
-    _encode_meta(in_stream_block, raw_msg);
-    _encode_counts(in_stream_block, raw_msg);
-    _encode_spectra(in_stream_block, raw_msg);
+    std::string raw_msg;
+    encode_counts_and_spectra_into(in_stream_block, raw_msg);
     return raw_msg;
 }
 
@@ -412,19 +509,366 @@ std::string Basic_Serializer::encode_counts_and_spectra(data_struct::Stream_Bloc
 
 data_struct::Stream_Block* Basic_Serializer::decode_counts_and_spectra(char* message, size_t message_len)
 {
+    if (is_versioned(message, message_len))
+    {
+        return _decode_versioned(message, message_len, true);
+    }
     size_t idx = 0;
-    data_struct::Stream_Block* out_stream_block = _decode_meta(message, message_len, idx);
-	if (out_stream_block != nullptr)
-	{
-		if (idx < message_len)
-		{
-			_decode_counts(message, message_len, idx, out_stream_block);
-		}
-		if (idx < message_len)
-		{
-			_decode_spectra(message, message_len, idx, out_stream_block);
-		}
-	}
+    data_struct::Stream_Block* out_stream_block = new data_struct::Stream_Block();
+    if (false == _decode_meta(message, message_len, idx, out_stream_block))
+    {
+        delete out_stream_block;
+        return nullptr;
+    }
+    if (idx < message_len)
+    {
+        _decode_counts(message, message_len, idx, out_stream_block);
+    }
+    if (idx < message_len)
+    {
+        _decode_spectra(message, message_len, idx, out_stream_block);
+    }
+    return out_stream_block;
+}
+
+//-----------------------------------------------------------------------------
+
+char* Basic_Serializer::_encode_header(Message_Type msg_type, char* cursor)
+{
+    _write_var(cursor, SERIALIZER_MAGIC, sizeof(unsigned int));
+    _write_var(cursor, SERIALIZER_VERSION, sizeof(unsigned short));
+    _write_var(cursor, msg_type, sizeof(unsigned short));
+    _write_var(cursor, _encode_dictionary.id, sizeof(unsigned int));
+    return cursor;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Basic_Serializer::_decode_header(char* message, size_t message_len, size_t& idx, unsigned short& version, Message_Type& msg_type, unsigned int& dict_id)
+{
+    unsigned int magic = 0;
+    if (idx + _header_size() > message_len)
+    {
+        return false;
+    }
+    _read_var(message, message_len, idx, magic, sizeof(unsigned int));
+    if (magic != SERIALIZER_MAGIC)
+    {
+        return false;
+    }
+    _read_var(message, message_len, idx, version, sizeof(unsigned short));
+    _read_var(message, message_len, idx, msg_type, sizeof(unsigned short));
+    _read_var(message, message_len, idx, dict_id, sizeof(unsigned int));
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Basic_Serializer::_dictionary_matches(data_struct::Stream_Block* stream_block)
+{
+    // a new dataset always gets a new dictionary so late subscribers can pick it up at the start of a scan
+    if (_encode_dictionary.id == 0
+        || stream_block->fitting_blocks.size() != _encode_dictionary.routines.size()
+        || *stream_block->dataset_name != _encode_dictionary.dataset_name
+        || *stream_block->dataset_directory != _encode_dictionary.dataset_directory)
+    {
+        return false;
+    }
+
+    for (size_t r = 0; r < _encode_dictionary.routines.size(); r++)
+    {
+        const data_struct::Stream_Fitting_Block& fit_block = stream_block->fitting_blocks[r];
+        if (fit_block.routine != _encode_dictionary.routines[r]
+            || fit_block.fit_counts.size() != fit_block.element_names.size()
+            || fit_block.element_names != _encode_dictionary.names[r])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void Basic_Serializer::_build_counts_dictionary(data_struct::Stream_Block* stream_block)
+{
+    // counts are packed in the order of the fitting blocks, init_fitting_blocks() keeps them sorted
+    _encode_dictionary.clear();
+    _encode_dictionary.id++;
+    _encode_dictionary.dataset_name = *stream_block->dataset_name;
+    _encode_dictionary.dataset_directory = *stream_block->dataset_directory;
+
+    for (const auto& fit_block : stream_block->fitting_blocks)
+    {
+        _encode_dictionary.routines.push_back(fit_block.routine);
+        _encode_dictionary.names.push_back(fit_block.element_names);
+    }
+    _dictionary_pending = true;
+}
+
+//-----------------------------------------------------------------------------
+
+data_struct::Stream_Fitting_Block& Basic_Serializer::_fitting_block_for(data_struct::Stream_Block* stream_block, data_struct::Fitting_Routines routine)
+{
+    data_struct::Stream_Fitting_Block* fit_block = stream_block->fitting_block(routine);
+    if (fit_block == nullptr)
+    {
+        stream_block->fitting_blocks.emplace_back();
+        fit_block = &stream_block->fitting_blocks.back();
+        fit_block->routine = routine;
+    }
+    return *fit_block;
+}
+
+//-----------------------------------------------------------------------------
+
+size_t Basic_Serializer::_dense_counts_size()
+{
+    size_t size = 4;
+    for (const auto& names : _encode_dictionary.names)
+    {
+        size += 8 + (names.size() * sizeof(real_t));
+    }
+    return size;
+}
+
+//-----------------------------------------------------------------------------
+
+char* Basic_Serializer::_encode_dense_counts(data_struct::Stream_Block* stream_block, char* cursor)
+{
+    _write_var(cursor, (unsigned int)_encode_dictionary.routines.size(), 4);
+    for (size_t r = 0; r < _encode_dictionary.routines.size(); r++)
+    {
+        const std::vector<real_t>& values = stream_block->fitting_blocks[r].fit_counts;
+        _write_var(cursor, _encode_dictionary.routines[r], 4);
+        _write_var(cursor, (unsigned int)values.size(), 4);
+        memcpy(cursor, values.data(), values.size() * sizeof(real_t));
+        cursor += values.size() * sizeof(real_t);
+    }
+    return cursor;
+}
+
+//-----------------------------------------------------------------------------
+
+void Basic_Serializer::encode_counts_dictionary_into(std::string& out_msg)
+{
+    size_t size = _header_size() + 4;
+    for (const auto& names : _encode_dictionary.names)
+    {
+        size += 8;
+        for (const auto& name : names)
+        {
+            size += name.length() + 1;
+        }
+    }
+
+    out_msg.resize(size);
+    char* cursor = _encode_header(Message_Type::COUNTS_DICTIONARY, &out_msg[0]);
+    _write_var(cursor, (unsigned int)_encode_dictionary.routines.size(), 4);
+    for (size_t r = 0; r < _encode_dictionary.routines.size(); r++)
+    {
+        _write_var(cursor, _encode_dictionary.routines[r], 4);
+        _write_var(cursor, (unsigned int)_encode_dictionary.names[r].size(), 4);
+        for (const auto& name : _encode_dictionary.names[r])
+        {
+            memcpy(cursor, name.c_str(), name.length() + 1);
+            cursor += name.length() + 1;
+        }
+    }
+    _dictionary_pending = false;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Basic_Serializer::is_versioned(char* message, size_t message_len)
+{
+    unsigned int magic = 0;
+    if (message_len < sizeof(unsigned int))
+    {
+        return false;
+    }
+    memcpy(&magic, message, sizeof(unsigned int));
+    return magic == SERIALIZER_MAGIC;
+}
+
+//-----------------------------------------------------------------------------
+
+void Basic_Serializer::batch_begin(std::string& out_batch)
+{
+    unsigned int count = 0;
+    out_batch.resize(_header_size() + sizeof(unsigned int));
+    char* cursor = _encode_header(Message_Type::BATCH, &out_batch[0]);
+    _write_var(cursor, count, sizeof(unsigned int));
+}
+
+//-----------------------------------------------------------------------------
+
+void Basic_Serializer::batch_append(std::string& out_batch, const std::string& msg)
+{
+    unsigned int count = 0;
+    unsigned int msg_len = (unsigned int)msg.length();
+    size_t offset = out_batch.length();
+
+    out_batch.resize(offset + sizeof(unsigned int) + msg.length());
+    char* cursor = &out_batch[offset];
+    _write_var(cursor, msg_len, sizeof(unsigned int));
+    memcpy(cursor, msg.data(), msg.length());
+
+    // bump the entry count right after the header
+    memcpy(&count, &out_batch[_header_size()], sizeof(unsigned int));
+    count++;
+    memcpy(&out_batch[_header_size()], &count, sizeof(unsigned int));
+}
+
+//-----------------------------------------------------------------------------
+
+bool Basic_Serializer::is_batch(char* message, size_t message_len)
+{
+    size_t idx = 0;
+    unsigned short version = 0;
+    Message_Type msg_type = Message_Type::COUNTS;
+    unsigned int dict_id = 0;
+    return _decode_header(message, message_len, idx, version, msg_type, dict_id) && msg_type == Message_Type::BATCH;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Basic_Serializer::is_counts_dictionary(char* message, size_t message_len)
+{
+    size_t idx = 0;
+    unsigned short version = 0;
+    Message_Type msg_type = Message_Type::COUNTS;
+    unsigned int dict_id = 0;
+    return _decode_header(message, message_len, idx, version, msg_type, dict_id) && msg_type == Message_Type::COUNTS_DICTIONARY;
+}
+
+//-----------------------------------------------------------------------------
+
+void Basic_Serializer::_decode_counts_dictionary(char* message, size_t message_len, size_t& idx, unsigned int dict_id)
+{
+    unsigned int num_routines = 0;
+    unsigned int num_names = 0;
+    data_struct::Fitting_Routines proc_type;
+
+    _decode_dictionary.clear();
+    _decode_dictionary.id = 0;
+    if (false == _read_var(message, message_len, idx, num_routines, 4))
+    {
+        return;
+    }
+    for (unsigned int r = 0; r < num_routines; r++)
+    {
+        if (false == _read_var(message, message_len, idx, proc_type, 4) || false == _read_var(message, message_len, idx, num_names, 4))
+        {
+            logE << "counts dictionary message truncated\n";
+            return;
+        }
+        std::vector<std::string> names;
+        names.reserve(num_names);
+        for (unsigned int i = 0; i < num_names; i++)
+        {
+            const char* term = (const char*)memchr(message + idx, '\0', message_len - idx);
+            if (term == nullptr)
+            {
+                logE << "counts dictionary message truncated\n";
+                return;
+            }
+            size_t name_len = term - (message + idx);
+            names.emplace_back(message + idx, name_len);
+            idx += name_len + 1;
+        }
+        _decode_dictionary.routines.push_back(proc_type);
+        _decode_dictionary.names.push_back(names);
+    }
+    _decode_dictionary.id = dict_id;
+}
+
+//-----------------------------------------------------------------------------
+
+void Basic_Serializer::_decode_dense_counts(char* message, size_t message_len, size_t& idx, unsigned int dict_id, data_struct::Stream_Block* out_stream_block)
+{
+    unsigned int num_routines = 0;
+    unsigned int num_values = 0;
+    data_struct::Fitting_Routines proc_type;
+
+    if (false == _read_var(message, message_len, idx, num_routines, 4))
+    {
+        return;
+    }
+    bool have_dictionary = (dict_id == _decode_dictionary.id && num_routines == _decode_dictionary.routines.size());
+    if (false == have_dictionary && dict_id != _missing_dictionary_id)
+    {
+        logW << "Missing counts dictionary " << dict_id << ", skipping counts until it is received\n";
+        _missing_dictionary_id = dict_id;
+    }
+    for (unsigned int r = 0; r < num_routines; r++)
+    {
+        if (false == _read_var(message, message_len, idx, proc_type, 4) || false == _read_var(message, message_len, idx, num_values, 4))
+        {
+            return;
+        }
+        if (idx + (num_values * sizeof(real_t)) > message_len)
+        {
+            logE << "counts message truncated\n";
+            idx = message_len;
+            return;
+        }
+        if (false == have_dictionary || proc_type != _decode_dictionary.routines[r] || num_values != _decode_dictionary.names[r].size())
+        {
+            idx += num_values * sizeof(real_t);
+            continue;
+        }
+        data_struct::Stream_Fitting_Block& fit_block = _fitting_block_for(out_stream_block, proc_type);
+        fit_block.element_names = _decode_dictionary.names[r];
+        fit_block.fit_counts.resize(num_values);
+        memcpy(fit_block.fit_counts.data(), message + idx, num_values * sizeof(real_t));
+        idx += num_values * sizeof(real_t);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+data_struct::Stream_Block* Basic_Serializer::_decode_versioned(char* message, size_t message_len, bool with_spectra)
+{
+    size_t idx = 0;
+    unsigned short version = 0;
+    Message_Type msg_type = Message_Type::COUNTS;
+    unsigned int dict_id = 0;
+
+    if (false == _decode_header(message, message_len, idx, version, msg_type, dict_id))
+    {
+        return nullptr;
+    }
+    if (version > SERIALIZER_VERSION)
+    {
+        logW << "Message version " << version << " is newer than supported version " << SERIALIZER_VERSION << "\n";
+    }
+
+    if (msg_type == Message_Type::COUNTS_DICTIONARY)
+    {
+        _decode_counts_dictionary(message, message_len, idx, dict_id);
+        return nullptr;
+    }
+    if (msg_type == Message_Type::BATCH)
+    {
+        logW << "Batch messages have to be split with for_each_in_batch() before decoding\n";
+        return nullptr;
+    }
+
+    data_struct::Stream_Block* out_stream_block = new data_struct::Stream_Block();
+    if (false == _decode_meta(message, message_len, idx, out_stream_block))
+    {
+        delete out_stream_block;
+        return nullptr;
+    }
+    if (idx < message_len)
+    {
+        _decode_dense_counts(message, message_len, idx, dict_id, out_stream_block);
+    }
+    if (with_spectra && msg_type == Message_Type::COUNTS_AND_SPECTRA && idx < message_len)
+    {
+        _decode_spectra(message, message_len, idx, out_stream_block);
+    }
     return out_stream_block;
 }
 
@@ -52,12 +52,55 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "core/defines.h"
 #include "data_struct/stream_block.h"
+#include <cstring>
+#include <vector>
 
 namespace io
 {
 namespace net
 {
 
+//-----------------------------------------------------------------------------
+
+// Versioned messages start with this marker. Version 1 (legacy) messages start with the detector number
+// which can never be this value, so both formats can be decoded from the same stream.
+const unsigned int SERIALIZER_MAGIC = 0x4D465258; // "XRFM"
+
+const unsigned short SERIALIZER_LEGACY_VERSION = 1;
+// Version 2 sends element names once in a dictionary message and dense value arrays per pixel
+const unsigned short SERIALIZER_VERSION = 2;
+
+enum class Message_Type : unsigned short { COUNTS_DICTIONARY=1, COUNTS=2, COUNTS_AND_SPECTRA=3, BATCH=4 };
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Counts_Dictionary struct : fitting routines and element names in the order their counts are packed.
+///
+struct Counts_Dictionary
+{
+    Counts_Dictionary() { id = 0; }
+
+    void clear()
+    {
+        routines.clear();
+        names.clear();
+    }
+
+    unsigned int id;
+
+    std::string dataset_name;
+
+    std::string dataset_directory;
+
+    std::vector<data_struct::Fitting_Routines> routines;
+
+    // by routine index
+    std::vector<std::vector<std::string> > names;
+};
+
+//-----------------------------------------------------------------------------
+
 class DLL_EXPORT Basic_Serializer
 {
 public:
@@ -74,35 +117,138 @@ public:
 
     data_struct::Stream_Block* decode_spectra(char* message, size_t message_len);
 
+    // Decode into a recycled stream block, its spectra and owned dataset strings are reused. Returns false if the header could not be decoded.
+    bool decode_spectra_into(char* message, size_t message_len, data_struct::Stream_Block* out_stream_block);
+
     std::string encode_counts_and_spectra(data_struct::Stream_Block* in_stream_block);
 
     data_struct::Stream_Block* decode_counts_and_spectra(char* message, size_t message_len);
 
+    // Encode into a caller owned buffer. The buffer is resized to the worst case message size
+    // and trimmed afterwards, so reusing it across pixels keeps its capacity and avoids reallocating.
+    void encode_counts_into(data_struct::Stream_Block* in_stream_block, std::string& out_msg);
+
+    void encode_spectra_into(data_struct::Stream_Block* in_stream_block, std::string& out_msg);
+
+    void encode_counts_and_spectra_into(data_struct::Stream_Block* in_stream_block, std::string& out_msg);
+
+    // Version used when encoding counts. Decoding accepts every version.
+    void set_counts_format_version(unsigned short version) { _counts_version = version; }
+
+    unsigned short counts_format_version() { return _counts_version; }
+
+    // True after a version 2 counts encode built a new dictionary (first pixel, new dataset, or element list changed).
+    // The dictionary message has to be sent before the counts message that triggered it.
+    bool counts_dictionary_pending() { return _dictionary_pending; }
+
+    void encode_counts_dictionary_into(std::string& out_msg);
+
+    bool is_versioned(char* message, size_t message_len);
+
+    // A batch packs several encoded messages (any version) into one, each prefixed by its length.
+    void batch_begin(std::string& out_batch);
+
+    void batch_append(std::string& out_batch, const std::string& msg);
+
+    bool is_batch(char* message, size_t message_len);
+
+    // Calls func(char* entry, size_t entry_len) for every message in a batch. Returns the number of entries.
+    template <typename F>
+    size_t for_each_in_batch(char* message, size_t message_len, F func)
+    {
+        size_t idx = _header_size();
+        unsigned int count = 0;
+        unsigned int entry_len = 0;
+        if (false == is_batch(message, message_len) || false == _read_var(message, message_len, idx, count, sizeof(unsigned int)))
+        {
+            return 0;
+        }
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (false == _read_var(message, message_len, idx, entry_len, sizeof(unsigned int)) || idx + entry_len > message_len)
+            {
+                logE << "batch message truncated at entry " << i << " of " << count << "\n";
+                return i;
+            }
+            func(message + idx, (size_t)entry_len);
+            idx += entry_len;
+        }
+        return count;
+    }
+
+    // Decode functions return nullptr for dictionary messages, the dictionary is kept for the following counts messages.
+    bool is_counts_dictionary(char* message, size_t message_len);
+
 protected:
-	template <typename T>
-	void _convert_var_to_bytes(std::string * str, char* bytes_temp, T variable, size_t size)
-	{
-		memcpy(bytes_temp, (char*)(&variable), size);
-        for (size_t i = 0; i < size; i++)
-			*str += bytes_temp[i];
-	}
 
-    void _encode_meta(data_struct::Stream_Block* stream_block, std::string& raw_msg);
+    template <typename T>
+    inline void _write_var(char*& cursor, T variable, size_t size)
+    {
+        memcpy(cursor, (char*)(&variable), size);
+        cursor += size;
+    }
+
+    template <typename T>
+    inline bool _read_var(const char* message, size_t message_len, size_t& idx, T& variable, size_t size)
+    {
+        if (idx + size > message_len)
+        {
+            return false;
+        }
+        memcpy((char*)(&variable), message + idx, size);
+        idx += size;
+        return true;
+    }
+
+    inline size_t _header_size() { return (sizeof(unsigned int) * 2) + (sizeof(unsigned short) * 2); }
+
+    bool _decode_header(char* message, size_t message_len, size_t& idx, unsigned short& version, Message_Type& msg_type, unsigned int& dict_id);
+
+    char* _encode_header(Message_Type msg_type, char* cursor);
+
+    bool _dictionary_matches(data_struct::Stream_Block* stream_block);
+
+    void _build_counts_dictionary(data_struct::Stream_Block* stream_block);
+
+    data_struct::Stream_Fitting_Block& _fitting_block_for(data_struct::Stream_Block* stream_block, data_struct::Fitting_Routines routine);
+
+    size_t _dense_counts_size();
 
-    void _encode_counts(data_struct::Stream_Block* stream_block, std::string& raw_msg);
+    char* _encode_dense_counts(data_struct::Stream_Block* stream_block, char* cursor);
 
-    void _encode_spectra(data_struct::Stream_Block* stream_block, std::string& raw_msg);
+    void _decode_counts_dictionary(char* message, size_t message_len, size_t& idx, unsigned int dict_id);
 
-    data_struct::Stream_Block* _decode_meta(char* message, size_t message_len, size_t& idx);
+    void _decode_dense_counts(char* message, size_t message_len, size_t& idx, unsigned int dict_id, data_struct::Stream_Block* out_stream_block);
+
+    data_struct::Stream_Block* _decode_versioned(char* message, size_t message_len, bool with_spectra);
+
+    size_t _meta_size(data_struct::Stream_Block* stream_block);
+
+    size_t _counts_size(data_struct::Stream_Block* stream_block);
+
+    size_t _spectra_max_size(data_struct::Stream_Block* stream_block);
+
+    char* _encode_meta(data_struct::Stream_Block* stream_block, char* cursor);
+
+    char* _encode_counts(data_struct::Stream_Block* stream_block, char* cursor);
+
+    char* _encode_spectra(data_struct::Stream_Block* stream_block, char* cursor);
+
+    bool _decode_meta(char* message, size_t message_len, size_t& idx, data_struct::Stream_Block* out_stream_block);
 
     void _decode_counts(char* message, size_t message_len, size_t& idx, data_struct::Stream_Block* out_stream_block);
 
     void _decode_spectra(char* message, size_t message_len, size_t& idx, data_struct::Stream_Block* out_stream_block);
 
-    char *_tmp_real;
-    char *_tmp_uint;
-    char *_tmp_size_t;
-    char *_tmp_ushort;
+    unsigned short _counts_version;
+
+    bool _dictionary_pending;
+
+    Counts_Dictionary _encode_dictionary;
+
+    Counts_Dictionary _decode_dictionary;
+
+    unsigned int _missing_dictionary_id;
 
 };
 
@@ -286,12 +286,17 @@ PYBIND11_MODULE(pyxrfmaps, m) {
     */
     py::class_<data_struct::Stream_Fitting_Block>(m, "StreamFittingBlock")
     .def(py::init<>())
+    .def("index_of", &data_struct::Stream_Fitting_Block::index_of)
+    .def("count", &data_struct::Stream_Fitting_Block::count)
+    .def_readwrite("routine", &data_struct::Stream_Fitting_Block::routine)
     .def_readwrite("fit_routine", &data_struct::Stream_Fitting_Block::fit_routine)
+    .def_readwrite("element_names", &data_struct::Stream_Fitting_Block::element_names)
     .def_readwrite("fit_counts", &data_struct::Stream_Fitting_Block::fit_counts);
 
     py::class_<data_struct::Stream_Block>(m, "StreamBlock")
     .def(py::init<>())
     .def("init_fitting_blocks", &data_struct::Stream_Block::init_fitting_blocks)
+    .def("fitting_block", &data_struct::Stream_Block::fitting_block, py::return_value_policy::reference_internal)
     .def("row", &data_struct::Stream_Block::row)
     .def("col", &data_struct::Stream_Block::col)
     .def("height", &data_struct::Stream_Block::height)
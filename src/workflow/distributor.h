@@ -101,7 +101,11 @@ public:
         _dist_func = dist_func;
     }
 
-    inline bool is_queue_empty() { return _job_queue.empty(); }
+    inline bool is_queue_empty()
+    {
+        std::unique_lock<std::mutex> lock(_queue_mutex);
+        return _job_queue.empty();
+    }
 
     T_OUT front_pop()
     {
@@ -0,0 +1,170 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+
+#ifndef Object_Pool_H
+#define Object_Pool_H
+
+#include "core/defines.h"
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace workflow
+{
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Object_Pool class : thread safe free list of reusable objects.
+/// Objects are created on demand up to max_size, after that acquire() blocks until one is released.
+/// A max_size of 0 never blocks. The pool owns every object it created and deletes them on destruction.
+///
+template<typename T>
+class Object_Pool
+{
+
+public:
+
+    Object_Pool(size_t max_size = 0, std::function<T* (void)> alloc_func = nullptr)
+    {
+        _max_size = max_size;
+        _alloc_func = alloc_func;
+    }
+
+    Object_Pool(const Object_Pool &) = delete;
+
+    Object_Pool& operator=(const Object_Pool&) = delete;
+
+    ~Object_Pool()
+    {
+        for (T* obj : _all)
+        {
+            delete obj;
+        }
+        _all.clear();
+        _free.clear();
+    }
+
+    // create objects up front so the steady state never allocates
+    void preallocate(size_t count)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (_all.size() < count && (_max_size == 0 || _all.size() < _max_size))
+        {
+            T* obj = _alloc();
+            _all.push_back(obj);
+            _free.push_back(obj);
+        }
+    }
+
+    T* acquire()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_free.empty() && (_max_size == 0 || _all.size() < _max_size))
+        {
+            T* obj = _alloc();
+            _all.push_back(obj);
+            return obj;
+        }
+        _condition.wait(lock, [this] { return false == _free.empty(); });
+        T* obj = _free.back();
+        _free.pop_back();
+        return obj;
+    }
+
+    void release(T* obj)
+    {
+        if (obj == nullptr)
+        {
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _free.push_back(obj);
+        }
+        _condition.notify_one();
+    }
+
+    size_t max_size() { return _max_size; }
+
+    size_t size()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _all.size();
+    }
+
+protected:
+
+    T* _alloc()
+    {
+        if (_alloc_func != nullptr)
+        {
+            return _alloc_func();
+        }
+        return new T();
+    }
+
+    size_t _max_size;
+
+    std::function<T* (void)> _alloc_func;
+
+    std::vector<T*> _all;
+
+    std::vector<T*> _free;
+
+    std::mutex _mutex;
+
+    std::condition_variable _condition;
+
+};
+
+//-----------------------------------------------------------------------------
+
+} //namespace workflow
+
+#endif // Object_Pool_H
@@ -54,6 +54,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "workflow/source.h"
 #include "workflow/distributor.h"
 #include "workflow/sink.h"
+#include "workflow/stage.h"
+#include <vector>
 
 namespace workflow
 {
@@ -108,6 +110,120 @@ protected:
 
 };
 
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Stage_Pipeline class : linear chain of typed stages between a source and a sink,
+/// e.g. decode -> fit[ROI] -> fit[NNLS] -> save. Every stage has its own threads and bounded queue.
+///
+class Stage_Pipeline
+{
+
+public:
+
+    Stage_Pipeline()
+    {
+
+    }
+
+    Stage_Pipeline(const Stage_Pipeline &) = delete;
+
+    Stage_Pipeline& operator=(const Stage_Pipeline&) = delete;
+
+    ~Stage_Pipeline()
+    {
+        // front to back so every stage is drained before the one it feeds goes away
+        for (Base_Stage* stage : _stages)
+        {
+            delete stage;
+        }
+        _stages.clear();
+    }
+
+    // Appends a stage fed by the last one. Returns nullptr if the last stage does not produce T_IN.
+    template<typename T_IN, typename T_OUT>
+    Stage<T_IN, T_OUT>* add_stage(std::string name, std::function<T_OUT (T_IN)> func, size_t num_threads = 1, size_t queue_size = 0, bool ordered = true)
+    {
+        Stage_Output<T_IN>* prev = nullptr;
+        if (false == _stages.empty())
+        {
+            prev = dynamic_cast<Stage_Output<T_IN>*>(_stages.back());
+            if (prev == nullptr)
+            {
+                logE << "Input of stage " << name << " does not match the output of stage " << _stages.back()->name() << "\n";
+                return nullptr;
+            }
+        }
+        Stage<T_IN, T_OUT>* stage = new Stage<T_IN, T_OUT>(name, func, num_threads, queue_size, ordered);
+        if (prev != nullptr)
+        {
+            prev->connect(std::bind(&Stage<T_IN, T_OUT>::push, stage, std::placeholders::_1));
+        }
+        _stages.push_back(stage);
+        return stage;
+    }
+
+    template<typename T>
+    bool connect_source(Source<T>* source)
+    {
+        Stage_Input<T>* first = _stages.empty() ? nullptr : dynamic_cast<Stage_Input<T>*>(_stages.front());
+        if (first == nullptr)
+        {
+            logE << "Source output does not match the input of the first stage\n";
+            return false;
+        }
+        source->connect(std::bind(&Stage_Input<T>::push, first, std::placeholders::_1));
+        return true;
+    }
+
+    template<typename T>
+    bool connect_sink(Sink<T>* sink)
+    {
+        Stage_Output<T>* last = _stages.empty() ? nullptr : dynamic_cast<Stage_Output<T>*>(_stages.back());
+        if (last == nullptr)
+        {
+            logE << "Sink input does not match the output of the last stage\n";
+            return false;
+        }
+        last->connect(sink);
+        return true;
+    }
+
+    // blocks until every item the source pushed has left the last stage
+    void wait_idle()
+    {
+        for (Base_Stage* stage : _stages)
+        {
+            stage->wait_idle();
+        }
+    }
+
+    std::vector<Stage_Stats> stats()
+    {
+        std::vector<Stage_Stats> all_stats;
+        for (Base_Stage* stage : _stages)
+        {
+            all_stats.push_back(stage->stats());
+        }
+        return all_stats;
+    }
+
+    void log_stats()
+    {
+        for (const Stage_Stats& stats : this->stats())
+        {
+            logI << stats.name << " : " << stats.processed << " items, " << stats.items_per_second() << " items/s, "
+                 << stats.num_threads << " threads " << (stats.utilization() * 100.0) << "% busy, queue "
+                 << stats.queue_depth << " (max " << stats.max_queue_depth << " of " << stats.queue_size << ")\n";
+        }
+    }
+
+protected:
+
+    std::vector<Base_Stage*> _stages;
+
+};
+
 } //namespace workflow
 
 #endif // Pipeline_H
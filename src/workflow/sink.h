@@ -51,9 +51,15 @@ POSSIBILITY OF SUCH DAMAGE.
 #define Sink_H
 
 #include "core/defines.h"
+#include "core/telemetry.h"
 #include <functional>
 #include <future>
+#include <atomic>
 #include <thread>
+#include <queue>
+#include <list>
+#include <mutex>
+#include <condition_variable>
 #include "workflow/distributor.h"
 
 namespace workflow
@@ -72,6 +78,9 @@ public:
         _thread = nullptr;
         _running = false;
         _delete_block = true;
+        _input_capacity = 0;
+        _input_busy = false;
+        _num_pending = 0;
     }
 
 	Sink(const Sink &)
@@ -96,6 +105,9 @@ public:
 
     void set_delete_block(bool val) { _delete_block = val; }
 
+    // called instead of delete once a block has been consumed, used to hand blocks back to a pool
+    void set_release_function(std::function<void (T_IN)> func) { _release_func = func; }
+
     template<typename _T>
     void connect(Distributor<_T, T_IN> *distributor)
     {
@@ -104,6 +116,19 @@ public:
         //_get_func = std::bind(&Distributor<_T, T_IN>::front_pop, distributor);
     }
 
+    // Blocks handed over with push() by a pipeline stage, consumed on the sink thread.
+    // 0 is unbounded, otherwise push() waits while capacity blocks are queued.
+    void set_input_capacity(size_t capacity) { _input_capacity = capacity; }
+
+    void push(T_IN val)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_input_mutex);
+            _input_condition.wait(lock, [this] { return _input_capacity == 0 || _input_queue.size() < _input_capacity; });
+            _input_queue.push(val);
+        }
+    }
+
     virtual void set_function(std::function<void (T_IN)> func)
     {
         _callback_func = func;
@@ -130,7 +155,7 @@ public:
 
     void wait_and_stop()
     {
-        while( _check_func() == false || !_job_queue.empty())
+        while( (_check_func != nullptr && _check_func() == false) || _num_pending > 0 || false == _input_empty())
         {
             std::this_thread::sleep_for(std::chrono::milliseconds(400));
         }
@@ -143,7 +168,7 @@ public:
 		// if sink thread is not running we have to delete the stream_block
 		if (_delete_block && _running == false)
 		{
-			delete val;
+			_release(val);
 		}
     }
 
@@ -153,31 +178,120 @@ protected:
     {
         while(_running)
         {
-            if( _check_func() == false)
+            bool had_input = _drain_input();
+            if(_check_func != nullptr && _check_func() == false)
             {
+                // count the jobs as pending before the distributor queue goes empty so wait_and_stop() sees them
+                _num_pending = _pending_jobs.size() + 1;
                 _get_func(&_job_queue);
                 while(! _job_queue.empty())
                 {
-                    auto ret = std::move(_job_queue.front());
+                    _pending_jobs.emplace_back(std::move(_job_queue.front()));
                     _job_queue.pop();
-                    T_IN input_block = ret.get();
-
-                    _callback_func(input_block);
-
-                    if(_delete_block && input_block != nullptr)
-                    {
-                        delete input_block;
-						input_block = nullptr;
-                    }
                 }
+                _num_pending = _pending_jobs.size();
+                telemetry::add_value("queue/sink_pending", (double)_pending_jobs.size());
+            }
+            if(_consume_ready_jobs())
+            {
+                continue;
             }
-            else
+            if(false == _pending_jobs.empty())
             {
+                // nothing finished yet, wait a little on the oldest one instead of blocking on it
+                _pending_jobs.front().wait_for(std::chrono::milliseconds(1));
+            }
+            else if(false == had_input)
+            {
+                _idle();
                 std::this_thread::sleep_for(std::chrono::milliseconds(10));
             }
         }
     }
 
+    // consume jobs in the order they finish so one slow pixel does not hold back the ones queued after it
+    bool _consume_ready_jobs()
+    {
+        bool consumed = false;
+        auto itr = _pending_jobs.begin();
+        while(itr != _pending_jobs.end())
+        {
+            if(itr->wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                ++itr;
+                continue;
+            }
+            T_IN input_block = itr->get();
+            itr = _pending_jobs.erase(itr);
+
+            _callback_func(input_block);
+
+            if(_delete_block && input_block != nullptr)
+            {
+                _release(input_block);
+            }
+            consumed = true;
+        }
+        _num_pending = _pending_jobs.size();
+        return consumed;
+    }
+
+    bool _input_empty()
+    {
+        std::unique_lock<std::mutex> lock(_input_mutex);
+        return _input_queue.empty() && _input_busy == false;
+    }
+
+    // consume everything pushed so far, returns false if there was nothing
+    bool _drain_input()
+    {
+        std::queue<T_IN> input;
+        {
+            std::unique_lock<std::mutex> lock(_input_mutex);
+            if(_input_queue.empty())
+            {
+                return false;
+            }
+            std::swap(input, _input_queue);
+            _input_busy = true;
+        }
+        telemetry::add_value("queue/sink_input", (double)input.size());
+        _input_condition.notify_all();
+        while(false == input.empty())
+        {
+            T_IN input_block = input.front();
+            input.pop();
+            _callback_func(input_block);
+            if(_delete_block && input_block != nullptr)
+            {
+                _release(input_block);
+            }
+        }
+        {
+            std::unique_lock<std::mutex> lock(_input_mutex);
+            _input_busy = false;
+        }
+        return true;
+    }
+
+    void _release(T_IN val)
+    {
+        if(_release_func != nullptr)
+        {
+            _release_func(val);
+        }
+        else
+        {
+            delete val;
+        }
+    }
+
+    // called from the sink thread while there is nothing to process
+    virtual void _idle()
+    {
+
+    }
+
 
     std::function<bool (void)> _check_func;
 
@@ -186,9 +300,26 @@ protected:
 
     std::function<void (T_IN)> _callback_func;
 
+    std::function<void (T_IN)> _release_func;
+
     std::queue<std::future<T_IN> > _job_queue;
 
-    bool _running;
+    // futures taken from the distributor that have not finished yet
+    std::list<std::future<T_IN> > _pending_jobs;
+
+    std::atomic<size_t> _num_pending;
+
+    std::queue<T_IN> _input_queue;
+
+    size_t _input_capacity;
+
+    bool _input_busy;
+
+    std::mutex _input_mutex;
+
+    std::condition_variable _input_condition;
+
+    std::atomic<bool> _running;
 
     std::thread *_thread;
 
@@ -89,6 +89,12 @@ public:
         _output_callback_func = std::bind(&Sink<T_OUT>::sink_function, sink, std::placeholders::_1);
     }
 
+    // e.g. the first stage of a Stage_Pipeline
+    void connect(Callback_Func_Def out_callback_func)
+    {
+        _output_callback_func = out_callback_func;
+    }
+
     template<typename _T>
     void connect_distributor(Distributor<T_OUT, _T> *distributor)
     {
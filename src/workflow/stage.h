@@ -0,0 +1,351 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+
+#ifndef Stage_H
+#define Stage_H
+
+#include "core/defines.h"
+#include <functional>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include "workflow/threadpool.h"
+#include "workflow/sink.h"
+
+namespace workflow
+{
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Stage_Stats struct : counters of one pipeline stage
+///
+struct Stage_Stats
+{
+    std::string name;
+
+    size_t num_threads;
+
+    size_t queue_size;
+
+    // items processed by the stage function
+    size_t processed;
+
+    // items waiting for a thread right now
+    size_t queue_depth;
+
+    size_t max_queue_depth;
+
+    // summed over all threads of the stage
+    double busy_seconds;
+
+    // first item in to last item out
+    double elapsed_seconds;
+
+    double items_per_second() const { return elapsed_seconds > 0.0 ? processed / elapsed_seconds : 0.0; }
+
+    // fraction of the stage threads that was busy, close to 1 means this stage is the bottleneck
+    double utilization() const { return (elapsed_seconds > 0.0 && num_threads > 0) ? busy_seconds / (elapsed_seconds * num_threads) : 0.0; }
+};
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Base_Stage class : type independent part of a stage so a pipeline can hold stages of different types.
+///
+class Base_Stage
+{
+
+public:
+
+    virtual ~Base_Stage() {}
+
+    virtual const std::string& name() = 0;
+
+    // blocks until every pushed item has been passed on
+    virtual void wait_idle() = 0;
+
+    virtual Stage_Stats stats() = 0;
+};
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Stage_Input class : stage consuming T_IN, what a source or the previous stage pushes into.
+///
+template<typename T_IN>
+class Stage_Input
+{
+
+public:
+
+    virtual ~Stage_Input() {}
+
+    virtual void push(T_IN input) = 0;
+};
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Stage_Output class : stage producing T_OUT, where the next stage or a sink is connected.
+///
+template<typename T_OUT>
+class Stage_Output : public Base_Stage
+{
+
+public:
+
+    virtual ~Stage_Output() {}
+
+    void connect(std::function<void (T_OUT)> output_func)
+    {
+        _output_func = output_func;
+    }
+
+    // the sink runs the callback on its own thread, start() it before pushing
+    void connect(Sink<T_OUT> *sink)
+    {
+        _output_func = std::bind(&Sink<T_OUT>::push, sink, std::placeholders::_1);
+    }
+
+protected:
+
+    std::function<void (T_OUT)> _output_func;
+};
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Stage class : runs func on num_threads threads of its own.
+/// At most queue_size items are in the stage at once, push() blocks until one leaves so a slow stage
+/// pushes back on the ones in front of it. Ordered stages pass items on in the order they were pushed.
+///
+template<typename T_IN, typename T_OUT>
+class Stage : public Stage_Output<T_OUT>, public Stage_Input<T_IN>
+{
+
+public:
+
+    Stage(std::string name, std::function<T_OUT (T_IN)> func, size_t num_threads = 1, size_t queue_size = 0, bool ordered = true)
+    {
+        _name = name;
+        _func = func;
+        _num_threads = std::max((size_t)1, num_threads);
+        _queue_size = (queue_size == 0) ? _num_threads * 4 : queue_size;
+        _ordered = ordered;
+        _reorder.resize(_queue_size);
+        _done.assign(_queue_size, false);
+        _next_sequence = 0;
+        _next_emit = 0;
+        _in_flight = 0;
+        _queue_depth = 0;
+        _max_queue_depth = 0;
+        _processed = 0;
+        _busy_ns = 0;
+        _started = false;
+        _thread_pool = new ThreadPool(_num_threads);
+    }
+
+    Stage(const Stage &) = delete;
+
+    Stage& operator=(const Stage&) = delete;
+
+    virtual ~Stage()
+    {
+        wait_idle();
+        delete _thread_pool;
+    }
+
+    virtual void push(T_IN input)
+    {
+        size_t sequence;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this] { return _in_flight < _queue_size; });
+            if (false == _started)
+            {
+                _start_time = std::chrono::steady_clock::now();
+                _started = true;
+            }
+            sequence = _next_sequence++;
+            _in_flight++;
+            _queue_depth++;
+            _max_queue_depth = std::max(_max_queue_depth, (size_t)_queue_depth);
+        }
+        _thread_pool->submit([this, input, sequence]() { _run(input, sequence); });
+    }
+
+    virtual const std::string& name() { return _name; }
+
+    virtual void wait_idle()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this] { return _in_flight == 0; });
+    }
+
+    virtual Stage_Stats stats()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        Stage_Stats stats;
+        stats.name = _name;
+        stats.num_threads = _num_threads;
+        stats.queue_size = _queue_size;
+        stats.processed = _processed;
+        stats.queue_depth = _queue_depth;
+        stats.max_queue_depth = _max_queue_depth;
+        stats.busy_seconds = _busy_ns * 1.0e-9;
+        stats.elapsed_seconds = _started ? std::chrono::duration<double>(_last_out_time - _start_time).count() : 0.0;
+        return stats;
+    }
+
+protected:
+
+    void _run(T_IN input, size_t sequence)
+    {
+        _queue_depth--;
+        auto start = std::chrono::steady_clock::now();
+        T_OUT output = _func(input);
+        auto end = std::chrono::steady_clock::now();
+        _busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        _processed++;
+
+        std::unique_lock<std::mutex> lock(_emit_mutex);
+        if (false == _ordered)
+        {
+            _emit(output);
+            _release(1);
+            return;
+        }
+        // in flight items are bounded by queue_size so their slots never collide
+        size_t slot = sequence % _queue_size;
+        _reorder[slot] = output;
+        _done[slot] = true;
+        size_t count = 0;
+        while (_done[_next_emit % _queue_size])
+        {
+            slot = _next_emit % _queue_size;
+            _done[slot] = false;
+            _emit(_reorder[slot]);
+            _next_emit++;
+            count++;
+        }
+        _release(count);
+    }
+
+    void _emit(T_OUT output)
+    {
+        if (this->_output_func != nullptr)
+        {
+            this->_output_func(output);
+        }
+    }
+
+    void _release(size_t count)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _in_flight -= count;
+            _last_out_time = std::chrono::steady_clock::now();
+        }
+        _condition.notify_all();
+    }
+
+    std::string _name;
+
+    std::function<T_OUT (T_IN)> _func;
+
+    size_t _num_threads;
+
+    size_t _queue_size;
+
+    bool _ordered;
+
+    ThreadPool *_thread_pool;
+
+    // finished items waiting for earlier ones, indexed by sequence % queue_size
+    std::vector<T_OUT> _reorder;
+
+    std::vector<bool> _done;
+
+    size_t _next_sequence;
+
+    size_t _next_emit;
+
+    size_t _in_flight;
+
+    std::atomic<size_t> _queue_depth;
+
+    size_t _max_queue_depth;
+
+    std::atomic<size_t> _processed;
+
+    std::atomic<long long> _busy_ns;
+
+    bool _started;
+
+    std::chrono::steady_clock::time_point _start_time;
+
+    std::chrono::steady_clock::time_point _last_out_time;
+
+    std::mutex _mutex;
+
+    std::mutex _emit_mutex;
+
+    std::condition_variable _condition;
+
+};
+
+} //namespace workflow
+
+#endif // Stage_H
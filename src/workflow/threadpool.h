@@ -23,6 +23,10 @@ freely, subject to the following restrictions:
    3. This notice may not be removed or altered from any source
    distribution.
 
+Altered for XRF-Maps: the single shared task queue was replaced by per worker
+deques with work stealing, tasks are stored without allocating when small,
+and submit() / parallel_for() were added.
+
 ***/
 
 #ifndef THREAD_POOL_H
@@ -37,6 +41,10 @@ freely, subject to the following restrictions:
 #include <future>
 #include <functional>
 #include <stdexcept>
+#include <atomic>
+#include <algorithm>
+#include <type_traits>
+#include <cstddef>
 
 #if defined _WIN32 || defined __CYGWIN__
 #include <Windows.h>
@@ -46,6 +54,162 @@ freely, subject to the following restrictions:
 
 //#include "task.h"
 
+// Move only type erased callable. Callables up to INLINE_SIZE bytes are stored in place so queuing them does not allocate.
+class Pool_Task {
+public:
+    static const size_t INLINE_SIZE = 64;
+
+    Pool_Task() : _ops(nullptr) {}
+
+    Pool_Task(Pool_Task&& other) : _ops(nullptr) { _move_from(other); }
+
+    Pool_Task& operator=(Pool_Task&& other)
+    {
+        if(this != &other)
+        {
+            reset();
+            _move_from(other);
+        }
+        return *this;
+    }
+
+    Pool_Task(const Pool_Task&) = delete;
+
+    Pool_Task& operator=(const Pool_Task&) = delete;
+
+    ~Pool_Task() { reset(); }
+
+    template<class F>
+    void assign(F&& f)
+    {
+        using Fn = typename std::decay<F>::type;
+        reset();
+        _assign<Fn>(std::forward<F>(f), std::integral_constant<bool, (sizeof(Fn) <= INLINE_SIZE
+                                                                    && alignof(Fn) <= alignof(std::max_align_t)
+                                                                    && std::is_nothrow_move_constructible<Fn>::value)>());
+    }
+
+    void operator()() { _ops->invoke(&_storage); }
+
+    explicit operator bool() const { return _ops != nullptr; }
+
+    void reset()
+    {
+        if(_ops != nullptr)
+        {
+            _ops->destroy(&_storage);
+            _ops = nullptr;
+        }
+    }
+
+private:
+    struct Ops
+    {
+        void (*invoke)(void*);
+        void (*move)(void* src, void* dst);
+        void (*destroy)(void*);
+    };
+
+    template<class Fn>
+    struct Inline_Ops
+    {
+        static void invoke(void* p) { (*static_cast<Fn*>(p))(); }
+        static void move(void* src, void* dst) { new (dst) Fn(std::move(*static_cast<Fn*>(src))); static_cast<Fn*>(src)->~Fn(); }
+        static void destroy(void* p) { static_cast<Fn*>(p)->~Fn(); }
+        static const Ops* ops() { static const Ops o = { &invoke, &move, &destroy }; return &o; }
+    };
+
+    template<class Fn>
+    struct Heap_Ops
+    {
+        static void invoke(void* p) { (**static_cast<Fn**>(p))(); }
+        static void move(void* src, void* dst) { *static_cast<Fn**>(dst) = *static_cast<Fn**>(src); }
+        static void destroy(void* p) { delete *static_cast<Fn**>(p); }
+        static const Ops* ops() { static const Ops o = { &invoke, &move, &destroy }; return &o; }
+    };
+
+    template<class Fn, class F>
+    void _assign(F&& f, std::true_type)
+    {
+        new (&_storage) Fn(std::forward<F>(f));
+        _ops = Inline_Ops<Fn>::ops();
+    }
+
+    template<class Fn, class F>
+    void _assign(F&& f, std::false_type)
+    {
+        *reinterpret_cast<Fn**>(&_storage) = new Fn(std::forward<F>(f));
+        _ops = Heap_Ops<Fn>::ops();
+    }
+
+    void _move_from(Pool_Task& other)
+    {
+        if(other._ops != nullptr)
+        {
+            other._ops->move(&other._storage, &_storage);
+            _ops = other._ops;
+            other._ops = nullptr;
+        }
+    }
+
+    const Ops* _ops;
+    typename std::aligned_storage<INLINE_SIZE, alignof(std::max_align_t)>::type _storage;
+};
+
+// Ring buffer of tasks owned by one worker. The owner pushes and pops at the back, thieves take from the front.
+class Task_Deque {
+public:
+    Task_Deque() : _head(0), _count(0) { _ring.resize(64); }
+
+    void push_back(Pool_Task&& task)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if(_count == _ring.size())
+        {
+            _grow();
+        }
+        _ring[(_head + _count) % _ring.size()] = std::move(task);
+        _count++;
+    }
+
+    bool pop_back(Pool_Task& task)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if(_count == 0)
+            return false;
+        _count--;
+        task = std::move(_ring[(_head + _count) % _ring.size()]);
+        return true;
+    }
+
+    bool pop_front(Pool_Task& task)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if(_count == 0)
+            return false;
+        task = std::move(_ring[_head]);
+        _head = (_head + 1) % _ring.size();
+        _count--;
+        return true;
+    }
+
+    std::mutex mutex;
+
+private:
+    void _grow()
+    {
+        std::vector<Pool_Task> ring(_ring.size() * 2);
+        for(size_t i = 0; i < _count; i++)
+            ring[i] = std::move(_ring[(_head + i) % _ring.size()]);
+        _ring.swap(ring);
+        _head = 0;
+    }
+
+    std::vector<Pool_Task> _ring;
+    size_t _head;
+    size_t _count;
+};
+
 class ThreadPool {
 public:
     ThreadPool(size_t);
@@ -53,47 +217,150 @@ public:
     auto enqueue(F&& f, Args&&... args)
         -> std::future<typename std::result_of<F(Args...)>::type>;
 
+    // fire and forget, does not allocate for small callables
+    template<class F>
+    void submit(F&& f);
+
+    // Calls func(i) for every i in [begin, end), grain indices per task (0 picks one from the thread count).
+    // Blocks until every index is done. The calling thread runs queued tasks while it waits so
+    // it can be used from inside a task. func must not throw.
+    template<class F>
+    void parallel_for(size_t begin, size_t end, F func, size_t grain = 0);
+
+    size_t size() const { return workers.size(); }
+
     //void enqueue_task(task* t);
 
     ~ThreadPool();
 private:
+    struct Worker_Id
+    {
+        const ThreadPool* pool;
+        size_t index;
+    };
+
+    // which pool and queue the current thread works for
+    static Worker_Id& current_worker()
+    {
+        static thread_local Worker_Id id = { nullptr, 0 };
+        return id;
+    }
+
+    void push(Pool_Task&& task);
+    // own queue first (newest task, still warm in cache) then steal the oldest task of the others
+    bool try_pop(size_t self, Pool_Task& task);
+    bool run_one(size_t self);
+    void worker_loop(size_t self);
+
     // need to keep track of threads so we can join them
     std::vector< std::thread > workers;
-    // the task queue
-    std::queue< std::function<void()> > tasks;
+    // one task deque per worker
+    std::vector< std::unique_ptr<Task_Deque> > queues;
 
-    // synchronization
-    std::mutex queue_mutex;
+    // queued tasks not yet picked up
+    std::atomic<size_t> pending;
+    std::atomic<size_t> sleeping;
+    std::atomic<size_t> next_queue;
+
+    // synchronization, only used to put idle workers to sleep
+    std::mutex sleep_mutex;
     std::condition_variable condition;
-    bool stop;
+    std::atomic<bool> stop;
 };
 
 // the constructor just launches some amount of workers
 inline ThreadPool::ThreadPool(size_t threads)
-    :   stop(false)
+    :   pending(0), sleeping(0), next_queue(0), stop(false)
 {
+    threads = std::max((size_t)1, threads);
     for(size_t i = 0;i<threads;++i)
-        workers.emplace_back(
-            [this]
-            {
-                for(;;)
-                {
-                    std::function<void()> task;
-
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock,
-                            [this]{ return this->stop || !this->tasks.empty(); });
-                        if(this->stop && this->tasks.empty())
-                            return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-
-                    task();
-                }
-            }
-        );
+        queues.emplace_back(new Task_Deque());
+    for(size_t i = 0;i<threads;++i)
+        workers.emplace_back([this, i] { this->worker_loop(i); });
+}
+
+inline void ThreadPool::worker_loop(size_t self)
+{
+    current_worker().pool = this;
+    current_worker().index = self;
+    for(;;)
+    {
+        if(run_one(self))
+            continue;
+
+        // spin a little before sleeping, tasks often come in bursts
+        bool found = false;
+        for(int spin = 0; spin < 16 && false == found; spin++)
+        {
+            std::this_thread::yield();
+            found = run_one(self);
+        }
+        if(found)
+            continue;
+
+        std::unique_lock<std::mutex> lock(this->sleep_mutex);
+        sleeping++;
+        this->condition.wait(lock,
+            [this]{ return this->stop || this->pending > 0; });
+        sleeping--;
+        if(this->stop && this->pending == 0)
+            return;
+    }
+}
+
+inline bool ThreadPool::try_pop(size_t self, Pool_Task& task)
+{
+    size_t num_queues = queues.size();
+    if(queues[self % num_queues]->pop_back(task))
+        return true;
+    for(size_t i = 1; i < num_queues; i++)
+    {
+        if(queues[(self + i) % num_queues]->pop_front(task))
+            return true;
+    }
+    return false;
+}
+
+inline bool ThreadPool::run_one(size_t self)
+{
+    Pool_Task task;
+    if(false == try_pop(self, task))
+        return false;
+    pending--;
+    task();
+    return true;
+}
+
+inline void ThreadPool::push(Pool_Task&& task)
+{
+    // don't allow enqueueing after stopping the pool
+    if(stop)
+        throw std::runtime_error("enqueue on stopped ThreadPool");
+
+    // workers push to their own queue, other threads spread tasks round robin
+    size_t idx;
+    Worker_Id& worker = current_worker();
+    if(worker.pool == this)
+        idx = worker.index;
+    else
+        idx = next_queue++ % queues.size();
+
+    // count before pushing so a worker that finds the task never sees the count go below zero
+    pending++;
+    queues[idx]->push_back(std::move(task));
+    if(sleeping > 0)
+    {
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        condition.notify_one();
+    }
+}
+
+template<class F>
+void ThreadPool::submit(F&& f)
+{
+    Pool_Task task;
+    task.assign(std::forward<F>(f));
+    push(std::move(task));
 }
 
 // add new work item to the pool
@@ -103,29 +370,55 @@ auto ThreadPool::enqueue(F&& f, Args&&... args)
 {
     using return_type = typename std::result_of<F(Args...)>::type;
 
-    auto task = std::make_shared< std::packaged_task<return_type()> >(
+    // the packaged task is stored in the pool task directly, its shared state is the only allocation
+    std::packaged_task<return_type()> task(
             std::bind(std::forward<F>(f), std::forward<Args>(args)...)
         );
 
-    std::future<return_type> res = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+    std::future<return_type> res = task.get_future();
+    submit(std::move(task));
+    return res;
+}
 
-        // don't allow enqueueing after stopping the pool
-        if(stop)
-            throw std::runtime_error("enqueue on stopped ThreadPool");
+template<class F>
+void ThreadPool::parallel_for(size_t begin, size_t end, F func, size_t grain)
+{
+    if(end <= begin)
+        return;
+    size_t count = end - begin;
+    if(grain == 0)
+        grain = std::max((size_t)1, count / (queues.size() * 4));
+    size_t num_chunks = (count + grain - 1) / grain;
 
-        tasks.emplace([task](){ (*task)(); });
+    std::atomic<size_t> remaining(num_chunks);
+    F* func_ptr = &func;
+    for(size_t c = 0; c < num_chunks; c++)
+    {
+        size_t chunk_begin = begin + (c * grain);
+        size_t chunk_end = std::min(end, chunk_begin + grain);
+        submit([func_ptr, &remaining, chunk_begin, chunk_end]()
+        {
+            for(size_t i = chunk_begin; i < chunk_end; i++)
+                (*func_ptr)(i);
+            remaining--;
+        });
+    }
+
+    // help out instead of blocking a thread the tasks may need
+    Worker_Id& worker = current_worker();
+    size_t self = (worker.pool == this) ? worker.index : next_queue++;
+    while(remaining > 0)
+    {
+        if(false == run_one(self))
+            std::this_thread::yield();
     }
-    condition.notify_one();
-    return res;
 }
 
 // the destructor joins all threads
 inline ThreadPool::~ThreadPool()
 {
     {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+        std::unique_lock<std::mutex> lock(sleep_mutex);
         stop = true;
     }
     condition.notify_all();
@@ -110,7 +110,7 @@ void Detector_Sum_Spectra_Source::cb_load_spectra_data(size_t row, size_t col, s
 
     if(detector_num == _detector_num_arr[_detector_num_arr.size()-1] && _output_callback_func != nullptr)
     {
-        data_struct::Stream_Block * stream_block = new data_struct::Stream_Block(-1, row, col, height, width);
+        data_struct::Stream_Block * stream_block = _alloc_stream_block(-1, row, col, height, width, spectra->size());
 
         if(_analysis_job != nullptr)
         {
@@ -134,13 +134,18 @@ void Detector_Sum_Spectra_Source::cb_load_spectra_data(size_t row, size_t col, s
             stream_block->optimize_fit_params_preset = _analysis_job->optimize_fit_params_preset;
         }
 
-        stream_block->spectra = _spectra;
+        // copy the sum into the block's recycled spectra and start the next pixel from zero
+        *stream_block->alloc_spectra(_spectra->size(), 0.0, 0.0, 0.0, 0.0) = *_spectra;
         stream_block->dataset_directory = _current_dataset_directory;
         stream_block->dataset_name = _current_dataset_name;
         
         _output_callback_func(stream_block);
 
-        _spectra = new data_struct::Spectra(spectra->size(), 0.0, 0.0, 0.0, 0.0);
+        _spectra->setZero();
+        _spectra->elapsed_livetime(0.0);
+        _spectra->elapsed_realtime(0.0);
+        _spectra->input_counts(0.0);
+        _spectra->output_counts(0.0);
     }
 
     delete spectra;
@@ -64,6 +64,7 @@ Spectra_File_Source::Spectra_File_Source() : Source<data_struct::Stream_Block*>(
     _current_dataset_directory = nullptr;
     _current_dataset_name = nullptr;
 	_max_num_stream_blocks = -1;
+    _stream_block_pool = nullptr;
     _cb_function = std::bind(&Spectra_File_Source::cb_load_spectra_data, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5, std::placeholders::_6, std::placeholders::_7);
 }
 
@@ -76,6 +77,7 @@ Spectra_File_Source::Spectra_File_Source(data_struct::Analysis_Job* analysis_job
     _current_dataset_name = nullptr;
     _init_fitting_routines = true;
 	_max_num_stream_blocks = -1;
+    _stream_block_pool = nullptr;
     _cb_function = std::bind(&Spectra_File_Source::cb_load_spectra_data, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5, std::placeholders::_6, std::placeholders::_7);
 }
 
@@ -108,10 +110,15 @@ bool Spectra_File_Source::load_netcdf_line(std::string dirpath,
 
 data_struct::Stream_Block* Spectra_File_Source::_alloc_stream_block(int detector, size_t row, size_t col, size_t height, size_t width, size_t spectra_size)
 {
-	if (_max_num_stream_blocks == -1)
+	if (_max_num_stream_blocks == -1 && _analysis_job != nullptr)
 	{
 		_max_num_stream_blocks = _analysis_job->mem_limit / (spectra_size * sizeof(real_t));
 	}
+	if (_stream_block_pool != nullptr)
+	{
+		_stream_block_pool->preallocate(spectra_size);
+		return _stream_block_pool->acquire(detector, row, col, height, width);
+	}
 	return new data_struct::Stream_Block(detector, row, col, height, width);
 }
 
@@ -58,6 +58,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "io/file/netcdf_io.h"
 #include "io/file/mda_io.h"
 #include "io/file/hdf5_io.h"
+#include "workflow/xrf/stream_block_pool.h"
 #include <functional>
 #include <iostream>
 #include <fstream>
@@ -94,6 +95,9 @@ public:
 
     void set_init_fitting_routines(bool val) {_init_fitting_routines = val;}
 
+    // pixels are taken from the pool instead of allocated, the sink has to release them back to it
+    void set_stream_block_pool(Stream_Block_Pool* pool) { _stream_block_pool = pool; }
+
 protected:
 
     virtual bool _load_spectra_volume_with_callback(std::string dataset_directory,
@@ -122,6 +126,8 @@ protected:
 
     bool _init_fitting_routines;
 
+    Stream_Block_Pool* _stream_block_pool;
+
 };
 
 } //namespace xrf
@@ -59,6 +59,11 @@ namespace xrf
 Spectra_Net_Source::Spectra_Net_Source(data_struct::Analysis_Job* analysis_job, std::string ip_addr, std::string port) : Source<data_struct::Stream_Block*>()
 {
     _analysis_job = analysis_job;
+    _num_decode_threads = 2;
+    _decode_pool = nullptr;
+    _message_pool = nullptr;
+    _stream_block_pool = nullptr;
+    _next_release = 0;
 #ifdef _BUILD_WITH_ZMQ
     _conn_str = "tcp://"+ip_addr+":"+port;
     logI<<"Connecting to "<<_conn_str<<"\n";
@@ -77,6 +82,17 @@ Spectra_Net_Source::Spectra_Net_Source(data_struct::Analysis_Job* analysis_job,
 
 Spectra_Net_Source::~Spectra_Net_Source()
 {
+    // joins the decode threads so nothing holds a pooled message anymore
+    if (_decode_pool != nullptr)
+    {
+        delete _decode_pool;
+        _decode_pool = nullptr;
+    }
+    if (_message_pool != nullptr)
+    {
+        delete _message_pool;
+        _message_pool = nullptr;
+    }
 #ifdef _BUILD_WITH_ZMQ
 	if (_zmq_socket != nullptr)
 	{
@@ -100,7 +116,16 @@ void Spectra_Net_Source::run()
 #ifdef _BUILD_WITH_ZMQ
     _running = true;
     zmq::message_t token, message;
-    data_struct::Stream_Block *stream_block;
+    size_t sequence = 0;
+
+    // in flight messages are bounded by the pool so a slow fitting stage pushes back on the socket
+    size_t max_in_flight = std::max((size_t)1, _num_decode_threads) * 8;
+    _message_pool = new Object_Pool<Raw_Message>(max_in_flight);
+    _message_pool->preallocate(max_in_flight);
+    _reorder.assign(max_in_flight, nullptr);
+    _next_release = 0;
+    _decode_pool = new ThreadPool(std::max((size_t)1, _num_decode_threads));
+
     while (_running)
     {
         _zmq_socket->recv(&token);
@@ -111,30 +136,133 @@ void Spectra_Net_Source::run()
             {
                 if(_output_callback_func != nullptr && _analysis_job != nullptr)
                 {
-                    stream_block = _serializer.decode_spectra((char*)message.data(), message.size());
-                    _analysis_job->init_fit_routines(stream_block->spectra->size());
-                    struct data_struct::Detector* cp = _analysis_job->get_detector(stream_block->detector_number());
-
-                    if(cp == nullptr)
-                    {
-                        cp = _analysis_job->get_first_detector();
-                    }
-                    if(cp != nullptr)
-                    {
-                        stream_block->init_fitting_blocks(&(cp->fit_routines), &(cp->fit_params_override_dict.elements_to_fit));
-                        stream_block->model = cp->model;
-                    }
-
-                    _output_callback_func(stream_block);
+                    // receive thread only copies into a pooled buffer, decoding happens on the decode threads
+                    Raw_Message* raw_msg = _message_pool->acquire();
+                    raw_msg->data.assign((char*)message.data(), message.size());
+                    raw_msg->sequence = sequence++;
+                    _decode_pool->submit([this, raw_msg]() { _decode_message(raw_msg); });
                 }
             }
         }
     }
     _zmq_socket->close();
+    // joins the decode threads after they finished the queued messages, a later run() starts with new pools
+    delete _decode_pool;
+    _decode_pool = nullptr;
+    delete _message_pool;
+    _message_pool = nullptr;
 #endif
 }
 
 // ----------------------------------------------------------------------------
 
+void Spectra_Net_Source::_decode_message(Raw_Message* raw_msg)
+{
+    char* data = &raw_msg->data[0];
+    size_t data_len = raw_msg->data.length();
+    raw_msg->blocks.clear();
+
+    if (_serializer.is_batch(data, data_len))
+    {
+        _serializer.for_each_in_batch(data, data_len, [this, raw_msg](char* entry, size_t entry_len)
+        {
+            data_struct::Stream_Block* stream_block = _decode_spectra_block(entry, entry_len);
+            if (stream_block != nullptr)
+            {
+                raw_msg->blocks.push_back(stream_block);
+            }
+        });
+    }
+    else
+    {
+        data_struct::Stream_Block* stream_block = _decode_spectra_block(data, data_len);
+        if (stream_block != nullptr)
+        {
+            raw_msg->blocks.push_back(stream_block);
+        }
+    }
+
+    _release_in_order(raw_msg);
+}
+
+// ----------------------------------------------------------------------------
+
+data_struct::Stream_Block* Spectra_Net_Source::_decode_spectra_block(char* message, size_t message_len)
+{
+    data_struct::Stream_Block* stream_block = nullptr;
+    if (_stream_block_pool != nullptr)
+    {
+        stream_block = _stream_block_pool->acquire(0, 0, 0, 0, 0);
+        if (false == _serializer.decode_spectra_into(message, message_len, stream_block))
+        {
+            _stream_block_pool->release(stream_block);
+            stream_block = nullptr;
+        }
+    }
+    else
+    {
+        stream_block = _serializer.decode_spectra(message, message_len);
+    }
+    if (stream_block == nullptr || stream_block->spectra == nullptr)
+    {
+        logW << "Could not decode spectra message\n";
+        if (_stream_block_pool != nullptr)
+        {
+            _stream_block_pool->release(stream_block);
+        }
+        else
+        {
+            delete stream_block;
+        }
+        return nullptr;
+    }
+    if (_stream_block_pool != nullptr)
+    {
+        _stream_block_pool->preallocate(stream_block->spectra->size());
+    }
+    // another decode thread can be creating the detectors and fit routines, look them up under the same lock
+    std::unique_lock<std::mutex> lock(_init_mutex);
+    _analysis_job->init_fit_routines(stream_block->spectra->size());
+    struct data_struct::Detector* cp = _analysis_job->get_detector(stream_block->detector_number());
+
+    if(cp == nullptr)
+    {
+        cp = _analysis_job->get_first_detector();
+    }
+    if(cp != nullptr)
+    {
+        stream_block->init_fitting_blocks(&(cp->fit_routines), &(cp->fit_params_override_dict.elements_to_fit));
+        stream_block->model = cp->model;
+    }
+    return stream_block;
+}
+
+// ----------------------------------------------------------------------------
+
+void Spectra_Net_Source::_release_in_order(Raw_Message* raw_msg)
+{
+    std::unique_lock<std::mutex> lock(_release_mutex);
+    _reorder[raw_msg->sequence % _reorder.size()] = raw_msg;
+    while (true)
+    {
+        size_t slot = _next_release % _reorder.size();
+        Raw_Message* next_msg = _reorder[slot];
+        if (next_msg == nullptr || next_msg->sequence != _next_release)
+        {
+            break;
+        }
+        _reorder[slot] = nullptr;
+        for (data_struct::Stream_Block* stream_block : next_msg->blocks)
+        {
+            _output_callback_func(stream_block);
+        }
+        next_msg->blocks.clear();
+        _message_pool->release(next_msg);
+        _next_release++;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
 } //namespace xrf
 } //namespace workflow
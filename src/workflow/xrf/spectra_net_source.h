@@ -56,6 +56,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "data_struct/stream_block.h"
 #include "io/net/basic_serializer.h"
 #include "data_struct/analysis_job.h"
+#include "workflow/object_pool.h"
+#include "workflow/threadpool.h"
+#include "workflow/xrf/stream_block_pool.h"
 #ifdef _BUILD_WITH_ZMQ
 #include "support/zmq/zmq.hpp"
 #endif
@@ -66,6 +69,20 @@ namespace xrf
 
 //-----------------------------------------------------------------------------
 
+///
+/// \brief The Raw_Message struct : pooled receive buffer and the stream blocks decoded from it
+///
+struct Raw_Message
+{
+    std::string data;
+
+    size_t sequence;
+
+    std::vector<data_struct::Stream_Block*> blocks;
+};
+
+//-----------------------------------------------------------------------------
+
 class DLL_EXPORT Spectra_Net_Source : public Source<data_struct::Stream_Block*>
 {
 
@@ -77,8 +94,23 @@ public:
 
     virtual void run();
 
+    // must be called before run()
+    void set_num_decode_threads(size_t num_threads) { _num_decode_threads = num_threads; }
+
+    // pixels are decoded into recycled blocks from the pool, the sink has to release them back to it
+    void set_stream_block_pool(Stream_Block_Pool* pool) { _stream_block_pool = pool; }
+
 protected:
 
+    // runs on a decode thread, splits batches and decodes every pixel of the message
+    void _decode_message(Raw_Message* raw_msg);
+
+    // decode one pixel (a plain message or one entry of a batch)
+    data_struct::Stream_Block* _decode_spectra_block(char* message, size_t message_len);
+
+    // pass decoded messages on in the order they were received and recycle their buffers
+    void _release_in_order(Raw_Message* raw_msg);
+
     bool _running;
 
     std::string _conn_str;
@@ -87,6 +119,23 @@ protected:
 
     data_struct::Analysis_Job* _analysis_job;
 
+    size_t _num_decode_threads;
+
+    ThreadPool* _decode_pool;
+
+    Object_Pool<Raw_Message>* _message_pool;
+
+    Stream_Block_Pool* _stream_block_pool;
+
+    // decoded messages waiting for earlier ones, indexed by sequence % size
+    std::vector<Raw_Message*> _reorder;
+
+    size_t _next_release;
+
+    std::mutex _release_mutex;
+
+    std::mutex _init_mutex;
+
 #ifdef _BUILD_WITH_ZMQ
 	zmq::context_t *_context;
 
@@ -56,12 +56,19 @@ namespace xrf
 
 //-----------------------------------------------------------------------------
 
-Spectra_Net_Streamer::Spectra_Net_Streamer(std::string port) : Sink<data_struct::Stream_Block*>()
+Spectra_Net_Streamer::Spectra_Net_Streamer(std::string port) : Sink<data_struct::Stream_Block*>(),
+    _counts_batch("XRF-Counts"),
+    _spectra_batch("XRF-Spectra"),
+    _counts_and_spectra_batch("XRF-Counts-and-Spectra")
 {
-#ifdef _BUILD_WITH_ZMQ
     _send_counts = true;
     _send_spectra = true;
-
+    _batch_max_pixels = 1;
+    _batch_end_of_row = false;
+    _batch_max_latency = std::chrono::milliseconds(0);
+    _dictionary_interval = 1000;
+    _pixels_since_dictionary = 0;
+#ifdef _BUILD_WITH_ZMQ
     _callback_func = std::bind(&Spectra_Net_Streamer::stream, this, std::placeholders::_1);
 
     std::string conn_str = "tcp://*:" + port;
@@ -78,6 +85,7 @@ Spectra_Net_Streamer::Spectra_Net_Streamer(std::string port) : Sink<data_struct:
 Spectra_Net_Streamer::~Spectra_Net_Streamer()
 {
 #ifdef _BUILD_WITH_ZMQ
+    flush();
     if(_zmq_socket != nullptr)
     {
 		_zmq_socket->close();
@@ -95,45 +103,51 @@ Spectra_Net_Streamer::~Spectra_Net_Streamer()
 
 // ----------------------------------------------------------------------------
 
+void Spectra_Net_Streamer::set_batch(size_t max_pixels, bool end_of_row, size_t max_latency_ms)
+{
+    flush();
+    _batch_max_pixels = max_pixels;
+    _batch_end_of_row = end_of_row;
+    _batch_max_latency = std::chrono::milliseconds(max_latency_ms);
+    if (_batch_max_pixels == 0 && false == _batch_end_of_row && _batch_max_latency.count() == 0)
+    {
+        logW << "Stream batch has no pixel limit, row or latency cap. Using 100ms latency cap.\n";
+        _batch_max_latency = std::chrono::milliseconds(100);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
 void Spectra_Net_Streamer::stream(data_struct::Stream_Block* stream_block)
 {
 #ifdef _BUILD_WITH_ZMQ
-	std::string data;
-
     if(_send_counts && _send_spectra)
     {
-        zmq::message_t topic("XRF-Counts-and-Spectra", 22);
-        _zmq_socket->send(topic, ZMQ_SNDMORE);
-        data = _serializer.encode_counts_and_spectra(stream_block);
-        zmq::message_t message(data.c_str(), data.length());
-        if (false == _zmq_socket->send(message, 0))
         {
-            logE << "sending ZMQ counts and spectra message"<<"\n";
+            telemetry::Scoped_Timer timer("stream_encode");
+            _serializer.encode_counts_and_spectra_into(stream_block, _send_buffer);
         }
+        _send_counts_dictionary(_counts_and_spectra_batch, stream_block);
+        _send_or_batch(_counts_and_spectra_batch, stream_block);
     }
     else
     {
         if(_send_counts)
         {
-            zmq::message_t topic("XRF-Counts", 10);
-            _zmq_socket->send(topic, ZMQ_SNDMORE);
-            data = _serializer.encode_counts(stream_block);
-            zmq::message_t message(data.c_str(), data.length());
-            if (false == _zmq_socket->send(message, 0))
             {
-                logE << "sending ZMQ counts message"<<"\n";
+                telemetry::Scoped_Timer timer("stream_encode");
+                _serializer.encode_counts_into(stream_block, _send_buffer);
             }
+            _send_counts_dictionary(_counts_batch, stream_block);
+            _send_or_batch(_counts_batch, stream_block);
         }
         if(_send_spectra)
         {
-            zmq::message_t topic("XRF-Spectra", 11);
-            _zmq_socket->send(topic, ZMQ_SNDMORE);
-            data = _serializer.encode_spectra(stream_block);
-            zmq::message_t message(data.c_str(), data.length());
-            if (false == _zmq_socket->send(message, 0))
             {
-                logE << "sending ZMQ spectra message"<<"\n";
+                telemetry::Scoped_Timer timer("stream_encode");
+                _serializer.encode_spectra_into(stream_block, _send_buffer);
             }
+            _send_or_batch(_spectra_batch, stream_block);
         }
     }
 #else
@@ -143,5 +157,117 @@ void Spectra_Net_Streamer::stream(data_struct::Stream_Block* stream_block)
 
 // ----------------------------------------------------------------------------
 
+void Spectra_Net_Streamer::_send_or_batch(Net_Batch& batch, data_struct::Stream_Block* stream_block)
+{
+    if (_batch_max_pixels == 1)
+    {
+        _send_message(batch.topic, _send_buffer);
+        return;
+    }
+
+    if (batch.count == 0)
+    {
+        _serializer.batch_begin(batch.buffer);
+        batch.first_time = std::chrono::steady_clock::now();
+    }
+    _serializer.batch_append(batch.buffer, _send_buffer);
+    batch.count++;
+
+    if ((_batch_max_pixels > 0 && batch.count >= _batch_max_pixels)
+        || (_batch_end_of_row && stream_block->is_end_of_row())
+        || (_batch_max_latency.count() > 0 && std::chrono::steady_clock::now() - batch.first_time >= _batch_max_latency))
+    {
+        _flush_batch(batch);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void Spectra_Net_Streamer::_flush_batch(Net_Batch& batch)
+{
+    if (batch.count > 0)
+    {
+        _send_message(batch.topic, batch.buffer);
+        batch.count = 0;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void Spectra_Net_Streamer::flush()
+{
+    _flush_batch(_counts_and_spectra_batch);
+    _flush_batch(_counts_batch);
+    _flush_batch(_spectra_batch);
+}
+
+// ----------------------------------------------------------------------------
+
+void Spectra_Net_Streamer::_idle()
+{
+    // enforce the latency cap when no new pixels are coming in
+    if (_batch_max_latency.count() > 0)
+    {
+        auto now = std::chrono::steady_clock::now();
+        for (Net_Batch* batch : { &_counts_and_spectra_batch, &_counts_batch, &_spectra_batch })
+        {
+            if (batch->count > 0 && now - batch->first_time >= _batch_max_latency)
+            {
+                _flush_batch(*batch);
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void Spectra_Net_Streamer::_send_message(const std::string& topic_name, const std::string& data)
+{
+#ifdef _BUILD_WITH_ZMQ
+    zmq::message_t topic(topic_name.c_str(), topic_name.length());
+    _zmq_socket->send(topic, ZMQ_SNDMORE);
+    zmq::message_t message(data.data(), data.length());
+    if (false == _zmq_socket->send(message, 0))
+    {
+        logE << "sending ZMQ " << topic_name << " message" << "\n";
+    }
+    else
+    {
+        telemetry::add_count("stream/bytes_sent", topic_name.length() + data.length());
+    }
+#else
+    (void)topic_name;
+    (void)data;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+
+void Spectra_Net_Streamer::_send_counts_dictionary(Net_Batch& batch, data_struct::Stream_Block* stream_block)
+{
+    // version 2 counts only carry values, send the element names first whenever they change
+    if (_serializer.counts_dictionary_pending())
+    {
+        // pixels already batched refer to the previous dictionary so they have to go out first
+        _flush_batch(batch);
+        _serializer.encode_counts_dictionary_into(_dictionary_buffer);
+        _send_message(batch.topic, _dictionary_buffer);
+        _pixels_since_dictionary = 0;
+    }
+    else if (_serializer.counts_format_version() > 1)
+    {
+        // PUB drops everything sent before a subscriber connects, repeat the unchanged dictionary
+        // so a late subscriber only misses the pixels up to the next row or interval
+        _pixels_since_dictionary++;
+        if (stream_block->col() == 0 || (_dictionary_interval > 0 && _pixels_since_dictionary >= _dictionary_interval))
+        {
+            _send_message(batch.topic, _dictionary_buffer);
+            _pixels_since_dictionary = 0;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
 } //namespace xrf
 } //namespace workflow
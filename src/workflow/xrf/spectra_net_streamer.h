@@ -65,6 +65,24 @@ namespace xrf
 
 //-----------------------------------------------------------------------------
 
+///
+/// \brief The Net_Batch struct : encoded pixels waiting to be sent on one topic
+///
+struct Net_Batch
+{
+    Net_Batch(std::string topic_name) : topic(topic_name), count(0) {}
+
+    std::string topic;
+
+    std::string buffer;
+
+    size_t count;
+
+    std::chrono::steady_clock::time_point first_time;
+};
+
+//-----------------------------------------------------------------------------
+
 class DLL_EXPORT Spectra_Net_Streamer : public Sink<data_struct::Stream_Block* >
 {
 
@@ -80,7 +98,35 @@ public:
 
     void set_send_spectra(bool val) {_send_spectra = val;}
 
+    void set_counts_format_version(unsigned short version) {_serializer.set_counts_format_version(version);}
+
+    // version 2 counts: besides every row start, send the dictionary again after this many pixels so subscribers
+    // that join late or drop the first message can decode the rest of the dataset. 0 only resends per row
+    void set_dictionary_interval(size_t num_pixels) {_dictionary_interval = num_pixels;}
+
+    ///
+    /// \brief set_batch : Pack several pixels per ZMQ message.
+    /// \param max_pixels : send when this many pixels are batched. 1 disables batching, 0 means no pixel limit
+    /// \param end_of_row : send at the end of every row
+    /// \param max_latency_ms : send a partial batch once its first pixel is this old. 0 disables the cap
+    ///
+    void set_batch(size_t max_pixels, bool end_of_row, size_t max_latency_ms);
+
+    // send any partially filled batches
+    void flush();
+
 protected:
+
+    virtual void _idle();
+
+    void _send_counts_dictionary(Net_Batch& batch, data_struct::Stream_Block* stream_block);
+
+    void _send_or_batch(Net_Batch& batch, data_struct::Stream_Block* stream_block);
+
+    void _flush_batch(Net_Batch& batch);
+
+    void _send_message(const std::string& topic_name, const std::string& data);
+
 #ifdef _BUILD_WITH_ZMQ
 	zmq::context_t *_context;
 
@@ -88,10 +134,31 @@ protected:
 #endif
 	io::net::Basic_Serializer _serializer;
 
+    // reused for every message so the encoder does not reallocate per pixel
+    std::string _send_buffer;
+
+    std::string _dictionary_buffer;
+
+    size_t _dictionary_interval;
+
+    size_t _pixels_since_dictionary;
+
     bool _send_counts;
 
     bool _send_spectra;
 
+    size_t _batch_max_pixels;
+
+    bool _batch_end_of_row;
+
+    std::chrono::milliseconds _batch_max_latency;
+
+    Net_Batch _counts_batch;
+
+    Net_Batch _spectra_batch;
+
+    Net_Batch _counts_and_spectra_batch;
+
 };
 
 //-----------------------------------------------------------------------------
@@ -65,7 +65,12 @@ Spectra_Stream_Saver::Spectra_Stream_Saver() : Sink<data_struct::Stream_Block*>(
 
 Spectra_Stream_Saver::~Spectra_Stream_Saver()
 {
-
+    // write out whatever is still buffered, e.g. rows that never received all their pixels
+    for (auto& itr : _dataset_map)
+    {
+        _finalize_dataset(itr.first, itr.second);
+    }
+    _dataset_map.clear();
 }
 
 // ----------------------------------------------------------------------------
@@ -73,70 +78,166 @@ Spectra_Stream_Saver::~Spectra_Stream_Saver()
 void Spectra_Stream_Saver::save_stream(data_struct::Stream_Block* stream_block)
 {
 
-    size_t d_hash = stream_block->dataset_hash();
-    size_t detector_num = stream_block->detector_number();
-
+    size_t d_hash = _dataset_key(stream_block);
 
     if (stream_block->is_end_block())
     {
         if (_dataset_map.count(d_hash) > 0)
         {
             Dataset_Save* dataset = _dataset_map.at(d_hash);
-            _finalize_dataset(dataset);
+            dataset->end_received = true;
+            // pixels fit out of order can still be on their way, finalize once the last one is in
+            if (_is_dataset_complete(dataset))
+            {
+                _finalize_dataset(d_hash, dataset);
+                _dataset_map.erase(d_hash);
+            }
+            else if (stream_block->del_str_ptr)
+            {
+                // the pixels still in flight share these strings, free them with the dataset
+                dataset->deferred_strings.push_back(stream_block->dataset_directory);
+                dataset->deferred_strings.push_back(stream_block->dataset_name);
+                stream_block->del_str_ptr = false;
+            }
         }
+        return;
     }
-    else
+
+    // Is this a new dataset
+    if (_dataset_map.count(d_hash) < 1)
     {
-        // Is this a new dataset
-        if (_dataset_map.count(d_hash) < 1)
+        // Close any open datasets because we should not get any more data from them,
+        // unless they are ended but still waiting on pixels that were fit out of order
+        auto itr = _dataset_map.begin();
+        while (itr != _dataset_map.end())
         {
-            // Close any open datasets because we should not get any more data from them
-            for (auto itr : _dataset_map)
+            if (itr->second->end_received && false == _is_dataset_complete(itr->second))
             {
-                _finalize_dataset(itr.second);
+                ++itr;
+                continue;
             }
-            _dataset_map.clear();
+            _finalize_dataset(itr->first, itr->second);
+            itr = _dataset_map.erase(itr);
+        }
+
+        //insert new dataset
+        _new_dataset(d_hash, stream_block);
+    }
+
+    Dataset_Save* dataset = _dataset_map.at(d_hash);
+    _add_pixel(d_hash, dataset, stream_block);
+
+    if (dataset->end_received && _is_dataset_complete(dataset))
+    {
+        _finalize_dataset(d_hash, dataset);
+        _dataset_map.erase(d_hash);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void Spectra_Stream_Saver::_add_pixel(size_t d_hash, Dataset_Save *dataset, data_struct::Stream_Block* stream_block)
+{
+    int detector_num = stream_block->detector_number();
+    if (dataset->detector_map.count(detector_num) < 1)
+    {
+        _new_detector(dataset, stream_block);
+    }
+    Detector_Save* detector = dataset->detector_map.at(detector_num);
 
-            //insert new dataset
-             _new_dataset(d_hash, stream_block);
+    size_t row = stream_block->row();
+    size_t col = stream_block->col();
+    if (row >= detector->height || col >= detector->width)
+    {
+        logW << "Pixel " << row << " " << col << " is outside of " << detector->height << " x " << detector->width << ", skipping\n";
+        return;
+    }
+
+    if (detector->received == 0)
+    {
+        detector->integrated_spectra = *stream_block->spectra;
+    }
+    else
+    {
+        detector->integrated_spectra.add(*stream_block->spectra);
+    }
+    detector->received++;
+
+    if (row < detector->next_row)
+    {
+        logW << "Row " << row << " was already saved, dropping pixel " << col << "\n";
+        return;
+    }
+
+    Row_Save* row_save;
+    auto itr = detector->pending_rows.find(row);
+    if (itr == detector->pending_rows.end())
+    {
+        row_save = detector->acquire_row();
+        detector->pending_rows.insert( { row, row_save } );
+    }
+    else
+    {
+        row_save = itr->second;
+    }
+
+    if (row_save->spectra_line[col] == nullptr)
+    {
+        row_save->received++;
+    }
+    // copy so the block keeps its spectra when it goes back to the pool
+    row_save->store(col, *stream_block->spectra);
+
+    if (row == detector->next_row && row_save->received == detector->width)
+    {
+        _save_rows(d_hash, detector_num, detector, false);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void Spectra_Stream_Saver::_save_rows(size_t d_hash, int detector_num, Detector_Save *detector, bool force)
+{
+    // save complete rows in order, or everything that is left if force is set
+    while (false == detector->pending_rows.empty())
+    {
+        auto itr = detector->pending_rows.begin();
+        Row_Save* row_save = itr->second;
+        if (false == force && (itr->first != detector->next_row || row_save->received < detector->width))
+        {
+            break;
         }
-        else
+        io::file::HDF5_IO::inst()->save_stream_row(d_hash, detector_num, itr->first, &row_save->spectra_line);
+        detector->next_row = itr->first + 1;
+        detector->release_row(row_save);
+        detector->pending_rows.erase(itr);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+size_t Spectra_Stream_Saver::_dataset_key(data_struct::Stream_Block* stream_block)
+{
+    // Stream_Block::dataset_hash() includes the detector, the end block and all detectors of a file share this one
+    if (stream_block->dataset_directory != nullptr && stream_block->dataset_name != nullptr)
+    {
+        return std::hash<std::string> {} ((*stream_block->dataset_directory) + (*stream_block->dataset_name));
+    }
+    return -1;
+}
+
+// ----------------------------------------------------------------------------
+
+bool Spectra_Stream_Saver::_is_dataset_complete(Dataset_Save *dataset)
+{
+    for (auto& itr : dataset->detector_map)
+    {
+        if (false == itr.second->is_complete())
         {
-            // Get dataset and check if we have detector for it
-            Dataset_Save* dataset = _dataset_map.at(d_hash);
-            if (dataset->detector_map.count(detector_num) < 1)
-            {
-                _new_detector(dataset, stream_block);
-            }
-            else
-            {
-                Detector_Save* detector = dataset->detector_map.at(detector_num);
-
-                if (detector->last_row > -1 && stream_block->row() > (size_t)detector->last_row)
-                {
-                    io::file::HDF5_IO::inst()->save_stream_row(d_hash, detector_num, detector->last_row, &detector->spectra_line);
-                    for (size_t i = 0; i < detector->spectra_line.size(); i++)
-                    {
-                        if (detector->spectra_line[i] != nullptr)
-                        {
-                            delete detector->spectra_line[i];
-                            detector->spectra_line[i] = nullptr;
-                        }
-                    }
-                }
-
-                detector->last_row = stream_block->row();
-                detector->integrated_spectra.add(*stream_block->spectra);
-                //TODO: add limit checks to spectra_line
-                if (detector->spectra_line[stream_block->col()] != nullptr)
-                {
-                    delete detector->spectra_line[stream_block->col()];
-                }
-                detector->spectra_line[stream_block->col()] = stream_block->spectra;
-                stream_block->spectra = nullptr;
-            }
+            return false;
         }
     }
+    return true;
 }
 
 // ----------------------------------------------------------------------------
@@ -144,31 +245,25 @@ void Spectra_Stream_Saver::save_stream(data_struct::Stream_Block* stream_block)
 void Spectra_Stream_Saver::_new_dataset(size_t d_hash, data_struct::Stream_Block* stream_block)
 {
     Dataset_Save *dataset = new Dataset_Save();
-    dataset->dataset_directory = stream_block->dataset_directory;
-    dataset->dataset_name = stream_block->dataset_name;
+    // keep copies, the block strings belong to the source or to the end block
+    dataset->dataset_directory = new std::string(*stream_block->dataset_directory);
+    dataset->dataset_name = new std::string(*stream_block->dataset_name);
     _dataset_map.insert( {d_hash, dataset} );
-    _new_detector(dataset, stream_block);
 }
 
 // ----------------------------------------------------------------------------
 
 void Spectra_Stream_Saver::_new_detector(Dataset_Save *dataset, data_struct::Stream_Block* stream_block)
 {
-    Detector_Save *detector = new Detector_Save(stream_block->width());
+    Detector_Save *detector = new Detector_Save(stream_block->width(), stream_block->height());
     dataset->detector_map.insert( { stream_block->detector_number(), detector } );
 
-    detector->integrated_spectra = *stream_block->spectra;
-    detector->spectra_line[stream_block->col()] = stream_block->spectra;
-
-    //release ownership
-    stream_block->spectra = nullptr;
-
     io::file::HDF5_IO::inst()->generate_stream_dataset(*dataset->dataset_directory, *dataset->dataset_name, stream_block->detector_number(), stream_block->height(), stream_block->width());
 }
 
 // ----------------------------------------------------------------------------
 
-void Spectra_Stream_Saver::_finalize_dataset(Dataset_Save *dataset)
+void Spectra_Stream_Saver::_finalize_dataset(size_t d_hash, Dataset_Save *dataset)
 {
     if (dataset != nullptr)
     {
@@ -178,6 +273,7 @@ void Spectra_Stream_Saver::_finalize_dataset(Dataset_Save *dataset)
             //save and close hdf5 for this detector
             if (detector != nullptr)
             {
+                _save_rows(d_hash, itr.first, detector, true);
                 io::file::HDF5_IO::inst()->save_itegrade_spectra(&detector->integrated_spectra);
                 ///io::file::HDF5_IO::inst()->save_scan_scalers(detector_num, stream_block->mda_io, params_override, false);
                 //io::file::HDF5_IO::inst()->close_dataset(d_hash);
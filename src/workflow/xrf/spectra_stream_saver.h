@@ -57,6 +57,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "io/file/mda_io.h"
 #include "io/file/hdf5_io.h"
 #include <functional>
+#include <algorithm>
 
 namespace workflow
 {
@@ -80,32 +81,130 @@ public:
 
 protected:
 
-    class Detector_Save
+    // one row of spectra, filled in whatever order the pixels finish
+    class Row_Save
     {
     public:
-        Detector_Save(size_t width)
+        Row_Save(size_t width)
+        {
+            received = 0;
+            spectra_line.resize(width, nullptr);
+            buffers.resize(width, nullptr);
+        }
+
+        Row_Save(const Row_Save&) = delete;
+
+        Row_Save& operator=(const Row_Save&) = delete;
+
+        ~Row_Save()
+        {
+            for (auto& itr : buffers)
+            {
+                if (itr != nullptr)
+                {
+                    delete itr;
+                }
+            }
+            buffers.clear();
+            spectra_line.clear();
+        }
+
+        // copy the pixel into the column buffer, only the first row that uses a column allocates it
+        void store(size_t col, const data_struct::Spectra& spectra)
         {
-            last_row = -1;
-            spectra_line.resize(width);
-            for(size_t i=0;i<width; i++)
+            if (buffers[col] == nullptr)
             {
-                spectra_line[i] = nullptr;
+                buffers[col] = new data_struct::Spectra(spectra);
             }
+            else
+            {
+                *buffers[col] = spectra;
+            }
+            spectra_line[col] = buffers[col];
+        }
+
+        // empty the row for reuse, keeps the buffers
+        void reset()
+        {
+            received = 0;
+            std::fill(spectra_line.begin(), spectra_line.end(), nullptr);
+        }
+
+        size_t received;
+        // what gets saved, nullptr for pixels that were never received
+        std::vector< data_struct::Spectra* > spectra_line;
+        std::vector< data_struct::Spectra* > buffers;
+    };
+
+    class Detector_Save
+    {
+    public:
+        Detector_Save(size_t width, size_t height)
+        {
+            this->width = width;
+            this->height = height;
+            next_row = 0;
+            received = 0;
         }
+
+        Detector_Save(const Detector_Save&) = delete;
+
+        Detector_Save& operator=(const Detector_Save&) = delete;
+
         ~Detector_Save()
         {
-            spectra_line.resize(1);
+            for (auto& itr : pending_rows)
+            {
+                delete itr.second;
+            }
+            pending_rows.clear();
+            for (auto& itr : free_rows)
+            {
+                delete itr;
+            }
+            free_rows.clear();
+        }
+
+        inline bool is_complete() { return received >= width * height; }
+
+        Row_Save* acquire_row()
+        {
+            if (free_rows.empty())
+            {
+                return new Row_Save(width);
+            }
+            Row_Save* row_save = free_rows.back();
+            free_rows.pop_back();
+            return row_save;
         }
 
-        int last_row;
+        void release_row(Row_Save* row_save)
+        {
+            row_save->reset();
+            free_rows.push_back(row_save);
+        }
+
+        size_t width;
+        size_t height;
+        // next row to write, rows are only saved in order
+        size_t next_row;
+        size_t received;
         data_struct::Spectra integrated_spectra;
-        std::vector< data_struct::Spectra* > spectra_line;
+        // reorder buffer: rows still missing pixels or waiting on an earlier row
+        std::map<size_t, Row_Save*> pending_rows;
+        // saved rows kept with their buffers for the next rows
+        std::vector<Row_Save*> free_rows;
     };
 
     class Dataset_Save
     {
     public:
-        Dataset_Save(){}
+        Dataset_Save()
+        {
+            dataset_directory = nullptr;
+            dataset_name = nullptr;
+            end_received = false;
+        }
         ~Dataset_Save()
         {
             if (dataset_directory != nullptr)
@@ -118,6 +217,11 @@ protected:
                 delete dataset_name;
             }
             dataset_name = nullptr;
+            for(auto& itr : deferred_strings)
+            {
+                delete itr;
+            }
+            deferred_strings.clear();
             for(auto& itr : detector_map)
             {
                 if (itr.second != nullptr)
@@ -130,6 +234,10 @@ protected:
 
         std::string *dataset_directory;
         std::string *dataset_name;
+        // the end block can overtake pixels that are still being fit
+        bool end_received;
+        // strings owned by the end block that late pixels still point to
+        std::vector<std::string*> deferred_strings;
         //by detector_num
         std::map<int, Detector_Save*> detector_map;
     };
@@ -138,9 +246,17 @@ protected:
 
     void _new_detector(Dataset_Save *dataset, data_struct::Stream_Block* stream_block);
 
-    void _finalize_dataset(Dataset_Save *dataset);
+    void _add_pixel(size_t d_hash, Dataset_Save *dataset, data_struct::Stream_Block* stream_block);
+
+    void _save_rows(size_t d_hash, int detector_num, Detector_Save *detector, bool force);
+
+    size_t _dataset_key(data_struct::Stream_Block* stream_block);
+
+    bool _is_dataset_complete(Dataset_Save *dataset);
+
+    void _finalize_dataset(size_t d_hash, Dataset_Save *dataset);
 
-    //by detector_dir + dataset hash
+    //by hash of dataset directory + name
     std::map<size_t, Dataset_Save*> _dataset_map;
 
 };
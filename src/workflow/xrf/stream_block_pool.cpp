@@ -0,0 +1,120 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+
+#include "workflow/xrf/stream_block_pool.h"
+
+namespace workflow
+{
+namespace xrf
+{
+
+//-----------------------------------------------------------------------------
+
+Stream_Block_Pool::Stream_Block_Pool(size_t max_blocks, size_t prefill) : _prefill(prefill), _spectra_size(0), _pool(max_blocks, [this]()
+{
+    data_struct::Stream_Block* stream_block = new data_struct::Stream_Block();
+    stream_block->set_pooled(true);
+    size_t spectra_size = _spectra_size;
+    if (spectra_size > 0)
+    {
+        // reset() keeps it as the spare for the first alloc_spectra()
+        stream_block->alloc_spectra(spectra_size, 0.0, 0.0, 0.0, 0.0);
+        stream_block->reset(0, 0, 0, 0, 0);
+    }
+    return stream_block;
+})
+{
+
+}
+
+//-----------------------------------------------------------------------------
+
+Stream_Block_Pool::~Stream_Block_Pool()
+{
+
+}
+
+//-----------------------------------------------------------------------------
+
+void Stream_Block_Pool::preallocate(size_t spectra_size)
+{
+    if (_spectra_size.exchange(spectra_size) == spectra_size)
+    {
+        return;
+    }
+    _pool.preallocate(_prefill);
+}
+
+//-----------------------------------------------------------------------------
+
+data_struct::Stream_Block* Stream_Block_Pool::acquire(int detector, size_t row, size_t col, size_t height, size_t width)
+{
+    data_struct::Stream_Block* stream_block = _pool.acquire();
+    stream_block->reset(detector, row, col, height, width);
+    return stream_block;
+}
+
+//-----------------------------------------------------------------------------
+
+void Stream_Block_Pool::release(data_struct::Stream_Block* stream_block)
+{
+    if (stream_block == nullptr)
+    {
+        return;
+    }
+    if (false == stream_block->is_pooled())
+    {
+        delete stream_block;
+        return;
+    }
+    _pool.release(stream_block);
+}
+
+//-----------------------------------------------------------------------------
+
+} //namespace xrf
+} //namespace workflow
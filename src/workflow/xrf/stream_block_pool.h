@@ -0,0 +1,103 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+
+#ifndef Stream_Block_Pool_H
+#define Stream_Block_Pool_H
+
+#include "core/defines.h"
+#include "data_struct/stream_block.h"
+#include "workflow/object_pool.h"
+#include <atomic>
+
+namespace workflow
+{
+namespace xrf
+{
+
+//-----------------------------------------------------------------------------
+
+///
+/// \brief The Stream_Block_Pool class : recycles stream blocks, their fitting blocks and spectra between pixels.
+/// Sources acquire blocks and the sink releases them. Blocks the pool did not create are deleted on release.
+///
+class DLL_EXPORT Stream_Block_Pool
+{
+
+public:
+
+    // max_blocks of 0 never blocks, prefill is the number of blocks preallocate() creates
+    Stream_Block_Pool(size_t max_blocks = 0, size_t prefill = 0);
+
+    ~Stream_Block_Pool();
+
+    // called by the source with the detector spectra size, only the first call for a size does any work. Creates the prefill
+    // blocks, every block the pool creates from then on comes with a spectra of spectra_size so sources that decode or sum into it do not allocate.
+    void preallocate(size_t spectra_size);
+
+    // blocks until a block is released once max_blocks are in use
+    data_struct::Stream_Block* acquire(int detector, size_t row, size_t col, size_t height, size_t width);
+
+    void release(data_struct::Stream_Block* stream_block);
+
+    size_t size() { return _pool.size(); }
+
+    size_t max_size() { return _pool.max_size(); }
+
+protected:
+
+    size_t _prefill;
+
+    std::atomic<size_t> _spectra_size;
+
+    Object_Pool<data_struct::Stream_Block> _pool;
+
+};
+
+} //namespace xrf
+} //namespace workflow
+
+#endif // Stream_Block_Pool_H